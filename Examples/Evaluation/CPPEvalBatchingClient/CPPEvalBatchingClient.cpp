@@ -0,0 +1,188 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// CPPEvalBatchingClient.cpp : Load generator comparing the batching evaluation interface with single requests
+//
+
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Eval.h"
+
+using namespace std;
+using namespace Microsoft::MSR::CNTK;
+
+struct LoadParameters
+{
+    size_t numClients;
+    size_t numRequestsPerClient;
+    size_t sequenceLength;
+};
+
+struct LoadResult
+{
+    double seconds;
+    vector<double> latencies; // milliseconds, one per request
+};
+
+// Creates a request with random dense data for all inputs.
+Values<float> CreateInputs(const VariableSchema& inputLayouts, size_t sequenceLength, mt19937& rng)
+{
+    uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+    Values<float> inputs(inputLayouts.size());
+    for (size_t i = 0; i < inputLayouts.size(); i++)
+    {
+        inputs[i].m_buffer.resize(inputLayouts[i].m_numElements * sequenceLength);
+        for (auto& value : inputs[i].m_buffer)
+            value = distribution(rng);
+    }
+    return inputs;
+}
+
+// Runs 'numClients' threads that send requests back to back through 'forwardPass'.
+template <class ForwardPass>
+LoadResult GenerateLoad(const LoadParameters& parameters, const VariableSchema& inputLayouts, const VariableSchema& outputLayouts, ForwardPass forwardPass)
+{
+    vector<vector<double>> latencies(parameters.numClients);
+    vector<thread> clients;
+    auto start = chrono::steady_clock::now();
+    for (size_t c = 0; c < parameters.numClients; c++)
+    {
+        clients.push_back(thread([&, c]()
+        {
+            mt19937 rng((unsigned int)c);
+            Values<float> inputs = CreateInputs(inputLayouts, parameters.sequenceLength, rng);
+            Values<float> outputs(outputLayouts.size());
+            for (size_t i = 0; i < outputLayouts.size(); i++)
+                outputs[i].m_buffer.reserve(outputLayouts[i].m_numElements * parameters.sequenceLength);
+
+            for (size_t r = 0; r < parameters.numRequestsPerClient; r++)
+            {
+                auto requestStart = chrono::steady_clock::now();
+                forwardPass(inputs, outputs);
+                latencies[c].push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - requestStart).count());
+            }
+        }));
+    }
+
+    for (auto& client : clients)
+        client.join();
+
+    LoadResult result;
+    result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    for (const auto& clientLatencies : latencies)
+        result.latencies.insert(result.latencies.end(), clientLatencies.begin(), clientLatencies.end());
+    sort(result.latencies.begin(), result.latencies.end());
+    return result;
+}
+
+void PrintResult(const char* name, const LoadResult& result)
+{
+    auto percentile = [&](double p) { return result.latencies[min(result.latencies.size() - 1, (size_t)(p * result.latencies.size()))]; };
+    fprintf(stdout, "%-10s %8.1f requests/s, latency [ms] p50 %.3f p90 %.3f p99 %.3f max %.3f\n",
+            name, result.latencies.size() / result.seconds, percentile(0.5), percentile(0.9), percentile(0.99), result.latencies.back());
+}
+
+void PrintHistogram(const char* name, const char* unit, const vector<size_t>& histogram)
+{
+    fprintf(stdout, "%s:\n", name);
+    for (size_t i = 0; i < histogram.size(); i++)
+    {
+        if (histogram[i] != 0)
+            fprintf(stdout, "  <= %10" PRIu64 " %s: %" PRIu64 "\n", (uint64_t)1 << i, unit, (uint64_t)histogram[i]);
+    }
+}
+
+/// <summary>
+/// Load generator for the batching evaluation interface located in the <see cref="eval.h"/> file.
+/// A number of client threads send single-sequence requests with random data back to back, first through
+/// IEvaluateModelExtended::ForwardPass (one minibatch per request) and then through
+/// IEvaluateModelBatching::ForwardPass (requests coalesced into minibatches). Throughput, latency percentiles
+/// and the batch size and queue latency histograms of the batching evaluator are printed.
+/// Usage: cppevalbatchingclient modelPath [numClients=32] [numRequestsPerClient=200] [sequenceLength=1]
+///        [maxBatchSize=32] [maxWaitTimeMs=2] [numCPUThreads=1]
+/// </summary>
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s modelPath [numClients] [numRequestsPerClient] [sequenceLength] [maxBatchSize] [maxWaitTimeMs] [numCPUThreads]\n", argv[0]);
+        return 1;
+    }
+
+    auto argument = [&](int i, const char* defaultValue) { return string(argc > i ? argv[i] : defaultValue); };
+    LoadParameters parameters;
+    parameters.numClients = stoul(argument(2, "32"));
+    parameters.numRequestsPerClient = stoul(argument(3, "200"));
+    parameters.sequenceLength = stoul(argument(4, "1"));
+    const string maxBatchSize = argument(5, "32");
+    const string maxWaitTimeMs = argument(6, "2");
+    const string numCPUThreads = argument(7, "1");
+
+    const string modelConfiguration = "modelPath=\"" + string(argv[1]) + "\" deviceId=-1 numCPUThreads=" + numCPUThreads;
+    int ret;
+    try
+    {
+        IEvaluateModelExtended<float>* eval;
+        GetEvalExtendedF(&eval);
+        eval->Init(modelConfiguration);
+        eval->CreateNetwork(modelConfiguration);
+        VariableSchema outputLayouts = eval->GetOutputSchema();
+        eval->StartForwardEvaluation({ outputLayouts[0].m_name });
+        VariableSchema inputLayouts = eval->GetInputSchema();
+        outputLayouts = eval->GetOutputSchema();
+
+        fprintf(stdout, "%" PRIu64 " clients, %" PRIu64 " requests per client, sequence length %" PRIu64 "\n",
+                (uint64_t)parameters.numClients, (uint64_t)parameters.numRequestsPerClient, (uint64_t)parameters.sequenceLength);
+
+        auto single = GenerateLoad(parameters, inputLayouts, outputLayouts,
+                                   [eval](const Values<float>& inputs, Values<float>& outputs) { eval->ForwardPass(inputs, outputs); });
+        eval->Destroy();
+        PrintResult("single", single);
+
+        IEvaluateModelBatching<float>* batchingEval;
+        GetEvalBatchingF(&batchingEval);
+        const string batchingConfiguration = modelConfiguration + " maxBatchSize=" + maxBatchSize + " maxWaitTimeMs=" + maxWaitTimeMs;
+        batchingEval->Init(batchingConfiguration);
+        batchingEval->CreateNetwork(batchingConfiguration);
+        batchingEval->StartForwardEvaluation({ outputLayouts[0].m_name });
+
+        auto batched = GenerateLoad(parameters, inputLayouts, outputLayouts,
+                                    [batchingEval](const Values<float>& inputs, Values<float>& outputs) { batchingEval->ForwardPass(inputs, outputs); });
+        PrintResult("batched", batched);
+
+        BatchingStatistics statistics = batchingEval->GetStatistics();
+        fprintf(stdout, "%" PRIu64 " requests in %" PRIu64 " minibatches\n", (uint64_t)statistics.m_numRequests, (uint64_t)statistics.m_numBatches);
+        PrintHistogram("Batch size", "requests", statistics.m_batchSizeHistogram);
+        PrintHistogram("Queue latency", "us", statistics.m_queueLatencyHistogram);
+        batchingEval->Destroy();
+
+        // This pattern is used by End2EndTests to check whether the program runs to complete.
+        fprintf(stdout, "Evaluation complete.\n");
+        ret = 0;
+    }
+    catch (const std::exception& err)
+    {
+        fprintf(stderr, "Evaluation failed. EXCEPTION occurred: %s\n", err.what());
+        ret = 1;
+    }
+    catch (...)
+    {
+        fprintf(stderr, "Evaluation failed. Unknown ERROR occurred.\n");
+        ret = 1;
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+    return ret;
+}
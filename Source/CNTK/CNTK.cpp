@@ -24,6 +24,7 @@
 #include "ModelEditLanguage.h"
 #include "CPUMatrix.h" // used for SetNumThreads()
 #include "CommonMatrix.h"
+#include "CPUCachingMemAllocator.h"
 #include "SGD.h"
 #include "MPIWrapper.h"
 #include "Config.h"
@@ -123,6 +124,18 @@ void ForceDeterministicAlgorithmsOnCPU()
     CPUMatrix<float /*any type will do*/>::SetCompatibleMode();
 }
 
+// print how the caching CPU allocator performed, if it was enabled
+static void PrintCPUMemoryCacheStatistics()
+{
+    if (!CPUCachingMemAllocator::GetEnabledInstance())
+        return;
+
+    auto statistics = CPUCachingMemAllocator::Instance().GetStatistics();
+    LOGPRINTF(stderr, "CPU memory cache: %.1f%% of %llu allocations served from the cache, %.1f MB peak in use, %.1f MB cached.\n",
+              100 * statistics.GetHitRate(), (unsigned long long) (statistics.m_numHits + statistics.m_numMisses),
+              statistics.m_peakBytesInUse / 1e6, statistics.m_bytesCached / 1e6);
+}
+
 #ifndef CPUONLY
 // abort execution is GPU is not supported (e.g. compute capability not supported)
 void CheckSupportForGpu(DEVICEID_TYPE deviceId)
@@ -194,6 +207,8 @@ void DoCommands(const ConfigParameters& config, const shared_ptr<MPIWrapper>& mp
         {
             LOGPRINTF(stderr, "Using %d CPU threads.\n", numCPUThreads);
         }
+        // accumulate CPU reductions in ElemType instead of double (faster for float, slightly different results)
+        CPUMatrix<ElemType>::UseElemTypeReductionAccumulator(config(L"useElemTypeReductionAccumulator", false));
     }
 
     bool progressTracing = config(L"progressTracing", false);
@@ -510,8 +525,11 @@ int wmainWithBS(int argc, wchar_t* argv[]) // called from wmain which is a wrapp
 
     Globals::SetShareNodeValueMatrices(config(L"shareNodeValueMatrices", true));
     Globals::SetGradientAccumulationOptimization(config(L"optimizeGradientAccumulation", true));
+    Globals::SetPlanMemoryForMinibatchSize(config(L"planMemoryForMinibatchSize", false));
+    Globals::SetUseTiledGemmConvolution(config(L"useTiledGemmConvolution", false));
 
     TracingGPUMemoryAllocator::SetTraceLevel(config(L"traceGPUMemoryAllocations", 0));
+    CPUCachingMemAllocator::Configure(config(L"cacheCPUMemory", false), config(L"useHugePages", false));
 
     // logging
     wstring logpath = config(L"stderr", L"");
@@ -544,6 +562,9 @@ int wmainWithBS(int argc, wchar_t* argv[]) // called from wmain which is a wrapp
         numCPUThreads = CPUMatrix<float /*any will do*/>::SetNumThreads(numCPUThreads);
         if (numCPUThreads > 0)
             LOGPRINTF(stderr, "Using %d CPU threads.\n", numCPUThreads);
+        bool useElemTypeReductionAccumulator = config(L"useElemTypeReductionAccumulator", false);
+        CPUMatrix<float>::UseElemTypeReductionAccumulator(useElemTypeReductionAccumulator);
+        CPUMatrix<double>::UseElemTypeReductionAccumulator(useElemTypeReductionAccumulator);
     }
 
     bool progressTracing = config(L"progressTracing", false);
@@ -579,6 +600,8 @@ int wmainWithBS(int argc, wchar_t* argv[]) // called from wmain which is a wrapp
         fprintf(fp, "successfully finished at %s on %s\n", TimeDateStamp().c_str(), GetHostName().c_str());
         fcloseOrDie(fp);
     }
+    PrintCPUMemoryCacheStatistics();
+
     // TODO: change this back to COMPLETED, double underscores don't look good in output
     LOGPRINTF(stderr, "__COMPLETED__\n");
     fflush(stderr);
@@ -658,8 +681,11 @@ int wmainOldCNTKConfig(int argc, wchar_t* argv[])
 
     Globals::SetShareNodeValueMatrices(config(L"shareNodeValueMatrices", true));
     Globals::SetGradientAccumulationOptimization(config(L"optimizeGradientAccumulation", true));
+    Globals::SetPlanMemoryForMinibatchSize(config(L"planMemoryForMinibatchSize", false));
+    Globals::SetUseTiledGemmConvolution(config(L"useTiledGemmConvolution", false));
 
     TracingGPUMemoryAllocator::SetTraceLevel(config(L"traceGPUMemoryAllocations", 0));
+    CPUCachingMemAllocator::Configure(config(L"cacheCPUMemory", false), config(L"useHugePages", false));
 
     if (logpath != L"")
     {
@@ -756,6 +782,7 @@ int wmainOldCNTKConfig(int argc, wchar_t* argv[])
         fprintf(fp, "Successfully finished at %s on %s\n", TimeDateStamp().c_str(), GetHostName().c_str());
         fcloseOrDie(fp);
     }
+    PrintCPUMemoryCacheStatistics();
     if (ProgressTracing::GetTimestampingFlag())
     {
         LOGPRINTF(stderr, "__COMPLETED__\n"); // running in server environment which expects this string
@@ -289,6 +289,22 @@ namespace CNTK
         CNTK_API void EnableGradientAccumulationOptimization();
         CNTK_API void DisableGradientAccumulationOptimization();
 
+        // Save large tensors of models and checkpoints in an aligned raw section after the protobuf message,
+        // which is memory-mapped by Function::Load (files written this way cannot be read by older versions).
+        CNTK_API void SetRawTensorSectionInModelFiles(bool enable);
+        CNTK_API bool IsRawTensorSectionInModelFilesEnabled();
+
+        // Update all dense CPU parameters of a learner in one fused pass (disabled by default).
+        CNTK_API void SetFusedParameterUpdate(bool enable);
+        CNTK_API bool IsFusedParameterUpdateEnabled();
+
+        // Keep the memory of freed CPU matrices and reader buffers in process-wide free lists for reuse (disabled by default).
+        // With useHugePages, blocks of 2 MB or more are backed by transparent huge pages (Linux only). Disabling only stops
+        // new allocations from being served from the free lists.
+        CNTK_API void EnableCPUMemoryCaching(bool useHugePages = false);
+        CNTK_API void DisableCPUMemoryCaching();
+        CNTK_API bool IsCPUMemoryCachingEnabled();
+
         static const uint64_t DefaultProfilerBufferSize = 32 * 1024 * 1024;
         CNTK_API void StartProfiler(const std::wstring& profilerDir = L"profiler", bool profilerSyncGpu = false, size_t profilerBufferSize = DefaultProfilerBufferSize);
         CNTK_API void EnableProfiler();
@@ -11,6 +11,7 @@
 #include <memory>
 #include <algorithm>
 #include <CPUMatrix.h> // For CPUMatrix::SetNumThreads
+#include "CPUCachingMemAllocator.h"
 #include <thread>
 #include "GPUMatrix.h"
 #include "Globals.h"
@@ -146,6 +147,43 @@ namespace CNTK
             return s_disableAutomaticUnpackingOfPackedValues.load();
         }
 
+        std::atomic<bool> s_rawTensorSectionInModelFiles(false);
+        void SetRawTensorSectionInModelFiles(bool enable)
+        {
+            s_rawTensorSectionInModelFiles.store(enable);
+        }
+
+        bool IsRawTensorSectionInModelFilesEnabled()
+        {
+            return s_rawTensorSectionInModelFiles.load();
+        }
+
+        std::atomic<bool> s_fusedParameterUpdate(false);
+        void SetFusedParameterUpdate(bool enable)
+        {
+            s_fusedParameterUpdate.store(enable);
+        }
+
+        bool IsFusedParameterUpdateEnabled()
+        {
+            return s_fusedParameterUpdate.load();
+        }
+
+        void EnableCPUMemoryCaching(bool useHugePages)
+        {
+            Microsoft::MSR::CNTK::CPUCachingMemAllocator::Configure(/* enabled = */ true, useHugePages);
+        }
+
+        void DisableCPUMemoryCaching()
+        {
+            Microsoft::MSR::CNTK::CPUCachingMemAllocator::Configure(/* enabled = */ false);
+        }
+
+        bool IsCPUMemoryCachingEnabled()
+        {
+            return Microsoft::MSR::CNTK::CPUCachingMemAllocator::GetEnabledInstance() != nullptr;
+        }
+
         void EnableForwardValuesSharing()
         {
             Microsoft::MSR::CNTK::Globals::SetShareNodeValueMatrices(/* enable = */ true);
@@ -468,8 +468,9 @@ namespace CNTK
         auto stream = GetFstream(filepath, true);
         if (!Internal::IsLegacyModel(*stream))
         {
-            Dictionary model;
-            *stream >> model;
+            // Loading from the file (instead of the stream) maps the raw tensor section into memory, if there is one.
+            stream.reset();
+            Dictionary model = Dictionary::Load(filepath);
             return Function::Deserialize(model, computeDevice);
         }
         else
@@ -268,10 +268,48 @@ namespace CNTK
 
         UpdateOnMinibatch(trainingSampleCount);
 
+        // Dense CPU parameters are collected and updated in one fused pass after the loop, if the update rule allows it.
+        FusedParameterUpdateSettings::Options fusedOptions;
+        FusedParameterUpdateSettings::ParameterOptions fusedParameterOptions;
+        unique_ptr<FusedParameterUpdate<float>> fusedUpdateFloat;
+        unique_ptr<FusedParameterUpdate<double>> fusedUpdateDouble;
+        vector<Parameter> fusedParameters;
+        if (Internal::IsFusedParameterUpdateEnabled() &&
+            GetCurrentTrainingParameterValue(m_additionalOptions.gaussianNoiseInjectionStdDev) == 0 &&
+            GetFusedUpdateSettings(trainingSampleCount, fusedOptions, fusedParameterOptions))
+        {
+            // same settings as in PreProcess() and PostProcess()
+            const size_t regularizationMBSize = m_additionalOptions.useMeanGradient ? 1 : trainingSampleCount;
+            if (m_additionalOptions.useMeanGradient)
+                fusedOptions.gradientScale = 1.0 / trainingSampleCount;
+            if (m_additionalOptions.gradientClippingThresholdPerSample != numeric_limits<double>::infinity())
+                fusedOptions.clippingThreshold = m_additionalOptions.gradientClippingThresholdPerSample * regularizationMBSize;
+            fusedOptions.clippingWithTruncation = m_additionalOptions.gradientClippingWithTruncation;
+            fusedParameterOptions.learningRate = LearningRate(trainingSampleCount);
+            fusedParameterOptions.l2RegWeight = m_additionalOptions.l2RegularizationWeight * regularizationMBSize;
+            fusedParameterOptions.l1Threshold = fusedParameterOptions.learningRate * m_additionalOptions.l1RegularizationWeight * regularizationMBSize;
+
+            fusedUpdateFloat.reset(new FusedParameterUpdate<float>(fusedOptions));
+            fusedUpdateDouble.reset(new FusedParameterUpdate<double>(fusedOptions));
+        }
+
         for (const auto& parameter : Parameters())
         {
             const auto& smoothedGradientValue = m_smoothedGradientValues.at(parameter);
             const auto& gradientValue = gradientValues.at(parameter);
+
+            if (fusedUpdateFloat)
+            {
+                const bool hasSmoothedGradient = fusedOptions.rule != FusedParameterUpdateSettings::Rule::SGD;
+                bool added = smoothedGradientValue->GetDataType() == DataType::Float ?
+                             AddToFusedUpdate<float>(*fusedUpdateFloat, parameter, gradientValue, smoothedGradientValue, hasSmoothedGradient, fusedParameterOptions) :
+                             AddToFusedUpdate<double>(*fusedUpdateDouble, parameter, gradientValue, smoothedGradientValue, hasSmoothedGradient, fusedParameterOptions);
+                if (added)
+                {
+                    fusedParameters.push_back(parameter);
+                    continue;
+                }
+            }
             // TODO: make this a runtime parameter.
 #if DUMPOUTPUT
             LOGPRINTF(stderr, "Update_%ls\n", parameter.Uid().c_str());
@@ -304,6 +342,15 @@ namespace CNTK
                 LogicError("%ls has NaNs in parameter values after parameter update.", parameter.Uid().c_str());
 #endif
         }
+
+        if (!fusedParameters.empty())
+        {
+            fusedUpdateFloat->Apply();
+            fusedUpdateDouble->Apply();
+            for (auto& parameter : fusedParameters)
+                parameter.RecordValueUpdate();
+        }
+
         m_sampleCount += trainingSampleCount;
         m_minibatchCount++;
         if (sweepEnd)
@@ -327,6 +374,22 @@ namespace CNTK
         paramRef.RecordValueUpdate();
     }
 
+    template <typename ElementType>
+    /*static*/ bool LearnerBase::AddToFusedUpdate(FusedParameterUpdate<ElementType>& fusedUpdate, const Parameter& parameter,
+                                                  const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, bool hasSmoothedGradient,
+                                                  const FusedParameterUpdateSettings::ParameterOptions& parameterOptions)
+    {
+        const auto& parameterMatrix = GetWritableMatrix<ElementType>(parameter.Value());
+        const auto& gradientMatrix = GetWritableMatrix<ElementType>(gradientValue);
+        // plain SGD has no smoothed gradient (a dummy scalar view is allocated), the argument is not used then
+        const auto& smoothedGradientMatrix = hasSmoothedGradient ? GetWritableMatrix<ElementType>(smoothedGradientValue) : gradientMatrix;
+        if (!fusedUpdate.CanAdd(*parameterMatrix, *gradientMatrix, *smoothedGradientMatrix))
+            return false;
+
+        fusedUpdate.Add(*parameterMatrix, *gradientMatrix, *smoothedGradientMatrix, parameterOptions);
+        return true;
+    }
+
     string LearnerBase::LearnerType() const
     {
         return Typename(this);
@@ -485,6 +548,14 @@ namespace CNTK
         parameterMatrix->SGDUpdate(*gradientMatrix, learningRate);
     }
 
+    /*virtual*/ bool LearnerSGD::GetFusedUpdateSettings(size_t /*trainingSampleCount*/,
+                                                        FusedParameterUpdateSettings::Options& options,
+                                                        FusedParameterUpdateSettings::ParameterOptions& /*parameterOptions*/) const /*override*/
+    {
+        options.rule = FusedParameterUpdateSettings::Rule::SGD;
+        return true;
+    }
+
     double LearnerMomentumSGD::MomentumValueForMB(const MomentumSchedule& schedule, size_t minibatchSize) const
     {
         double currentMomentum = GetCurrentTrainingParameterValue(schedule);
@@ -520,6 +591,18 @@ namespace CNTK
                                            learningRate, momentum, UseUnitGainMomentum());
     }
 
+    /*virtual*/ bool LearnerMomentumSGD::GetFusedUpdateSettings(size_t trainingSampleCount,
+                                                                FusedParameterUpdateSettings::Options& options,
+                                                                FusedParameterUpdateSettings::ParameterOptions& parameterOptions) const /*override*/
+    {
+        ReportTrainingParameterValue(m_momentumSchedule, L"Momentum");
+
+        options.rule = FusedParameterUpdateSettings::Rule::MomentumSGD;
+        options.unitGainMomentum = UseUnitGainMomentum();
+        parameterOptions.momentum = MomentumValueForMB(trainingSampleCount);
+        return true;
+    }
+
     /*virtual*/ void LearnerNesterov::Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, 
                                              const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const /*override*/
     {
@@ -539,6 +622,16 @@ namespace CNTK
                                                               learningRate, momentum, UseUnitGainMomentum());
     }
 
+    /*virtual*/ bool LearnerNesterov::GetFusedUpdateSettings(size_t trainingSampleCount,
+                                                             FusedParameterUpdateSettings::Options& options,
+                                                             FusedParameterUpdateSettings::ParameterOptions& parameterOptions) const /*override*/
+    {
+        options.rule = FusedParameterUpdateSettings::Rule::Nesterov;
+        options.unitGainMomentum = UseUnitGainMomentum();
+        parameterOptions.momentum = MomentumValueForMB(trainingSampleCount);
+        return true;
+    }
+
     LearnerAdaGrad::LearnerAdaGrad(const std::vector<Parameter>& parameters,
                                    const LearningRateSchedule& learningRateSchedule,
                                    bool needAveMultiplier,
@@ -687,6 +780,18 @@ namespace CNTK
                                                 momentum, varMomentum, UseUnitGainMomentum());
     }
 
+    /*virtual*/ bool LearnerFSAdaGrad::GetFusedUpdateSettings(size_t trainingSampleCount,
+                                                              FusedParameterUpdateSettings::Options& options,
+                                                              FusedParameterUpdateSettings::ParameterOptions& parameterOptions) const /*override*/
+    {
+        options.rule = FusedParameterUpdateSettings::Rule::FSAdaGrad;
+        options.unitGainMomentum = UseUnitGainMomentum();
+        options.varMomentum = VarianceMomentumValueForMB(trainingSampleCount);
+        parameterOptions.momentum = MomentumValueForMB(trainingSampleCount);
+        parameterOptions.adaMul = m_targetAdagradAvDenom_x_sqrtAdagradSqrFrames;
+        return true;
+    }
+
     LearnerAdam::LearnerAdam(const vector<Parameter>& parameters,
         const LearningRateSchedule& learningRateSchedule,
         const MomentumSchedule& momentumSchedule,
@@ -760,6 +865,25 @@ namespace CNTK
                                            momentum, varMomentum, (ElementType)m_epsilon, UseUnitGainMomentum(), m_adamax);
     }
 
+    /*virtual*/ bool LearnerAdam::GetFusedUpdateSettings(size_t trainingSampleCount,
+                                                         FusedParameterUpdateSettings::Options& options,
+                                                         FusedParameterUpdateSettings::ParameterOptions& parameterOptions) const /*override*/
+    {
+        const auto momentum = MomentumValueForMB(trainingSampleCount);
+        const auto varMomentum = VarianceMomentumValueForMB(trainingSampleCount);
+
+        options.rule = FusedParameterUpdateSettings::Rule::Adam;
+        options.unitGainMomentum = UseUnitGainMomentum();
+        options.varMomentum = varMomentum;
+        options.epsilon = m_epsilon;
+        options.adamax = m_adamax;
+        parameterOptions.momentum = momentum;
+        // bias correction, as in Matrix::AdamUpdate()
+        parameterOptions.adaMul = m_adamax ? 1.0 / (1.0 - pow(momentum, m_smoothedCount))
+                                           : sqrt(1.0 - pow(varMomentum, m_smoothedCount)) / (1.0 - pow(momentum, m_smoothedCount));
+        return true;
+    }
+
     LearnerRMSProp::LearnerRMSProp(const vector<Parameter>& parameters,
                                    const LearningRateSchedule& learningRateSchedule,
                                    double gamma, double inc, double dec, double max, double min,
@@ -7,6 +7,7 @@
 
 #include "stdafx.h"
 #include "CNTKLibrary.h"
+#include "FusedParameterUpdate.h"
 #include <numeric>
 #include <functional>
 
@@ -43,6 +44,15 @@ namespace CNTK
         // Allows derived class may override this to perform per-minibatch update actions
         virtual void UpdateOnMinibatch(size_t /*trainingSampleCount*/) {}
 
+        // Learners whose update rule is implemented by FusedParameterUpdate override this to provide the rule specific
+        // settings for the current minibatch; their dense CPU parameters are then updated all at once instead of one by one.
+        virtual bool GetFusedUpdateSettings(size_t /*trainingSampleCount*/,
+                                            Microsoft::MSR::CNTK::FusedParameterUpdateSettings::Options& /*options*/,
+                                            Microsoft::MSR::CNTK::FusedParameterUpdateSettings::ParameterOptions& /*parameterOptions*/) const
+        {
+            return false;
+        }
+
         std::string LearnerType() const;
 
         // Returns current (per-sample) learning rate.
@@ -110,6 +120,12 @@ namespace CNTK
         template <typename ElementType>
         void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const;
 
+        // Adds the parameter to the fused update if its matrices allow it, returns false otherwise.
+        template <typename ElementType>
+        static bool AddToFusedUpdate(Microsoft::MSR::CNTK::FusedParameterUpdate<ElementType>& fusedUpdate, const Parameter& parameter,
+                                     const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, bool hasSmoothedGradient,
+                                     const Microsoft::MSR::CNTK::FusedParameterUpdateSettings::ParameterOptions& parameterOptions);
+
         // TODO: make these functions friends of NDViewArray and move to Utils?
         static bool HasNan(const NDArrayViewPtr& value, const char* name);
         static void Print(const NDArrayViewPtr& value, const char* msg);
@@ -134,6 +150,10 @@ namespace CNTK
 
         virtual void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const override;
 
+        virtual bool GetFusedUpdateSettings(size_t trainingSampleCount,
+                                            Microsoft::MSR::CNTK::FusedParameterUpdateSettings::Options& options,
+                                            Microsoft::MSR::CNTK::FusedParameterUpdateSettings::ParameterOptions& parameterOptions) const override;
+
         template <typename ElementType>
         void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const;
     };
@@ -162,6 +182,10 @@ namespace CNTK
     protected:
         virtual void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const override;
 
+        virtual bool GetFusedUpdateSettings(size_t trainingSampleCount,
+                                            Microsoft::MSR::CNTK::FusedParameterUpdateSettings::Options& options,
+                                            Microsoft::MSR::CNTK::FusedParameterUpdateSettings::ParameterOptions& parameterOptions) const override;
+
         template <typename ElementType>
         void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const;
 
@@ -196,6 +220,10 @@ namespace CNTK
     protected:
         virtual void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const override;
 
+        virtual bool GetFusedUpdateSettings(size_t trainingSampleCount,
+                                            Microsoft::MSR::CNTK::FusedParameterUpdateSettings::Options& options,
+                                            Microsoft::MSR::CNTK::FusedParameterUpdateSettings::ParameterOptions& parameterOptions) const override;
+
         template <typename ElementType>
         void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const;
     };
@@ -258,6 +286,10 @@ namespace CNTK
         virtual void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const override;
         virtual void UpdateOnMinibatch(size_t trainingSampleCount) override;
 
+        virtual bool GetFusedUpdateSettings(size_t trainingSampleCount,
+                                            Microsoft::MSR::CNTK::FusedParameterUpdateSettings::Options& options,
+                                            Microsoft::MSR::CNTK::FusedParameterUpdateSettings::ParameterOptions& parameterOptions) const override;
+
         template <typename ElementType>
         void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const;
 
@@ -299,6 +331,10 @@ namespace CNTK
         virtual void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const override;
         virtual void UpdateOnMinibatch(size_t trainingSampleCount) override;
 
+        virtual bool GetFusedUpdateSettings(size_t trainingSampleCount,
+                                            Microsoft::MSR::CNTK::FusedParameterUpdateSettings::Options& options,
+                                            Microsoft::MSR::CNTK::FusedParameterUpdateSettings::ParameterOptions& parameterOptions) const override;
+
         template <typename ElementType>
         void Update(const Parameter& parameter, const NDArrayViewPtr& gradientValue, const NDArrayViewPtr& smoothedGradientValue, size_t trainingSampleCount) const;
 
@@ -53,6 +53,17 @@ namespace CNTK
         }
     }
 
+    template <typename ElementType>
+    static TensorView<ElementType>* AllocateTensorView(const NDShape& viewShape,
+                                                       void* dataBuffer,
+                                                       const std::shared_ptr<void>& bufferOwner)
+    {
+        auto matrixDims = GetMatrixDimensions(viewShape);
+        std::shared_ptr<Matrix<ElementType>> matrix = std::make_shared<Matrix<ElementType>>(CPUDEVICE);
+        matrix->AttachExternalBuffer(matrixDims.first, matrixDims.second, (ElementType*)dataBuffer, bufferOwner);
+        return new TensorView<ElementType>(matrix, AsTensorViewShape(viewShape));
+    }
+
     template <typename ElementType>
     static TensorView<ElementType>* AllocateTensorView(const NDShape& viewShape,
                                                        CNTK::StorageFormat storageType,
@@ -129,6 +140,28 @@ namespace CNTK
         : NDArrayView(dataType, device, storageType, viewShape, false, AllocateTensorView(dataType, storageType, viewShape, device))
     {}
 
+    /*static*/ NDArrayView* Utils::NewReadOnlyNDArrayView(CNTK::DataType dataType, const NDShape& viewShape, void* dataBuffer, const std::shared_ptr<void>& bufferOwner)
+    {
+        if (dataBuffer == nullptr)
+            InvalidArgument("Cannot create a NDArrayView over a null data buffer.");
+
+        void* tensorView = nullptr;
+        switch (dataType)
+        {
+        case DataType::Float:
+            tensorView = AllocateTensorView<float>(viewShape, dataBuffer, bufferOwner);
+            break;
+        case DataType::Double:
+            tensorView = AllocateTensorView<double>(viewShape, dataBuffer, bufferOwner);
+            break;
+        default:
+            LogicError("Unsupported DataType %s", DataTypeName(dataType));
+            break;
+        }
+
+        return new NDArrayView(dataType, DeviceDescriptor::CPUDevice(), StorageFormat::Dense, viewShape, /*readOnly =*/ true, tensorView);
+    }
+
     NDArrayView::~NDArrayView()
     {}
 
@@ -6,6 +6,8 @@
 #include "stdafx.h"
 #include "CNTKLibrary.h"
 #include "Utils.h"
+#include "File.h"
+#include <algorithm>
 #include <istream>
 #include <ostream>
 #include <string>
@@ -31,6 +33,22 @@ namespace CNTK
     static const uint32 MAGIC_NUMBER = 0x636e746bU;
     static const uint32 BLOCK_SIZE = 8 << 10; // 8Kb;
 
+    // Models with a raw tensor section are prefixed with this magic number and the message size (like the ones
+    // over 2GBs). The values of tensors of at least RAW_TENSOR_MIN_SIZE bytes are stored after the message instead
+    // of inside it: the section starts at a multiple of RAW_SECTION_ALIGNMENT, so that it can be used in place
+    // when the file is memory-mapped, and every tensor at a multiple of RAW_TENSOR_ALIGNMENT (in native byte order).
+    // The first byte of the magic number is not a valid protobuf tag (wire type 7), so older versions reject the file.
+    static const uint32 RAW_SECTION_MAGIC_NUMBER = 0x636e7477U;
+    static const size_t RAW_SECTION_HEADER_SIZE = 2 * sizeof(uint32);
+    static const size_t RAW_SECTION_ALIGNMENT = 4096;
+    static const size_t RAW_TENSOR_ALIGNMENT = 64;
+    static const size_t RAW_TENSOR_MIN_SIZE = 4096;
+
+    static uint64 AlignUp(uint64 value, uint64 alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
     static void SetUTF8Locale()
     {
 #ifndef _MSC_VER
@@ -141,6 +159,7 @@ namespace CNTK
         
         void CopyNDArrayViewDataToProtos();
         void WriteNDArrayViewData(io::CodedOutputStream& output);
+        void WriteWithRawSection(io::CodedOutputStream& output);
 
         std::ostream& Write(std::ostream& stream);
         void Write(const std::wstring& filename);
@@ -157,6 +176,8 @@ namespace CNTK
         bool Read(std::istream& stream, const std::function<bool(io::ZeroCopyInputStream& input)>& callback);
 
         bool ReadNDArrayViewData(io::ZeroCopyInputStream& input);
+        bool ReadRawNDArrayViewData(io::ZeroCopyInputStream& input);
+        void MapFile(const std::wstring& filename);
 
         size_t GetTotalByteSize() 
         {
@@ -278,13 +299,39 @@ namespace CNTK
             memcpy(buffer, src.data(), size * sizeof(T));
         }
 
-        
+        template <typename T>
+        static bool ReadRawData(io::ZeroCopyInputStream& input, NDArrayView& dst)
+        {
+            char* buffer = reinterpret_cast<char*>(dst.WritableDataBuffer<T>());
+            size_t size = dst.Shape().TotalSize() * sizeof(T);
+            while (size > 0)
+            {
+                const void* data;
+                int available;
+                if (!input.Next(&data, &available))
+                    return false;
+                size_t count = std::min(size, static_cast<size_t>(available));
+                memcpy(buffer, data, count);
+                if (count < available)
+                    input.BackUp(available - static_cast<int>(count));
+                buffer += count;
+                size -= count;
+            }
+            return true;
+        }
 
         UsingUTF8 m_locale;
         Arena m_arena;
         Message* m_proto;
         std::vector<std::pair<NDArrayView*, proto::NDArrayView*>> m_arrayViews;
         size_t m_byteSize {0};
+
+        // Models with a raw tensor section: the offset of the section (0 - no raw section), the tensors that have to
+        // be read from it and the mapped file, if the model is read from a file.
+        uint64 m_rawSectionOffset {0};
+        std::vector<std::pair<NDArrayView*, uint64>> m_rawArrayViews;
+        std::shared_ptr<void> m_mapping;
+        uint64 m_mappingSize {0};
     };
 
 
@@ -331,8 +378,117 @@ namespace CNTK
         }
     }
 
+    void Serializer::WriteWithRawSection(io::CodedOutputStream& output)
+    {
+        // Move the large tensors out of the message. Their offsets are fixed64 fields and never 0,
+        // so the message size does not depend on their values and can be determined upfront.
+        std::vector<std::pair<const NDArrayView*, proto::NDArrayView*>> rawArrayViews;
+        for (auto& pair : m_arrayViews)
+        {
+            const auto& src = *(pair.first);
+            auto dst = pair.second;
+            if (src.Shape().TotalSize() * DataTypeSize(src.GetDataType()) >= RAW_TENSOR_MIN_SIZE)
+            {
+                dst->set_raw_values_offset(1);
+                rawArrayViews.push_back(pair);
+            }
+            else if (src.GetDataType() == DataType::Float)
+            {
+                CopyData<float>(src, dst->mutable_float_values()->mutable_value());
+            }
+            else if (src.GetDataType() == DataType::Double)
+            {
+                CopyData<double>(src, dst->mutable_double_values()->mutable_value());
+            }
+        }
+
+        size_t messageSize = m_proto->ByteSizeLong();
+        if (messageSize >= static_cast<size_t>(INT_MAX))
+            RuntimeError("Serializer: the model description exceeds 2GBs even without the tensor values.");
+
+        uint64 offset = AlignUp(RAW_SECTION_HEADER_SIZE + messageSize, RAW_SECTION_ALIGNMENT);
+        for (auto& pair : rawArrayViews)
+        {
+            pair.second->set_raw_values_offset(offset);
+            offset = AlignUp(offset + pair.first->Shape().TotalSize() * DataTypeSize(pair.first->GetDataType()), RAW_TENSOR_ALIGNMENT);
+        }
+
+        output.WriteLittleEndian32(RAW_SECTION_MAGIC_NUMBER);
+        output.WriteLittleEndian32(static_cast<uint32>(messageSize));
+        m_proto->SerializeToCodedStream(&output);
+
+        static const char padding[RAW_SECTION_ALIGNMENT] = {};
+        uint64 position = RAW_SECTION_HEADER_SIZE + messageSize;
+        for (auto& pair : rawArrayViews)
+        {
+            const auto& src = *(pair.first);
+            uint64 tensorOffset = pair.second->raw_values_offset();
+            output.WriteRaw(padding, static_cast<int>(tensorOffset - position));
+
+            const char* buffer = (src.GetDataType() == DataType::Float) ?
+                reinterpret_cast<const char*>(src.DataBuffer<float>()) : reinterpret_cast<const char*>(src.DataBuffer<double>());
+            size_t size = src.Shape().TotalSize() * DataTypeSize(src.GetDataType());
+            position = tensorOffset + size;
+            while (size > 0)
+            {
+                int count = static_cast<int>(std::min(size, static_cast<size_t>(INT_MAX / 2)));
+                output.WriteRaw(buffer, count);
+                buffer += count;
+                size -= count;
+            }
+        }
+    }
+
+    bool Serializer::ReadRawNDArrayViewData(io::ZeroCopyInputStream& input)
+    {
+        if (m_rawSectionOffset == 0)
+            return false;
+
+        // The stream is positioned right after the message, the tensors are read in the order of their offsets.
+        std::sort(m_rawArrayViews.begin(), m_rawArrayViews.end(),
+                  [](const std::pair<NDArrayView*, uint64>& a, const std::pair<NDArrayView*, uint64>& b) { return a.second < b.second; });
+        uint64 position = m_rawSectionOffset;
+        for (auto& pair : m_rawArrayViews)
+        {
+            auto& dst = *(pair.first);
+            if (pair.second < position)
+                return false;
+            for (uint64 skip = pair.second - position; skip > 0;)
+            {
+                int count = static_cast<int>(std::min(skip, static_cast<uint64>(INT_MAX)));
+                if (!input.Skip(count))
+                    return false;
+                skip -= count;
+            }
+
+            if (dst.GetDataType() == DataType::Float)
+            {
+                if (!ReadRawData<float>(input, dst))
+                    return false;
+            }
+            else if (dst.GetDataType() == DataType::Double)
+            {
+                if (!ReadRawData<double>(input, dst))
+                    return false;
+            }
+            position = pair.second + dst.Shape().TotalSize() * DataTypeSize(dst.GetDataType());
+        }
+        return true;
+    }
+
+    void Serializer::MapFile(const std::wstring& filename)
+    {
+        // Without a mapping (e.g. the file system does not support it), the tensors are read instead.
+        Microsoft::MSR::CNTK::File file(filename, Microsoft::MSR::CNTK::fileOptionsBinary | Microsoft::MSR::CNTK::fileOptionsRead | Microsoft::MSR::CNTK::fileOptionsMemoryMapped);
+        m_mapping = file.GetMapping();
+        m_mappingSize = file.GetMappingSize();
+    }
+
     bool Serializer::ReadNDArrayViewData(io::ZeroCopyInputStream& input)
     {
+        if (m_rawArrayViews.size() != 0)
+            return m_arrayViews.size() == 0 && ReadRawNDArrayViewData(input);
+
         if (m_arrayViews.size() == 0)
             return true;
 
@@ -430,6 +586,22 @@ namespace CNTK
         std::unique_ptr<NDShape> shape(CreateFromProto(src.shape()));
         auto dataType = FromProtoType(src.data_type());
         auto storageFormat = FromProtoType(src.storage_format());
+        if (src.raw_values_offset() != 0)
+        {
+            // The values are stored in the raw tensor section, use them in place if the file is mapped.
+            uint64 offset = src.raw_values_offset();
+            uint64 size = shape->TotalSize() * DataTypeSize(dataType);
+            if (m_mapping && storageFormat == StorageFormat::Dense && m_rawSectionOffset != 0 &&
+                offset >= m_rawSectionOffset && offset <= m_mappingSize && size <= m_mappingSize - offset && offset % RAW_TENSOR_ALIGNMENT == 0)
+            {
+                return Utils::NewReadOnlyNDArrayView(dataType, *shape, static_cast<char*>(m_mapping.get()) + offset, m_mapping);
+            }
+
+            NDArrayView* dst = new NDArrayView(dataType, storageFormat, *shape, DeviceDescriptor::CPUDevice());
+            m_rawArrayViews.push_back({ dst, offset });
+            return dst;
+        }
+
         NDArrayView* dst = new NDArrayView(dataType, storageFormat, *shape, DeviceDescriptor::CPUDevice());
 
         if (dataType == DataType::Float)
@@ -611,6 +783,12 @@ namespace CNTK
     void Serializer::Write(io::ZeroCopyOutputStream& stream) {
         io::CodedOutputStream output(&stream);
 
+        if (Internal::IsRawTensorSectionInModelFilesEnabled())
+        {
+            WriteWithRawSection(output);
+            return;
+        }
+
         // Protobufs have a hard limit on the maximum message size(INT_MAX = 2GBs). 
         // Check if we fit into a single protobuf message.
         if (FitsIntoProtobuf())
@@ -651,8 +829,11 @@ namespace CNTK
 #endif
     }
 
-    bool ParseMessage(io::ZeroCopyInputStream& input, Message& msg)
+    // Returns the number of bytes of the prefix and the message in 'rawSectionOffset' if the message is followed by
+    // a raw tensor section, 0 otherwise.
+    bool ParseMessage(io::ZeroCopyInputStream& input, Message& msg, uint64& rawSectionOffset)
     {
+        rawSectionOffset = 0;
         uint32 prefix = 0, limit = INT_MAX;;
         const void* temp;
         int size;
@@ -670,13 +851,16 @@ namespace CNTK
         }
 
         // the message is only prefixed with a magic number + message length,
-        // if its size exceeds 2GBs.
-        if (prefix == MAGIC_NUMBER) 
+        // if its size exceeds 2GBs or if it is followed by a raw tensor section.
+        if (prefix == MAGIC_NUMBER || prefix == RAW_SECTION_MAGIC_NUMBER) 
         {
             io::CodedInputStream::ReadLittleEndian32FromArray(
                 reinterpret_cast<const uint8*>(temp) + sizeof(prefix), &limit);
 
             input.BackUp(size - sizeof(prefix) - sizeof(limit));
+
+            if (prefix == RAW_SECTION_MAGIC_NUMBER)
+                rawSectionOffset = RAW_SECTION_HEADER_SIZE + limit;
         }
         else 
             input.BackUp(size);
@@ -729,7 +913,9 @@ namespace CNTK
         auto fd = GetFileDescriptor(filename, true);
         {
             io::FileInputStream input(fd, BLOCK_SIZE);
-            result = ParseMessage(input, *m_proto);
+            result = ParseMessage(input, *m_proto, m_rawSectionOffset);
+            if (result && m_rawSectionOffset != 0)
+                MapFile(filename);
             result = result && callback(input);
         }
 #ifdef _MSC_VER
@@ -743,7 +929,7 @@ namespace CNTK
     bool Serializer::Read(std::istream& stream, const std::function<bool(io::ZeroCopyInputStream& input)>& callback)
     {
         io::IstreamInputStream input(&stream, BLOCK_SIZE);
-        if (ParseMessage(input, *m_proto))
+        if (ParseMessage(input, *m_proto, m_rawSectionOffset))
         {
             return callback(input);
         }
@@ -699,6 +699,10 @@ namespace CNTK
         }
         static void VerifyVariableValueCompatibility(const Variable& var, const ValuePtr& value, NDShape* inferredVarShape = nullptr);
 
+        // Creates a read-only dense CPU view over an external buffer (e.g. a memory-mapped model file) without copying it.
+        // 'bufferOwner' is kept alive as long as the view or any alias of it exists.
+        static NDArrayView* NewReadOnlyNDArrayView(DataType dataType, const NDShape& viewShape, void* dataBuffer, const std::shared_ptr<void>& bufferOwner);
+
         template <typename ElementType>
         static std::pair<std::shared_ptr<const Microsoft::MSR::CNTK::Matrix<ElementType>>, Microsoft::MSR::CNTK::MBLayoutPtr>
         GetCNTKImplMatrixAndMBLayoutFromValueObject(const Variable& var, const ValuePtr& value, NDShape* inferredVarShape,
@@ -513,7 +513,9 @@ namespace CNTK
 
             // TODO: this copying here is redundant, value should be moved from the dictionary to the variable.
             // Also, the correct device should be used upfront when deserializing NDArrayView.
-            Variable var(shape, kind, dataType, value.DeepClone(device, kind == VariableKind::Constant), needsGradient, dynamicAxis, isSparse, name, uid);
+            // Read-only values (mapped from a model file with a raw tensor section) are used in place by constants.
+            bool useInPlace = kind == VariableKind::Constant && value.IsReadOnly() && value.Device() == device;
+            Variable var(shape, kind, dataType, useInPlace ? value.Alias(/*readOnly =*/ true) : value.DeepClone(device, kind == VariableKind::Constant), needsGradient, dynamicAxis, isSparse, name, uid);
             if (var.IsParameter())
                 return Parameter(var);
             else
@@ -190,6 +190,22 @@ bool DataReader::SupportsDistributedMBRead() const
     return supportsDistributedMBRead;
 }
 
+//GetInputStreamDescriptions - Returns the streams of all readers
+std::vector<InputStreamDescription> DataReader::GetInputStreamDescriptions(int deviceId)
+{
+    std::vector<InputStreamDescription> streams;
+    for (size_t i = 0; i < m_ioNames.size(); i++)
+    {
+        auto currReaderIter = m_dataReaders.find(m_ioNames[i]);
+        assert(currReaderIter != m_dataReaders.end());
+
+        auto readerStreams = currReaderIter->second->GetInputStreamDescriptions(deviceId);
+        streams.insert(streams.end(), readerStreams.begin(), readerStreams.end());
+    }
+
+    return streams;
+}
+
 //IsLegacyReader - Returns true if one of the readers is a legacy reader, false otherwise.
 bool DataReader::IsLegacyReader() const
 {
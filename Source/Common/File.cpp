@@ -25,6 +25,8 @@
 #endif
 #ifdef __unix__
 #include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <linux/limits.h> // for PATH_MAX
 #endif
 
@@ -123,6 +125,7 @@ void File::Init(const wchar_t* filename, int fileOptions)
     //  - "cmd|" reads from a pipe
     m_pcloseNeeded = false;
     m_seekable = false;
+    m_mappingSize = 0;
     if (m_filename == L"-") // stdin/stdout
     {
         if (writing && reading)
@@ -147,6 +150,55 @@ void File::Init(const wchar_t* filename, int fileOptions)
                     m_file = fopenOrDie(filename, options.c_str());
                     m_seekable = true;
                 });
+    if (m_seekable && reading && !writing && (fileOptions & fileOptionsBinary) && (fileOptions & fileOptionsMemoryMapped))
+        MapFile();
+}
+
+// map the whole file copy-on-write, in addition to the regular stream, so that TryGetMappedArray() can hand out
+// aligned payloads without reading them. The mapping outlives the file if references to it are kept.
+// On failure a warning is printed and everything is read through the stream.
+void File::MapFile()
+{
+#ifdef _WIN32
+    HANDLE fileHandle = (HANDLE)_get_osfhandle(_fileno(m_file));
+    LARGE_INTEGER size;
+    if (fileHandle == INVALID_HANDLE_VALUE || !GetFileSizeEx(fileHandle, &size))
+    {
+        fprintf(stderr, "WARNING: File: cannot determine the size of '%ls', it is not memory-mapped.\n", m_filename.c_str());
+        return;
+    }
+    if (size.QuadPart == 0)
+        return;
+    HANDLE mappingHandle = CreateFileMappingW(fileHandle, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+    void* data = mappingHandle ? MapViewOfFile(mappingHandle, FILE_MAP_COPY, 0, 0, 0) : nullptr;
+    if (mappingHandle)
+        CloseHandle(mappingHandle); // the view keeps the mapping alive
+    if (!data)
+    {
+        fprintf(stderr, "WARNING: File: cannot memory-map '%ls' (error %d), it is read instead.\n", m_filename.c_str(), (int)GetLastError());
+        return;
+    }
+    m_mapping.reset(data, [](void* p) { UnmapViewOfFile(p); });
+    m_mappingSize = size.QuadPart;
+#else
+    struct stat fileStat;
+    if (fstat(fileno(m_file), &fileStat) != 0)
+    {
+        fprintf(stderr, "WARNING: File: cannot determine the size of '%ls', it is not memory-mapped.\n", m_filename.c_str());
+        return;
+    }
+    if (fileStat.st_size == 0)
+        return;
+    size_t size = fileStat.st_size;
+    void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(m_file), 0);
+    if (data == MAP_FAILED)
+    {
+        fprintf(stderr, "WARNING: File: cannot memory-map '%ls' (%s), it is read instead.\n", m_filename.c_str(), strerror(errno));
+        return;
+    }
+    m_mapping.reset(data, [size](void* p) { munmap(p, size); });
+    m_mappingSize = size;
+#endif
 }
 
 // determine the directory for a given pathname
@@ -845,6 +897,17 @@ void File::SetPosition(uint64_t pos)
     fsetpos(m_file, pos);
 }
 
+// GetPayloadPadding - number of bytes to insert before a header of 'headerSize' bytes, so that the payload that
+// follows it starts at a multiple of PayloadAlignment
+// granularity - the padding must be a multiple of this (e.g. the size of the padding characters)
+size_t File::GetPayloadPadding(size_t headerSize, size_t payloadSize, size_t granularity)
+{
+    if (IsTextBased() || !CanSeek() || payloadSize < PayloadAlignment)
+        return 0;
+    size_t padding = (size_t)((PayloadAlignment - (GetPosition() + headerSize) % PayloadAlignment) % PayloadAlignment);
+    return padding % granularity == 0 ? padding : 0;
+}
+
 // helper to load a matrix from a stream (file or string literal)
 // The input string is expected to contain one line per matrix row (natural printing order for humans).
 // Inputs:
@@ -10,5 +10,7 @@
 // The default threshold size to pack a gradient into a continuous buffer during aggregation for less MPI ops.
 const size_t DEFAULT_PACK_THRESHOLD_SIZE_IN_KB = 32;
 const size_t DEFAULT_PACK_THRESHOLD_SIZE_IN_BYTES = DEFAULT_PACK_THRESHOLD_SIZE_IN_KB * 1024;
+// The default size of the buckets of gradients that are reduced together when overlapping the aggregation with backprop.
+const size_t DEFAULT_GRADIENT_BUCKET_SIZE_IN_KB = 25 * 1024;
 
 #endif
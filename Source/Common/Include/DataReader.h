@@ -253,6 +253,13 @@ public:
         NOT_IMPLEMENTED;
     }
 
+    // Gets the descriptions of all streams the reader provides, for matrices on the given device.
+    // Allows to drive a reader without a network. Legacy readers do not know their streams upfront.
+    virtual std::vector<InputStreamDescription> GetInputStreamDescriptions(int /*deviceId*/)
+    {
+        return {};
+    }
+
     virtual void StartDistributedMinibatchLoop(size_t mbSize, size_t epoch, size_t subsetNum, size_t numSubsets, size_t requestedEpochSamples = requestDataSize)
     {
         if (SupportsDistributedMBRead() || (numSubsets != 1) || (subsetNum != 0))
@@ -426,6 +433,8 @@ public:
 
     size_t GetCurrentSamplePosition() override;
 
+    std::vector<InputStreamDescription> GetInputStreamDescriptions(int deviceId) override;
+
     // StartMinibatchLoop - Startup a minibatch loop
     // mbSize - [in] size of the minibatch (number of frames, etc.)
     // epoch - [in] epoch number for this loop
@@ -332,7 +332,11 @@ public:
     // The layout and shape of the data in inputs vector must match the schema returned by GetInputLayouts.
     // Output must be preallocated and sized to avoid memory allocation / deallocation across DLL
     // boundaries.
-    // This method is not reentrant, as the forward pass keeps internal state.
+    // Can be called from several threads at the same time once StartForwardEvaluation() has returned. Every call
+    // runs on its own copy of the network state, the parameters of the model are shared. Calls on GPUs are serialized.
+    // On CPUs at most maxNumEvaluationContexts (Init() option, default: number of cores) calls run at the same time.
+    // With resetRNN = false the recurrent state of the previous call of the same thread is continued if that call's
+    // copy of the network state is not in use by another thread, otherwise the state is reset.
     // inputs - vector of input buffers, one for every input as given by GetInputLayouts()
     // outputs - vector of output buffers. Must be sized to fit output schema.
     //
@@ -362,4 +366,56 @@ void EVAL_API GetEvalExtended(IEvaluateModelExtended<ElemType>** peval);
 extern "C" EVAL_API void GetEvalExtendedF(IEvaluateModelExtended<float>** peval);
 extern "C" EVAL_API void GetEvalExtendedD(IEvaluateModelExtended<double>** peval);
 
+// ------------------------------------------------------------------------
+// Batching interface
+// ------------------------------------------------------------------------
+
+//
+// Statistics of the batching evaluator. The histograms have logarithmic buckets: bucket 0 counts the values <= 1,
+// bucket i > 0 the values in (2^(i-1), 2^i].
+//
+struct BatchingStatistics
+{
+    size_t m_numRequests;
+    size_t m_numBatches;
+    std::vector<size_t> m_batchSizeHistogram;    // number of requests per minibatch
+    std::vector<size_t> m_queueLatencyHistogram; // microseconds between the submission of a request and the start of its minibatch
+};
+
+//
+// Evaluator for servers that receive many small requests. Concurrent calls to ForwardPass() are queued and
+// coalesced into one minibatch, the sequences of the requests are packed side by side. A minibatch is started
+// once it holds maxBatchSize requests or once its first request has waited maxWaitTimeMs milliseconds.
+// Additional configuration parameters of Init(): maxBatchSize=32 maxWaitTimeMs=2 numWorkerThreads=1
+// (number of minibatches evaluated at the same time, values > 1 are only useful on CPUs).
+//
+template <typename ElemType>
+class IEvaluateModelBatching : public IEvaluateModelBase<ElemType>
+{
+public:
+    //
+    // Same as in IEvaluateModelExtended.
+    //
+    virtual VariableSchema GetOutputSchema() const = 0;
+    virtual void StartForwardEvaluation(const std::vector<std::wstring>& outputs) = 0;
+    virtual VariableSchema GetInputSchema() const = 0;
+
+    //
+    // Evaluates one sequence per input, blocks until the minibatch of the request has been evaluated.
+    // Can be called from any number of threads. Inputs must be dense, recurrent state is reset for every request.
+    // The output buffers must be preallocated as for IEvaluateModelExtended::ForwardPass().
+    //
+    virtual void ForwardPass(const Values<ElemType>& inputs, Values<ElemType>& outputs) = 0;
+
+    //
+    // Statistics since StartForwardEvaluation().
+    //
+    virtual BatchingStatistics GetStatistics() const = 0;
+};
+
+template <typename ElemType>
+void EVAL_API GetEvalBatching(IEvaluateModelBatching<ElemType>** peval);
+extern "C" EVAL_API void GetEvalBatchingF(IEvaluateModelBatching<float>** peval);
+extern "C" EVAL_API void GetEvalBatchingD(IEvaluateModelBatching<double>** peval);
+
 } } }
@@ -9,6 +9,8 @@
 #include <string>
 #include <vector>
 #include <stdint.h>
+#include <memory>
+#include <algorithm>
 #ifdef _WIN32
 #define NOMINMAX
 #include "Windows.h"
@@ -34,6 +36,7 @@ enum FileOptions
     fileOptionsRead = 8,                                        // open in read mode
     fileOptionsWrite = 16,                                      // open in write mode
     fileOptionsSequential = 32,                                 // optimize for sequential reads (allocates big buffer)
+    fileOptionsMemoryMapped = 64,                               // binary read: also map the file into memory (copy-on-write), see TryGetMappedArray()
     fileOptionsReadWrite = fileOptionsRead | fileOptionsWrite,  // read/write mode
 };
 
@@ -99,7 +102,10 @@ private:
     bool m_pcloseNeeded; // was opened with popen(), use pclose() when destructing
     bool m_seekable;     // this stream is seekable
     int m_options;       // FileOptions ored togther
+    std::shared_ptr<void> m_mapping; // the mapped file with fileOptionsMemoryMapped, unmapped when the last reference is gone
+    uint64_t m_mappingSize;
     void Init(const wchar_t* filename, int fileOptions);
+    void MapFile();
 
 public:
     File(const std::wstring& filename, int fileOptions);
@@ -195,6 +201,57 @@ public:
         return *this;
     }
 
+    // put/get 'count' values of a basic type, in the same format as the same number of operator<< / operator>> calls,
+    // but with a single fwrite()/fread() for binary files
+    template <typename T>
+    void WriteArray(const T* data, size_t count)
+    {
+        if (IsTextBased())
+        {
+            for (size_t i = 0; i < count; ++i)
+                fputText(m_file, data[i]);
+        }
+        else if (count > 0)
+            fwriteOrDie(data, sizeof(T), count, m_file);
+    }
+    template <typename T>
+    void ReadArray(T* data, size_t count)
+    {
+        if (IsTextBased())
+        {
+            for (size_t i = 0; i < count; ++i)
+                fgetText(m_file, data[i]);
+        }
+        else if (count > 0)
+            freadOrDie(data, sizeof(T), count, m_file);
+    }
+
+    // Large array payloads (e.g. matrix values) are aligned to this boundary when written, so that a memory-mapped
+    // file can use them in place.
+    static const size_t PayloadAlignment = 4096;
+
+    // Returns the number of padding bytes (a multiple of 'granularity') to write at the current position, so that
+    // a payload that follows after 'headerSize' more bytes starts at a multiple of PayloadAlignment.
+    // Returns 0 for payloads smaller than PayloadAlignment, for text files and for non-seekable streams.
+    size_t GetPayloadPadding(size_t headerSize, size_t payloadSize, size_t granularity = 1);
+
+    // For files opened with fileOptionsMemoryMapped: returns the mapped memory of 'count' values at the current
+    // position and skips them, if the position is aligned to PayloadAlignment. Returns nullptr otherwise, the values
+    // have to be read then. The memory is copy-on-write and stays valid as long as a copy of GetMapping() exists.
+    template <typename T>
+    T* TryGetMappedArray(size_t count)
+    {
+        if (!m_mapping || count == 0)
+            return nullptr;
+        uint64_t pos = GetPosition();
+        if (pos % PayloadAlignment != 0 || count > (m_mappingSize - std::min(pos, m_mappingSize)) / sizeof(T))
+            return nullptr;
+        SetPosition(pos + count * sizeof(T));
+        return reinterpret_cast<T*>(static_cast<char*>(m_mapping.get()) + pos);
+    }
+    const std::shared_ptr<void>& GetMapping() const { return m_mapping; }
+    uint64_t GetMappingSize() const { return m_mappingSize; }
+
     void WriteString(const char* str, int size = 0);                   // zero terminated strings use size=0
     void ReadString(char* str, int size);                              // read up to size bytes, or a zero terminator (or space in text mode)
     void WriteString(const wchar_t* str, int size = 0);                // zero terminated strings use size=0
@@ -28,11 +28,26 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         static void SetShareNodeValueMatrices(bool enable) { m_enableShareNodeValueMatrices = enable; }
         static bool ShouldEnableShareNodeValueMatrices() { return m_enableShareNodeValueMatrices; }
 
+        static void SetMemoryMapModelFiles(bool enable) { m_memoryMapModelFiles = enable; }
+        static bool ShouldMemoryMapModelFiles() { return m_memoryMapModelFiles; }
+
+        static void SetPlanMemoryForMinibatchSize(bool enable) { m_planMemoryForMinibatchSize = enable; }
+        static bool ShouldPlanMemoryForMinibatchSize() { return m_planMemoryForMinibatchSize; }
+
+        static void SetUseTiledGemmConvolution(bool enable) { m_useTiledGemmConvolution = enable; }
+        static bool ShouldUseTiledGemmConvolution() { return m_useTiledGemmConvolution; }
+
     private:
         static std::atomic<bool> m_forceDeterministicAlgorithms;
         // The global flag to enable matrices values in forward and backward prop
         static std::atomic<bool> m_enableShareNodeValueMatrices;
         static std::atomic<bool> m_forceConstantRandomSeed;
         static std::atomic<bool> m_optimizeGradientAccumulation;
+        // Map model files into memory when loading on the CPU, parameters then use the mapped pages in place
+        static std::atomic<bool> m_memoryMapModelFiles;
+        // Plan the sharing of node matrices with the actual minibatch size, and re-plan when it changes
+        static std::atomic<bool> m_planMemoryForMinibatchSize;
+        // Let convolution and pooling nodes on the CPU use the autotuned tiled GEMM engine (not reproducible between runs)
+        static std::atomic<bool> m_useTiledGemmConvolution;
     };
 }}}
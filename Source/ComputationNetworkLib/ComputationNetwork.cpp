@@ -274,7 +274,12 @@ void ComputationNetwork::Read(const wstring& fileName)
 {
     ClearNetwork();
 
-    File fstream(fileName, FileOptions::fileOptionsBinary | FileOptions::fileOptionsRead);
+    // With a memory-mapped model, large parameter matrices loaded on the CPU point into the mapping (copy-on-write)
+    // instead of being read, see CPUMatrix's operator>>.
+    int fileOptions = FileOptions::fileOptionsBinary | FileOptions::fileOptionsRead;
+    if (Globals::ShouldMemoryMapModelFiles() && GetDeviceId() == CPUDEVICE)
+        fileOptions |= FileOptions::fileOptionsMemoryMapped;
+    File fstream(fileName, fileOptions);
 
     auto modelVersion = GetModelVersion(fstream);
 
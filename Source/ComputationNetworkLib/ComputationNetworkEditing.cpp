@@ -103,6 +103,41 @@ void ComputationNetwork::CopyInputs(const std::wstring fromName, std::wstring to
     CopyNode(*this, fromName, toName, CopyNodeFlags::copyNodeInputLinks);
 }
 
+// creates a compiled copy of the network in which every node is duplicated, except that the learnable parameters
+// share their value matrices with this network instead of holding copies.
+// Used to evaluate a model concurrently: the duplicates have their own activations, MBLayouts and recurrent state.
+// The shared parameters must not be modified while the copy is in use.
+ComputationNetworkPtr ComputationNetwork::CloneWithSharedParameters() const
+{
+    auto net = make_shared<ComputationNetwork>(GetDeviceId());
+    net->SetTraceLevel(TraceLevel());
+
+    map<ComputationNodeBasePtr, ComputationNodeBasePtr> clonedNodes;
+    for (const auto& node : GetAllNodes())
+    {
+        bool isParameter = node->OperationName() == OperationNameOf(LearnableParameter);
+        auto flags = isParameter ? (CopyNodeFlags)(CopyNodeFlags::copyNodeAll | CopyNodeFlags::copyNodeShareValue) : CopyNodeFlags::copyNodeAll;
+        clonedNodes[node] = net->AddNodeToNet(node->Duplicate(node->NodeName(), flags));
+    }
+
+    // the duplicates still refer to the inputs in this network
+    for (const auto& iter : clonedNodes)
+    {
+        const auto& inputs = iter.first->GetInputs();
+        for (size_t i = 0; i < inputs.size(); i++)
+            iter.second->SetInput(i, clonedNodes.at(inputs[i]));
+    }
+
+    for (const auto& groupTag : { L"feature", L"label", L"criterion", L"evaluation", L"output" })
+    {
+        for (const auto& node : const_cast<ComputationNetwork*>(this)->GetNodeGroup(groupTag))
+            net->AddToNodeGroup(groupTag, clonedNodes.at(node));
+    }
+
+    net->CompileNetwork();
+    return net;
+}
+
 // RenameNode - Rename a node to another name
 // nodeNameOrig - original node name
 // nodeNameNew - new node name
@@ -73,6 +73,11 @@ static bool SetRootGradientToScalarOne(ComputationNodeBasePtr nodep)
 //  - ForwardProp() for the training criterion (which will reuse computation results from the previous step)
 //  - Backprop() for the training criterion
 void ComputationNetwork::Backprop(const ComputationNodeBasePtr rootNode) // training criterion to compute the gradients for
+{
+    Backprop(rootNode, nullptr);
+}
+
+void ComputationNetwork::Backprop(const ComputationNodeBasePtr rootNode, const std::function<void(const ComputationNodeBasePtr&)>& onNodeBackpropDone)
 {
     if (!Environment().IsTraining())
         LogicError("Backprop: Requires network is to be in training mode.");
@@ -85,7 +90,10 @@ void ComputationNetwork::Backprop(const ComputationNodeBasePtr rootNode) // trai
     ZeroInputGradients(rootNode);
 
     // backpropagate through the network
-    GetNestedNetwork(rootNode)->Backprop(FrameRange(nullptr), true, true);
+    if (onNodeBackpropDone)
+        dynamic_pointer_cast<PARTraversalFlowControlNode>(GetNestedNetwork(rootNode))->Backprop(FrameRange(nullptr), onNodeBackpropDone);
+    else
+        GetNestedNetwork(rootNode)->Backprop(FrameRange(nullptr), true, true);
 }
 
 void ComputationNetwork::FormNestedNetwork(const ComputationNodeBasePtr& rootNode)
@@ -177,7 +185,13 @@ ComputationNetwork::PARTraversalFlowControlNode::PARTraversalFlowControlNode(con
 /*virtual*/ void ComputationNetwork::PARTraversalFlowControlNode::Backprop(const FrameRange& fr, bool childrenInThisLoop, bool childrenInOuterLoop) /*override*/
 {
     childrenInThisLoop, childrenInOuterLoop; // TODO: think through what these mean when coming from PAR mode
+    Backprop(fr, nullptr);
+}
+
+void ComputationNetwork::PARTraversalFlowControlNode::Backprop(const FrameRange& fr, const std::function<void(const ComputationNodeBasePtr&)>& onNodeBackpropDone)
+{
     // process nodes in pre-determined order
+    // All consumers of a node come after it in evaluation order, so once we get to a node its gradient is complete.
     for (auto pnode = m_nestedNodes.rbegin(); pnode != m_nestedNodes.rend(); pnode++) // iterate backwards over evaluation order
     {
         auto& node = *pnode;
@@ -189,6 +203,9 @@ ComputationNetwork::PARTraversalFlowControlNode::PARTraversalFlowControlNode(con
         // Extreme Tracing, part 2/4
         if (node->HasEnvironmentPtr() && node->Environment().ShouldDumpNode() && node->NeedsGradient())
             DumpNode<float>(node, /*dumpGradient=*/true) || DumpNode<double>(node, true);
+
+        if (onNodeBackpropDone)
+            onNodeBackpropDone(node);
     }
 }
 /*virtual*/ void ComputationNetwork::PARTraversalFlowControlNode::RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) /*override*/
@@ -1173,16 +1190,44 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
     m_matrixPool.OptimizedMemoryAllocation(); 
     m_areMatricesAllocated = true;
 
-    // TO DO: At the time of AllocateAllMatrices we don't know the minibatch size. In theory one may allocate memory again once we start to receive
-    // data from the reader (and the minibatch size is known). For some problems, minibatch size can change constantly, and there needs to be a 
-    // tradeoff in deciding how frequent to run optimized memory allocation. For now, we do it only once at the very beginning for speed concerns. 
+    // At the time of AllocateAllMatrices we don't know the minibatch size. If Globals::ShouldPlanMemoryForMinibatchSize(), the allocation is
+    // planned again once the minibatch size is known, see PlanMemoryForMinibatchSize(). To limit the number of re-plans for minibatch sizes that
+    // change constantly, the plans are made for sizes rounded up to powers of two, and only ever for larger minibatches.
 
     // TO DO: when some matrices are sparse, the memory size request may be wrong. One may need to call OptimizedMemoryAllocation later again 
     // if the requests of sparse allocation and release are re-processed correctly. Future work. 
 
     // print the memory sharing structure
     if (TraceLevel() > 0)
+    {
         PrintMemorySharingStructure(GetAllNodes());
+        if (Globals::ShouldPlanMemoryForMinibatchSize())
+            PrintMemoryPlanStatistics();
+    }
+}
+
+void ComputationNetwork::PlanMemoryForMinibatchSize(size_t numColumns)
+{
+    if (!Globals::ShouldPlanMemoryForMinibatchSize() || !AreMatricesAllocated() || numColumns == 0)
+        return;
+
+    if (!m_matrixPool.PlanMemoryForMinibatchSize(numColumns))
+        return;
+
+    // shared matrices have been replaced, all values must be recomputed
+    ResetEvalTimeStamps();
+
+    if (TraceLevel() > 0)
+        PrintMemoryPlanStatistics();
+}
+
+void ComputationNetwork::PrintMemoryPlanStatistics()
+{
+    const auto& statistics = m_matrixPool.GetPlanStatistics();
+    const double MB = 1024.0 * 1024.0;
+    fprintf(stderr, "Memory plan for minibatches of up to %d columns: %d matrices share %d buffers of %.1f MB in total (%.1f MB without sharing, %.1f MB peak live).\n",
+            (int)statistics.numColumns, (int)statistics.numRequests, (int)statistics.numBuffers,
+            statistics.plannedBytes / MB, statistics.naiveBytes / MB, statistics.peakLiveBytes / MB);
 }
 
 void ComputationNetwork::ReleaseMatricesAfterEvalForChildren(ComputationNodeBasePtr n, std::unordered_map<ComputationNodeBasePtr, std::unordered_set<ComputationNodeBasePtr>>& parentsMap)
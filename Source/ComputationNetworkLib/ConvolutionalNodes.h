@@ -12,6 +12,15 @@
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// Engines that convolution and pooling nodes may use. The tiled GEMM CPU engine is opt-in (useTiledGemmConvolution),
+// as it selects its algorithm by timing, so results are not reproducible between runs.
+inline ConvolutionEngineKind GetEnabledConvolutionEngines()
+{
+    if (!Globals::ShouldUseTiledGemmConvolution())
+        return ConvolutionEngineKind::All;
+    return (ConvolutionEngineKind)((int)ConvolutionEngineKind::All | (int)ConvolutionEngineKind::TiledGemm);
+}
+
 // -----------------------------------------------------------------------
 // ConvolutionNodeBase
 // -----------------------------------------------------------------------
@@ -563,7 +572,7 @@ public:
                                                                    m_sharing, m_autoPad, m_lowerPad, m_upperPad);
                 m_convEng = ConvolutionEngine<ElemType>::Create(geometry, m_deviceId, m_imageLayout,
                                                                 m_maxTempMemSizeInSamples, m_poolKind,
-                                                                ConvolutionEngineKind::All, NodeName(), Globals::ShouldForceDeterministicAlgorithms());
+                                                                GetEnabledConvolutionEngines(), NodeName(), Globals::ShouldForceDeterministicAlgorithms());
             }
 
             if (Input(0)->GetSampleLayout().GetNumElements() != m_kernelShape.GetNumElements() * m_convEng->Geometry()->KernelCount())
@@ -935,7 +944,7 @@ public:
                                                                    m_sharing, m_autoPad, m_lowerPad, m_upperPad, m_ceilOutDim);
                 m_convEng = ConvolutionEngine<ElemType>::Create(geometry, m_deviceId, m_imageLayout,
                                                                 m_maxTempMemSizeInSamples, m_poolKind,
-                                                                ConvolutionEngineKind::All, NodeName(), false, m_poolIncludePad);
+                                                                GetEnabledConvolutionEngines(), NodeName(), false, m_poolIncludePad);
             }
         }
     }
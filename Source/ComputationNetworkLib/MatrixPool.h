@@ -14,6 +14,7 @@
 #include <stdlib.h>
 
 #include "Basics.h"
+#include "Globals.h"
 #include "Matrix.h"
 #include "ComputationNode.h"
 
@@ -58,6 +59,21 @@ struct MemAllocInfo
     }
 };
 
+// statistics of a memory plan, summed over all devices and element types
+struct MemoryPlanStatistics
+{
+    size_t numColumns;    // minibatch size the plan was made for, rounded up to a power of two (0 if no plan was made)
+    size_t numRequests;   // number of dense matrices taking part in sharing
+    size_t numBuffers;    // number of distinct matrices they were assigned to
+    size_t naiveBytes;    // memory needed without any sharing
+    size_t plannedBytes;  // memory needed by the buffers
+    size_t peakLiveBytes; // largest amount of memory live at any step, no plan can do better
+    MemoryPlanStatistics()
+        : numColumns(0), numRequests(0), numBuffers(0), naiveBytes(0), plannedBytes(0), peakLiveBytes(0)
+    {
+    }
+};
+
 // MatrixPool -- class to support memory sharing
 // Despite the gather general name of this class, it is specifically designed to support the memory sharing of ComputationNodes.
 // Note: see #define SUPRESS_MEMSHARING below as for how to temporarily disable memory sharing altogether, for debugging
@@ -67,6 +83,7 @@ class MatrixPool
     vector<MemRequestInfo<double>> m_memRequestInfoDoubleVec;
     set<DEVICEID_TYPE> m_deviceIDSet; 
     int m_stepCounter; 
+    MemoryPlanStatistics m_planStatistics;
 
     template <class ElemType>
     vector<MemRequestInfo<ElemType>>& GetMemRequestInfoVec(); 
@@ -111,12 +128,40 @@ public:
 
     void OptimizedMemoryAllocation()
     {
+        // The minibatch size is not known yet, plan for a single sample. See PlanMemoryForMinibatchSize().
+        if (Globals::ShouldPlanMemoryForMinibatchSize())
+        {
+            PlanMemory(1);
+            return;
+        }
+
         // MatrixPool is not templated, so we call both float and double versions here 
         OptimizedMemoryAllocationFunc<float>(); 
         OptimizedMemoryAllocationFunc<double>();
         return; 
     }
 
+    // Re-plans the memory sharing for minibatches of up to 'numColumns' columns, rounded up to the next power of two,
+    // unless the current plan was made for at least that many columns. The plan is a high-water mark: a plan for
+    // larger minibatches is valid for smaller ones as well, so variable-length data and the short last minibatch of
+    // an epoch do not cause matrices to be freed and reallocated. Returns true if the matrices have been reassigned.
+    // In that case the values of all matrices that are released during forward or backward prop are lost, so this
+    // must be called before the forward prop of a minibatch. Matrices that are never released (e.g. gradients of
+    // parameters, values of root nodes) keep their contents.
+    bool PlanMemoryForMinibatchSize(size_t numColumns)
+    {
+        size_t bucket = 1;
+        while (bucket < numColumns)
+            bucket *= 2;
+        if (bucket <= m_planStatistics.numColumns)
+            return false;
+
+        PlanMemory(bucket);
+        return true;
+    }
+
+    const MemoryPlanStatistics& GetPlanStatistics() const { return m_planStatistics; }
+
 private: 
     bool CheckOverlap(pair<int, int>occ, vector<pair<int, int>>&occVec)
     {
@@ -137,6 +182,118 @@ private:
         return bRet;
     }
 
+    void PlanMemory(size_t numColumns)
+    {
+        m_planStatistics = MemoryPlanStatistics();
+        m_planStatistics.numColumns = numColumns;
+        PlanMemoryFunc<float>(numColumns);
+        PlanMemoryFunc<double>(numColumns);
+    }
+
+    // Unlike OptimizedMemoryAllocationFunc(), this knows the size of every request for the given minibatch size,
+    // so requests that scale with the minibatch size and those that do not are planned together. This is a coloring
+    // of the interval graph of the requests: from largest to smallest, each request goes to the buffer without time
+    // overlap that grows the least (and, if none grows, wastes the least), a new buffer is only added if all overlap.
+    template <class ElemType>
+    void PlanMemoryFunc(size_t numColumns)
+    {
+        vector<MemRequestInfo<ElemType>>& memInfoVec = GetMemRequestInfoVec<ElemType>();
+        auto requestBytes = [numColumns](const MemRequestInfo<ElemType>* memInfo)
+        {
+            return memInfo->matrixSize * (memInfo->mbScale ? numColumns : 1) * sizeof(ElemType);
+        };
+
+        struct Buffer
+        {
+            size_t bytes;
+            vector<pair<int, int>> occupancy;
+            shared_ptr<Matrix<ElemType>> matrixPtr;
+        };
+
+        for (auto& devId : m_deviceIDSet)
+        {
+            for (auto wsFlag : { true, false }) // the workspace memory is not shared with the non-workspace memory requests
+            {
+                // sparse matrices do not participate in memory sharing
+                vector<MemRequestInfo<ElemType>*> requests;
+                for (auto& memInfo : memInfoVec)
+                {
+                    if (memInfo.deviceId == devId && memInfo.isWorkSpace == wsFlag && (*memInfo.pMatrixPtr)->GetMatrixType() != SPARSE)
+                        requests.push_back(&memInfo);
+                }
+                if (requests.empty())
+                    continue;
+
+                std::stable_sort(requests.begin(), requests.end(), [&](const MemRequestInfo<ElemType>* a, const MemRequestInfo<ElemType>* b)
+                {
+                    return requestBytes(a) > requestBytes(b);
+                });
+
+                vector<Buffer> buffers;
+                for (auto memInfo : requests)
+                {
+                    auto occ = make_pair(memInfo->allocStep, memInfo->releaseStep);
+                    size_t bytes = requestBytes(memInfo);
+                    size_t best = buffers.size();
+                    pair<size_t, size_t> bestCost; // (growth, waste)
+                    for (size_t i = 0; i < buffers.size(); i++)
+                    {
+                        if (CheckOverlap(occ, buffers[i].occupancy))
+                            continue;
+                        auto cost = make_pair(bytes > buffers[i].bytes ? bytes - buffers[i].bytes : 0,
+                                              buffers[i].bytes > bytes ? buffers[i].bytes - bytes : 0);
+                        if (best == buffers.size() || cost < bestCost)
+                        {
+                            best = i;
+                            bestCost = cost;
+                        }
+                    }
+
+                    if (best == buffers.size())
+                        buffers.push_back(Buffer{ 0, vector<pair<int, int>>(), nullptr });
+                    Buffer& buffer = buffers[best];
+                    buffer.bytes = max(buffer.bytes, bytes);
+                    buffer.occupancy.push_back(occ);
+                    memInfo->SetMemoryId((int)best);
+
+                    // Matrices that are never released may be referenced across minibatches (e.g. gradients of
+                    // parameters by the gradient aggregation), they keep their matrix object. Since they overlap
+                    // with each other, there is at most one of them per buffer.
+                    if (memInfo->releaseStep == INT_MAX)
+                        buffer.matrixPtr = *memInfo->pMatrixPtr;
+                }
+
+                // now assign the actual pointers
+                for (auto& buffer : buffers)
+                {
+                    if (!buffer.matrixPtr)
+                        buffer.matrixPtr = make_shared<Matrix<ElemType>>(devId);
+                    m_planStatistics.plannedBytes += buffer.bytes;
+                }
+                for (auto memInfo : requests)
+                    *memInfo->pMatrixPtr = buffers[memInfo->memoryId].matrixPtr;
+
+                // bytes live at each step, matrices that are never released are live until the last step
+                vector<long long> liveBytesDelta(m_stepCounter + 2, 0);
+                for (auto memInfo : requests)
+                {
+                    liveBytesDelta[memInfo->allocStep] += requestBytes(memInfo);
+                    liveBytesDelta[min(memInfo->releaseStep, m_stepCounter) + 1] -= requestBytes(memInfo);
+                    m_planStatistics.naiveBytes += requestBytes(memInfo);
+                }
+                long long liveBytes = 0, peakLiveBytes = 0;
+                for (auto delta : liveBytesDelta)
+                {
+                    liveBytes += delta;
+                    peakLiveBytes = max(peakLiveBytes, liveBytes);
+                }
+                m_planStatistics.peakLiveBytes += (size_t)peakLiveBytes;
+                m_planStatistics.numRequests += requests.size();
+                m_planStatistics.numBuffers += buffers.size();
+            }
+        }
+    }
+
     template <class ElemType>
     void OptimizedMemoryAllocationFunc()
     {
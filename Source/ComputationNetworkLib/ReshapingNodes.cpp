@@ -637,6 +637,113 @@ template <class ElemType>
 template class ScatterPackedNode<float>;
 template class ScatterPackedNode<double>;
 
+// -----------------------------------------------------------------------
+// SpliceContextWindowNode(input, leftContext, rightContext, windowedInput) -- context expansion
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+void SpliceContextWindowNode<ElemType>::UpdateColumnIndices()
+{
+    let& layout = GetMBLayout();
+    let S = layout->GetNumParallelSequences();
+    let T = layout->GetNumTimeSteps();
+    let windowSize = m_leftContext + 1 + m_rightContext;
+
+    m_columnIndicesBuffer.assign(layout->GetNumCols() * windowSize, -1); // -1 means gap
+    for (let& seq : layout->GetAllSequences())
+    {
+        if (seq.seqId == GAP_SEQUENCE_ID)
+            continue;
+
+        // The neighbors beyond a cut of truncated BPTT are in another minibatch.
+        if ((seq.tBegin < 0 || seq.tEnd > T) && windowSize > 1)
+            InvalidArgument("%ls: a sequence continues beyond the minibatch (truncated BPTT), its context windows cannot be formed from the frames in the minibatch. "
+                            "Let the reader gather the windows instead (the HTK deserializer does so with expandContextInNetwork=true and truncated=true) and set windowedInput=true.",
+                            NodeDescription().c_str());
+
+        // frames of the sequence that are in this minibatch
+        let tBegin = (size_t)std::max(seq.tBegin, (ptrdiff_t)0);
+        let tEnd = std::min(seq.tEnd, T);
+        for (size_t t = tBegin; t < tEnd; t++)
+        {
+            let j = t * S + seq.s;
+            for (size_t k = 0; k < windowSize; k++)
+            {
+                // the index does not move beyond the sequence boundaries
+                let tSource = (size_t)std::min(std::max((ptrdiff_t)t + (ptrdiff_t)k - (ptrdiff_t)m_leftContext, (ptrdiff_t)tBegin), (ptrdiff_t)tEnd - 1);
+                m_columnIndicesBuffer[j * windowSize + k] = (ElemType)(tSource * S + seq.s);
+            }
+        }
+    }
+    m_columnIndices->SetValue(1, m_columnIndicesBuffer.size(), m_deviceId, m_columnIndicesBuffer.data(), matrixFlagNormal);
+}
+
+template <class ElemType>
+/*virtual*/ void SpliceContextWindowNode<ElemType>::ForwardPropNonLooping() /*override*/
+{
+    // the windows come from the reader already, only the window axis is flattened
+    if (m_windowedInput)
+    {
+        Value().AssignValuesOf(InputRef(0).Value());
+        return;
+    }
+
+    UpdateColumnIndices();
+
+    // The output [dim * windowSize x N] is viewed as [dim x windowSize * N], i.e. one column per frame of a window.
+    let& input = InputRef(0).Value();
+    auto output = Value().Reshaped(input.GetNumRows(), m_columnIndices->GetNumCols());
+    output.DoGatherColumnsOf(/*beta=*/0, *m_columnIndices, input, /*alpha=*/1);
+
+    // gap columns are skipped by the gather
+    if (GetMBLayout()->HasGaps())
+        MaskMissingValueColumnsToZero(FrameRange(GetMBLayout()));
+}
+
+template <class ElemType>
+/*virtual*/ void SpliceContextWindowNode<ElemType>::BackpropToNonLooping(size_t /*inputIndex*/) /*override*/
+{
+    auto& inputGradient = InputRef(0).Gradient();
+    if (m_windowedInput)
+    {
+        inputGradient += Gradient();
+        return;
+    }
+
+    // A frame receives the gradients of all windows it is part of, including the replicated boundary frames.
+    let outputGradient = Gradient().Reshaped(inputGradient.GetNumRows(), m_columnIndices->GetNumCols());
+    inputGradient.DoScatterColumnsOf(/*beta=*/1, *m_columnIndices, outputGradient, /*alpha=*/1);
+}
+
+template <class ElemType>
+/*virtual*/ void SpliceContextWindowNode<ElemType>::Validate(bool isFinalValidationPass) /*override*/
+{
+    Base::Validate(isFinalValidationPass);
+    InferMBLayoutFromInputsForStandardCase(isFinalValidationPass);
+
+    if (isFinalValidationPass && !HasMBLayout())
+        InvalidArgument("%ls requires its input to be a sequence (must have an MBLayout).", NodeDescription().c_str());
+
+    // the frames of the window are stacked into a vector
+    let& inputLayout = GetInputSampleLayout(0);
+    let windowSize = m_leftContext + 1 + m_rightContext;
+    let dim = inputLayout.GetNumElements();
+    if (!m_windowedInput)
+    {
+        SetDims(TensorShape(dim * windowSize), HasMBLayout());
+        return;
+    }
+
+    // the windows were gathered by the reader, their frames are along the last axis
+    if (isFinalValidationPass && (inputLayout.GetRank() < 2 || inputLayout[inputLayout.GetRank() - 1] != windowSize))
+        InvalidArgument("%ls: with windowedInput=true the input must hold the windows gathered by the reader as [frame dim x %d], but its shape is %s.",
+                        NodeDescription().c_str(), (int)windowSize, string(inputLayout).c_str());
+    SetDims(TensorShape(dim), HasMBLayout());
+}
+
+template class SpliceContextWindowNode<float>;
+template class SpliceContextWindowNode<double>;
+
 // -----------------------------------------------------------------------
 // CropNode -- crop operation, crops first input according to shape of second
 //             input at offsets which are directly given or automatically calculated.
@@ -1150,6 +1150,94 @@ public:
     virtual void Validate(bool isFinalValidationPass) override;
 };
 
+// -----------------------------------------------------------------------
+// SpliceContextWindowNode(input, leftContext, rightContext, windowedInput=false) -- stack each frame
+// with its leftContext preceding and rightContext following frames.
+// The output sample is [x(t-leftContext); ...; x(t); ...; x(t+rightContext)],
+// where frames beyond the begin or end of the sequence are replaced by the
+// first or last frame of the sequence. This is the same context expansion
+// that the HTK deserializer performs with contextWindow, but done on the
+// minibatch, so that the reader only has to deliver the raw frames
+// (expandContextInNetwork=true).
+// Implemented as a column gather from the input into the output viewed as
+// [input dim x (window size * columns)], and the corresponding scatter in
+// backprop.
+// Where the neighbors of a frame are not in the minibatch (frame mode, or
+// sequences cut by truncated BPTT), the reader gathers the windows itself
+// and delivers them as [frame dim x window size]. With windowedInput=true
+// the node expects such an input and passes it through as is; any other
+// input shape is an error. A cut sequence of plain frames is rejected,
+// since its windows at the cut would differ from the reader's.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class SpliceContextWindowNode : public ComputationNodeNonLooping<ElemType>, public NumInputs<1>
+{
+    typedef ComputationNodeNonLooping<ElemType> Base; UsingComputationNodeMembersBoilerplate;
+    static const std::wstring TypeName() { return L"SpliceContextWindow"; }
+
+public:
+    SpliceContextWindowNode(DEVICEID_TYPE deviceId, const wstring& name, size_t leftContext = 0, size_t rightContext = 0, bool windowedInput = false)
+        : Base(deviceId, name),
+          m_leftContext(leftContext),
+          m_rightContext(rightContext),
+          m_windowedInput(windowedInput),
+          m_columnIndices(make_shared<Matrix<ElemType>>(deviceId))
+    {
+    }
+    SpliceContextWindowNode(const ScriptableObjects::IConfigRecordPtr configp)
+        : SpliceContextWindowNode(configp->Get(L"deviceId"), L"<placeholder>", configp->Get(L"leftContext"), configp->Get(L"rightContext"), configp->Get(L"windowedInput"))
+    {
+        AttachInputsFromConfig(configp, this->GetExpectedNumInputs());
+    }
+
+    virtual void CopyTo(ComputationNodeBasePtr nodeP, const std::wstring& newName, const CopyNodeFlags flags) const override
+    {
+        Base::CopyTo(nodeP, newName, flags);
+        if (flags & CopyNodeFlags::copyNodeValue)
+        {
+            auto node = dynamic_pointer_cast<SpliceContextWindowNode<ElemType>>(nodeP);
+            node->m_leftContext = m_leftContext;
+            node->m_rightContext = m_rightContext;
+            node->m_windowedInput = m_windowedInput;
+        }
+    }
+
+    virtual void Save(File& fstream) const override
+    {
+        Base::Save(fstream);
+        fstream << m_leftContext << m_rightContext << m_windowedInput;
+    }
+
+    virtual void Load(File& fstream, size_t modelVersion) override
+    {
+        Base::Load(fstream, modelVersion);
+        fstream >> m_leftContext >> m_rightContext >> m_windowedInput;
+    }
+
+    virtual std::string FormatOperationPrototype(const std::string& extraArgs) const override
+    {
+        return Base::FormatOperationPrototype(extraArgs + msra::strfun::strprintf(", leftContext=%lu, rightContext=%lu%s", m_leftContext, m_rightContext, m_windowedInput ? ", windowedInput" : ""));
+    }
+
+    virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override;
+    virtual void /*ComputationNodeNonLooping::*/ BackpropToNonLooping(size_t inputIndex) override;
+    virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
+    virtual bool InputUsedInComputingInputNodesGradients(size_t /*childIndex*/) const override { return false; }
+    virtual void Validate(bool isFinalValidationPass) override;
+
+private:
+    // Sets up m_columnIndices for the current MBLayout.
+    void UpdateColumnIndices();
+
+    size_t m_leftContext;
+    size_t m_rightContext;
+    bool m_windowedInput; // the input holds the windows gathered by the reader, [frame dim x window size]
+
+    shared_ptr<Matrix<ElemType>> m_columnIndices; // [0, j * window size + k] input column of frame k of the window of output column j, -1 for gaps
+    vector<ElemType> m_columnIndicesBuffer;       // CPU-side buffer for constructing m_columnIndices
+};
+
 // -----------------------------------------------------------------------
 // DiagonalNode -- extract diagonal elements of a square matrix into a row vector
 // -----------------------------------------------------------------------
@@ -41,6 +41,7 @@ void CNTKEvalBase<ElemType>::Init(const std::string& config)
     CPUMatrix<ElemType>::SetNumThreads(nThreads);
 
     Globals::SetShareNodeValueMatrices(m_config(L"shareNodeValueMatrices", true));
+    Globals::SetMemoryMapModelFiles(m_config(L"memoryMapModelFile", false));
 }
 
 
@@ -254,31 +255,146 @@ VariableLayout CNTKEvalExtended<ElemType>::ToVariableLayout(const ComputationNod
 
 
 template<typename ElemType>
-void CNTKEvalExtended<ElemType>::StartForwardEvaluation(const std::vector<wstring>& outputNodeNames)
+typename CNTKEvalExtended<ElemType>::EvaluationContextPtr CNTKEvalExtended<ElemType>::CreateContext(const ComputationNetworkPtr& net) const
 {
-    m_scopedNetworkOperationMode = make_shared<ScopedNetworkOperationMode>(this->m_net, NetworkOperationMode::inferring);
-    m_outputNodes  = this->m_net->OutputNodesByName(outputNodeNames);
-    m_inputNodes = this->m_net->InputNodesForOutputs(outputNodeNames);
+    auto context = make_shared<EvaluationContext>();
+    context->m_net = net;
+    context->m_scopedNetworkOperationMode = make_shared<ScopedNetworkOperationMode>(net, NetworkOperationMode::inferring);
+    context->m_outputNodes = net->OutputNodesByName(m_outputNodeNames);
+    context->m_inputNodes = net->InputNodesForOutputs(m_outputNodeNames);
     // allocate memory for forward computation
-    this->m_net->AllocateAllMatrices({}, m_outputNodes, nullptr);
-    this->m_net->StartEvaluateMinibatchLoop(m_outputNodes);
-    m_inputMatrices = DataReaderHelpers::RetrieveInputMatrices(m_inputNodes);
+    net->AllocateAllMatrices({}, context->m_outputNodes, nullptr);
+    net->StartEvaluateMinibatchLoop(context->m_outputNodes);
+    context->m_inputMatrices = DataReaderHelpers::RetrieveInputMatrices(context->m_inputNodes);
+    return context;
+}
+
+template<typename ElemType>
+void CNTKEvalExtended<ElemType>::StartForwardEvaluation(const std::vector<wstring>& outputNodeNames)
+{
+    DestroyContexts();
 
-    for (const auto& node : m_outputNodes)
+    m_outputNodeNames = outputNodeNames;
+    // Contexts are cloned from a copy of the network that is never evaluated: cloning the network of a context
+    // would copy activations that another thread may be computing at the same time.
+    m_templateNet = this->m_net->CloneWithSharedParameters();
+    m_mainContext = CreateContext(this->m_net);
+
+    for (const auto& node : m_mainContext->m_outputNodes)
     {
         shared_ptr<Matrix<ElemType>> outputMatrix = dynamic_pointer_cast<Matrix<ElemType>>(node->ValuePtr());
         if (outputMatrix->GetMatrixType() != MatrixType::DENSE)
             RuntimeError("Sparse outputs are not supported by this API.");
     }
 
+    m_contexts.push_back(m_mainContext);
+    m_freeContexts.push_back(m_mainContext);
+
+    // Handles of the GPU libraries are not thread safe, concurrent calls are serialized on the GPU.
+    // On the CPU every context holds the activations of a whole network, their number is limited (by default
+    // to the number of cores, more concurrent calls would not run faster).
+    if (this->m_net->GetDeviceId() == CPUDEVICE)
+    {
+        m_maxNumContexts = this->m_config(L"maxNumEvaluationContexts", (size_t)std::max(1u, std::thread::hardware_concurrency()));
+        if (m_maxNumContexts == 0)
+            InvalidArgument("maxNumEvaluationContexts must be greater than zero.");
+    }
+    else
+        m_maxNumContexts = 1;
     m_started = true;
 }
 
+template<typename ElemType>
+typename CNTKEvalExtended<ElemType>::EvaluationContextPtr CNTKEvalExtended<ElemType>::AcquireContext()
+{
+    const auto thisThread = std::this_thread::get_id();
+    {
+        std::unique_lock<std::mutex> lock(m_contextLock);
+        for (;;)
+        {
+            if (!m_freeContexts.empty())
+            {
+                // Prefer the context this thread used last, it holds the recurrent state of the previous call.
+                // Any other free context is reused rather than creating a new one, its recurrent state is reset.
+                auto it = std::find_if(m_freeContexts.begin(), m_freeContexts.end(),
+                                       [thisThread](const EvaluationContextPtr& c) { return c->m_lastThread == thisThread; });
+                if (it == m_freeContexts.end())
+                    it = m_freeContexts.end() - 1;
+                auto context = *it;
+                m_freeContexts.erase(it);
+                context->m_resetState = context->m_lastThread != thisThread;
+                return context;
+            }
+
+            if (m_contexts.size() < m_maxNumContexts)
+                break;
+
+            m_contextReleased.wait(lock);
+        }
+
+        // Reserve the slot, the network is cloned outside of the lock.
+        m_contexts.push_back(nullptr);
+    }
+
+    EvaluationContextPtr context;
+    try
+    {
+        ComputationNetworkPtr net;
+        {
+            std::lock_guard<std::mutex> lock(m_cloneLock);
+            net = m_templateNet->CloneWithSharedParameters();
+        }
+        context = CreateContext(net);
+        context->m_resetState = true;
+    }
+    catch (...)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_contextLock);
+            m_contexts.erase(std::find(m_contexts.begin(), m_contexts.end(), nullptr));
+        }
+        // The slot is free again, a waiting thread may create the context instead.
+        m_contextReleased.notify_one();
+        throw;
+    }
+
+    std::lock_guard<std::mutex> lock(m_contextLock);
+    *std::find(m_contexts.begin(), m_contexts.end(), nullptr) = context;
+    return context;
+}
+
+template<typename ElemType>
+void CNTKEvalExtended<ElemType>::ReleaseContext(const EvaluationContextPtr& context)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_contextLock);
+        context->m_lastThread = std::this_thread::get_id();
+        m_freeContexts.push_back(context);
+    }
+    m_contextReleased.notify_one();
+}
+
+template<typename ElemType>
+void CNTKEvalExtended<ElemType>::DestroyContexts()
+{
+    // Since m_scopedNetworkOperationMode has a reference to the network, it has to be released first.
+    for (auto& context : m_contexts)
+    {
+        if (context)
+            context->m_scopedNetworkOperationMode.reset();
+    }
+    m_freeContexts.clear();
+    m_contexts.clear();
+    m_mainContext.reset();
+    m_templateNet.reset();
+    m_started = false;
+}
+
 template<typename ElemType>
 VariableSchema CNTKEvalExtended<ElemType>::GetOutputSchema() const
 {
     VariableSchema schema;
-    auto& nodes = m_started ? m_outputNodes : this->m_net->OutputNodes();
+    auto& nodes = m_started ? m_mainContext->m_outputNodes : this->m_net->OutputNodes();
     for (const auto& n : nodes)
     {
         schema.push_back(ToVariableLayout(n));
@@ -290,7 +406,9 @@ template<typename ElemType>
 VariableSchema CNTKEvalExtended<ElemType>::GetInputSchema() const
 {
     VariableSchema inputLayouts;
-    auto nodes = m_inputNodes;
+    std::vector<ComputationNodeBasePtr> nodes;
+    if (m_started)
+        nodes = m_mainContext->m_inputNodes;
     if (nodes.size() == 0)
     {
         // Default to all nodes
@@ -311,14 +429,31 @@ void CNTKEvalExtended<ElemType>::ForwardPassT(const std::vector<ValueBuffer<Elem
     if (!m_started)
         RuntimeError("ForwardPass() called before StartForwardEvaluation()");
 
-    if (inputs.size() != (size_t)std::distance(m_inputMatrices.begin(), m_inputMatrices.end()))
-        RuntimeError("Expected %d inputs, but got %d.", (int)std::distance(m_inputMatrices.begin(), m_inputMatrices.end()), (int)inputs.size());
+    auto context = AcquireContext();
+    try
+    {
+        ForwardPassT(*context, inputs, outputs, resetRNN);
+    }
+    catch (...)
+    {
+        ReleaseContext(context);
+        throw;
+    }
+    ReleaseContext(context);
+}
+
+template<typename ElemType>
+template<template<typename> class ValueContainer>
+void CNTKEvalExtended<ElemType>::ForwardPassT(EvaluationContext& context, const std::vector<ValueBuffer<ElemType, ValueContainer> >& inputs, std::vector<ValueBuffer<ElemType, ValueContainer> >& outputs, bool resetRNN)
+{
+    if (inputs.size() != (size_t)std::distance(context.m_inputMatrices.begin(), context.m_inputMatrices.end()))
+        RuntimeError("Expected %d inputs, but got %d.", (int)std::distance(context.m_inputMatrices.begin(), context.m_inputMatrices.end()), (int)inputs.size());
 
-    if (outputs.size() != m_outputNodes.size())
-        RuntimeError("Expected %d outputs, but got %d.", (int)m_outputNodes.size(), (int)outputs.size());
+    if (outputs.size() != context.m_outputNodes.size())
+        RuntimeError("Expected %d outputs, but got %d.", (int)context.m_outputNodes.size(), (int)outputs.size());
 
     size_t i = 0;
-    for (auto& inputNode : m_inputNodes)
+    for (auto& inputNode : context.m_inputNodes)
     {
         // const cast: The matrix class takes this over without copying and could theoretically change the contents,
         // though it doesn't in this case.
@@ -328,28 +463,28 @@ void CNTKEvalExtended<ElemType>::ForwardPassT(const std::vector<ValueBuffer<Elem
         size_t numRows = inputNode->GetSampleLayout().GetNumElements();
 
         if (buffer.m_buffer.data() == nullptr)
-            RuntimeError("Input %ls: Buffer is not allocated.", m_inputNodes[i]->GetName().c_str());
+            RuntimeError("Input %ls: Buffer is not allocated.", context.m_inputNodes[i]->GetName().c_str());
         if (type == MatrixType::DENSE)
         {
             if (buffer.m_buffer.size() % numRows != 0)
                 RuntimeError("Input %ls: Expected input data to be a multiple of %" PRIu64 ", but it is %" PRIu64 ".", 
-                             m_inputNodes[i]->GetName().c_str(), numRows, buffer.m_buffer.size());
+                             context.m_inputNodes[i]->GetName().c_str(), numRows, buffer.m_buffer.size());
             if (buffer.m_buffer.size() == 0)
-                RuntimeError("Input %ls: Expected at least one element.", m_inputNodes[i]->GetName().c_str());
+                RuntimeError("Input %ls: Expected at least one element.", context.m_inputNodes[i]->GetName().c_str());
         }
         else if (type == MatrixType::SPARSE)
         {
             if (buffer.m_colIndices.data() == nullptr)
-                RuntimeError("Input %ls: Due to sparse input format, expected colIndices array, but was nullptr.", m_inputNodes[i]->GetName().c_str());
+                RuntimeError("Input %ls: Due to sparse input format, expected colIndices array, but was nullptr.", context.m_inputNodes[i]->GetName().c_str());
             if (buffer.m_indices.data() == nullptr)
-                RuntimeError("Input %ls: Due to sparse input format, expected Indices array, but was nullptr.", m_inputNodes[i]->GetName().c_str());
+                RuntimeError("Input %ls: Due to sparse input format, expected Indices array, but was nullptr.", context.m_inputNodes[i]->GetName().c_str());
             if (buffer.m_colIndices.size() < 2)
-                RuntimeError("Input %ls: Expected at least one element (2 entries in colIndices array).", m_inputNodes[i]->GetName().c_str());
+                RuntimeError("Input %ls: Expected at least one element (2 entries in colIndices array).", context.m_inputNodes[i]->GetName().c_str());
             if (buffer.m_colIndices[0] != 0)
-                RuntimeError("Input %ls: First element of column indices must be 0", m_inputNodes[i]->GetName().c_str());
+                RuntimeError("Input %ls: First element of column indices must be 0", context.m_inputNodes[i]->GetName().c_str());
             if (buffer.m_colIndices[buffer.m_colIndices.size() - 1] != buffer.m_indices.size())
                 RuntimeError("Input %ls: Last element of column indices must be equal to the size of indices (%ld), but was %d", 
-                             m_inputNodes[i]->GetName().c_str(), buffer.m_indices.size(), 
+                             context.m_inputNodes[i]->GetName().c_str(), buffer.m_indices.size(), 
                              buffer.m_colIndices[buffer.m_colIndices.size() - 1]);
         }
 
@@ -358,8 +493,10 @@ void CNTKEvalExtended<ElemType>::ForwardPassT(const std::vector<ValueBuffer<Elem
             RuntimeError("Input: the number of column must be greater than or equal to 1.");
         inputNode->GetMBLayout()->Init(1, numCols);
         
-        // SentinelValueIndicatingUnspecifedSequenceBeginIdx is used to specify the lower bound of look-back step of recurrent nodes
-        inputNode->GetMBLayout()->AddSequence(0, 0, resetRNN ? 0 : SentinelValueIndicatingUnspecifedSequenceBeginIdx, numCols);
+        // SentinelValueIndicatingUnspecifedSequenceBeginIdx is used to specify the lower bound of look-back step of recurrent nodes.
+        // The recurrent state of a context that was last used by another thread (or not at all) is not continued.
+        bool reset = resetRNN || context.m_resetState;
+        inputNode->GetMBLayout()->AddSequence(0, 0, reset ? 0 : SentinelValueIndicatingUnspecifedSequenceBeginIdx, numCols);
 
         if (type == MatrixType::DENSE)
             matrix->SetValue(numRows, numCols, matrix->GetDeviceId(), buffer.m_buffer.data(), matrixFlagNormal);
@@ -374,12 +511,12 @@ void CNTKEvalExtended<ElemType>::ForwardPassT(const std::vector<ValueBuffer<Elem
         ++i;
     }
 
-    ComputationNetwork::BumpEvalTimeStamp(m_inputNodes);
-    this->m_net->ForwardProp(m_outputNodes);
+    ComputationNetwork::BumpEvalTimeStamp(context.m_inputNodes);
+    context.m_net->ForwardProp(context.m_outputNodes);
 
-    for (size_t i2 = 0; i2 < m_outputNodes.size(); ++i2)
+    for (size_t i2 = 0; i2 < context.m_outputNodes.size(); ++i2)
     {
-        auto node = m_outputNodes[i2];
+        auto node = context.m_outputNodes[i2];
         
         shared_ptr<Matrix<ElemType>> outputMatrix = dynamic_pointer_cast<Matrix<ElemType>>(node->ValuePtr());
         auto pMBLayout = node->GetMBLayout();
@@ -433,11 +570,152 @@ void CNTKEvalExtended<ElemType>::ForwardPass(const ValueRefs<ElemType>& inputs,
     ForwardPassT(inputs, outputs, resetRNN);
 }
 
+template<typename ElemType>
+void CNTKEvalExtended<ElemType>::ForwardPassBatch(const std::vector<const Values<ElemType>*>& inputs, const std::vector<Values<ElemType>*>& outputs)
+{
+    if (!m_started)
+        RuntimeError("ForwardPassBatch() called before StartForwardEvaluation()");
+
+    if (inputs.size() != outputs.size())
+        LogicError("ForwardPassBatch: Expected the same number of input and output requests, but got %d and %d.", (int)inputs.size(), (int)outputs.size());
+
+    if (inputs.empty())
+        return;
+
+    auto context = AcquireContext();
+    try
+    {
+        ForwardPassBatch(*context, inputs, outputs);
+    }
+    catch (...)
+    {
+        ReleaseContext(context);
+        throw;
+    }
+    ReleaseContext(context);
+}
+
+template<typename ElemType>
+void CNTKEvalExtended<ElemType>::ForwardPassBatch(EvaluationContext& context, const std::vector<const Values<ElemType>*>& inputs, const std::vector<Values<ElemType>*>& outputs)
+{
+    const size_t numRequests = inputs.size();
+    for (size_t k = 0; k < numRequests; ++k)
+    {
+        if (inputs[k]->size() != context.m_inputNodes.size())
+            RuntimeError("Request %d: Expected %d inputs, but got %d.", (int)k, (int)context.m_inputNodes.size(), (int)inputs[k]->size());
+        if (outputs[k]->size() != context.m_outputNodes.size())
+            RuntimeError("Request %d: Expected %d outputs, but got %d.", (int)k, (int)context.m_outputNodes.size(), (int)outputs[k]->size());
+    }
+
+    // Inputs on the same dynamic axis share their MBLayout, which is packed once from the first of these inputs.
+    // The sequence of request k gets the sequence id k, which is used to find its columns in the outputs.
+    std::map<MBLayoutPtr, std::vector<std::pair<size_t, size_t>>> placements;
+    std::map<MBLayoutPtr, std::vector<size_t>> sequenceLengths;
+    std::vector<ElemType> data;
+    for (size_t i = 0; i < context.m_inputNodes.size(); ++i)
+    {
+        auto& inputNode = context.m_inputNodes[i];
+        auto matrix = dynamic_pointer_cast<Matrix<ElemType>>(inputNode->ValuePtr());
+        if (matrix->GetMatrixType() != MatrixType::DENSE)
+            RuntimeError("Input %ls: Only dense inputs are supported in batched evaluation.", inputNode->GetName().c_str());
+        // The requests are told apart by their sequences, an input without a dynamic axis cannot be batched.
+        if (!inputNode->HasMBLayout())
+            RuntimeError("Input %ls: Inputs without a dynamic axis are not supported in batched evaluation.", inputNode->GetName().c_str());
+
+        size_t numRows = inputNode->GetSampleLayout().GetNumElements();
+        std::vector<size_t> lengths(numRequests);
+        for (size_t k = 0; k < numRequests; ++k)
+        {
+            const auto& buffer = (*inputs[k])[i].m_buffer;
+            if (buffer.size() == 0 || buffer.size() % numRows != 0)
+                RuntimeError("Input %ls: Expected input data of request %d to be a non-zero multiple of %" PRIu64 ", but it is %" PRIu64 ".",
+                             inputNode->GetName().c_str(), (int)k, numRows, buffer.size());
+            lengths[k] = buffer.size() / numRows;
+        }
+
+        auto pMBLayout = inputNode->GetMBLayout();
+        auto placement = placements.find(pMBLayout);
+        if (placement == placements.end())
+        {
+            std::vector<MBLayout::SequenceInfo> sequences;
+            for (size_t k = 0; k < numRequests; ++k)
+                sequences.push_back({ k, SIZE_MAX, 0, lengths[k] });
+
+            placement = placements.insert(make_pair(pMBLayout, std::vector<std::pair<size_t, size_t>>())).first;
+            std::vector<size_t> rowAllocations;
+            pMBLayout->InitAsPackedSequences(sequences, placement->second, rowAllocations);
+            sequenceLengths[pMBLayout] = lengths;
+        }
+        else if (sequenceLengths[pMBLayout] != lengths)
+            RuntimeError("Input %ls: The sequence lengths must match the other inputs on the same dynamic axis.", inputNode->GetName().c_str());
+
+        // Sample t of parallel sequence s goes to column t * numParallelSequences + s, gaps are zero.
+        const size_t numParallelSequences = pMBLayout->GetNumParallelSequences();
+        data.assign(numRows * pMBLayout->GetNumCols(), 0);
+        for (size_t k = 0; k < numRequests; ++k)
+        {
+            const auto& buffer = (*inputs[k])[i].m_buffer;
+            size_t s = placement->second[k].first;
+            size_t tBegin = placement->second[k].second;
+            for (size_t t = 0; t < lengths[k]; ++t)
+                memcpy(&data[((tBegin + t) * numParallelSequences + s) * numRows], &buffer[t * numRows], numRows * sizeof(ElemType));
+        }
+        matrix->SetValue(numRows, pMBLayout->GetNumCols(), matrix->GetDeviceId(), data.data(), matrixFlagNormal);
+    }
+
+    ComputationNetwork::BumpEvalTimeStamp(context.m_inputNodes);
+    context.m_net->ForwardProp(context.m_outputNodes);
+
+    std::vector<bool> found(numRequests);
+    for (size_t i2 = 0; i2 < context.m_outputNodes.size(); ++i2)
+    {
+        auto node = context.m_outputNodes[i2];
+        auto pMBLayout = node->GetMBLayout();
+        if (!pMBLayout)
+            RuntimeError("Output %ls: Outputs without a dynamic axis are not supported in batched evaluation.", node->GetName().c_str());
+
+        shared_ptr<Matrix<ElemType>> outputMatrix = dynamic_pointer_cast<Matrix<ElemType>>(node->ValuePtr());
+        size_t numElements = outputMatrix->GetNumElements();
+        data.resize(numElements);
+        ElemType* dataPtr = data.data();
+        outputMatrix->CopyToArray(dataPtr, numElements);
+
+        const size_t numRows = outputMatrix->GetNumRows();
+        const size_t numParallelSequences = pMBLayout->GetNumParallelSequences();
+        const size_t numTimeSteps = pMBLayout->GetNumTimeSteps();
+        std::fill(found.begin(), found.end(), false);
+        for (const auto& sequence : pMBLayout->GetAllSequences())
+        {
+            if (sequence.seqId == GAP_SEQUENCE_ID)
+                continue;
+            if (sequence.seqId >= numRequests || found[sequence.seqId])
+                RuntimeError("Output %ls: Cannot map the output sequences back to the requests.", node->GetName().c_str());
+            found[sequence.seqId] = true;
+
+            // Sequences may begin or end outside of the minibatch.
+            size_t tBegin = (size_t)std::max<ptrdiff_t>(sequence.tBegin, 0);
+            size_t tEnd = std::min(sequence.tEnd, numTimeSteps);
+            auto& vec = (*outputs[sequence.seqId])[i2].m_buffer;
+            if (vec.capacity() < numRows * (tEnd - tBegin))
+            {
+                // Bad luck - we can't reallocate memory of an external object at this point.
+                RuntimeError("Not enough space in output buffer for output '%ls'.", node->GetName().c_str());
+            }
+
+            vec.resize(numRows * (tEnd - tBegin));
+            for (size_t t = tBegin; t < tEnd; ++t)
+                memcpy(&vec[(t - tBegin) * numRows], &data[(t * numParallelSequences + sequence.s) * numRows], numRows * sizeof(ElemType));
+        }
+
+        if (std::find(found.begin(), found.end(), false) != found.end())
+            RuntimeError("Output %ls: Cannot map the output sequences back to the requests.", node->GetName().c_str());
+    }
+}
+
 template <typename ElemType>
 void CNTKEvalExtended<ElemType>::Destroy()
 {
-    // Since m_scopeNetworkOperationMode has a reference to m_net, it has to be released first.
-    m_scopedNetworkOperationMode.reset();
+    DestroyContexts();
     CNTKEvalBase<ElemType>::Destroy();
     delete this;
 }
@@ -459,4 +737,239 @@ extern "C" EVAL_API void GetEvalExtendedD(IEvaluateModelExtended<double>** peval
 
 template class CNTKEvalExtended<double>;
 template class CNTKEvalExtended<float>;
+
+// ----------------------------------------------------------------------------
+// Batching interface
+// ----------------------------------------------------------------------------
+
+template <typename ElemType>
+CNTKBatchingEval<ElemType>::CNTKBatchingEval()
+    : m_eval(new CNTKEvalExtended<ElemType>()),
+      m_started(false),
+      m_maxBatchSize(32),
+      m_maxWaitTime(2000),
+      m_numWorkerThreads(1),
+      m_stop(false),
+      m_statistics()
+{
+}
+
+template <typename ElemType>
+void CNTKBatchingEval<ElemType>::Init(const std::string& config)
+{
+    m_eval->Init(config);
+
+    ConfigParameters parameters;
+    parameters.Parse(config);
+    m_maxBatchSize = parameters("maxBatchSize", "32");
+    m_maxWaitTime = std::chrono::microseconds((long long)(1000 * (double)parameters("maxWaitTimeMs", "2")));
+    m_numWorkerThreads = parameters("numWorkerThreads", "1");
+    if (m_maxBatchSize == 0 || m_numWorkerThreads == 0)
+        InvalidArgument("maxBatchSize and numWorkerThreads must be greater than zero.");
+}
+
+template <typename ElemType>
+void CNTKBatchingEval<ElemType>::CreateNetwork(const std::string& networkDescription)
+{
+    m_eval->CreateNetwork(networkDescription);
+}
+
+template <typename ElemType>
+VariableSchema CNTKBatchingEval<ElemType>::GetOutputSchema() const
+{
+    return m_eval->GetOutputSchema();
+}
+
+template <typename ElemType>
+VariableSchema CNTKBatchingEval<ElemType>::GetInputSchema() const
+{
+    return m_eval->GetInputSchema();
+}
+
+template <typename ElemType>
+void CNTKBatchingEval<ElemType>::StartForwardEvaluation(const std::vector<wstring>& outputs)
+{
+    StopWorkers();
+
+    m_eval->StartForwardEvaluation(outputs);
+    m_inputSchema = m_eval->GetInputSchema();
+    m_outputSchema = m_eval->GetOutputSchema();
+    for (const auto& input : m_inputSchema)
+    {
+        if (input.m_storageType != VariableLayout::Dense)
+            RuntimeError("Input %ls: Only dense inputs are supported in batched evaluation.", input.m_name.c_str());
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_statistics = BatchingStatistics();
+        m_stop = false;
+        m_started = true;
+    }
+    for (size_t i = 0; i < m_numWorkerThreads; ++i)
+        m_workers.push_back(std::thread([this]() { WorkerLoop(); }));
+}
+
+template <typename ElemType>
+void CNTKBatchingEval<ElemType>::ForwardPass(const Values<ElemType>& inputs, Values<ElemType>& outputs)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        if (!m_started)
+            RuntimeError("ForwardPass() called before StartForwardEvaluation()");
+    }
+
+    // Check the request here, so that a malformed request does not fail the other requests of its minibatch.
+    if (inputs.size() != m_inputSchema.size())
+        RuntimeError("Expected %d inputs, but got %d.", (int)m_inputSchema.size(), (int)inputs.size());
+    if (outputs.size() != m_outputSchema.size())
+        RuntimeError("Expected %d outputs, but got %d.", (int)m_outputSchema.size(), (int)outputs.size());
+    for (size_t i = 0; i < inputs.size(); ++i)
+    {
+        size_t numRows = m_inputSchema[i].m_numElements;
+        if (inputs[i].m_buffer.size() == 0 || inputs[i].m_buffer.size() % numRows != 0)
+            RuntimeError("Input %ls: Expected input data to be a non-zero multiple of %" PRIu64 ", but it is %" PRIu64 ".",
+                         m_inputSchema[i].m_name.c_str(), numRows, inputs[i].m_buffer.size());
+    }
+
+    Request request;
+    request.m_inputs = &inputs;
+    request.m_outputs = &outputs;
+    auto done = request.m_done.get_future();
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        if (m_stop || !m_started)
+            RuntimeError("ForwardPass() called after the evaluation has been stopped.");
+        request.m_submitted = std::chrono::steady_clock::now();
+        m_queue.push_back(&request);
+    }
+    // Workers waiting for a full minibatch have to check the queue again.
+    m_requestQueued.notify_all();
+
+    done.get();
+}
+
+template <typename ElemType>
+void CNTKBatchingEval<ElemType>::WorkerLoop()
+{
+    std::vector<Request*> batch;
+    std::vector<const Values<ElemType>*> inputs;
+    std::vector<Values<ElemType>*> outputs;
+    for (;;)
+    {
+        batch.clear();
+        {
+            std::unique_lock<std::mutex> lock(m_lock);
+            m_requestQueued.wait(lock, [this]() { return m_stop || !m_queue.empty(); });
+            if (m_stop)
+                return;
+
+            // Wait for more requests until the minibatch is full or the oldest request has waited long enough.
+            auto deadline = m_queue.front()->m_submitted + m_maxWaitTime;
+            m_requestQueued.wait_until(lock, deadline, [this]() { return m_stop || m_queue.size() >= m_maxBatchSize; });
+            if (m_stop)
+                return;
+
+            // Another worker may have taken the requests in the meantime.
+            if (m_queue.empty())
+                continue;
+
+            size_t batchSize = std::min(m_queue.size(), m_maxBatchSize);
+            batch.assign(m_queue.begin(), m_queue.begin() + batchSize);
+            m_queue.erase(m_queue.begin(), m_queue.begin() + batchSize);
+
+            auto now = std::chrono::steady_clock::now();
+            m_statistics.m_numRequests += batchSize;
+            m_statistics.m_numBatches++;
+            AddToHistogram(m_statistics.m_batchSizeHistogram, batchSize);
+            for (auto request : batch)
+                AddToHistogram(m_statistics.m_queueLatencyHistogram,
+                               (size_t)std::chrono::duration_cast<std::chrono::microseconds>(now - request->m_submitted).count());
+        }
+
+        inputs.clear();
+        outputs.clear();
+        for (auto request : batch)
+        {
+            inputs.push_back(request->m_inputs);
+            outputs.push_back(request->m_outputs);
+        }
+
+        try
+        {
+            m_eval->ForwardPassBatch(inputs, outputs);
+            for (auto request : batch)
+                request->m_done.set_value();
+        }
+        catch (...)
+        {
+            for (auto request : batch)
+                request->m_done.set_exception(std::current_exception());
+        }
+    }
+}
+
+template <typename ElemType>
+void CNTKBatchingEval<ElemType>::StopWorkers()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_stop = true;
+    }
+    m_requestQueued.notify_all();
+    for (auto& worker : m_workers)
+        worker.join();
+    m_workers.clear();
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    for (auto request : m_queue)
+        request->m_done.set_exception(std::make_exception_ptr(std::runtime_error("The evaluation has been stopped before the request was processed.")));
+    m_queue.clear();
+    m_started = false;
+}
+
+template <typename ElemType>
+void CNTKBatchingEval<ElemType>::AddToHistogram(std::vector<size_t>& histogram, size_t value)
+{
+    size_t bucket = 0;
+    while (bucket < 8 * sizeof(size_t) - 1 && ((size_t)1 << bucket) < value)
+        bucket++;
+
+    if (histogram.size() <= bucket)
+        histogram.resize(bucket + 1);
+    histogram[bucket]++;
+}
+
+template <typename ElemType>
+BatchingStatistics CNTKBatchingEval<ElemType>::GetStatistics() const
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_statistics;
+}
+
+template <typename ElemType>
+void CNTKBatchingEval<ElemType>::Destroy()
+{
+    StopWorkers();
+    m_eval->Destroy();
+    delete this;
+}
+
+template <typename ElemType>
+void EVAL_API GetEvalBatching(IEvaluateModelBatching<ElemType>** peval)
+{
+    *peval = new CNTKBatchingEval<ElemType>();
+}
+
+extern "C" EVAL_API void GetEvalBatchingF(IEvaluateModelBatching<float>** peval)
+{
+    GetEvalBatching(peval);
+}
+extern "C" EVAL_API void GetEvalBatchingD(IEvaluateModelBatching<double>** peval)
+{
+    GetEvalBatching(peval);
+}
+
+template class CNTKBatchingEval<double>;
+template class CNTKBatchingEval<float>;
 } } }
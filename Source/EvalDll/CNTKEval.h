@@ -13,6 +13,12 @@
 #include <string>
 #include <map>
 #include <vector>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <chrono>
 
 #include "Eval.h"
 #include "EvalReader.h"
@@ -86,12 +92,17 @@ public:
 // ------------------------------------------------------------------------
 // Extended interface
 // ------------------------------------------------------------------------
+// ForwardPass() can be called concurrently. Every call runs on an evaluation context, which holds a copy of the
+// network that shares the parameters with the loaded model, so only activations, MBLayouts and recurrent state
+// are kept per context. Contexts are reused and only created when none is free, up to maxNumEvaluationContexts
+// (default: number of cores). A thread gets the context it used last if it is free, so that recurrent state is
+// carried over between calls of one thread (resetRNN = false); on any other context the state is reset.
 template <typename ElemType>
 class CNTKEvalExtended : public CNTKEvalBase<ElemType>, public IEvaluateModelExtended<ElemType>
 {
 public:
     CNTKEvalExtended() : CNTKEvalBase<ElemType>(), 
-        m_started(false){}
+        m_started(false), m_maxNumContexts(0) {}
 
     virtual VariableSchema GetOutputSchema() const override;
 
@@ -107,6 +118,11 @@ public:
 
     virtual void ForwardPass(const ValueRefs<ElemType>& inputs, ValueRefs<ElemType>& output, bool resetRNN) override;
 
+    // Evaluates several independent requests in one minibatch, inputs[k] and outputs[k] are the buffers of the
+    // k-th request as in ForwardPass(). The sequences of the requests are packed into one MBLayout, so the
+    // inputs must be dense and recurrent state is reset for every request.
+    void ForwardPassBatch(const std::vector<const Values<ElemType>*>& inputs, const std::vector<Values<ElemType>*>& outputs);
+
     virtual void Destroy() override;
 
     virtual void CreateNetwork(const std::string& networkDescription) override
@@ -120,16 +136,111 @@ public:
     }
 
 private:
+    // The network a forward pass runs on, with its evaluation state.
+    struct EvaluationContext
+    {
+        ComputationNetworkPtr m_net;
+        std::shared_ptr<ScopedNetworkOperationMode> m_scopedNetworkOperationMode;
+        std::vector<ComputationNodeBasePtr> m_outputNodes;
+        std::vector<ComputationNodeBasePtr> m_inputNodes;
+        StreamMinibatchInputs m_inputMatrices;
+        std::thread::id m_lastThread; // the thread that used the context last
+        bool m_resetState = false;    // the recurrent state belongs to another thread, the next call resets it
+    };
+    typedef std::shared_ptr<EvaluationContext> EvaluationContextPtr;
+
     static VariableLayout ToVariableLayout(const ComputationNodeBasePtr n);
-    std::vector<ComputationNodeBasePtr> m_outputNodes;
-    std::shared_ptr<ScopedNetworkOperationMode> m_scopedNetworkOperationMode;
-    std::vector<ComputationNodeBasePtr> m_inputNodes;
-    StreamMinibatchInputs m_inputMatrices;
+
+    // Prepares the network for the evaluation of m_outputNodeNames.
+    EvaluationContextPtr CreateContext(const ComputationNetworkPtr& net) const;
+    // Gets a free context (creating one if needed and possible) or waits for one.
+    EvaluationContextPtr AcquireContext();
+    void ReleaseContext(const EvaluationContextPtr& context);
+    void DestroyContexts();
+
+    std::vector<std::wstring> m_outputNodeNames;
+    // The context of the loaded network, used for the schemas.
+    EvaluationContextPtr m_mainContext;
+    // Copy of the loaded network that is never evaluated, new contexts are cloned from it.
+    ComputationNetworkPtr m_templateNet;
+    // Serializes the clones of m_templateNet.
+    std::mutex m_cloneLock;
     bool m_started;
 
+    std::vector<EvaluationContextPtr> m_contexts;
+    std::vector<EvaluationContextPtr> m_freeContexts;
+    // Maximum number of contexts, on GPUs all calls share the network of the loaded model.
+    size_t m_maxNumContexts;
+    std::mutex m_contextLock;
+    std::condition_variable m_contextReleased;
+
     template<template<typename> class ValueContainer> 
     void ForwardPassT(const std::vector < ValueBuffer<ElemType, ValueContainer> >& inputs,
                       std::vector < ValueBuffer<ElemType, ValueContainer> >& outputs, bool resetRNN);
 
+    template<template<typename> class ValueContainer> 
+    void ForwardPassT(EvaluationContext& context, const std::vector < ValueBuffer<ElemType, ValueContainer> >& inputs,
+                      std::vector < ValueBuffer<ElemType, ValueContainer> >& outputs, bool resetRNN);
+
+    void ForwardPassBatch(EvaluationContext& context, const std::vector<const Values<ElemType>*>& inputs, const std::vector<Values<ElemType>*>& outputs);
+};
+
+// ------------------------------------------------------------------------
+// Batching interface
+// ------------------------------------------------------------------------
+// Requests are queued by ForwardPass() and picked up by the worker threads, which evaluate up to m_maxBatchSize
+// of them at a time through CNTKEvalExtended::ForwardPassBatch().
+template <typename ElemType>
+class CNTKBatchingEval : public IEvaluateModelBatching<ElemType>
+{
+public:
+    CNTKBatchingEval();
+
+    virtual void Init(const std::string& config) override;
+
+    virtual void CreateNetwork(const std::string& networkDescription) override;
+
+    virtual VariableSchema GetOutputSchema() const override;
+
+    virtual void StartForwardEvaluation(const std::vector<wstring>& outputs) override;
+
+    virtual VariableSchema GetInputSchema() const override;
+
+    virtual void ForwardPass(const Values<ElemType>& inputs, Values<ElemType>& outputs) override;
+
+    virtual BatchingStatistics GetStatistics() const override;
+
+    virtual void Destroy() override;
+
+private:
+    struct Request
+    {
+        const Values<ElemType>* m_inputs;
+        Values<ElemType>* m_outputs;
+        std::chrono::steady_clock::time_point m_submitted;
+        std::promise<void> m_done;
+    };
+
+    void WorkerLoop();
+    // Stops the workers and fails the requests that are still queued.
+    void StopWorkers();
+    static void AddToHistogram(std::vector<size_t>& histogram, size_t value);
+
+    CNTKEvalExtended<ElemType>* m_eval;
+    VariableSchema m_inputSchema;
+    VariableSchema m_outputSchema;
+    bool m_started;
+
+    size_t m_maxBatchSize;
+    std::chrono::microseconds m_maxWaitTime;
+    size_t m_numWorkerThreads;
+    std::vector<std::thread> m_workers;
+
+    // Protects the queue and the statistics.
+    mutable std::mutex m_lock;
+    std::condition_variable m_requestQueued;
+    std::deque<Request*> m_queue;
+    bool m_stop;
+    BatchingStatistics m_statistics;
 };
 } } }
@@ -0,0 +1,305 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include "CPUCachingMemAllocator.h"
+#include <new>
+#include <stdlib.h>
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+namespace {
+
+// Size classes are 4, 5, 6 and 7 times a power of two, from 256 bytes up to 1.75 GB. Larger blocks are not cached.
+const size_t MinClassShift = 6;
+const size_t MaxClassShift = 28;
+const size_t NumSizeClasses = (MaxClassShift - MinClassShift + 1) * 4;
+const size_t NoSizeClass = SIZE_MAX;
+
+// Blocks up to 256 KB are cached per thread, up to 16 MB per thread.
+const size_t NumThreadCachedClasses = (16 - MinClassShift) * 4 + 1;
+const size_t MaxThreadCachedBytes = 16 * 1024 * 1024;
+
+const size_t HugePageSize = 2 * 1024 * 1024;
+
+size_t GetSizeClass(size_t size)
+{
+    size_t shift = MinClassShift;
+    while (shift <= MaxClassShift && ((size_t) 8 << shift) < size)
+        shift++;
+    if (shift > MaxClassShift)
+        return NoSizeClass;
+
+    size_t multiple = (size + ((size_t) 1 << shift) - 1) >> shift;
+    if (multiple < 4)
+        multiple = 4;
+    else if (multiple == 8)
+    {
+        multiple = 4;
+        shift++;
+    }
+
+    if (shift > MaxClassShift)
+        return NoSizeClass;
+    return (shift - MinClassShift) * 4 + multiple - 4;
+}
+
+size_t GetClassSize(size_t sizeClass)
+{
+    return (4 + sizeClass % 4) << (MinClassShift + sizeClass / 4);
+}
+
+// Precedes every block, the user pointer is one alignment unit behind the start of the allocation.
+struct BlockHeader
+{
+    size_t m_sizeClass;
+    size_t m_size;
+};
+static_assert(sizeof(BlockHeader) <= CPUCachingMemAllocator::Alignment, "The block header must fit into the alignment padding.");
+
+BlockHeader* GetHeader(void* block)
+{
+    return reinterpret_cast<BlockHeader*>(static_cast<char*>(block) - CPUCachingMemAllocator::Alignment);
+}
+
+struct ThreadCache
+{
+    std::vector<void*> m_freeLists[NumThreadCachedClasses];
+    size_t m_bytes = 0;
+};
+
+// The cache is created on first use and handed over to the shared cache when the thread exits. Blocks freed
+// by destructors of other thread-local objects that run later go to the shared cache directly.
+thread_local ThreadCache* t_threadCache = nullptr;
+thread_local bool t_threadExited = false;
+
+struct ThreadCacheOwner
+{
+    ~ThreadCacheOwner()
+    {
+        CPUCachingMemAllocator::Instance().ReleaseThreadCache();
+        t_threadExited = true;
+    }
+};
+
+ThreadCache* GetThreadCache()
+{
+    static thread_local ThreadCacheOwner owner; // constructed on the first call in a thread
+    if (!t_threadCache && !t_threadExited)
+        t_threadCache = new ThreadCache();
+    return t_threadCache;
+}
+
+}
+
+std::atomic<bool> CPUCachingMemAllocator::s_enabled(false);
+std::atomic<bool> CPUCachingMemAllocator::s_useHugePages(false);
+std::atomic<size_t> CPUCachingMemAllocator::s_maxCachedBytes(SIZE_MAX);
+
+CPUCachingMemAllocator& CPUCachingMemAllocator::Instance()
+{
+    // Never destroyed, blocks may be freed by destructors of static objects.
+    static CPUCachingMemAllocator* instance = new CPUCachingMemAllocator();
+    return *instance;
+}
+
+void CPUCachingMemAllocator::Configure(bool enabled, bool useHugePages, size_t maxCachedBytes)
+{
+    s_useHugePages = useHugePages;
+    s_maxCachedBytes = maxCachedBytes;
+    s_enabled = enabled;
+}
+
+MemAllocator* CPUCachingMemAllocator::GetEnabledInstance()
+{
+    return s_enabled ? &Instance() : nullptr;
+}
+
+CPUCachingMemAllocator::CPUCachingMemAllocator()
+    : m_freeLists(NumSizeClasses),
+      m_bytesCached(0),
+      m_bytesInUse(0),
+      m_peakBytesInUse(0),
+      m_numHits(0),
+      m_numMisses(0)
+{
+}
+
+void* CPUCachingMemAllocator::AllocateBlock(size_t sizeClass, size_t size)
+{
+    // Huge pages need the allocation to cover whole pages, the data itself starts one alignment unit later.
+    const bool useHugePages = s_useHugePages && size >= HugePageSize;
+    const size_t alignment = useHugePages ? HugePageSize : Alignment;
+    if (size > SIZE_MAX - HugePageSize)
+        throw std::bad_alloc();
+    const size_t totalSize = Alignment + size;
+
+    void* allocation;
+#ifdef _WIN32
+    // Large pages require the SeLockMemoryPrivilege on Windows, they are not used.
+    allocation = _aligned_malloc(totalSize, alignment);
+#else
+    if (posix_memalign(&allocation, alignment, totalSize) != 0)
+        allocation = nullptr;
+#endif
+    if (!allocation)
+        throw std::bad_alloc();
+
+#ifndef _WIN32
+    if (useHugePages)
+        madvise(allocation, totalSize, MADV_HUGEPAGE); // only a hint, ignored if transparent huge pages are disabled
+#endif
+
+    BlockHeader* header = static_cast<BlockHeader*>(allocation);
+    header->m_sizeClass = sizeClass;
+    header->m_size = size;
+    return static_cast<char*>(allocation) + Alignment;
+}
+
+void CPUCachingMemAllocator::FreeBlock(void* block)
+{
+#ifdef _WIN32
+    _aligned_free(GetHeader(block));
+#else
+    free(GetHeader(block));
+#endif
+}
+
+void* CPUCachingMemAllocator::Malloc(size_t size)
+{
+    const size_t sizeClass = GetSizeClass(size);
+    void* block = nullptr;
+    if (sizeClass != NoSizeClass)
+    {
+        size = GetClassSize(sizeClass);
+
+        ThreadCache* threadCache = sizeClass < NumThreadCachedClasses ? GetThreadCache() : nullptr;
+        if (threadCache && !threadCache->m_freeLists[sizeClass].empty())
+        {
+            block = threadCache->m_freeLists[sizeClass].back();
+            threadCache->m_freeLists[sizeClass].pop_back();
+            threadCache->m_bytes -= size;
+        }
+        else
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_freeLists[sizeClass].empty())
+            {
+                block = m_freeLists[sizeClass].back();
+                m_freeLists[sizeClass].pop_back();
+            }
+        }
+    }
+
+    if (block)
+    {
+        m_bytesCached -= size;
+        m_numHits++;
+    }
+    else
+    {
+        block = AllocateBlock(sizeClass, size);
+        m_numMisses++;
+    }
+
+    size_t bytesInUse = (m_bytesInUse += size);
+    size_t peak = m_peakBytesInUse;
+    while (bytesInUse > peak && !m_peakBytesInUse.compare_exchange_weak(peak, bytesInUse))
+        ;
+
+    return block;
+}
+
+void CPUCachingMemAllocator::Free(void* p)
+{
+    if (!p)
+        return;
+
+    const BlockHeader* header = GetHeader(p);
+    m_bytesInUse -= header->m_size;
+    if (header->m_sizeClass == NoSizeClass)
+        FreeBlock(p);
+    else
+        CacheOrFree(p, header->m_sizeClass, /*useThreadCache=*/ true);
+}
+
+void CPUCachingMemAllocator::CacheOrFree(void* block, size_t sizeClass, bool useThreadCache)
+{
+    const size_t size = GetClassSize(sizeClass);
+    if (m_bytesCached + size > s_maxCachedBytes)
+    {
+        FreeBlock(block);
+        return;
+    }
+
+    ThreadCache* threadCache = useThreadCache && sizeClass < NumThreadCachedClasses ? GetThreadCache() : nullptr;
+    if (threadCache && threadCache->m_bytes + size <= MaxThreadCachedBytes)
+    {
+        threadCache->m_freeLists[sizeClass].push_back(block);
+        threadCache->m_bytes += size;
+    }
+    else
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_freeLists[sizeClass].push_back(block);
+    }
+    m_bytesCached += size;
+}
+
+void CPUCachingMemAllocator::ReleaseThreadCache()
+{
+    ThreadCache* threadCache = t_threadCache;
+    if (!threadCache)
+        return;
+
+    t_threadCache = nullptr;
+    for (size_t sizeClass = 0; sizeClass < NumThreadCachedClasses; sizeClass++)
+    {
+        for (void* block : threadCache->m_freeLists[sizeClass])
+        {
+            m_bytesCached -= GetClassSize(sizeClass);
+            CacheOrFree(block, sizeClass, /*useThreadCache=*/ false);
+        }
+    }
+    delete threadCache;
+}
+
+void CPUCachingMemAllocator::ReleaseCachedMemory()
+{
+    ReleaseThreadCache();
+
+    std::vector<std::vector<void*>> freeLists(NumSizeClasses);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_freeLists.swap(freeLists);
+    }
+
+    for (size_t sizeClass = 0; sizeClass < NumSizeClasses; sizeClass++)
+    {
+        for (void* block : freeLists[sizeClass])
+        {
+            m_bytesCached -= GetClassSize(sizeClass);
+            FreeBlock(block);
+        }
+    }
+}
+
+CPUCachingMemAllocator::Statistics CPUCachingMemAllocator::GetStatistics() const
+{
+    Statistics statistics;
+    statistics.m_bytesInUse = m_bytesInUse;
+    statistics.m_peakBytesInUse = m_peakBytesInUse;
+    statistics.m_bytesCached = m_bytesCached;
+    statistics.m_numHits = m_numHits;
+    statistics.m_numMisses = m_numMisses;
+    return statistics;
+}
+
+}}}
@@ -0,0 +1,89 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include "MemAllocator.h"
+#include <atomic>
+#include <mutex>
+#include <stdint.h>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+#pragma warning(push)
+#pragma warning(disable : 4251)
+
+//-------------------------------------------------------------
+// Caching allocator for CPU buffers, the CPU counterpart of a caching GPU allocator.
+//
+// Dense CPU matrices and reader buffers are reallocated for every minibatch whose size differs from the previous one,
+// and with many threads the global heap becomes a point of contention. Freed blocks are therefore kept in free lists
+// per size class (four classes per power of two, at most 25% waste) and handed out again. Small blocks are cached per
+// thread without locking, larger ones in a shared cache. Blocks are 64-byte aligned (AVX-512), blocks of 2 MB or more
+// can optionally be backed by transparent huge pages (Linux only).
+//
+// There is a single process-wide instance. Blocks can be freed from any thread, also after the allocator has been
+// disabled; disabling only stops new allocations from being served by it.
+//-------------------------------------------------------------
+class MATH_API CPUCachingMemAllocator : public MemAllocator
+{
+public:
+    struct Statistics
+    {
+        size_t m_bytesInUse;     // allocated and not yet freed, rounded up to the size classes
+        size_t m_peakBytesInUse;
+        size_t m_bytesCached;    // in the free lists of all threads
+        size_t m_numHits;        // allocations served from the free lists
+        size_t m_numMisses;      // allocations served from the heap
+
+        double GetHitRate() const { return m_numHits + m_numMisses == 0 ? 0 : (double) m_numHits / (m_numHits + m_numMisses); }
+    };
+
+    static const size_t Alignment = 64;
+
+    static CPUCachingMemAllocator& Instance();
+
+    // Enables or disables the allocator for CPU matrices and reader buffers. Blocks in excess of 'maxCachedBytes'
+    // are returned to the heap when freed.
+    static void Configure(bool enabled, bool useHugePages = false, size_t maxCachedBytes = SIZE_MAX);
+
+    // The instance if enabled, nullptr otherwise. Memory obtained from it must be freed through it.
+    static MemAllocator* GetEnabledInstance();
+
+    void* Malloc(size_t size) override;
+    void Free(void* p) override;
+
+    // Moves the blocks cached by the calling thread to the shared cache. Called when a thread exits.
+    void ReleaseThreadCache();
+
+    // Returns the shared cache and the cache of the calling thread to the heap.
+    void ReleaseCachedMemory();
+
+    Statistics GetStatistics() const;
+
+private:
+    CPUCachingMemAllocator();
+
+    void* AllocateBlock(size_t sizeClass, size_t size);
+    void FreeBlock(void* block);
+    void CacheOrFree(void* block, size_t sizeClass, bool useThreadCache);
+
+    static std::atomic<bool> s_enabled;
+    static std::atomic<bool> s_useHugePages;
+    static std::atomic<size_t> s_maxCachedBytes;
+
+    std::mutex m_mutex;                           // for m_freeLists
+    std::vector<std::vector<void*>> m_freeLists;  // per size class
+    std::atomic<size_t> m_bytesCached;            // in the free lists of all threads
+    std::atomic<size_t> m_bytesInUse;
+    std::atomic<size_t> m_peakBytesInUse;
+    std::atomic<size_t> m_numHits;
+    std::atomic<size_t> m_numMisses;
+};
+
+#pragma warning(pop)
+
+}}}
@@ -28,6 +28,8 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
 double logadd(double x, double y);
 
+template<class ElemType> class CPURNNExecutor;
+
 // To comply with BLAS libraries matrices are stored in ColMajor. However, by default C/C++/C# use RowMajor
 // conversion is need when passing data between CPUMatrix and C++ matrices
 template <class ElemType>
@@ -39,6 +41,10 @@ class MATH_API CPUMatrix : public BaseMatrix<ElemType>
     using Base::m_sliceViewOffset;
     using Base::HasExternalBuffer;
     using Base::SetBuffer;
+    using Base::FreeCPUBuffer;
+    using Base::SetExternalBufferOwner;
+    using Base::SetNumStorageRows;
+    using Base::SetNumStorageCols;
     using Base::SetComputeDeviceId;
     using Base::SetSizeAllocated;
     using Base::GetSizeAllocated;
@@ -145,6 +151,9 @@ public:
     //void SetValue(const CPUSparseMatrix<ElemType>& deepCopyFrom);
     //void SetValue(const GPUSparseMatrix<ElemType>& deepCopyFrom);
     void SetValue(const size_t numRows, const size_t numCols, ElemType* pArray, size_t matrixFlags = matrixFlagNormal);
+    // Makes the matrix use 'pArray' (column major) without copying it, in new storage that keeps 'owner' alive.
+    // Like with matrixFlagDontOwnBuffer, the matrix can be modified in place but not resized.
+    void AttachExternalBuffer(const size_t numRows, const size_t numCols, ElemType* pArray, const std::shared_ptr<void>& owner);
 
     void MaskColumnsValue(const CPUMatrix<char>& columnsMask, ElemType val, size_t numColsPerMaskEntry);
 
@@ -403,6 +412,9 @@ public:
     void BatchNormalizationBackward(const CPUMatrix<ElemType>& in, CPUMatrix<ElemType>& grad, const CPUMatrix<ElemType>& scale, double blendFactor, const CPUMatrix<ElemType>& saveMean, const CPUMatrix<ElemType>& saveInvStdDev,
                                     CPUMatrix<ElemType>& scaleGrad, CPUMatrix<ElemType>& biasGrad) const;
 
+    // RNN support functions (inference only)
+    void RNNForward(const CPUMatrix<ElemType>& inputX, const CPUMatrix<ElemType>& paramW, size_t xDim, size_t yDim, const vector<size_t>& numSequencesForFrame, const struct RnnAttributes& rnnAttributes, CPUMatrix<ElemType>& workspace);
+
 public:
     // This functions do not depend on <ElemType>, i.e. you can call them on any <ElemType>
     static int SetNumThreads(int numThreads);
@@ -410,6 +422,9 @@ public:
 
     static void SetCompatibleMode();
 
+    static void UseElemTypeReductionAccumulator(bool enable);
+    static bool IsElemTypeReductionAccumulatorUsed() { return s_useElemTypeReductionAccumulator; }
+
     // static BLAS functions
     static void SVD(const CPUMatrix<ElemType>& A, CPUMatrix<ElemType>& SIGMA, CPUMatrix<ElemType>& U, CPUMatrix<ElemType>& VT, CPUMatrix<ElemType>& W);
 
@@ -493,13 +508,18 @@ public:
         size_t numRows, numCols;
         int format;
         stream >> matrixName >> format >> numRows >> numCols;
-        ElemType* d_array = new ElemType[numRows * numCols];
-        for (size_t i = 0; i < numRows * numCols; ++i)
-            stream >> d_array[i];
+        // memory-mapped files: aligned values are used in place (copy-on-write)
+        ElemType* mappedArray = stream.TryGetMappedArray<ElemType>(numRows * numCols);
+        if (mappedArray)
+            us.AttachExternalBuffer(numRows, numCols, mappedArray, stream.GetMapping());
+        else
+        {
+            us.SetFormat(matrixFormatDense);
+            us.SetComputeDeviceId(CPUDEVICE);
+            us.RequireSize(numRows, numCols);
+            stream.ReadArray(us.Data(), numRows * numCols);
+        }
         stream.GetMarker(fileMarkerEndSection, std::wstring(L"EMAT"));
-        us.SetValue(numRows, numCols, d_array, matrixFlagNormal);
-
-        delete[] d_array;
         return stream;
     }
     friend File& operator<<(File& stream, const CPUMatrix<ElemType>& us)
@@ -507,13 +527,16 @@ public:
         stream.PutMarker(fileMarkerBeginSection, std::wstring(L"BMAT"));
         stream << sizeof(ElemType);
 
+        // The name is ignored on input. It is padded with spaces, so that large values start at
+        // File::PayloadAlignment and can be used in place when the file is memory-mapped.
         std::wstring s = std::wstring(L"unnamed");
+        const size_t headerSize = 2 * (s.size() + 1) + sizeof(int) + 2 * sizeof(size_t); // strings are stored as UTF-16
+        s.append(stream.GetPayloadPadding(headerSize, us.GetNumElements() * sizeof(ElemType), 2) / 2, L' ');
         int format = us.GetFormat();
         stream << s << format;
 
         stream << us.m_numRows << us.m_numCols;
-        for (size_t i = 0; i < us.GetNumElements(); ++i)
-            stream << us.Data()[i];
+        stream.WriteArray(us.Data(), us.GetNumElements());
         stream.PutMarker(fileMarkerEndSection, std::wstring(L"EMAT"));
         return stream;
     }
@@ -552,6 +575,13 @@ protected:
 private:
     void Clear();
 
+    static bool s_useElemTypeReductionAccumulator;
+
+#pragma warning(push)
+#pragma warning(disable : 4251)
+    mutable std::shared_ptr<CPURNNExecutor<ElemType>> m_rnnExecutor;
+#pragma warning(pop)
+
     void ScatterValues(ElemType* indices, ElemType* value, ElemType* data, ElemType alpha, size_t num_indices, size_t rows, size_t cols, size_t indices_step = 1);
 };
 
@@ -11,6 +11,8 @@
 #include "File.h"
 
 #include "CPUMatrix.h"
+#include "CPURNN.h"
+#include "CPUCachingMemAllocator.h"
 #include "TensorOps.h"
 #include <assert.h>
 #include <stdexcept>
@@ -126,6 +128,21 @@ static ElemType* NewArray(size_t n)
     return p;
 }
 
+// helper to allocate the buffer of a dense matrix, from the caching allocator if it is enabled
+// The buffer is zero-initialized like the one from NewArray(). 'allocator' receives the allocator to free it with.
+template <class ElemType>
+static ElemType* NewBuffer(size_t n, MemAllocator*& allocator)
+{
+    allocator = CPUCachingMemAllocator::GetEnabledInstance();
+    if (!allocator)
+        return NewArray<ElemType>(n);
+
+    size_t bytes = AsMultipleOf(n, 2) * sizeof(ElemType);
+    ElemType* p = static_cast<ElemType*>(allocator->Malloc(bytes));
+    memset(p, 0, bytes);
+    return p;
+}
+
 template <class ElemType>
 CPUMatrix<ElemType>::CPUMatrix(const size_t numRows, const size_t numCols)
 {
@@ -137,7 +154,9 @@ CPUMatrix<ElemType>::CPUMatrix(const size_t numRows, const size_t numCols)
 
     if (GetNumElements() != 0)
     {
-        SetBuffer(NewArray<ElemType>(GetNumElements()), GetNumElements() * sizeof(ElemType));
+        MemAllocator* allocator;
+        ElemType* pArray = NewBuffer<ElemType>(GetNumElements(), allocator);
+        SetBuffer(pArray, GetNumElements() * sizeof(ElemType), false, allocator);
     }
 }
 
@@ -875,7 +894,7 @@ void CPUMatrix<ElemType>::SetValue(const size_t numRows, const size_t numCols, E
     if (matrixFlags & matrixFlagDontOwnBuffer)
     {
         // free previous array allocation if any before overwriting
-        delete[] Buffer();
+        FreeCPUBuffer();
 
         m_numRows = numRows;
         m_numCols = numCols;
@@ -918,6 +937,23 @@ void CPUMatrix<ElemType>::SetValue(const size_t numRows, const size_t numCols, E
     }
 }
 
+template <class ElemType>
+void CPUMatrix<ElemType>::AttachExternalBuffer(const size_t numRows, const size_t numCols, ElemType* pArray, const std::shared_ptr<void>& owner)
+{
+    if (pArray == nullptr && numRows * numCols > 0)
+        InvalidArgument("Invalid pArray. pArray == nullptr, but matrix is of size %d * %d = %d.", (int)numRows, (int)numCols, (int)(numRows * numCols));
+
+    // new storage, other views of the current storage keep their buffer
+    ZeroInit(matrixFormatDense, CPUDEVICE);
+    m_numRows = numRows;
+    m_numCols = numCols;
+    SetNumStorageRows(numRows);
+    SetNumStorageCols(numCols);
+    SetBuffer(pArray, GetNumElements() * sizeof(ElemType), true);
+    SetSizeAllocated(GetNumElements());
+    SetExternalBufferOwner(owner);
+}
+
 template <class ElemType>
 void CPUMatrix<ElemType>::SetDiagonalValue(const ElemType v)
 {
@@ -1524,14 +1560,15 @@ void CPUMatrix<ElemType>::Resize(const size_t numRows, const size_t numCols, boo
     {
         // reallocate buffer
         ElemType* pArray = nullptr;
+        MemAllocator* allocator = nullptr;
         if (numElements > 0)
         {
-            pArray = NewArray<ElemType>(numElements);
+            pArray = NewBuffer<ElemType>(numElements, allocator);
         }
         // success: update the object
-        delete[] Buffer();
+        FreeCPUBuffer();
 
-        SetBuffer(pArray, numElements * sizeof(ElemType));
+        SetBuffer(pArray, numElements * sizeof(ElemType), false, allocator);
         SetSizeAllocated(numElements);
     }
 
@@ -4848,6 +4885,19 @@ void CPUMatrix<ElemType>::BatchNormalizationBackward(const CPUMatrix<ElemType>&
     RuntimeError("Batch normalization training on CPU is not yet implemented.");
 }
 
+#pragma region RNN Functions
+
+template <class ElemType>
+void CPUMatrix<ElemType>::RNNForward(const CPUMatrix<ElemType>& inputX, const CPUMatrix<ElemType>& paramW, size_t xDim, size_t yDim, const vector<size_t>& numSequencesForFrame, const RnnAttributes& rnnAttributes, CPUMatrix<ElemType>& workspace)
+{
+    // the executor is cheap to create, so unlike cuDNN just rebuild it if a different RNN reuses this matrix
+    if (!m_rnnExecutor || !m_rnnExecutor->IsCompatible(rnnAttributes))
+        m_rnnExecutor = std::make_shared<CPURNNExecutor<ElemType>>(xDim, yDim, rnnAttributes);
+    m_rnnExecutor->ForwardCore(paramW, inputX, *this, numSequencesForFrame, rnnAttributes, workspace);
+}
+
+#pragma endregion RNN Functions
+
 
 #pragma region Static BLAS Functions
 
@@ -6679,6 +6729,17 @@ int CPUMatrix<ElemType>::GetMaxNumThreads()
     return numThreads;
 }
 
+template <class ElemType>
+bool CPUMatrix<ElemType>::s_useElemTypeReductionAccumulator = false;
+
+// By default, CPU tensor reductions accumulate in double, see TensorOpWithFn().
+// Accumulating in ElemType is faster for float (and matches the GPU), but changes results slightly.
+template <class ElemType>
+void CPUMatrix<ElemType>::UseElemTypeReductionAccumulator(bool enable)
+{
+    s_useElemTypeReductionAccumulator = enable;
+}
+
 // To ensure Intel MKL calls return the same results on all Intel or Intel compatible CPUs,
 // the function set CBWR compatible mode.
 template <class ElemType>
@@ -6713,7 +6774,9 @@ struct TensorOpReduction
         for (size_t i = 0; i < N - 1; i++) // N = a small constant, this will be unrolled
             strides[i] = reducingStrides[i][(size_t) m];
 
-        double aggregate = TensorOpReduction<ElemType, OPFN, ReductionOp, N, m - 1>::Loop(pointers, opfn, reductionOp, reducingOpDims, reducingStrides);
+        // double or ElemType, depending on the reduction lambda, see TensorOpWithFn()
+        typedef decltype(reductionOp(ElemType(), ElemType())) AggregateType;
+        AggregateType aggregate = TensorOpReduction<ElemType, OPFN, ReductionOp, N, m - 1>::Loop(pointers, opfn, reductionOp, reducingOpDims, reducingStrides);
         for (size_t dim = reducingOpDims[(size_t)m] - 1; dim-- > 0;)
         {
             // advance the pointers
@@ -6724,7 +6787,7 @@ struct TensorOpReduction
             aggregate = reductionOp(aggregate, TensorOpReduction<ElemType, OPFN, ReductionOp, N, m - 1>::Loop(pointers, opfn, reductionOp, reducingOpDims, reducingStrides));
         }
         // Actually it would be nicer to return double but we keep ElementType so that test don't return different numbers than previous implementation.
-        return static_cast<double>(aggregate);
+        return static_cast<ElemType>(aggregate);
     }
 };
 
@@ -6972,6 +7035,142 @@ struct TensorArgOpIteration<ElemType, N, -1>
     }
 };
 
+// -----------------------------------------------------------------------
+// parallel reductions
+// -----------------------------------------------------------------------
+
+// Reductions below this many input elements are not worth the OMP overhead and run serially.
+static const size_t TensorOpParallelReductionMinElements = 16384;
+// Minimum number of slices of the outermost reducing dimension per thread when splitting a single reduction.
+static const size_t TensorOpParallelReductionMinChunk = 64;
+
+// perform a single reduction with the outermost reduction index m split across threads
+template <class ElemType, typename OPFN, typename ReductionOp, size_t N, int m>
+struct TensorOpParallelReduction
+{
+    // double or ElemType, depending on the reduction lambda, see TensorOpWithFn()
+    typedef decltype(std::declval<ReductionOp>()(ElemType(), ElemType())) AggregateType;
+    static const size_t NumLanes = 4;
+
+    // Reduce over [begin, end) of index m. Consecutive slices go to independent accumulators ("lanes"),
+    // so that they do not form a single dependency chain and the compiler can overlap or vectorize them.
+    static inline AggregateType ReduceRange(array<ElemType*, N> pointers, const OPFN& opfn, const ReductionOp& reductionOp,
+                                            const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides,
+                                            size_t begin, size_t end)
+    {
+        array<ptrdiff_t, N - 1> strides;   // N-1 because last one is the result pointer, which is unused in reduction
+        for (size_t i = 0; i < N - 1; i++) // N = a small constant, this will be unrolled
+        {
+            strides[i] = reducingStrides[i][(size_t) m];
+            pointers[i] += (ptrdiff_t) begin * strides[i];
+        }
+        auto reduceSlice = [&](size_t j) -> AggregateType
+        {
+            array<ElemType*, N> p = pointers;
+            for (size_t i = 0; i < N - 1; i++)
+                p[i] += (ptrdiff_t) j * strides[i];
+            return TensorOpReduction<ElemType, OPFN, ReductionOp, N, m - 1>::Loop(p, opfn, reductionOp, reducingOpDims, reducingStrides);
+        };
+
+        size_t count = end - begin;
+        size_t numLanes = min(NumLanes, count);
+        AggregateType lanes[NumLanes];
+        for (size_t l = 0; l < numLanes; l++)
+            lanes[l] = reduceSlice(l);
+        size_t j = numLanes;
+        for (; j + NumLanes <= count; j += NumLanes)
+            for (size_t l = 0; l < NumLanes; l++)
+                lanes[l] = reductionOp(lanes[l], reduceSlice(j + l));
+        for (; j < count; j++)
+            lanes[0] = reductionOp(lanes[0], reduceSlice(j));
+
+        AggregateType aggregate = lanes[0];
+        for (size_t l = 1; l < numLanes; l++)
+            aggregate = reductionOp(aggregate, lanes[l]);
+        return aggregate;
+    }
+
+    // Each thread reduces a contiguous chunk of index m into its own partial result. The partial results are
+    // combined in chunk order, so the result only depends on numChunks, not on thread scheduling.
+    static inline ElemType Loop(array<ElemType*, N> pointers, const OPFN& opfn, const ReductionOp& reductionOp,
+                                const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides,
+                                int numChunks)
+    {
+        size_t dim = reducingOpDims[(size_t) m];
+        vector<AggregateType> partials(numChunks);
+#pragma omp parallel for
+        for (int c = 0; c < numChunks; c++)
+            partials[c] = ReduceRange(pointers, opfn, reductionOp, reducingOpDims, reducingStrides, dim * c / numChunks, dim * (c + 1) / numChunks);
+
+        AggregateType aggregate = partials[0];
+        for (int c = 1; c < numChunks; c++)
+            aggregate = reductionOp(aggregate, partials[c]);
+        return (ElemType) aggregate;
+    }
+};
+
+// Run a tensor reduction with reduction index m in parallel, if there is enough work. Returns false if the caller should use the serial loop.
+// With enough output elements, those are distributed over threads, and each one is computed exactly as in the serial loop.
+// Otherwise each reduction itself is split across threads by TensorOpParallelReduction.
+// Either way the results are deterministic for a fixed number of threads.
+template <class ElemType, typename OPFN, typename ReductionOp, size_t N, int m>
+static bool TensorOpWithParallelReduction(ElemType beta, const array<ElemType*, N>& pointers, ElemType alpha, const OPFN& opfn, const ReductionOp& reductionOp,
+                                          const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrides,
+                                          const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides)
+{
+    int numThreads = omp_get_max_threads();
+    if (numThreads <= 1 || omp_in_parallel())
+        return false;
+
+    size_t numOutputs = 1;
+    for (size_t k = 0; k < regularOpDims.size(); k++)
+        numOutputs *= regularOpDims[k];
+    size_t reductionSize = 1;
+    for (size_t k = 0; k < reducingOpDims.size(); k++)
+        reductionSize *= reducingOpDims[k];
+    if (numOutputs * reductionSize < TensorOpParallelReductionMinElements)
+        return false;
+
+    int numChunks = (int) min((size_t) numThreads, reducingOpDims[(size_t) m] / TensorOpParallelReductionMinChunk);
+    if (numOutputs < (size_t) numThreads && numChunks < 2)
+        return false; // neither outputs nor the reduction can be split
+
+    // locate the output element with linear index 'index' and compute it
+    auto computeOutput = [&](size_t index, bool splitReduction)
+    {
+        array<ElemType*, N> p = pointers;
+        for (size_t k = 0; k < regularOpDims.size(); k++)
+        {
+            ptrdiff_t coordinate = (ptrdiff_t) (index % regularOpDims[k]);
+            index /= regularOpDims[k];
+            for (size_t i = 0; i < N; i++)
+                p[i] += coordinate * regularStrides[i][k];
+        }
+        ElemType val = splitReduction ?
+            TensorOpParallelReduction<ElemType, OPFN, ReductionOp, N, m>::Loop(p, opfn, reductionOp, reducingOpDims, reducingStrides, numChunks) :
+            TensorOpReduction<ElemType, OPFN, ReductionOp, N, m>::Loop(p, opfn, reductionOp, reducingOpDims, reducingStrides);
+        // scale, combine with previous value in target matrix, then write it out (same as TensorOpIteration)
+        val *= alpha;
+        auto* pout = p.back();
+        if (beta != 0)
+            val += beta * *pout;
+        *pout = val;
+    };
+
+    if (numOutputs >= (size_t) numThreads)
+    {
+#pragma omp parallel for
+        for (long index = 0; index < (long) numOutputs; index++)
+            computeOutput((size_t) index, /*splitReduction=*/false);
+    }
+    else
+    {
+        for (size_t index = 0; index < numOutputs; index++)
+            computeOutput(index, /*splitReduction=*/true);
+    }
+    return true;
+}
+
 // -----------------------------------------------------------------------
 // map runtime parameters N to template parameters
 // -----------------------------------------------------------------------
@@ -6986,8 +7185,12 @@ static void TensorOpWithRegularLoop(ElemType beta, const array<ElemType*, N>& po
     switch (dims)
     {
     case 2:
+        if (TensorOpWithParallelReduction<ElemType, OPFN, ReductionOp, N, 1>(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides))
+            return;
         return TensorOpIteration<ElemType, OPFN, ReductionOp, N, false /*vectorizable*/, 1, k>::Loop(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
     case 1:
+        if (TensorOpWithParallelReduction<ElemType, OPFN, ReductionOp, N, 0>(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides))
+            return;
         return TensorOpIteration<ElemType, OPFN, ReductionOp, N, false /*vectorizable*/, 0, k>::Loop(beta, pointers, alpha, opfn, reductionOp, regularOpDims, regularStrides, reducingOpDims, reducingStrides);
     case 0:
     {
@@ -7041,30 +7244,37 @@ static void TensorOpWithFn(ElemType beta, array<ElemType*, N> pointers, ElemType
     const SmallVector<size_t>& regularOpDims, const array<SmallVector<ptrdiff_t>, N>& regularStrides,
     const SmallVector<size_t>& reducingOpDims, const array<SmallVector<ptrdiff_t>, N>& reducingStrides)
 {
-// BUGBUG: Using always 'double' as type of aggregator even for ElemType==float. Reason: otherwise some e2e test would fail as historically we 
+// BUGBUG: By default 'double' is used as type of aggregator even for ElemType==float. Reason: otherwise some e2e test would fail as historically we 
 // used double for aggregator of sum. But:
 // * for min and max reductions this is meaningless.
 // * It is not consitent with what we do on GPU, there we aggregate on ElemType.
 // * It costs performance.
-// TODO: apdapt e2e tests to run with aggregator of type ElemType.
-#define CaseTensorOpWithFnAndReduction(oper)                                                  \
-    case ElementWiseOperator::op##oper:                                                       \
-    return TensorOpWithFnAndReduction(beta, pointers, alpha, opfn, [](double a, double b)     \
-                                    {                                                         \
-                                    return Op##oper(a, b);                                    \
-                                    },                                                        \
+// UseElemTypeReductionAccumulator(true) switches to an ElemType aggregator.
+// TODO: apdapt e2e tests to run with aggregator of type ElemType, and make that the default.
+#define CaseTensorOpWithFnAndReduction(oper, AggregateType)                                           \
+    case ElementWiseOperator::op##oper:                                                                 \
+    return TensorOpWithFnAndReduction(beta, pointers, alpha, opfn, [](AggregateType a, AggregateType b) \
+                                    {                                                                   \
+                                    return Op##oper(a, b);                                              \
+                                    },                                                                  \
                                     offsets, regularOpDims, regularStrides, reducingOpDims, reducingStrides)
 
-    switch (reductionOp)
-    {
-        CaseTensorOpWithFnAndReduction(Sum);
-        CaseTensorOpWithFnAndReduction(LogSum);
-        CaseTensorOpWithFnAndReduction(Min);
-        CaseTensorOpWithFnAndReduction(Max);
-        CaseTensorOpWithFnAndReduction(ElementwiseProduct);
-    default:
-        LogicError("Specified ElementWiseOperator op %d not supported as reduction operation.", (int)reductionOp);
+#define CaseTensorOpWithFnAndReductions(AggregateType)                                                              \
+    switch (reductionOp)                                                                                            \
+    {                                                                                                               \
+        CaseTensorOpWithFnAndReduction(Sum, AggregateType);                                                         \
+        CaseTensorOpWithFnAndReduction(LogSum, AggregateType);                                                      \
+        CaseTensorOpWithFnAndReduction(Min, AggregateType);                                                         \
+        CaseTensorOpWithFnAndReduction(Max, AggregateType);                                                         \
+        CaseTensorOpWithFnAndReduction(ElementwiseProduct, AggregateType);                                          \
+    default:                                                                                                        \
+        LogicError("Specified ElementWiseOperator op %d not supported as reduction operation.", (int)reductionOp); \
     }
+
+    if (CPUMatrix<ElemType>::IsElemTypeReductionAccumulatorUsed())
+        CaseTensorOpWithFnAndReductions(ElemType)
+    else
+        CaseTensorOpWithFnAndReductions(double)
 }
 
 // -----------------------------------------------------------------------
@@ -0,0 +1,220 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include "CPURNN.h"
+#include <algorithm>
+#include <cmath>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+template <class ElemType>
+static inline ElemType RNNSigmoid(ElemType x)
+{
+    return 1 / (1 + exp(-x));
+}
+
+template <class ElemType>
+CPURNNExecutor<ElemType>::CPURNNExecutor(size_t xDim, size_t yDim, const RnnAttributes& rnnAttributes)
+    : m_rnnAttributes(rnnAttributes), m_xDim(xDim), m_yDim(yDim)
+{
+    if      (m_rnnAttributes.m_recurrentOp == wstring(L"lstm"))    m_cellType = CellType::LSTM;
+    else if (m_rnnAttributes.m_recurrentOp == wstring(L"gru"))     m_cellType = CellType::GRU;
+    else if (m_rnnAttributes.m_recurrentOp == wstring(L"rnnReLU")) m_cellType = CellType::RNNReLU;
+    else if (m_rnnAttributes.m_recurrentOp == wstring(L"rnnTanh")) m_cellType = CellType::RNNTanh;
+    else InvalidArgument("Unknown cell type '%ls'. Supported values are 'lstm', 'gru', 'rnnReLU', 'rnnTanh'.", m_rnnAttributes.m_recurrentOp.c_str());
+}
+
+template <class ElemType>
+void CPURNNExecutor<ElemType>::ForwardCore(const CPUMatrix<ElemType>& weightsW, const CPUMatrix<ElemType>& inputX, CPUMatrix<ElemType>& outputY,
+                                           const vector<size_t>& numSequencesForFrame, const RnnAttributes& rnnAttributes, CPUMatrix<ElemType>& workspace)
+{
+    if (!IsCompatible(rnnAttributes))
+        LogicError("RNN Layout has changed during processing");
+
+    const size_t hiddenSize = m_rnnAttributes.m_hiddenSize;
+    const size_t numLayers = m_rnnAttributes.m_numLayers;
+    const size_t numGates = NumGates();
+    const size_t numDirections = NumDirections();
+    const size_t gateDim = numGates * hiddenSize;
+
+    if (m_yDim != numDirections * hiddenSize)
+        InvalidArgument("CPU RNN ForwardCore: Output leading dimension must be twice hidden size for bidirectional networks");
+    if (inputX.GetNumRows() != m_xDim)
+        InvalidArgument("CPU RNN ForwardCore: Input has %d rows, but %d were expected", (int)inputX.GetNumRows(), (int)m_xDim);
+    const auto numParameters = m_rnnAttributes.GetNumParameters(m_xDim);
+    if (weightsW.GetNumElements() != numParameters.first * numParameters.second)
+        InvalidArgument("CPU RNN ForwardCore: Parameter block has %d elements, which does not match the RNN configuration", (int)weightsW.GetNumElements());
+
+    // column offset of the first sequence of each frame in the packed input/output
+    vector<size_t> frameOffsets(numSequencesForFrame.size() + 1, 0);
+    for (size_t t = 0; t < numSequencesForFrame.size(); t++)
+        frameOffsets[t + 1] = frameOffsets[t] + numSequencesForFrame[t];
+    const size_t numCols = frameOffsets.back();
+    const size_t maxSequences = numSequencesForFrame.empty() ? 0 : *max_element(numSequencesForFrame.begin(), numSequencesForFrame.end());
+
+    if (inputX.GetNumCols() != numCols)
+        InvalidArgument("CPU RNN ForwardCore: Input has %d columns, but the sequence layout describes %d", (int)inputX.GetNumCols(), (int)numCols);
+
+    outputY.RequireSize(m_yDim, numCols);
+    if (numCols == 0)
+        return;
+
+    // carve all temporaries out of the workspace:
+    //  - input projections of all frames for one layer and direction
+    //  - recurrent projections of one frame
+    //  - hidden and cell state
+    //  - up to two intermediate layer outputs (ping-pong between layers)
+    const size_t numIntermediate = min<size_t>(numLayers - 1, 2);
+    workspace.RequireSize(gateDim * (numCols + maxSequences) + 2 * hiddenSize * maxSequences + numIntermediate * m_yDim * numCols, 1);
+    ElemType* ws = workspace.Data();
+    CPUMatrix<ElemType> gates(gateDim, numCols, ws, matrixFlagDontOwnBuffer);               ws += gateDim * numCols;
+    CPUMatrix<ElemType> recurrentGates(gateDim, maxSequences, ws, matrixFlagDontOwnBuffer); ws += gateDim * maxSequences;
+    CPUMatrix<ElemType> h(hiddenSize, maxSequences, ws, matrixFlagDontOwnBuffer);           ws += hiddenSize * maxSequences;
+    CPUMatrix<ElemType> c(hiddenSize, maxSequences, ws, matrixFlagDontOwnBuffer);           ws += hiddenSize * maxSequences;
+    vector<CPUMatrix<ElemType>> layerOutputs;
+    for (size_t i = 0; i < numIntermediate; i++, ws += m_yDim * numCols)
+        layerOutputs.push_back(CPUMatrix<ElemType>(m_yDim, numCols, ws, matrixFlagDontOwnBuffer));
+
+    // the biases follow all weight matrices
+    ElemType* params = weightsW.Data();
+    size_t weightOffset = 0;
+    size_t biasOffset = 0;
+    for (size_t layer = 0, inputDim = m_xDim; layer < numLayers; layer++, inputDim = m_yDim)
+        biasOffset += numDirections * (inputDim + hiddenSize) * gateDim;
+
+    const CPUMatrix<ElemType>* layerInput = &inputX;
+    for (size_t layer = 0; layer < numLayers; layer++)
+    {
+        const size_t inputDim = layerInput->GetNumRows();
+        CPUMatrix<ElemType>& layerOutput = (layer + 1 == numLayers) ? outputY : layerOutputs[layer % 2];
+
+        for (size_t dir = 0; dir < numDirections; dir++)
+        {
+            CPUMatrix<ElemType> W(inputDim, gateDim, params + weightOffset, matrixFlagDontOwnBuffer);
+            weightOffset += inputDim * gateDim;
+            CPUMatrix<ElemType> R(hiddenSize, gateDim, params + weightOffset, matrixFlagDontOwnBuffer);
+            weightOffset += hiddenSize * gateDim;
+            const ElemType* inputBias = params + biasOffset;
+            const ElemType* recurrentBias = params + biasOffset + gateDim;
+            biasOffset += 2 * gateDim;
+
+            // input projection of all frames at once
+            CPUMatrix<ElemType>::MultiplyAndWeightedAdd(1, W, true, *layerInput, false, 0, gates);
+
+            // Fold both biases into the input projection. GRU is the exception: cuDNN applies the
+            // recurrent bias of the new gate inside the reset gate product, so it is kept separate.
+            const size_t foldedRecurrentBiasDim = (m_cellType == CellType::GRU) ? 2 * hiddenSize : gateDim;
+            ElemType* gatesData = gates.Data();
+#pragma omp parallel for
+            for (long j = 0; j < (long)numCols; j++)
+            {
+                ElemType* col = gatesData + j * gateDim;
+                for (size_t i = 0; i < gateDim; i++)
+                    col[i] += inputBias[i];
+                for (size_t i = 0; i < foldedRecurrentBiasDim; i++)
+                    col[i] += recurrentBias[i];
+            }
+
+            const ElemType* recurrentNewGateBias = (m_cellType == CellType::GRU) ? recurrentBias + 2 * hiddenSize : nullptr;
+            RecurrentPass(R, recurrentNewGateBias, gates, recurrentGates, h, c, layerOutput, dir * hiddenSize, /*backwards=*/dir == 1,
+                          numSequencesForFrame, frameOffsets);
+        }
+        layerInput = &layerOutput;
+    }
+}
+
+template <class ElemType>
+void CPURNNExecutor<ElemType>::RecurrentPass(const CPUMatrix<ElemType>& R, const ElemType* recurrentNewGateBias, const CPUMatrix<ElemType>& gates,
+                                             CPUMatrix<ElemType>& recurrentGates, CPUMatrix<ElemType>& h, CPUMatrix<ElemType>& c,
+                                             CPUMatrix<ElemType>& output, size_t outputRowOffset, bool backwards,
+                                             const vector<size_t>& numSequencesForFrame, const vector<size_t>& frameOffsets) const
+{
+    const size_t hiddenSize = m_rnnAttributes.m_hiddenSize;
+    const size_t gateDim = NumGates() * hiddenSize;
+    const size_t numFrames = numSequencesForFrame.size();
+
+    size_t numActive = 0; // number of sequences whose state has been initialized
+    for (size_t step = 0; step < numFrames; step++)
+    {
+        const size_t t = backwards ? numFrames - 1 - step : step;
+        const size_t numSequences = numSequencesForFrame[t];
+        if (numSequences == 0)
+            continue;
+
+        // Sequences are sorted by decreasing length, so going forward the set of active sequences only shrinks,
+        // while going backwards new sequences join at the end. Those start from a zero state.
+        if (numSequences > numActive)
+        {
+            memset(h.Data() + numActive * hiddenSize, 0, (numSequences - numActive) * hiddenSize * sizeof(ElemType));
+            memset(c.Data() + numActive * hiddenSize, 0, (numSequences - numActive) * hiddenSize * sizeof(ElemType));
+            numActive = numSequences;
+        }
+
+        CPUMatrix<ElemType> recurrentGatesSlice = recurrentGates.ColumnSlice(0, numSequences);
+        CPUMatrix<ElemType>::MultiplyAndWeightedAdd(1, R, true, h.ColumnSlice(0, numSequences), false, 0, recurrentGatesSlice);
+
+        ComputeCell(gates.Data() + frameOffsets[t] * gateDim, recurrentGates.Data(), recurrentNewGateBias, h.Data(), c.Data(), numSequences);
+
+        const size_t outputStride = output.GetNumRows();
+        ElemType* out = output.Data() + frameOffsets[t] * outputStride + outputRowOffset;
+        for (size_t j = 0; j < numSequences; j++)
+            memcpy(out + j * outputStride, h.Data() + j * hiddenSize, hiddenSize * sizeof(ElemType));
+    }
+}
+
+template <class ElemType>
+void CPURNNExecutor<ElemType>::ComputeCell(const ElemType* gates, const ElemType* recurrentGates, const ElemType* recurrentNewGateBias,
+                                           ElemType* h, ElemType* c, size_t numSequences) const
+{
+    const size_t H = m_rnnAttributes.m_hiddenSize;
+    const size_t gateDim = NumGates() * H;
+    const CellType cellType = m_cellType;
+
+#pragma omp parallel for
+    for (long j = 0; j < (long)numSequences; j++)
+    {
+        const ElemType* x = gates + j * gateDim;
+        const ElemType* r = recurrentGates + j * gateDim;
+        ElemType* hj = h + j * H;
+        ElemType* cj = c + j * H;
+        switch (cellType)
+        {
+        case CellType::LSTM:
+            for (size_t k = 0; k < H; k++)
+            {
+                ElemType i = RNNSigmoid(x[k]         + r[k]);
+                ElemType f = RNNSigmoid(x[k + H]     + r[k + H]);
+                ElemType g = tanh      (x[k + 2 * H] + r[k + 2 * H]);
+                ElemType o = RNNSigmoid(x[k + 3 * H] + r[k + 3 * H]);
+                cj[k] = f * cj[k] + i * g;
+                hj[k] = o * tanh(cj[k]);
+            }
+            break;
+        case CellType::GRU:
+            for (size_t k = 0; k < H; k++)
+            {
+                ElemType reset  = RNNSigmoid(x[k]     + r[k]);
+                ElemType update = RNNSigmoid(x[k + H] + r[k + H]);
+                ElemType n = tanh(x[k + 2 * H] + reset * (r[k + 2 * H] + recurrentNewGateBias[k]));
+                hj[k] = (1 - update) * n + update * hj[k];
+            }
+            break;
+        case CellType::RNNReLU:
+            for (size_t k = 0; k < H; k++)
+                hj[k] = max<ElemType>(x[k] + r[k], 0);
+            break;
+        case CellType::RNNTanh:
+            for (size_t k = 0; k < H; k++)
+                hj[k] = tanh(x[k] + r[k]);
+            break;
+        }
+    }
+}
+
+template class CPURNNExecutor<float>;
+template class CPURNNExecutor<double>;
+
+}}}
@@ -0,0 +1,78 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#pragma once
+
+#include "CPUMatrix.h"
+#include "RNNCommon.h"
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// CPURNNExecutor is the CPU counterpart of CuDnnRNNExecutor. It consumes the same packed data
+// layout (frames ordered by time step, and within a time step the sequences sorted by decreasing
+// length, as described by numSequencesForFrame) and the same monolithic parameter block as cuDNN,
+// so that models trained with OptimizedRNNStack on the GPU can be evaluated unchanged on the CPU.
+//
+// Parameter layout (cuDNN, linear input mode): for every layer and direction an input matrix W
+// of [inputDim x numGates*hiddenSize] followed by a recurrent matrix R of [hiddenSize x numGates*hiddenSize],
+// both stored column-major; after all matrices, for every layer and direction two bias vectors
+// of numGates*hiddenSize each. Gate order is (input, forget, cell, output) for LSTM and
+// (reset, update, new) for GRU.
+//
+// For each layer and direction, the input projections of all time steps are computed by a single GEMM.
+// Only the recurrent projection remains inside the time loop, followed by a fused kernel that applies
+// the gate nonlinearities and the state update in one pass over the hidden units.
+//
+// Only inference is supported at present.
+template <class ElemType>
+class CPURNNExecutor
+{
+public:
+    CPURNNExecutor(size_t xDim, size_t yDim, const RnnAttributes& rnnAttributes);
+
+    void ForwardCore(const CPUMatrix<ElemType>& weightsW, const CPUMatrix<ElemType>& inputX, CPUMatrix<ElemType>& outputY,
+                     const vector<size_t>& numSequencesForFrame, const RnnAttributes& rnnAttributes, CPUMatrix<ElemType>& workspace);
+
+    bool IsCompatible(const RnnAttributes& rnnAttributes) const
+    {
+        return m_rnnAttributes == rnnAttributes;
+    }
+
+private:
+    enum class CellType
+    {
+        LSTM,
+        GRU,
+        RNNReLU,
+        RNNTanh
+    };
+
+    size_t NumGates() const
+    {
+        return m_cellType == CellType::LSTM ? 4 : m_cellType == CellType::GRU ? 3 : 1;
+    }
+
+    size_t NumDirections() const
+    {
+        return m_rnnAttributes.m_bidirectional ? 2 : 1;
+    }
+
+    // Runs the recurrence of a single layer in a single direction. 'gates' holds the precomputed
+    // input projections (plus biases) of all frames.
+    void RecurrentPass(const CPUMatrix<ElemType>& R, const ElemType* recurrentNewGateBias, const CPUMatrix<ElemType>& gates,
+                       CPUMatrix<ElemType>& recurrentGates, CPUMatrix<ElemType>& h, CPUMatrix<ElemType>& c,
+                       CPUMatrix<ElemType>& output, size_t outputRowOffset, bool backwards,
+                       const vector<size_t>& numSequencesForFrame, const vector<size_t>& frameOffsets) const;
+
+    // Fused gate computation for 'numSequences' columns of one time step.
+    void ComputeCell(const ElemType* gates, const ElemType* recurrentGates, const ElemType* recurrentNewGateBias,
+                     ElemType* h, ElemType* c, size_t numSequences) const;
+
+    RnnAttributes m_rnnAttributes;
+    CellType m_cellType;
+    size_t m_xDim, m_yDim;
+};
+
+}}}
@@ -870,8 +870,42 @@ void CPUSparseMatrix<ElemType>::Reset()
     SetBlockIdShift(0);
 }
 
+// Splits 'size' elements into one range per thread, but no range is shorter than 'minRangeSize' (except if 'size' is).
+// Range 'r' is [size * r / numRanges, size * (r + 1) / numRanges).
+static size_t GetNumParallelRanges(size_t size, size_t minRangeSize)
+{
+    size_t numRanges = std::min((size_t)omp_get_max_threads(), (size + minRangeSize - 1) / minRangeSize);
+    return std::max(numRanges, (size_t)1);
+}
+
+// Minimum number of elements of the dense dimension handled by one thread in the sparse-dense products.
+static const size_t c_minParallelRangeSize = 64;
+
+// y[0:n:incy] += alpha * x[0:n:incx]. The unit stride loop is kept separate so that the compiler vectorizes it.
+template <class ElemType>
+static inline void ScaleAndAddVector(size_t n, ElemType alpha, const ElemType* x, size_t incx, ElemType* y, size_t incy)
+{
+    if (incx == 1 && incy == 1)
+    {
+        for (size_t i = 0; i < n; i++)
+            y[i] += alpha * x[i];
+    }
+    else
+    {
+        for (size_t i = 0; i < n; i++)
+            y[i * incy] += alpha * x[i * incx];
+    }
+}
+
 // Implements product of one sparse and one dense matrix updating a third dense matrix. Input matrices are optionally transposed.
 // NOTE: The only for using a class template instead of a function template was that I couldn't make the function template compile.
+//
+// Each nonzero element of the sparse matrix updates a row or column of c with a scaled row or column of the dense matrix, along
+// the outer index of the dense matrix. The work is split so that no two threads update the same element of c:
+// * In general the outer dimension of the dense matrix is split into ranges, each thread handles all nonzero elements for one range.
+//   If each sparse column only updates one row or column of c, the sparse columns are distributed across threads as well.
+// * Sparse times non-transposed dense is computed column by column of c instead, since the dense matrix is not contiguous along
+//   the outer index there.
 template <class ElemType, bool denseTimesSparse /* false means SparseTimesDense */, bool transposeA, bool transposeB>
 class MultiplyDenseAndSparse{
 public:
@@ -929,47 +963,106 @@ public:
         // * Initialized the output matrix c
 
         // Now do the actual multiplication.
-        ElemType* valueBuffer = sparse.Buffer() + *sparse.SecondaryIndexLocation(); // Points to the value buffer of the current view (i.e. buffer containing values of non-zero elements).
-        int* rowIndexBuffer = sparse.MajorIndexLocation();                          // Points to the index buffer of the current view (i.e. buffer containing indices of non-zero elements).
-        size_t iNonzero = 0;                                                           // Number of nonzero elements handled so far for curent slice view.
-        int numPreviosNonzero = sparse.SecondaryIndexLocation()[0];                 // Total number of nonzero values handled in previous slices.
+        if (!denseTimesSparse && !transposeB)
+            SparseTimesDenseByColumns(alpha, sparse, dense, outerDimensionDense, c);
+        else
+            MultiplyByRanges(alpha, sparse, dense, outerDimensionDense, c);
+    }
+
+private:
+    // The nonzero elements of the sparse column 'colSparse' of the current slice view are [begin, end) in the value and row index buffers of the view.
+    static void GetColumnRange(const CPUSparseMatrix<ElemType>& sparse, size_t colSparse, size_t& begin, size_t& end)
+    {
+        const CPUSPARSE_INDEX_TYPE* secondaryIndex = sparse.SecondaryIndexLocation();
+        begin = secondaryIndex[colSparse] - secondaryIndex[0];
+        end = secondaryIndex[colSparse + 1] - secondaryIndex[0];
+    }
+
+    static void MultiplyByRanges(ElemType alpha, const CPUSparseMatrix<ElemType>& sparse, const CPUMatrix<ElemType>& dense, size_t outerDimensionDense, CPUMatrix<ElemType>& c)
+    {
+        const ElemType* valueBuffer = sparse.Buffer() + *sparse.SecondaryIndexLocation(); // Points to the value buffer of the current view (i.e. buffer containing values of non-zero elements).
+        const CPUSPARSE_INDEX_TYPE* rowIndexBuffer = sparse.MajorIndexLocation();         // Points to the index buffer of the current view (i.e. buffer containing indices of non-zero elements).
+        const ElemType* denseBuffer = dense.Data();
+        ElemType* cBuffer = c.Data();
+        const size_t ldDense = dense.GetNumRows();
+        const size_t ldc = c.GetNumRows();
 
-        // Loop over columns of the sparse matrix
-        for (size_t colSparse = 0; colSparse < sparse.GetNumCols(); colSparse++)
+        // The element of the dense matrix with the inner index i and the outer index j is at denseBuffer[i * denseInnerStride + j * denseOuterStride],
+        // the element of c with the outer indices i (sparse) and j (dense) at cBuffer[i * cSparseStride + j * cDenseStride].
+        // Below conditions are evaluated at compile time.
+        const bool denseTransposed = denseTimesSparse ? transposeA : transposeB;
+        const size_t denseInnerStride = (denseTimesSparse == denseTransposed) ? 1 : ldDense;
+        const size_t denseOuterStride = (denseTimesSparse == denseTransposed) ? ldDense : 1;
+        const size_t cSparseStride = denseTimesSparse ? ldc : 1;
+        const size_t cDenseStride = denseTimesSparse ? 1 : ldc;
+
+        // Whether the outer index of the sparse matrix is its column index, so that different sparse columns update different parts of c.
+        const bool outerIndexIsColumn = denseTimesSparse ? !transposeB : transposeA;
+        const size_t numColumnRanges = outerIndexIsColumn ? sparse.GetNumCols() : 1;
+        const size_t numRanges = GetNumParallelRanges(outerDimensionDense, c_minParallelRangeSize);
+
+#pragma omp parallel for schedule(dynamic)
+        for (long task = 0; task < (long)(numColumnRanges * numRanges); task++)
         {
-            size_t numNonzeroInSparseCol = sparse.SecondaryIndexLocation()[colSparse + 1] - numPreviosNonzero;
-            // Loop over the nonzero rows of the current column of the sparse matrix
-            for (; iNonzero < numNonzeroInSparseCol; iNonzero++)
+            const size_t range = (size_t)task % numRanges;
+            const size_t rangeBegin = outerDimensionDense * range / numRanges;
+            const size_t rangeEnd = outerDimensionDense * (range + 1) / numRanges;
+            const size_t colBegin = outerIndexIsColumn ? (size_t)task / numRanges : 0;
+            const size_t colEnd = outerIndexIsColumn ? colBegin + 1 : sparse.GetNumCols();
+
+            for (size_t colSparse = colBegin; colSparse < colEnd; colSparse++)
             {
-                size_t rowSparse = rowIndexBuffer[iNonzero]; // RowLocation
-                ElemType sparseVal = valueBuffer[iNonzero];
-
-                // Determine the index of the 'outer' dimension of the sparse matrix and the common inner index.
-                size_t outerIndexSparse;
-                size_t innerIndex;
-                // Below if-statements are evaluated at compile time.
-                if      ( denseTimesSparse && !transposeB) { outerIndexSparse = colSparse; innerIndex = rowSparse; }
-                else if ( denseTimesSparse &&  transposeB) { outerIndexSparse = rowSparse; innerIndex = colSparse; }
-                else if (!denseTimesSparse && !transposeA) { outerIndexSparse = rowSparse; innerIndex = colSparse; }
-                else if (!denseTimesSparse &&  transposeA) { outerIndexSparse = colSparse; innerIndex = rowSparse; }
-
-                // Loop over the outer index of the dense matrix
-                for (size_t outerIndexDense = 0; outerIndexDense < outerDimensionDense; outerIndexDense++)
+                size_t begin, end;
+                GetColumnRange(sparse, colSparse, begin, end);
+                for (size_t iNonzero = begin; iNonzero < end; iNonzero++)
                 {
-                    // Determine the row index of the dense input matrix.
-                    // Below if-statements are evaluated at compile time.
-                    ElemType denseVal;
-                    if      ( denseTimesSparse && !transposeA) denseVal = dense(outerIndexDense,      innerIndex);
-                    else if ( denseTimesSparse &&  transposeA) denseVal = dense(     innerIndex, outerIndexDense);
-                    else if (!denseTimesSparse && !transposeB) denseVal = dense(     innerIndex, outerIndexDense);
-                    else if (!denseTimesSparse &&  transposeB) denseVal = dense(outerIndexDense,      innerIndex);
-                    
-
-                    // Update matrix c.
-                    if (denseTimesSparse)
-                        c(outerIndexDense, outerIndexSparse) += alpha * denseVal * sparseVal;
-                    else /*Sparse times dense */
-                        c(outerIndexSparse, outerIndexDense) += alpha * denseVal * sparseVal;
+                    // Determine the index of the 'outer' dimension of the sparse matrix and the common inner index.
+                    size_t rowSparse = rowIndexBuffer[iNonzero];
+                    size_t outerIndexSparse = outerIndexIsColumn ? colSparse : rowSparse;
+                    size_t innerIndex = outerIndexIsColumn ? rowSparse : colSparse;
+
+                    // c(outerIndexSparse, outerIndexDense) += alpha * sparseVal * dense(innerIndex, outerIndexDense) for all outerIndexDense in the range,
+                    // with the indices of c swapped for dense times sparse.
+                    ScaleAndAddVector(rangeEnd - rangeBegin, alpha * valueBuffer[iNonzero],
+                                      denseBuffer + innerIndex * denseInnerStride + rangeBegin * denseOuterStride, denseOuterStride,
+                                      cBuffer + outerIndexSparse * cSparseStride + rangeBegin * cDenseStride, cDenseStride);
+                }
+            }
+        }
+    }
+
+    static void SparseTimesDenseByColumns(ElemType alpha, const CPUSparseMatrix<ElemType>& sparse, const CPUMatrix<ElemType>& dense, size_t outerDimensionDense, CPUMatrix<ElemType>& c)
+    {
+        const ElemType* valueBuffer = sparse.Buffer() + *sparse.SecondaryIndexLocation();
+        const CPUSPARSE_INDEX_TYPE* rowIndexBuffer = sparse.MajorIndexLocation();
+        const ElemType* denseBuffer = dense.Data();
+        ElemType* cBuffer = c.Data();
+        const size_t ldDense = dense.GetNumRows();
+        const size_t ldc = c.GetNumRows();
+
+#pragma omp parallel for
+        for (long outerIndexDense = 0; outerIndexDense < (long)outerDimensionDense; outerIndexDense++)
+        {
+            const ElemType* denseColumn = denseBuffer + outerIndexDense * ldDense;
+            ElemType* cColumn = cBuffer + outerIndexDense * ldc;
+            for (size_t colSparse = 0; colSparse < sparse.GetNumCols(); colSparse++)
+            {
+                size_t begin, end;
+                GetColumnRange(sparse, colSparse, begin, end);
+                if (!transposeA)
+                {
+                    // c(rowSparse, outerIndexDense) += alpha * sparse(rowSparse, colSparse) * dense(colSparse, outerIndexDense)
+                    ElemType denseVal = alpha * denseColumn[colSparse];
+                    for (size_t iNonzero = begin; iNonzero < end; iNonzero++)
+                        cColumn[rowIndexBuffer[iNonzero]] += valueBuffer[iNonzero] * denseVal;
+                }
+                else
+                {
+                    // c(colSparse, outerIndexDense) += alpha * sum_rowSparse sparse(rowSparse, colSparse) * dense(rowSparse, outerIndexDense)
+                    ElemType sum = 0;
+                    for (size_t iNonzero = begin; iNonzero < end; iNonzero++)
+                        sum += valueBuffer[iNonzero] * denseColumn[rowIndexBuffer[iNonzero]];
+                    cColumn[colSparse] += alpha * sum;
                 }
             }
         }
@@ -1054,21 +1147,33 @@ void CPUSparseMatrix<ElemType>::MultiplyAndAdd(ElemType alpha, const CPUMatrix<E
             c.RequireSizeAndAllocate(m, n, 0, true); // allocate for blockIds
         }
 
-        map<size_t, size_t> col2BlockId;
+        const ElemType* rhsValues = rhs.Buffer() + *rhs.SecondaryIndexLocation();
+        const CPUSPARSE_INDEX_TYPE* rhsRows = rhs.MajorIndexLocation();
+        const size_t rhsNzCount = rhs.NzCount();
+
+        // Columns of the result that already have a block, sorted by column, and the columns that are new.
+        vector<pair<size_t, size_t>> col2BlockId(blockSizePrev);
         for (size_t blockId = 0; blockId < blockSizePrev; blockId++)
+            col2BlockId[blockId] = make_pair(c.GetBlockIds()[blockId], blockId);
+        sort(col2BlockId.begin(), col2BlockId.end());
+
+        vector<size_t> resultCols(rhsRows, rhsRows + rhsNzCount);
+        sort(resultCols.begin(), resultCols.end());
+        resultCols.erase(unique(resultCols.begin(), resultCols.end()), resultCols.end());
+
+        auto findBlock = [&col2BlockId](size_t resultCol)
         {
-            col2BlockId[c.GetBlockIds()[blockId]] = blockId;
-        }
+            return lower_bound(col2BlockId.begin(), col2BlockId.end(), make_pair(resultCol, (size_t)0));
+        };
 
         size_t blockSizeCurr = blockSizePrev;
-        for (size_t rhsNz = 0; rhsNz < rhs.NzCount(); rhsNz++)
+        for (size_t resultCol : resultCols)
         {
-            size_t resultCol = rhs.MajorIndexLocation()[rhsNz];
-            if (col2BlockId.find(resultCol) == col2BlockId.end())
+            auto it = findBlock(resultCol);
+            if (it == col2BlockId.end() || it->first != resultCol)
             {
-                col2BlockId[resultCol] = blockSizeCurr;
                 c.GetBlockIds()[blockSizeCurr] = resultCol;
-                blockSizeCurr ++;
+                blockSizeCurr++;
             }
         }
 
@@ -1077,23 +1182,38 @@ void CPUSparseMatrix<ElemType>::MultiplyAndAdd(ElemType alpha, const CPUMatrix<E
             c.RequireSizeAndAllocate(m, n, m * blockSizeCurr, true, true);
             c.SetBlockSize(blockSizeCurr);
             memset(c.Data() + m * blockSizePrev, 0, sizeof(ElemType) * m * (blockSizeCurr - blockSizePrev));
+
+            // The new blocks were added in the order of their columns.
+            for (size_t blockId = blockSizePrev; blockId < blockSizeCurr; blockId++)
+                col2BlockId.push_back(make_pair(c.GetBlockIds()[blockId], blockId));
+            inplace_merge(col2BlockId.begin(), col2BlockId.begin() + blockSizePrev, col2BlockId.end());
         }
 
-        for (size_t rhsCol = 0; rhsCol < rhs.GetNumCols(); rhsCol++)
-        {
-            size_t start = rhs.SecondaryIndexLocation()[rhsCol];
-            size_t end = rhs.SecondaryIndexLocation()[rhsCol + 1];
+        // Resolve the block of each nonzero element once.
+        vector<size_t> nzBlockIds(rhsNzCount);
+#pragma omp parallel for
+        for (long rhsNz = 0; rhsNz < (long)rhsNzCount; rhsNz++)
+            nzBlockIds[rhsNz] = findBlock(rhsRows[rhsNz])->second;
 
-            for (size_t p = start; p < end; p++)
+        // Each thread updates a range of rows in all blocks.
+        const size_t numRowRanges = GetNumParallelRanges(m, c_minParallelRangeSize);
+        const ElemType* lhsBuffer = lhs.Data();
+        ElemType* resultBuffer = c.Buffer();
+#pragma omp parallel for
+        for (long rowRange = 0; rowRange < (long)numRowRanges; rowRange++)
+        {
+            const size_t rowBegin = m * rowRange / numRowRanges;
+            const size_t rowEnd = m * (rowRange + 1) / numRowRanges;
+            for (size_t rhsCol = 0; rhsCol < rhs.GetNumCols(); rhsCol++)
             {
-                size_t rhsRow = rhs.MajorIndexLocation()[p];
-                ElemType val = rhs.Buffer()[p];
+                size_t start = rhs.SecondaryIndexLocation()[rhsCol] - rhs.SecondaryIndexLocation()[0];
+                size_t end = rhs.SecondaryIndexLocation()[rhsCol + 1] - rhs.SecondaryIndexLocation()[0];
 
-                ElemType* results = c.Buffer() + col2BlockId[rhsRow] * m;
-                #pragma omp parallel for
-                for (int lhsRow = 0; lhsRow < (int)m; lhsRow++)
+                for (size_t p = start; p < end; p++)
                 {
-                    results[lhsRow] += alpha * lhs((size_t)lhsRow, rhsCol) * val;
+                    // results(lhsRow) += alpha * lhs(lhsRow, rhsCol) * val
+                    ScaleAndAddVector(rowEnd - rowBegin, alpha * rhsValues[p], lhsBuffer + rhsCol * m + rowBegin, 1,
+                                      resultBuffer + nzBlockIds[p] * m + rowBegin, 1);
                 }
             }
         }
@@ -15,6 +15,7 @@
 
 #include "Basics.h"
 #include "basetypes.h"
+#include "MemAllocator.h"
 #include <string>
 #include <stdint.h>
 #include <memory>
@@ -258,7 +259,7 @@ public:
         {
             if (m_computeDevice < 0)
             {
-                delete[] m_pArray;
+                FreeCPUBuffer();
                 m_pArray = nullptr;
                 m_nzValues = nullptr;
 
@@ -314,7 +315,21 @@ protected:
     bool IsEmpty() const { return m_numRows == 0 || m_numCols == 0; }
 
     ElemType* Buffer() const { return m_pArray; }
-    void SetBuffer(ElemType* pArray, size_t alloc, bool external = false) { m_pArray = pArray; m_totalBufferSizeAllocated = alloc; m_externalBuffer = external; }
+    void SetBuffer(ElemType* pArray, size_t alloc, bool external = false, MemAllocator* allocator = nullptr) { m_pArray = pArray; m_totalBufferSizeAllocated = alloc; m_externalBuffer = external; m_externalBufferOwner.reset(); m_bufferAllocator = allocator; }
+
+    // frees the buffer of a CPU matrix that is owned by the storage, but leaves the pointer in place
+    void FreeCPUBuffer()
+    {
+        if (m_externalBuffer)
+            return;
+        if (m_bufferAllocator)
+            m_bufferAllocator->Free(m_pArray);
+        else
+            delete[] m_pArray;
+    }
+
+    // keeps an external buffer alive (e.g. a memory-mapped file) as long as the storage uses it
+    void SetExternalBufferOwner(const shared_ptr<void>& owner) { m_externalBufferOwner = owner; }
 
     size_t BufferSizeAllocated() const { return m_totalBufferSizeAllocated; }
     
@@ -363,6 +378,8 @@ protected:
     void ZeroInit(const MatrixFormat matrixFormat = matrixFormatDense, const DEVICEID_TYPE computeDevice = -1)
     {
         m_externalBuffer           = false;
+        m_externalBufferOwner.reset();
+        m_bufferAllocator          = nullptr;
         m_format                   = matrixFormat;
         m_computeDevice            = computeDevice;
         m_numRows                  = 0;
@@ -391,12 +408,14 @@ protected:
     MatrixFormat m_format;
     mutable DEVICEID_TYPE m_computeDevice; // current GPU device Id or CPUDEVICE
     bool m_externalBuffer; // is the buffer used by this matrix,
+    shared_ptr<void> m_externalBufferOwner; // optional owner of the external buffer
 
     // m_numRows and m_numCols should be removed
     size_t m_numRows;
     size_t m_numCols;
     size_t m_elemSizeAllocated;
     ElemType* m_pArray;
+    MemAllocator* m_bufferAllocator; // allocator of m_pArray on the CPU, nullptr for new[]
 
     // **************************
     // GPUSparseMatrix variables
@@ -516,7 +535,9 @@ protected:
     void SetSizeAllocated(size_t alloc) { m_sob->SetSizeAllocated(alloc); }
 
     ElemType* Buffer() const { return m_sob->Buffer(); }
-    void SetBuffer(ElemType* parray, size_t alloc, bool external = false) { m_sob->SetBuffer(parray, alloc, external); }
+    void SetBuffer(ElemType* parray, size_t alloc, bool external = false, MemAllocator* allocator = nullptr) { m_sob->SetBuffer(parray, alloc, external, allocator); }
+    void FreeCPUBuffer() { m_sob->FreeCPUBuffer(); }
+    void SetExternalBufferOwner(const shared_ptr<void>& owner) { m_sob->SetExternalBufferOwner(owner); }
 
     
     size_t GetBlockSize() const { return m_sob->GetBlockSize(); }
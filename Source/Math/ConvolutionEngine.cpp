@@ -6,6 +6,12 @@
 #include "stdafx.h"
 #include "ConvolutionEngine.h"
 #include "CuDnnFactories.h"
+#include "CPUMatrix.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -851,6 +857,527 @@ public:
     }
 };
 
+//------------------------------------------------------------------
+// Multithreaded CPU convolution engine.
+// Convolution forward uses one of three algorithms, the fastest one for a given
+// geometry is selected by timing all applicable ones on the first minibatch:
+// 1. Tiled unroll + GEMM: unlike the GEMM engine, the input is not unrolled for the whole
+//    (sub-)minibatch at once but in tiles of output positions that fit in L2 cache,
+//    and the tiles of all samples are processed in parallel.
+// 2. Pointwise (1x1 kernel, stride 1, no padding): one GEMM per sample directly on
+//    the input, no unrolling required.
+// 3. Direct: for consecutive output positions that use the full kernel (interior of a map
+//    with stride 1 in the first dimension) the kernel is applied with vectorizable loops
+//    over the positions, without unrolling. Used for small (e.g. 3x3) kernels only.
+// With forceDeterministicAlgorithms only algorithm 1 is used, since the algorithms sum in
+// different orders. The engine is not part of ConvolutionEngineKind::All, it is opt-in.
+// Backward data and kernel use the GEMM engine implementation. Pooling is parallelized
+// over samples and channels.
+//------------------------------------------------------------------
+static std::atomic<TiledGemmConvolutionAlgorithm> s_forcedTiledGemmConvolutionAlgorithm(TiledGemmConvolutionAlgorithm::None);
+
+void ForceTiledGemmConvolutionAlgorithm(TiledGemmConvolutionAlgorithm algorithm)
+{
+    s_forcedTiledGemmConvolutionAlgorithm = algorithm;
+}
+
+template <class ElemType>
+class TiledGemmConvolutionEngine : public GemmConvolutionEngine<ElemType>
+{
+public:
+    using Base = GemmConvolutionEngine<ElemType>;
+    using typename Base::Mat;
+
+public:
+    TiledGemmConvolutionEngine(ConvolveGeometryPtr geometry, DEVICEID_TYPE deviceId, ImageLayoutKind imageLayout, size_t maxTempMemSizeInSamples, PoolKind poolKind,
+                               bool forceDeterministicAlgorithms, bool poolIncludePad)
+        : Base(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind, poolIncludePad),
+        m_forceDeterministicAlgorithms(forceDeterministicAlgorithms), m_algorithm(Algorithm::None), m_isPointwise(false), m_poolChannelCount(0)
+    {
+    }
+
+protected:
+    using Base::m_geometry;
+    using Base::m_poolKind;
+    using Base::m_poolIncludePad;
+
+    using Algorithm = TiledGemmConvolutionAlgorithm;
+
+    // Consecutive output positions (rows of a single output map) that are computed together by the direct algorithm.
+    // If m_isFull is true, all positions use the full kernel run and consecutive input positions.
+    struct Segment
+    {
+        int m_begin;
+        int m_end;
+        bool m_isFull;
+    };
+
+    // Size of the per-thread buffers of the tiled algorithm.
+    static const size_t L2CacheSizeInBytes = 256 * 1024;
+    // Kernels with more spatial elements are never computed directly.
+    static const size_t MaxDirectKernelMapSize = 9;
+    // Max number of output positions computed at once by the direct algorithm, so the output segment stays in L1 cache.
+    static const int MaxDirectSegmentSize = 256;
+
+    void EnsureConvolutionInitialized() override
+    {
+        Base::EnsureConvolutionInitialized();
+        if (!m_segments.empty())
+            return;
+
+        const auto& mpRowCol = m_geometry->MpRowCol();
+        const auto& mpRowRun = m_geometry->MpRowRun();
+        const auto& runs = m_geometry->Runs();
+
+        size_t mapCount = m_geometry->GetMapCount(m_geometry->InputShape().GetRank() - 1);
+        m_mapOutSize = m_geometry->OutputShape().GetNumElements() / mapCount;
+        m_kernelSize = m_geometry->KernelShape().GetNumElements();
+
+        size_t tileSize = L2CacheSizeInBytes / (sizeof(ElemType) * (m_kernelSize + mapCount));
+        m_tileSize = max((size_t)1, min(m_mapOutSize, max((size_t)16, tileSize)));
+
+        auto isFull = [&](int row)
+        {
+            int i0 = mpRowRun[row];
+            int skip = runs[i0];
+            int size = runs[i0 + 1];
+            if (skip != 0 || size != (int)m_kernelSize)
+                return false;
+            for (int i = 0; i < size; i++)
+            {
+                if (runs[i0 + 2 + size + i] == 0)
+                    return false;
+            }
+            return true;
+        };
+
+        for (int row = 0; row < (int)m_mapOutSize; row++)
+        {
+            bool full = isFull(row);
+            if (!m_segments.empty())
+            {
+                auto& last = m_segments.back();
+                if (last.m_isFull == full && last.m_end - last.m_begin < MaxDirectSegmentSize &&
+                    (!full || (mpRowRun[row] == mpRowRun[last.m_begin] && mpRowCol[row] == mpRowCol[row - 1] + 1)))
+                {
+                    last.m_end++;
+                    continue;
+                }
+            }
+            m_segments.push_back(Segment{ row, row + 1, full });
+        }
+
+        // Pointwise: every output position uses the full kernel, and kernel element i reads
+        // the same position in input map i, so the input sample is a [W'H' x C] matrix.
+        size_t inRows = m_geometry->InputShape().GetNumElements();
+        m_isPointwise = inRows == m_mapOutSize * m_kernelSize;
+        for (int row = 0; row < (int)m_mapOutSize && m_isPointwise; row++)
+        {
+            int i0 = mpRowRun[row];
+            if (!isFull(row))
+                m_isPointwise = false;
+            for (int i = 0; i < (int)m_kernelSize && m_isPointwise; i++)
+                m_isPointwise = mpRowCol[row] + runs[i0 + 2 + i] == row + i * (int)m_mapOutSize;
+        }
+    }
+
+    void ForwardCore(const Mat& in, const Mat& kernel, Mat& out, Mat& workspace) override
+    {
+        if (!IsDenseOnCpu(in) || !IsDenseOnCpu(kernel) || !IsDenseOnCpu(out))
+        {
+            Base::ForwardCore(in, kernel, out, workspace);
+            return;
+        }
+
+        if (m_algorithm == Algorithm::None)
+            m_algorithm = SelectAlgorithm(in, kernel, out);
+        ForwardWith(m_algorithm, in, kernel, out);
+    }
+
+    void ForwardWith(Algorithm algorithm, const Mat& in, const Mat& kernel, Mat& out) const
+    {
+        switch (algorithm)
+        {
+        case Algorithm::TiledGemm: ForwardTiledGemm(in, kernel, out); break;
+        case Algorithm::Pointwise: ForwardPointwise(in, kernel, out); break;
+        case Algorithm::Direct:    ForwardDirect(in, kernel, out); break;
+        default: LogicError("Unexpected convolution algorithm %d.", (int)algorithm);
+        }
+    }
+
+    // Times all applicable algorithms on the current minibatch. The result is cached for the geometry,
+    // so other nodes with the same configuration reuse it. The algorithms sum in different orders, so
+    // with forceDeterministicAlgorithms the tiled GEMM algorithm is always used instead. An algorithm
+    // forced by a test takes precedence over both and is not cached.
+    Algorithm SelectAlgorithm(const Mat& in, const Mat& kernel, Mat& out) const
+    {
+        Algorithm forced = s_forcedTiledGemmConvolutionAlgorithm;
+        if (forced != Algorithm::None)
+        {
+            auto candidates = GetCandidateAlgorithms();
+            if (std::find(candidates.begin(), candidates.end(), forced) == candidates.end())
+                InvalidArgument("The forced convolution algorithm %d does not apply to geometry: %s.", (int)forced, ((std::string)*m_geometry).c_str());
+            return forced;
+        }
+
+        if (m_forceDeterministicAlgorithms)
+            return Algorithm::TiledGemm;
+
+        static std::mutex s_lock;
+        static std::map<std::string, Algorithm> s_selected;
+
+        std::string key = (std::string)*m_geometry + (sizeof(ElemType) == sizeof(float) ? " float" : " double");
+        {
+            std::lock_guard<std::mutex> lock(s_lock);
+            auto it = s_selected.find(key);
+            if (it != s_selected.end())
+                return it->second;
+        }
+
+        auto candidates = GetCandidateAlgorithms();
+        Algorithm best = candidates[0];
+        if (candidates.size() > 1)
+        {
+            double bestTime = std::numeric_limits<double>::infinity();
+            for (auto algorithm : candidates)
+            {
+                // The first run warms up caches and thread pools.
+                ForwardWith(algorithm, in, kernel, out);
+                auto start = std::chrono::steady_clock::now();
+                ForwardWith(algorithm, in, kernel, out);
+                double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                if (time < bestTime)
+                {
+                    bestTime = time;
+                    best = algorithm;
+                }
+            }
+
+            if (GetMathLibTraceLevel() > 0)
+                fprintf(stderr, "Tiled GEMM convolution engine selected algorithm %d for geometry: %s.\n", (int)best, key.c_str());
+        }
+
+        std::lock_guard<std::mutex> lock(s_lock);
+        s_selected[key] = best;
+        return best;
+    }
+
+    // The algorithms that apply to the geometry.
+    std::vector<Algorithm> GetCandidateAlgorithms() const
+    {
+        std::vector<Algorithm> candidates{ Algorithm::TiledGemm };
+        if (m_isPointwise)
+            candidates.push_back(Algorithm::Pointwise);
+        if (m_kernelSize / m_geometry->KernelShape()[m_geometry->KernelShape().GetRank() - 1] <= MaxDirectKernelMapSize)
+            candidates.push_back(Algorithm::Direct);
+        return candidates;
+    }
+
+    void ForwardTiledGemm(const Mat& in, const Mat& kernel, Mat& out) const
+    {
+        const auto& mpRowCol = m_geometry->MpRowCol();
+        const auto& mpRowRun = m_geometry->MpRowRun();
+        const auto& runs = m_geometry->Runs();
+
+        size_t mapCount = kernel.GetNumElements() / m_kernelSize;
+        size_t inRows = in.GetNumRows();
+        size_t outRows = out.GetNumRows();
+        const ElemType* inData = in.Data();
+        ElemType* outData = out.Data();
+        // cudnn layout uses row-major kernel weight matrix.
+        CPUMatrix<ElemType> kern(m_kernelSize, mapCount, kernel.Data(), matrixFlagDontOwnBuffer);
+
+        size_t tilesPerSample = (m_mapOutSize + m_tileSize - 1) / m_tileSize;
+        long tileCount = (long)(in.GetNumCols() * tilesPerSample);
+#pragma omp parallel
+        {
+            std::vector<ElemType> unrolled(m_kernelSize * m_tileSize);
+            std::vector<ElemType> product(m_tileSize * mapCount);
+
+#pragma omp for schedule(dynamic)
+            for (long tile = 0; tile < tileCount; tile++)
+            {
+                size_t sample = tile / tilesPerSample;
+                size_t begin = (tile % tilesPerSample) * m_tileSize;
+                size_t count = min(m_tileSize, m_mapOutSize - begin);
+                const ElemType* x = inData + sample * inRows;
+
+                // Unroll the tile: [WHC] -> [XYC x count].
+                std::fill(unrolled.begin(), unrolled.begin() + m_kernelSize * count, (ElemType)0);
+                for (size_t j = 0; j < count; j++)
+                {
+                    size_t row = begin + j;
+                    int colBase = mpRowCol[row];
+                    int i0 = mpRowRun[row];
+                    int skip = runs[i0++];
+                    int size = runs[i0++];
+                    int imask = i0 + size;
+                    ElemType* dst = unrolled.data() + j * m_kernelSize + skip;
+                    for (int i = 0; i < size; i++)
+                    {
+                        if (runs[imask + i] != 0)
+                            dst[i] = x[colBase + runs[i0 + i]];
+                    }
+                }
+
+                // [XYC x count]^T * [XYC x K] -> [count x K]
+                CPUMatrix<ElemType> unrolledTile(m_kernelSize, count, unrolled.data(), matrixFlagDontOwnBuffer);
+                CPUMatrix<ElemType> productTile(count, mapCount, product.data(), matrixFlagDontOwnBuffer);
+                CPUMatrix<ElemType>::MultiplyAndWeightedAdd(1, unrolledTile, true, kern, false, 0, productTile);
+
+                ElemType* y = outData + sample * outRows + begin;
+                for (size_t k = 0; k < mapCount; k++)
+                    std::copy(product.data() + k * count, product.data() + (k + 1) * count, y + k * m_mapOutSize);
+            }
+        }
+    }
+
+    void ForwardPointwise(const Mat& in, const Mat& kernel, Mat& out) const
+    {
+        size_t mapCount = kernel.GetNumElements() / m_kernelSize;
+        size_t inRows = in.GetNumRows();
+        size_t outRows = out.GetNumRows();
+        ElemType* inData = in.Data();
+        ElemType* outData = out.Data();
+        CPUMatrix<ElemType> kern(m_kernelSize, mapCount, kernel.Data(), matrixFlagDontOwnBuffer);
+
+        // [W'H' x C] * [C x K] -> [W'H' x K] for each sample.
+#pragma omp parallel for
+        for (long sample = 0; sample < (long)in.GetNumCols(); sample++)
+        {
+            CPUMatrix<ElemType> x(m_mapOutSize, m_kernelSize, inData + sample * inRows, matrixFlagDontOwnBuffer);
+            CPUMatrix<ElemType> y(m_mapOutSize, mapCount, outData + sample * outRows, matrixFlagDontOwnBuffer);
+            CPUMatrix<ElemType>::MultiplyAndWeightedAdd(1, x, false, kern, false, 0, y);
+        }
+    }
+
+    void ForwardDirect(const Mat& in, const Mat& kernel, Mat& out) const
+    {
+        const auto& mpRowCol = m_geometry->MpRowCol();
+        const auto& mpRowRun = m_geometry->MpRowRun();
+        const auto& runs = m_geometry->Runs();
+
+        size_t mapCount = kernel.GetNumElements() / m_kernelSize;
+        size_t inRows = in.GetNumRows();
+        size_t outRows = out.GetNumRows();
+        const ElemType* inData = in.Data();
+        const ElemType* kernData = kernel.Data();
+        ElemType* outData = out.Data();
+
+        long taskCount = (long)(in.GetNumCols() * m_segments.size());
+#pragma omp parallel for schedule(dynamic)
+        for (long task = 0; task < taskCount; task++)
+        {
+            size_t sample = task / m_segments.size();
+            const auto& segment = m_segments[task % m_segments.size()];
+            const ElemType* x = inData + sample * inRows;
+            ElemType* y = outData + sample * outRows;
+
+            if (segment.m_isFull)
+            {
+                int count = segment.m_end - segment.m_begin;
+                const int* offsets = runs.data() + mpRowRun[segment.m_begin] + 2;
+                const ElemType* src = x + mpRowCol[segment.m_begin];
+                for (size_t k = 0; k < mapCount; k++)
+                {
+                    ElemType* dst = y + k * m_mapOutSize + segment.m_begin;
+                    const ElemType* w = kernData + k * m_kernelSize;
+                    std::fill(dst, dst + count, (ElemType)0);
+                    for (size_t i = 0; i < m_kernelSize; i++)
+                    {
+                        const ElemType wi = w[i];
+                        const ElemType* srcI = src + offsets[i];
+                        for (int j = 0; j < count; j++)
+                            dst[j] += wi * srcI[j];
+                    }
+                }
+                continue;
+            }
+
+            // Border of a map: use the masks as the reference engine does.
+            for (int row = segment.m_begin; row < segment.m_end; row++)
+            {
+                int colBase = mpRowCol[row];
+                int i0 = mpRowRun[row];
+                int skip = runs[i0++];
+                int size = runs[i0++];
+                int imask = i0 + size;
+                for (size_t k = 0; k < mapCount; k++)
+                {
+                    const ElemType* w = kernData + k * m_kernelSize + skip;
+                    ElemType sum = 0;
+                    for (int i = 0; i < size; i++)
+                    {
+                        if (runs[imask + i] != 0)
+                            sum += w[i] * x[colBase + runs[i0 + i]];
+                    }
+                    y[k * m_mapOutSize + row] = sum;
+                }
+            }
+        }
+    }
+
+    // Pooling is computed by independent tasks for each sample and, if every output map only reads
+    // the input map with the same index (the usual case), for each map.
+    void EnsurePoolingInitialized() override
+    {
+        Base::EnsurePoolingInitialized();
+        if (m_poolChannelCount != 0)
+            return;
+
+        const auto& mpRowCol = m_geometry->MpRowCol();
+        const auto& mpRowIndices = m_geometry->MpRowIndices();
+        const auto& indices = m_geometry->Indices();
+
+        const auto& inT = m_geometry->InputShape();
+        const auto& outT = m_geometry->OutputShape();
+        size_t channelCount = outT[outT.GetRank() - 1];
+        bool independent = inT.GetRank() == outT.GetRank() && inT[inT.GetRank() - 1] == channelCount;
+        size_t mapInSize = inT.GetNumElements() / channelCount;
+        size_t mapOutSize = outT.GetNumElements() / channelCount;
+        for (size_t row = 0; row < outT.GetNumElements() && independent; row++)
+        {
+            int lo = (int)((row / mapOutSize) * mapInSize);
+            int hi = lo + (int)mapInSize;
+            int i0 = mpRowIndices[row];
+            int size = indices[i0++];
+            for (int i = 0; i < size && independent; i++)
+            {
+                int col = mpRowCol[row] + indices[i0 + i];
+                independent = lo <= col && col < hi;
+            }
+        }
+        m_poolChannelCount = independent ? channelCount : 1;
+    }
+
+    void ForwardPoolingCore(const Mat& in, Mat& out) override
+    {
+        if (!IsDenseOnCpu(in) || !IsDenseOnCpu(out) || (m_poolKind != PoolKind::Max && m_poolKind != PoolKind::Average))
+        {
+            Base::ForwardPoolingCore(in, out);
+            return;
+        }
+
+        const auto& mpRowCol = m_geometry->MpRowCol();
+        const auto& mpRowIndices = m_geometry->MpRowIndices();
+        const auto& indices = m_geometry->Indices();
+
+        size_t inRows = in.GetNumRows();
+        size_t outRows = out.GetNumRows();
+        size_t rowsPerTask = outRows / m_poolChannelCount;
+        const ElemType* inData = in.Data();
+        ElemType* outData = out.Data();
+
+        long taskCount = (long)(out.GetNumCols() * m_poolChannelCount);
+#pragma omp parallel for
+        for (long task = 0; task < taskCount; task++)
+        {
+            size_t sample = task / m_poolChannelCount;
+            size_t begin = (task % m_poolChannelCount) * rowsPerTask;
+            const ElemType* x = inData + sample * inRows;
+            ElemType* y = outData + sample * outRows;
+            for (size_t row = begin; row < begin + rowsPerTask; row++)
+            {
+                const ElemType* src = x + mpRowCol[row];
+                int i0 = mpRowIndices[row];
+                int size = indices[i0++];
+                assert(size > 0);
+                if (m_poolKind == PoolKind::Max)
+                {
+                    ElemType res = -std::numeric_limits<ElemType>::infinity();
+                    for (int i = 0; i < size; i++)
+                        res = std::max(res, src[indices[i0 + i]]);
+                    y[row] = res;
+                }
+                else
+                {
+                    ElemType sum = 0;
+                    for (int i = 0; i < size; i++)
+                        sum += src[indices[i0 + i]];
+                    // Divide by the number of actual elements unless padding is included.
+                    y[row] = sum / (m_poolIncludePad ? indices[0] : size);
+                }
+            }
+        }
+    }
+
+    void BackwardPoolingCore(const Mat& out, const Mat& srcGrad, const Mat& in, Mat& grad) override
+    {
+        if (!IsDenseOnCpu(out) || !IsDenseOnCpu(srcGrad) || !IsDenseOnCpu(in) || !IsDenseOnCpu(grad) ||
+            (m_poolKind != PoolKind::Max && m_poolKind != PoolKind::Average))
+        {
+            Base::BackwardPoolingCore(out, srcGrad, in, grad);
+            return;
+        }
+
+        const auto& mpRowCol = m_geometry->MpRowCol();
+        const auto& mpRowIndices = m_geometry->MpRowIndices();
+        const auto& indices = m_geometry->Indices();
+
+        size_t inRows = in.GetNumRows();
+        size_t outRows = out.GetNumRows();
+        size_t rowsPerTask = outRows / m_poolChannelCount;
+        const ElemType* inData = in.Data();
+        const ElemType* outData = out.Data();
+        const ElemType* srcGradData = srcGrad.Data();
+        ElemType* gradData = grad.Data();
+
+        // Tasks write to disjoint parts of grad, no atomics required.
+        long taskCount = (long)(out.GetNumCols() * m_poolChannelCount);
+#pragma omp parallel for
+        for (long task = 0; task < taskCount; task++)
+        {
+            size_t sample = task / m_poolChannelCount;
+            size_t begin = (task % m_poolChannelCount) * rowsPerTask;
+            const ElemType* x = inData + sample * inRows;
+            ElemType* dx = gradData + sample * inRows;
+            for (size_t row = begin; row < begin + rowsPerTask; row++)
+            {
+                int colBase = mpRowCol[row];
+                int i0 = mpRowIndices[row];
+                int size = indices[i0++];
+                assert(size > 0);
+                ElemType g = srcGradData[sample * outRows + row];
+                if (m_poolKind == PoolKind::Max)
+                {
+                    ElemType m = outData[sample * outRows + row];
+                    for (int i = 0; i < size; i++)
+                    {
+                        int col = colBase + indices[i0 + i];
+                        if (x[col] >= m)
+                        {
+                            dx[col] += g;
+                            break;
+                        }
+                    }
+                }
+                else
+                {
+                    g /= m_poolIncludePad ? indices[0] : size;
+                    for (int i = 0; i < size; i++)
+                        dx[colBase + indices[i0 + i]] += g;
+                }
+            }
+        }
+    }
+
+private:
+    static bool IsDenseOnCpu(const Mat& mat)
+    {
+        return mat.GetMatrixType() == MatrixType::DENSE && mat.GetCurrentMatrixLocation() == CurrentDataLocation::CPU;
+    }
+
+private:
+    bool m_forceDeterministicAlgorithms;
+    Algorithm m_algorithm;
+    size_t m_mapOutSize;
+    size_t m_kernelSize;
+    size_t m_tileSize;
+    bool m_isPointwise;
+    std::vector<Segment> m_segments;
+    size_t m_poolChannelCount;
+};
+
 template <class ElemType>
 std::unique_ptr<ConvolutionEngine<ElemType>> ConvolutionEngine<ElemType>::Create(ConvolveGeometryPtr geometry, DEVICEID_TYPE deviceId,
                                                                                  ImageLayoutKind imageLayout, size_t maxTempMemSizeInSamples, PoolKind poolKind,
@@ -886,6 +1413,14 @@ std::unique_ptr<ConvolutionEngine<ElemType>> ConvolutionEngine<ElemType>::Create
         return CuDnnConvolutionEngineFactory<ElemType>::Create(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind, forceDeterministicAlgorithms, poolIncludePad);
     }
 
+    if (isEnabled(ConvolutionEngineKind::TiledGemm) && TiledGemmConvolutionEngine<ElemType>::IsSupported(deviceId, geometry))
+    {
+        if (GetMathLibTraceLevel() > 0)
+            fprintf(stderr, "%lsusing tiled GEMM convolution engine for geometry: %s.\n", logPrefix.c_str(), engStr.c_str());
+
+        return std::make_unique<TiledGemmConvolutionEngine<ElemType>>(geometry, deviceId, imageLayout, maxTempMemSizeInSamples, poolKind, forceDeterministicAlgorithms, poolIncludePad);
+    }
+
     if (isEnabled(ConvolutionEngineKind::Gemm) && GemmConvolutionEngine<ElemType>::IsSupported(deviceId, geometry))
     {
         if (GetMathLibTraceLevel() > 0)
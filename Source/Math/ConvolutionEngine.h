@@ -22,10 +22,27 @@ enum class ConvolutionEngineKind
     CuDnn     = 1 << 1, // cuDNN, works only for 2D/3D convos with full sharing.
     Legacy    = 1 << 2, // Legacy, for backwards compatibility. REVIEW alexeyk: implement sparse version and remove Legacy altogether.
     Gemm      = 1 << 3, // Uses convolution unrolling+GEMM technique. Works only for convos with full sharing.
+    TiledGemm = 1 << 4, // Multithreaded CPU engine: tiled unrolling+GEMM and direct small-kernel paths, autotuned per geometry. Works only for convos with full sharing.
+                        // Opt-in (not part of All): the autotuned algorithms sum in different orders, so results may differ between runs.
 
     All       = Reference | CuDnn | Legacy | Gemm
 };
 
+// Algorithms of the forward convolution of the TiledGemm engine, which times the ones that apply to a geometry and uses
+// the fastest.
+enum class TiledGemmConvolutionAlgorithm
+{
+    None,      // not selected (or, when forcing, not forced)
+    TiledGemm, // Tiled unrolling+GEMM, applies to all geometries.
+    Pointwise, // One GEMM per sample, for 1x1 convolutions that read every input position.
+    Direct     // Direct loops, for kernels with at most 9 elements per map.
+};
+
+// For tests: makes TiledGemm engines use the given algorithm instead of selecting one, from their next first Forward on,
+// so that all algorithms can be checked. Forward throws std::invalid_argument if the algorithm does not apply to the
+// geometry. None restores the selection.
+MATH_API void ForceTiledGemmConvolutionAlgorithm(TiledGemmConvolutionAlgorithm algorithm);
+
 enum class PoolKind
 {
     None,
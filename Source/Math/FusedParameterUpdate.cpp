@@ -0,0 +1,233 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include "FusedParameterUpdate.h"
+#include <algorithm>
+#include <math.h>
+#include <omp.h>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+template <class ElemType>
+const size_t FusedParameterUpdate<ElemType>::TileSize;
+
+template <class ElemType>
+FusedParameterUpdate<ElemType>::FusedParameterUpdate(const Options& options)
+    : m_options(options)
+{
+    if (options.clippingThreshold <= 0)
+        InvalidArgument("FusedParameterUpdate: the gradient clipping threshold must be positive.");
+}
+
+template <class ElemType>
+bool FusedParameterUpdate<ElemType>::CanAdd(const Matrix<ElemType>& value, const Matrix<ElemType>& gradient, const Matrix<ElemType>& smoothedGradient) const
+{
+    auto isDenseOnCPU = [](const Matrix<ElemType>& matrix)
+    {
+        return matrix.GetMatrixType() == MatrixType::DENSE && matrix.GetCurrentMatrixLocation() == CurrentDataLocation::CPU;
+    };
+
+    if (!isDenseOnCPU(value) || !isDenseOnCPU(gradient) || value.IsEmpty() ||
+        value.GetNumRows() != gradient.GetNumRows() || value.GetNumCols() != gradient.GetNumCols())
+        return false;
+
+    if (m_options.rule == Rule::SGD)
+        return true;
+
+    // FSAdaGrad and Adam keep two accumulators side by side, the Matrix methods resize the smoothed gradient on first use.
+    const size_t numAccumulators = (m_options.rule == Rule::FSAdaGrad || m_options.rule == Rule::Adam) ? 2 : 1;
+    return isDenseOnCPU(smoothedGradient) &&
+           smoothedGradient.GetNumRows() == gradient.GetNumRows() && smoothedGradient.GetNumCols() == numAccumulators * gradient.GetNumCols();
+}
+
+template <class ElemType>
+void FusedParameterUpdate<ElemType>::Add(Matrix<ElemType>& value, Matrix<ElemType>& gradient, Matrix<ElemType>& smoothedGradient, const ParameterOptions& parameterOptions)
+{
+    if (!CanAdd(value, gradient, smoothedGradient))
+        LogicError("FusedParameterUpdate: only dense CPU parameters with matching gradients and smoothed gradients can be added.");
+
+    Parameter parameter;
+    parameter.m_value = value.Data();
+    parameter.m_gradient = gradient.Data();
+    parameter.m_smoothedGradient = m_options.rule == Rule::SGD ? nullptr : smoothedGradient.Data();
+    parameter.m_size = value.GetNumElements();
+    parameter.m_options = parameterOptions;
+    parameter.m_gradientScale = (ElemType) m_options.gradientScale;
+    m_parameters.push_back(parameter);
+}
+
+template <class ElemType>
+double FusedParameterUpdate<ElemType>::SumOfSquares(const Tile& tile) const
+{
+    const Parameter& parameter = m_parameters[tile.m_parameter];
+    const ElemType* gradient = parameter.m_gradient;
+
+    double sum = 0;
+    for (size_t i = tile.m_begin; i < tile.m_end; i++)
+        sum += (double) gradient[i] * gradient[i];
+
+    return sum * parameter.m_gradientScale * parameter.m_gradientScale;
+}
+
+template <class ElemType>
+template <FusedParameterUpdateSettings::Rule rule>
+void FusedParameterUpdate<ElemType>::UpdateTile(const Tile& tile) const
+{
+    const Parameter& parameter = m_parameters[tile.m_parameter];
+    const size_t n = tile.m_end - tile.m_begin;
+    ElemType* value = parameter.m_value + tile.m_begin;
+    ElemType* gradient = parameter.m_gradient + tile.m_begin;
+    // For FSAdaGrad and Adam the first half of the smoothed gradient holds the variance accumulator, the second half the momentum.
+    ElemType* smoothed = rule == Rule::SGD ? nullptr : parameter.m_smoothedGradient + tile.m_begin;
+    ElemType* smoothedMomentum = (rule == Rule::FSAdaGrad || rule == Rule::Adam) ? parameter.m_smoothedGradient + parameter.m_size + tile.m_begin : nullptr;
+
+    const ElemType gradientScale = parameter.m_gradientScale;
+    const bool truncate = m_options.clippingWithTruncation && m_options.clippingThreshold != std::numeric_limits<double>::infinity();
+    const ElemType threshold = truncate ? (ElemType) m_options.clippingThreshold : 0;
+    const ElemType l2RegWeight = (ElemType) parameter.m_options.l2RegWeight;
+    const ElemType l1Threshold = (ElemType) parameter.m_options.l1Threshold;
+
+    const ElemType learningRate = (ElemType) parameter.m_options.learningRate;
+    const ElemType momentum = (ElemType) parameter.m_options.momentum;
+    const ElemType unitGainFactor = (ElemType) (m_options.unitGainMomentum ? (1.0 - momentum) : 1.0);
+    const ElemType unitGainLearningRate = unitGainFactor * learningRate;
+    const ElemType varMomentum = (ElemType) m_options.varMomentum;
+    const ElemType adaMul = (ElemType) parameter.m_options.adaMul;
+    const ElemType epsilon = (ElemType) m_options.epsilon;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        // preprocessing: scaling, clipping, L2 regularization
+        ElemType g = gradient[i] * gradientScale;
+        if (truncate)
+            g = std::max(-threshold, std::min(threshold, g));
+        if (l2RegWeight > 0)
+            g += l2RegWeight * value[i];
+        gradient[i] = g;
+
+        // update rule, below conditions are evaluated at compile time
+        ElemType w = value[i];
+        if (rule == Rule::SGD)
+        {
+            w -= learningRate * g;
+        }
+        else if (rule == Rule::MomentumSGD || rule == Rule::Nesterov)
+        {
+            ElemType sg = momentum * smoothed[i] + unitGainLearningRate * g;
+            smoothed[i] = sg;
+            if (rule == Rule::MomentumSGD)
+                w -= sg;
+            else
+            {
+                w -= momentum * sg;
+                w -= unitGainLearningRate * g;
+            }
+        }
+        else if (rule == Rule::FSAdaGrad)
+        {
+            ElemType adaSqr = varMomentum * smoothed[i] + (1 - varMomentum) * g * g;
+            smoothed[i] = adaSqr;
+            if (adaSqr != 0)
+            {
+                ElemType weight = adaMul * (1 / sqrt(adaSqr));
+                if (weight > 10)
+                    weight = 10;
+                g *= weight;
+            }
+
+            if (momentum > 0)
+            {
+                g = momentum * smoothedMomentum[i] + unitGainFactor * g;
+                smoothedMomentum[i] = g;
+            }
+            w -= g * learningRate;
+        }
+        else if (rule == Rule::Adam)
+        {
+            ElemType ada;
+            if (!m_options.adamax)
+            {
+                ElemType adaSqr = varMomentum * smoothed[i] + (1 - varMomentum) * g * g;
+                smoothed[i] = adaSqr;
+                ada = sqrt(adaSqr);
+            }
+            else
+                ada = smoothed[i] = std::max(varMomentum * smoothed[i], (ElemType) fabs(g));
+
+            ElemType weight = adaMul * (1 / (ada + epsilon));
+            g = momentum * smoothedMomentum[i] + unitGainFactor * g;
+            smoothedMomentum[i] = g;
+            w -= g * weight * learningRate;
+        }
+
+        // postprocessing: L1 regularization with proximal gradient descent
+        if (l1Threshold > 0)
+        {
+            if (w > l1Threshold)
+                w -= l1Threshold;
+            else if (w < -l1Threshold)
+                w += l1Threshold;
+            else
+                w = 0;
+        }
+        value[i] = w;
+    }
+}
+
+template <class ElemType>
+void FusedParameterUpdate<ElemType>::Apply()
+{
+    if (m_parameters.empty())
+        return;
+
+    std::vector<Tile> tiles;
+    for (size_t p = 0; p < m_parameters.size(); p++)
+    {
+        for (size_t begin = 0; begin < m_parameters[p].m_size; begin += TileSize)
+            tiles.push_back(Tile{ p, begin, std::min(begin + (size_t) TileSize, m_parameters[p].m_size) });
+    }
+
+    // Clipping by norm needs the norms of all gradients first. The partial sums are added up in a fixed order,
+    // so the result does not depend on the number of threads.
+    if (!m_options.clippingWithTruncation && m_options.clippingThreshold != std::numeric_limits<double>::infinity())
+    {
+        std::vector<double> sums(tiles.size());
+#pragma omp parallel for schedule(dynamic)
+        for (long t = 0; t < (long) tiles.size(); t++)
+            sums[t] = SumOfSquares(tiles[t]);
+
+        std::vector<double> norms(m_parameters.size(), 0);
+        for (size_t t = 0; t < tiles.size(); t++)
+            norms[tiles[t].m_parameter] += sums[t];
+
+        for (size_t p = 0; p < m_parameters.size(); p++)
+        {
+            double norm = sqrt(norms[p]);
+            if (norm > m_options.clippingThreshold)
+                m_parameters[p].m_gradientScale = (ElemType) (m_options.gradientScale * m_options.clippingThreshold / norm);
+        }
+    }
+
+#pragma omp parallel for schedule(dynamic)
+    for (long t = 0; t < (long) tiles.size(); t++)
+    {
+        switch (m_options.rule)
+        {
+        case Rule::SGD:         UpdateTile<Rule::SGD>(tiles[t]); break;
+        case Rule::MomentumSGD: UpdateTile<Rule::MomentumSGD>(tiles[t]); break;
+        case Rule::Nesterov:    UpdateTile<Rule::Nesterov>(tiles[t]); break;
+        case Rule::FSAdaGrad:   UpdateTile<Rule::FSAdaGrad>(tiles[t]); break;
+        case Rule::Adam:        UpdateTile<Rule::Adam>(tiles[t]); break;
+        }
+    }
+
+    m_parameters.clear();
+}
+
+template class FusedParameterUpdate<float>;
+template class FusedParameterUpdate<double>;
+
+}}}
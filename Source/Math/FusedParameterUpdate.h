@@ -0,0 +1,118 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include "Matrix.h"
+#include <limits>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+#pragma warning(push)
+#pragma warning(disable : 4251)
+
+// Settings of FusedParameterUpdate, independent of the element type.
+struct FusedParameterUpdateSettings
+{
+    enum class Rule
+    {
+        SGD,
+        MomentumSGD,
+        Nesterov,
+        FSAdaGrad, // the smoothed gradient holds the variance and the momentum accumulators, as for FSAdagradUpdate()
+        Adam       // the smoothed gradient holds the variance and the momentum accumulators, as for AdamUpdate()
+    };
+
+    // Settings shared by all parameters.
+    struct Options
+    {
+        Rule rule = Rule::MomentumSGD;
+        double gradientScale = 1;                                          // applied to the gradients first, e.g. for mean gradients
+        double clippingThreshold = std::numeric_limits<double>::infinity(); // per parameter, after the scaling
+        bool clippingWithTruncation = true;                                // truncate elements instead of normalizing the norm
+        bool unitGainMomentum = true;
+        double varMomentum = 0;                                            // FSAdaGrad and Adam
+        double epsilon = 0;                                                // Adam
+        bool adamax = false;                                               // Adam
+    };
+
+    // Settings of one parameter. The regularization weights are expected to be scaled by the minibatch size already
+    // and the L1 threshold to include the learning rate, as for InplaceSoftThreshold().
+    struct ParameterOptions
+    {
+        double learningRate = 0;
+        double momentum = 0;
+        double l2RegWeight = 0;
+        double l1Threshold = 0;
+        double adaMul = 1; // FSAdaGrad: targetAdagradAvDenom * sqrt(smoothed count), Adam: bias correction
+    };
+};
+
+//-------------------------------------------------------------
+// Fused optimizer step for dense CPU parameters.
+//
+// The per-parameter update applies gradient clipping, L2 regularization, the update rule and L1 regularization one after
+// another, each in a full pass over the parameter, and is invoked for one parameter at a time. For models with many small
+// parameters this is dominated by per-call overhead and memory traffic. FusedParameterUpdate instead collects all parameters
+// of a minibatch, splits them into cache-sized tiles and applies all steps to one tile at a time, with the tiles of all
+// parameters distributed across threads in a single sweep. Norm based gradient clipping needs one additional (read only) sweep.
+//
+// The results match the corresponding Matrix methods (MomentumSGDUpdate, NesterovAcceleratedMomentumSGDUpdate,
+// FSAdagradUpdate, AdamUpdate, SGDUpdate, InplaceTruncate, InplaceSoftThreshold) up to rounding. As with those, the
+// gradients are left scaled, clipped and L2 regularized.
+//-------------------------------------------------------------
+template <class ElemType>
+class MATH_API FusedParameterUpdate : public FusedParameterUpdateSettings
+{
+public:
+    explicit FusedParameterUpdate(const Options& options);
+
+    // Returns true if the parameter can be updated by the fused engine: all matrices are dense, located on the CPU, and the
+    // smoothed gradient has the shape required by the update rule. Other parameters have to be updated one by one.
+    bool CanAdd(const Matrix<ElemType>& value, const Matrix<ElemType>& gradient, const Matrix<ElemType>& smoothedGradient) const;
+
+    // Adds a parameter to the update. The matrices must stay alive and must not be resized until Apply() returns.
+    void Add(Matrix<ElemType>& value, Matrix<ElemType>& gradient, Matrix<ElemType>& smoothedGradient, const ParameterOptions& parameterOptions);
+
+    size_t GetNumParameters() const { return m_parameters.size(); }
+
+    // Updates all added parameters and removes them from the engine.
+    void Apply();
+
+    // Number of elements processed by a thread at once, small enough for the tiles of all operands to stay in the L2 cache.
+    static const size_t TileSize = 8192;
+
+private:
+    struct Parameter
+    {
+        ElemType* m_value;
+        ElemType* m_gradient;
+        ElemType* m_smoothedGradient;
+        size_t m_size;
+        ParameterOptions m_options;
+        ElemType m_gradientScale; // including the clipping factor if clipping by norm
+    };
+
+    struct Tile
+    {
+        size_t m_parameter;
+        size_t m_begin;
+        size_t m_end;
+    };
+
+    // Sum of squares of the scaled gradient elements of the tile.
+    double SumOfSquares(const Tile& tile) const;
+
+    template <Rule rule>
+    void UpdateTile(const Tile& tile) const;
+
+    Options m_options;
+    std::vector<Parameter> m_parameters;
+};
+
+#pragma warning(pop)
+
+}}}
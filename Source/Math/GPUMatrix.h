@@ -618,12 +618,10 @@ public:
         size_t numRows, numCols;
         int format;
         stream >> matrixNameDummy >> format >> numRows >> numCols;
-        ElemType* d_array = new ElemType[numRows * numCols];
-        for (size_t i = 0; i < numRows * numCols; ++i)
-            stream >> d_array[i];
+        std::vector<ElemType> values(numRows * numCols);
+        stream.ReadArray(values.data(), values.size());
         stream.GetMarker(fileMarkerEndSection, std::wstring(L"EMAT"));
-        us.SetValue(numRows, numCols, us.GetComputeDeviceId(), d_array, matrixFlagNormal | format);
-        delete[] d_array;
+        us.SetValue(numRows, numCols, us.GetComputeDeviceId(), values.data(), matrixFlagNormal | format);
         return stream;
     }
     friend File& operator<<(File& stream, const GPUMatrix<ElemType>& us)
@@ -632,15 +630,17 @@ public:
         stream << sizeof(ElemType);
 
         // TODO: This is now ignored on input, so we can should change to an empty string. This might break parsing, and must be tested first
+        // The name is padded like in CPUMatrix's operator<<, so that large values are aligned for memory-mapped loading.
         std::wstring s = std::wstring(L"unnamed");
+        const size_t headerSize = 2 * (s.size() + 1) + sizeof(int) + 2 * sizeof(size_t);
+        s.append(stream.GetPayloadPadding(headerSize, us.GetNumElements() * sizeof(ElemType), 2) / 2, L' ');
         int format = us.GetFormat();
         stream << s << format;
 
         stream << us.m_numRows << us.m_numCols;
         ElemType* pArray = us.CopyToArray();
-        for (size_t i = 0; i < us.GetNumElements(); ++i)
-            stream << pArray[i];
-        
+        stream.WriteArray(pArray, us.GetNumElements());
+
         delete[] pArray;
 
         stream.PutMarker(fileMarkerEndSection, std::wstring(L"EMAT"));
@@ -267,6 +267,8 @@ public:
     // AssignValuesOf respects the target matrix's information. It copies the values from the target into the memory of the source.
     void AssignValuesOf(const Matrix<ElemType>& deepCopyFrom);
     void SetValue(const size_t numRows, const size_t numCols, int deviceId, ElemType* pArray, const size_t matrixFlags = matrixFlagNormal, DataTransferer* transferer = nullptr);
+    // CPU only: use the external (column major) buffer in place and keep 'owner' alive as long as the storage uses it
+    void AttachExternalBuffer(const size_t numRows, const size_t numCols, ElemType* pArray, const std::shared_ptr<void>& owner);
     void SetValue(const size_t rIdx, const size_t cIdx, ElemType val); // set matrix sparsely
     void SetValue(const size_t numRows, const size_t numCols, std::initializer_list<ElemType> l) // SetValue(2,3, {1,2,3,  4,5,6});
     {
@@ -0,0 +1,90 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "QuantizedOperations.h"
+// BlockHandlerSSE is not available on ARM64, see BlockHandlerSSE.cpp. Fall back to a plain loop there.
+#if !defined(__aarch64__)
+#include "BlockMultiplier.h"
+#endif
+#include <omp.h>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+#if !defined(__aarch64__)
+#ifdef SUPPORT_AVX2
+typedef BlockMultiplier<BlockHandlerAVX> QuantizedBlockMultiplier;
+#else
+typedef BlockMultiplier<BlockHandlerSSE> QuantizedBlockMultiplier;
+#endif
+#endif
+
+// BlockMultiplier works on row-major matrices. A column-major matrix is the row-major view of its transpose,
+// so the column-major C = A * B is computed as the row-major C' = B' * A'. This makes A the right-hand side
+// of the block multiplication, which is the operand BlockMultiplier keeps pre-packed (PrepareB()).
+struct QuantizedGemm::Impl
+{
+    int m = 0;
+    int k = 0;
+#if !defined(__aarch64__)
+    QuantizedBlockMultiplier multiplier;
+    short* packedA = nullptr;
+
+    Impl() : multiplier(omp_get_max_threads()) {}
+    ~Impl()
+    {
+        if (packedA != nullptr)
+            QuantizedBlockMultiplier::FreeMatrix(packedA);
+    }
+#else
+    std::vector<short> A;
+#endif
+};
+
+QuantizedGemm::QuantizedGemm() : m_impl(new Impl())
+{
+}
+
+QuantizedGemm::~QuantizedGemm()
+{
+}
+
+void QuantizedGemm::PackA(const short* A, int m, int k)
+{
+    m_impl->m = m;
+    m_impl->k = k;
+#if !defined(__aarch64__)
+    if (m_impl->packedA != nullptr)
+        QuantizedBlockMultiplier::FreeMatrix(m_impl->packedA);
+    m_impl->packedA = m_impl->multiplier.PrepareB(const_cast<short*>(A), k, m);
+#else
+    m_impl->A.assign(A, A + m * k);
+#endif
+}
+
+void QuantizedGemm::Multiply(const short* B, int n, int32_t* C)
+{
+    const int m = m_impl->m;
+    const int k = m_impl->k;
+#if !defined(__aarch64__)
+    if (m_impl->packedA == nullptr)
+        LogicError("QuantizedGemm::Multiply: PackA() must be called first.");
+
+    // BlockMultiplier accumulates into C
+    memset(C, 0, sizeof(int32_t) * m * n);
+    m_impl->multiplier.MultiplyMatrices(const_cast<short*>(B), n, k, m_impl->packedA, m, C);
+#else
+    const short* A = m_impl->A.data();
+    for (int j = 0; j < n; j++)
+        for (int i = 0; i < m; i++)
+        {
+            int32_t dotProduct = 0;
+            for (int l = 0; l < k; l++)
+                dotProduct += A[i + l * m] * B[l + k * j];
+            C[i + j * m] = dotProduct;
+        }
+#endif
+}
+
+}}}
@@ -4,9 +4,48 @@
 //
 #pragma once
 #include "Quantizers.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef MATH_API
+#ifdef MATH_EXPORTS
+#define MATH_API __declspec(dllexport)
+#else
+#define MATH_API __declspec(dllimport)
+#endif
+#endif /* MATH_API */
+#else  // no DLLs in Linux
+#define MATH_API
+#endif
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// 16-bit integer product C[m,n] = A[m,k]*B[k,n] in column-major storage, with 32-bit integer results.
+// This is a thin wrapper around BlockMultiplier with the SSE (or AVX2, if compiled with SUPPORT_AVX2) block handler.
+// A is rewritten into block order by PackA() and stays packed until the next PackA() call, so that a constant
+// matrix (typically the weights) is only rewritten once. The BlockMultiplier is kept in QuantizedOperations.cpp
+// so that the SIMD intrinsics headers do not leak into CUDA translation units.
+class MATH_API QuantizedGemm
+{
+public:
+    QuantizedGemm();
+    ~QuantizedGemm();
+
+    // Rewrite A[m,k] into block order.
+    void PackA(const short* A, int m, int k);
+    // C[m,n] = packed A * B[k,n]
+    void Multiply(const short* B, int n, int32_t* C);
+
+private:
+    struct Impl;
+#pragma warning(push)
+#pragma warning(disable : 4251)
+    std::unique_ptr<Impl> m_impl;
+#pragma warning(pop)
+};
+
 
 // Quantized product of two dense matrices A and B, where each matrix has its own quantizer.
 // This class handles quantization of both matrices, product and de-quantization of the result.
@@ -21,9 +60,15 @@ class QuantizedMultiplier
     // Placeholders for quantized matrices A and B
     vector<short> m_pMatA, m_pMatB;
 
+    // Placeholder for the integer product
+    vector<int32_t> m_pMatC;
+
+    // Block multiplier holding A in packed form
+    QuantizedGemm m_gemm;
+
     // Whether matrices A and B are constant (i.e. weights)
     // If the matrix is constant, the size of the underlying container for quatized values will be preserved for
-    // the lifespan of the object
+    // the lifespan of the object, and A will only be packed for the block multiplier once
     bool m_isAConstant;
     bool m_isBConstant;
 
@@ -50,6 +95,7 @@ public:
             m_pMatA.resize(m*k);
             ArrayRef<short> refMatA(m_pMatA.data(), m_pMatA.size());
             m_pQuantizerA->Quantize(ArrayRef<ElemType>(A, m_pMatA.size()), refMatA);
+            m_gemm.PackA(m_pMatA.data(), m, k);
         }
         
         if (!m_isBConstant || m_firstPass)
@@ -62,22 +108,13 @@ public:
         m_firstPass = false;
 
         // Do multiply
-        // Naive inefficient product, just for demonstation
-        // TODO: replace with an efficient version, e.g. IPG, block multiplier, Eigen, gemmlowp, etc.
-        for (size_t i = 0; i < m; i++)
-            for (size_t j = 0; j < n; j++)
-            {
-                int dotProduct=0;
-                for (size_t l = 0; l < k; l++)
-                {
-                    // CNTK is using column-major storage
-                    dotProduct += m_pMatA[i + l*m] * m_pMatB[l + k*j];
-                }
-                C[i + j*m] = (ElemType)dotProduct;
-            }
+        int mn = m*n;
+        m_pMatC.resize(mn);
+        m_gemm.Multiply(m_pMatB.data(), n, m_pMatC.data());
+        for (int i = 0; i < mn; i++)
+            C[i] = (ElemType)m_pMatC[i];
 
         // De-quantize
-        int mn = m*n;
         m_pQuantizerB->Dequantize(C, C, mn);
         m_pQuantizerA->Dequantize(C, C, mn);
     }
@@ -17,8 +17,10 @@
 #include "fileutil.h"
 #include "TimerUtility.h"
 #include <algorithm>
+#include <atomic>
 #include <memory>
 #include <mutex>
+#include <vector>
 #include <stdio.h>
 #ifndef CPUONLY
 #include <cuda_runtime_api.h>
@@ -67,6 +69,22 @@ static const FixedEventDesc c_fixedEvtDesc[profilerEvtMax] = {
     { "", profilerEvtSeparator, false },                            // profilerSepSpace2
 
     { "Prefetch Minibatch", profilerEvtTime, false },               // profilerEvtPrefetchMinibatch
+    { "_Pack Minibatch", profilerEvtTime, false },                  // profilerEvtReaderPack
+    { "__Transform Sequences", profilerEvtTime, false },            // profilerEvtReaderTransform
+    { "___Randomize Sequences", profilerEvtTime, false },           // profilerEvtReaderRandomize
+    { "____Load Chunk", profilerEvtTime, false },                   // profilerEvtReaderLoadChunk
+    { "_Transfer Minibatch", profilerEvtTime, false },              // profilerEvtReaderTransfer
+    { "Wait For Prefetch", profilerEvtTime, false },                // profilerEvtReaderWaitForPrefetch
+};
+
+// Fixed events of the reader stages
+static const int c_readerStageEvt[readerStageMax] = {
+    profilerEvtReaderLoadChunk,                                     // readerStageLoadChunk
+    profilerEvtReaderRandomize,                                     // readerStageRandomize
+    profilerEvtReaderTransform,                                     // readerStageTransform
+    profilerEvtReaderPack,                                          // readerStagePack
+    profilerEvtReaderTransfer,                                      // readerStageTransfer
+    profilerEvtReaderWaitForPrefetch,                               // readerStageWaitForPrefetch
 };
 
 
@@ -116,6 +134,22 @@ static unique_ptr<ProfilerState> g_profilerState;
 // Mutex controlling access to g_profilerState
 static std::mutex g_mutex;
 
+
+//
+// State of the reader statistics, independent of the profiler state
+//
+struct ReaderStatisticsState
+{
+    ReaderStatistics        statistics;                  // Accumulated statistics, without the chunk load percentiles
+    std::vector<long long>  chunkLoadTicks;              // Duration of every chunk load
+};
+
+static std::atomic<bool> g_readerStatisticsEnabled(false);
+static ReaderStatisticsState g_readerStatisticsState;
+
+// Mutex controlling access to g_readerStatisticsState
+static std::mutex g_readerStatisticsMutex;
+
 // Forward declarations
 unsigned int GetThreadId();
 
@@ -342,6 +376,92 @@ void PERF_PROFILER_API ProfilerThroughputEnd(const long long stateId, const int
 }
 
 
+//
+// Enable/disable the collection of reader statistics.
+//
+void PERF_PROFILER_API ReaderStatisticsEnable(bool enable)
+{
+    g_readerStatisticsEnabled = enable;
+}
+
+bool PERF_PROFILER_API ReaderStatisticsEnabled()
+{
+    return g_readerStatisticsEnabled;
+}
+
+
+//
+// Reset or retrieve the reader statistics.
+//
+void PERF_PROFILER_API ReaderStatisticsReset()
+{
+    std::lock_guard<std::mutex> lock(g_readerStatisticsMutex);
+    g_readerStatisticsState.statistics = ReaderStatistics();
+    g_readerStatisticsState.chunkLoadTicks.clear();
+}
+
+void PERF_PROFILER_API ReaderStatisticsGet(ReaderStatistics& statistics)
+{
+    std::vector<long long> chunkLoadTicks;
+    {
+        std::lock_guard<std::mutex> lock(g_readerStatisticsMutex);
+        statistics = g_readerStatisticsState.statistics;
+        chunkLoadTicks = g_readerStatisticsState.chunkLoadTicks;
+    }
+
+    auto percentile = [&chunkLoadTicks](double p)
+    {
+        if (chunkLoadTicks.empty())
+            return 0.0;
+        size_t index = std::min((size_t)(p * chunkLoadTicks.size()), chunkLoadTicks.size() - 1);
+        std::nth_element(chunkLoadTicks.begin(), chunkLoadTicks.begin() + index, chunkLoadTicks.end());
+        return TicksToSeconds(chunkLoadTicks[index]);
+    };
+
+    statistics.chunkLoadP50 = percentile(0.5);
+    statistics.chunkLoadP90 = percentile(0.9);
+    statistics.chunkLoadP99 = percentile(0.99);
+    statistics.chunkLoadMax = percentile(1.0);
+}
+
+
+//
+// Record a reader stage, as fixed event and in the reader statistics.
+//
+void PERF_PROFILER_API ReaderStageEnd(const long long stateId, const ReaderStage stage, const long long samples, const long long bytes)
+{
+    ProfilerTimeEnd(stateId, c_readerStageEvt[stage]);
+
+    if (!g_readerStatisticsEnabled)
+        return;
+
+    long long ticks = Clock::GetTimeStamp() - stateId;
+
+    std::lock_guard<std::mutex> lock(g_readerStatisticsMutex);
+    auto& stageStatistics = g_readerStatisticsState.statistics.stages[stage];
+    stageStatistics.count++;
+    stageStatistics.samples += samples;
+    stageStatistics.bytes += bytes;
+    stageStatistics.seconds += TicksToSeconds(ticks);
+
+    if (stage == readerStageLoadChunk)
+        g_readerStatisticsState.chunkLoadTicks.push_back(ticks);
+}
+
+void PERF_PROFILER_API ReaderRandomizationWindow(const long long numChunks, const long long numSamples)
+{
+    if (!g_readerStatisticsEnabled)
+        return;
+
+    std::lock_guard<std::mutex> lock(g_readerStatisticsMutex);
+    auto& statistics = g_readerStatisticsState.statistics;
+    statistics.windowChunks = numChunks;
+    statistics.windowSamples = numSamples;
+    statistics.peakWindowChunks = std::max(statistics.peakWindowChunks, numChunks);
+    statistics.peakWindowSamples = std::max(statistics.peakWindowSamples, numSamples);
+}
+
+
 //
 // Generate reports and release all resources.
 //
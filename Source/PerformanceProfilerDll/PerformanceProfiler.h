@@ -31,6 +31,14 @@
 // The profiler is turned off during the very first epoch to avoid polluting profile data with
 // times that are typically larger (warm-up).
 //
+// Reader statistics
+//
+// The stages of the reader pipeline (chunk loading, randomization, transformation, packing and the
+// transfer into matrices) are recorded as fixed events. In addition they report the number of samples
+// and bytes they produced to the reader statistics, which are collected independently of ProfilerInit()
+// once turned on with ReaderStatisticsEnable(), and can be retrieved at any time. The reader benchmark
+// (Tests/UnitTests/ReaderPerformanceTests) uses them to report per-stage throughput.
+//
 
 #pragma once
 
@@ -73,6 +81,12 @@ enum ProfilerEvents
 
     // Data reader events
     profilerEvtPrefetchMinibatch,           // Prefetching the next minibatch in a background thread
+    profilerEvtReaderPack,                  // Packing sequences into a minibatch, including getting the sequences
+    profilerEvtReaderTransform,             // Getting and transforming sequences
+    profilerEvtReaderRandomize,             // Getting (randomized) sequences from the loaded chunks
+    profilerEvtReaderLoadChunk,             // Loading a chunk from the deserializer, in the background or on demand
+    profilerEvtReaderTransfer,              // Copying a packed minibatch into the prefetch matrices
+    profilerEvtReaderWaitForPrefetch,       // Main thread waiting for the prefetched minibatch
 
     profilerEvtMax
 };
@@ -174,4 +188,73 @@ private:
 
 #define THROUGHPUT_SCOPE(eventId, bytes)    ScopeThroughput __st##eventId(eventId, bytes);
 
+
+//
+// Stages of the reader pipeline. Each stage includes the stages it calls into: packing includes
+// transformation, which includes randomization, which includes loading chunks on demand.
+//
+enum ReaderStage
+{
+    readerStageLoadChunk = 0,               // Deserializer: loading chunks
+    readerStageRandomize,                   // Randomizer: getting sequences from the loaded chunks
+    readerStageTransform,                   // Transformations of the sequences
+    readerStagePack,                        // Packer: packing sequences into minibatches
+    readerStageTransfer,                    // ReaderShim: copying minibatches into matrices
+    readerStageWaitForPrefetch,             // ReaderShim: main thread waiting for the prefetch thread
+
+    readerStageMax
+};
+
+struct ReaderStageStatistics
+{
+    long long       count;                  // number of times the stage was run
+    long long       samples;                // samples produced
+    long long       bytes;                  // bytes produced
+    double          seconds;                // total time
+};
+
+struct ReaderStatistics
+{
+    ReaderStageStatistics stages[readerStageMax];
+
+    // Chunk load latency percentiles (seconds).
+    double          chunkLoadP50;
+    double          chunkLoadP90;
+    double          chunkLoadP99;
+    double          chunkLoadMax;
+
+    // Randomization window, the last reported and the largest one.
+    long long       windowChunks;
+    long long       windowSamples;
+    long long       peakWindowChunks;
+    long long       peakWindowSamples;
+};
+
+
+//
+// Enable/disable the collection of reader statistics. Disabled by default.
+//
+void PERF_PROFILER_API ReaderStatisticsEnable(bool enable);
+bool PERF_PROFILER_API ReaderStatisticsEnabled();
+
+
+//
+// Reset the reader statistics, or retrieve the statistics collected since the last reset.
+//
+void PERF_PROFILER_API ReaderStatisticsReset();
+void PERF_PROFILER_API ReaderStatisticsGet(ReaderStatistics& statistics);
+
+
+//
+// Record a reader stage started with ProfilerTimeBegin(), both as the corresponding fixed event and in the
+// reader statistics. Computing the samples and bytes can be skipped if ReaderStatisticsEnabled() is false.
+//
+void PERF_PROFILER_API ReaderStageEnd(const long long stateId, const ReaderStage stage, const long long samples, const long long bytes);
+
+
+//
+// Record the chunks currently held by a randomizer and the number of samples in them.
+//
+void PERF_PROFILER_API ReaderRandomizationWindow(const long long numChunks, const long long numSamples);
+
 }}}
@@ -68,6 +68,9 @@ BinaryChunkDeserializer::BinaryChunkDeserializer(const BinaryConfigHelper& helpe
     SetTraceLevel(helper.GetTraceLevel());
 
     Initialize(helper.GetRename(), helper.GetElementType());
+
+    if (helper.ShouldMemoryMapChunks())
+        m_mappedFile = make_unique<MemoryMappedFile>(m_filename);
 }
 
 
@@ -196,7 +199,7 @@ void BinaryChunkDeserializer::GetSequencesForChunk(ChunkIdType chunkId, std::vec
     }
 }
 
-unique_ptr<byte[]> BinaryChunkDeserializer::ReadChunk(ChunkIdType chunkId)
+shared_ptr<byte> BinaryChunkDeserializer::ReadChunk(ChunkIdType chunkId)
 {
     // Seek to the start of the data portion in the chunk
     CNTKBinaryFileHelper::SeekOrDie(m_file, m_chunkTable->GetDataStartOffset(chunkId), SEEK_SET);
@@ -211,14 +214,20 @@ unique_ptr<byte[]> BinaryChunkDeserializer::ReadChunk(ChunkIdType chunkId)
     // Read the chunk from disk
     CNTKBinaryFileHelper::ReadOrDie(buffer.get(), sizeof(byte), chunkSize, m_file);
 
-    return buffer;
+    return shared_ptr<byte>(buffer.release(), default_delete<byte[]>());
+}
+
+shared_ptr<byte> BinaryChunkDeserializer::MapChunk(ChunkIdType chunkId)
+{
+    assert(m_mappedFile);
+    return m_mappedFile->MapRegion(m_chunkTable->GetDataStartOffset(chunkId), m_chunkTable->GetChunkSize(chunkId));
 }
 
 
 ChunkPtr BinaryChunkDeserializer::GetChunk(ChunkIdType chunkId)
 {
-    // Read the chunk into memory
-    unique_ptr<byte[]> buffer = ReadChunk(chunkId);
+    // Map the chunk, or read it into memory
+    shared_ptr<byte> buffer = m_mappedFile ? MapChunk(chunkId) : ReadChunk(chunkId);
 
     return make_shared<BinaryDataChunk>(chunkId, m_chunkTable->GetNumSequences(chunkId), std::move(buffer), m_deserializers);
 }
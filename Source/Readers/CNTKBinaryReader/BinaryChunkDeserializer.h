@@ -10,6 +10,7 @@
 #include "CorpusDescriptor.h"
 #include "BinaryDataChunk.h"
 #include "BinaryDataDeserializer.h"
+#include "MemoryMappedFile.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -106,7 +107,10 @@ private:
     void ReadChunkTable(FILE* infile);
 
     // Reads a chunk from disk into buffer
-    unique_ptr<byte[]> ReadChunk(ChunkIdType chunkId);
+    shared_ptr<byte> ReadChunk(ChunkIdType chunkId);
+
+    // Maps a chunk from the input file, no data is copied
+    shared_ptr<byte> MapChunk(ChunkIdType chunkId);
 
     BinaryChunkDeserializer(const wstring& filename);
 
@@ -116,6 +120,9 @@ private:
     const wstring m_filename;
     FILE* m_file;
 
+    // Set if chunks are mapped from the input file rather than read
+    unique_ptr<MemoryMappedFile> m_mappedFile;
+
     int64_t m_headerOffset, m_chunkTableOffset;
 
     std::vector<BinaryDataDeserializerPtr> m_deserializers;
@@ -64,6 +64,8 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
         m_filepath = msra::strfun::utf16(config(L"file"));
         m_keepDataInMemory = config(L"keepDataInMemory", false);
+        m_maxCacheSizeBytes = config(L"maxCacheSizeInBytes", SIZE_MAX); // no limit by default
+        m_memoryMapChunks = config(L"memoryMapChunks", false);
 
         m_randomizationWindow = GetRandomizationWindowFromConfig(config);
         m_sampleBasedRandomizationWindow = config(L"sampleBasedRandomizationWindow", false);
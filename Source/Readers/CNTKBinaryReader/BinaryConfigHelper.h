@@ -34,6 +34,10 @@ public:
 
     bool ShouldKeepDataInMemory() const { return m_keepDataInMemory; }
 
+    size_t GetMaxCacheSize() const { return m_maxCacheSizeBytes; }
+
+    bool ShouldMemoryMapChunks() const { return m_memoryMapChunks; }
+
     ElementType GetElementType() const { return m_elementType; }
 
     DISABLE_COPY_AND_MOVE(BinaryConfigHelper);
@@ -48,6 +52,8 @@ private:
     bool m_sampleBasedRandomizationWindow;
     unsigned int m_traceLevel;
     bool m_keepDataInMemory; // if true the whole dataset is kept in memory
+    size_t m_maxCacheSizeBytes; // limit of the memory used to keep the data (chunks are evicted in LRU order above it)
+    bool m_memoryMapChunks; // if true chunks are mapped from the input file instead of being read into memory
 };
 
 } } }
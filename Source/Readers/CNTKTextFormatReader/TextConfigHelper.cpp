@@ -123,7 +123,10 @@ TextConfigHelper::TextConfigHelper(const ConfigParameters& config)
     m_maxErrors = config(L"maxErrors", 0);
     m_traceLevel = config(L"traceLevel", 1);
     m_chunkSizeBytes = config(L"chunkSizeInBytes", g_32MB); // 32 MB by default
+    m_numIndexingThreads = config(L"numIndexingThreads", 1);
+    m_cacheIndex = config(L"cacheIndex", false);
     m_keepDataInMemory = config(L"keepDataInMemory", false);
+    m_maxCacheSizeBytes = config(L"maxCacheSizeInBytes", SIZE_MAX); // no limit by default
     m_frameMode = config(L"frameMode", false);
 
     m_randomizationWindow = GetRandomizationWindowFromConfig(config);
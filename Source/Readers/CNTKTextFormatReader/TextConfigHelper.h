@@ -37,8 +37,14 @@ public:
 
     size_t GetChunkSize() const { return m_chunkSizeBytes; }
 
+    size_t GetNumIndexingThreads() const { return m_numIndexingThreads; }
+
+    bool ShouldCacheIndex() const { return m_cacheIndex; }
+
     bool ShouldKeepDataInMemory() const { return m_keepDataInMemory; }
 
+    size_t GetMaxCacheSize() const { return m_maxCacheSizeBytes; }
+
     bool IsInFrameMode() const { return m_frameMode; }
 
     ElementType GetElementType() const { return m_elementType; }
@@ -57,7 +63,10 @@ private:
     unsigned int m_maxErrors;
     unsigned int m_traceLevel;
     size_t m_chunkSizeBytes; // chunks size in bytes
+    size_t m_numIndexingThreads; // number of threads used to index the input file (0 = number of cores)
+    bool m_cacheIndex; // if true the index is persisted next to the input file and reused by later runs
     bool m_keepDataInMemory; // if true the whole dataset is kept in memory
+    size_t m_maxCacheSizeBytes; // limit of the memory used to keep the data (chunks are evicted in LRU order above it)
     bool m_frameMode; // if true, the maximum expected sequence length in the dataset is one sample.
 };
 
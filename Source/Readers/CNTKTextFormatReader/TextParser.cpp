@@ -7,6 +7,9 @@
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
 #include <cfloat>
+#if !defined(__aarch64__)
+#include <emmintrin.h>
+#endif
 #include "Indexer.h"
 #include "TextParser.h"
 #include "TextReaderConstants.h"
@@ -21,6 +24,204 @@ inline bool IsDigit(char c)
     return '0' <= c && c <= '9';
 }
 
+// -----------------------------------------------------------------------
+// fast parsing
+// The helpers below scan a part of the input buffer [p, end) 16 bytes at a time (SSE2) and parse
+// the common case of a well-formed token that is followed by a delimiter inside the buffer. Everything else
+// (malformed tokens, tokens that span a buffer refill or the end of a sequence) is left to the
+// character-by-character parsing, which also reports the errors.
+// -----------------------------------------------------------------------
+
+static inline int IndexOfFirstSetBit(int mask)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (int)index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+// Returns the first position in [p, end) that does not hold a decimal digit, or end.
+static inline const char* FindNonDigit(const char* p, const char* end)
+{
+#if !defined(__aarch64__)
+    const __m128i zero = _mm_set1_epi8('0');
+    const __m128i nine = _mm_set1_epi8(9);
+    for (; end - p >= 16; p += 16)
+    {
+        // digits are the bytes for which c - '0' is in [0, 9] as an unsigned value
+        __m128i v = _mm_sub_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), zero);
+        int digits = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(v, nine), v));
+        if (digits != 0xffff)
+            return p + IndexOfFirstSetBit(~digits);
+    }
+#endif
+    while (p != end && IsDigit(*p))
+        ++p;
+    return p;
+}
+
+// Returns the first position in [p, end) that holds either an input name prefix or a row delimiter, or end.
+static inline const char* FindInputOrRowEnd(const char* p, const char* end)
+{
+#if !defined(__aarch64__)
+    const __m128i prefix = _mm_set1_epi8(NAME_PREFIX);
+    const __m128i rowDelimiter = _mm_set1_epi8(ROW_DELIMITER);
+    for (; end - p >= 16; p += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        int found = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, prefix), _mm_cmpeq_epi8(v, rowDelimiter)));
+        if (found)
+            return p + IndexOfFirstSetBit(found);
+    }
+#endif
+    while (p != end && *p != NAME_PREFIX && *p != ROW_DELIMITER)
+        ++p;
+    return p;
+}
+
+// Returns the first position in [p, end) that terminates an input name (a value delimiter,
+// an input name prefix or a non-printable character), or end.
+static inline const char* FindInputNameEnd(const char* p, const char* end)
+{
+#if !defined(__aarch64__)
+    // Value delimiters and non-printable characters are exactly the (signed) chars <= SPACE_CHAR.
+    const __m128i printable = _mm_set1_epi8(SPACE_CHAR + 1);
+    const __m128i prefix = _mm_set1_epi8(NAME_PREFIX);
+    for (; end - p >= 16; p += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        int found = _mm_movemask_epi8(_mm_or_si128(_mm_cmplt_epi8(v, printable), _mm_cmpeq_epi8(v, prefix)));
+        if (found)
+            return p + IndexOfFirstSetBit(found);
+    }
+#endif
+    while (p != end && !isValueDelimiter(*p) && *p != NAME_PREFIX && !isNonPrintable(*p))
+        ++p;
+    return p;
+}
+
+// Parses the run of digits starting at p, returns the position after the run.
+// The value is the same as the one accumulated digit by digit in double precision (number = number * 10 + digit):
+// up to 15 digits all intermediate values are exact, so the run is accumulated as an integer and converted once.
+static inline const char* ParseDigits(const char* p, const char* end, double& number, size_t& numDigits)
+{
+    const char* next = FindNonDigit(p, end);
+    numDigits = next - p;
+    if (numDigits <= 15)
+    {
+        uint64_t integer = 0;
+        for (; p != next; ++p)
+            integer = integer * 10 + (*p - '0');
+        number = static_cast<double>(integer);
+    }
+    else
+    {
+        number = 0;
+        for (; p != next; ++p)
+            number = number * 10 + (*p - '0');
+    }
+    return next;
+}
+
+// Exact powers of ten, a product of repeated multiplications by 10 yields the same values.
+static const double s_powersOf10[] =
+{
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Parses a floating point number at p, which has to be followed by a character that is not part of the number before end.
+// Produces bit-identical values to TextParser::TryReadRealNumber (the same operations are applied in the same order).
+// Returns the position after the number, or nullptr if the number is malformed or not terminated before end.
+template <class ElemType>
+static inline const char* TryParseRealNumber(const char* p, const char* end, ElemType& value)
+{
+    bool negative = false;
+    if (p != end && isSign(*p))
+    {
+        negative = (*p == '-');
+        ++p;
+    }
+
+    if (p == end || !IsDigit(*p))
+        return nullptr;
+
+    double number, coefficient;
+    size_t numDigits;
+    p = ParseDigits(p, end, number, numDigits);
+    if (p == end)
+        return nullptr;
+
+    if (*p == '.')
+    {
+        if (++p == end)
+            return nullptr;
+
+        if (!IsDigit(*p))
+        {
+            value = static_cast<ElemType>((negative) ? -number : number);
+            return p;
+        }
+
+        double fraction, divider;
+        p = ParseDigits(p, end, fraction, numDigits);
+        if (p == end)
+            return nullptr;
+
+        if (numDigits < sizeof(s_powersOf10) / sizeof(s_powersOf10[0]))
+            divider = s_powersOf10[numDigits];
+        else
+            for (divider = 1; numDigits > 0; --numDigits)
+                divider *= 10;
+
+        coefficient = number;
+        coefficient += (fraction / divider);
+        if (!isE(*p))
+        {
+            value = static_cast<ElemType>((negative) ? -coefficient : coefficient);
+            return p;
+        }
+
+        if (negative)
+            coefficient = -coefficient;
+    }
+    else if (isE(*p))
+    {
+        coefficient = (negative) ? -number : number;
+    }
+    else
+    {
+        value = static_cast<ElemType>((negative) ? -number : number);
+        return p;
+    }
+
+    // exponent
+    if (++p == end)
+        return nullptr;
+
+    negative = false;
+    if (isSign(*p))
+    {
+        negative = (*p == '-');
+        if (++p == end)
+            return nullptr;
+    }
+
+    if (!IsDigit(*p))
+        return nullptr;
+
+    p = ParseDigits(p, end, number, numDigits);
+    if (p == end)
+        return nullptr;
+
+    double exponent = (negative) ? -number : number;
+    value = static_cast<ElemType>(coefficient * pow(10.0, exponent));
+    return p;
+}
+
 enum State
 {
     Init = 0,
@@ -64,6 +265,8 @@ TextParser(corpus, helper.GetFilePath(), helper.GetStreams(), primary)
     SetTraceLevel(helper.GetTraceLevel());
     SetMaxAllowedErrors(helper.GetMaxAllowedErrors());
     SetChunkSize(helper.GetChunkSize());
+    SetNumIndexingThreads(helper.GetNumIndexingThreads());
+    SetCacheIndex(helper.ShouldCacheIndex());
     SetSkipSequenceIds(helper.ShouldSkipSequenceIds());
 
     Initialize();
@@ -85,6 +288,9 @@ TextParser<ElemType>::TextParser(CorpusDescriptorPtr corpus, const std::wstring&
     m_bufferEnd(nullptr),
     m_pos(nullptr),
     m_chunkSizeBytes(0),
+    m_numIndexingThreads(1),
+    m_cacheIndex(false),
+    m_fastParsing(true),
     m_traceLevel(TraceLevel::Error),
     m_hadWarnings(false),
     m_numAllowedErrors(0),
@@ -181,6 +387,9 @@ void TextParser<ElemType>::Initialize()
         }
 
         m_indexer = make_unique<Indexer>(m_file, m_primary, m_skipSequenceIds, NAME_PREFIX, m_chunkSizeBytes, mainStreamAlias);
+        m_indexer->SetNumThreads(m_numIndexingThreads);
+        if (m_cacheIndex)
+            m_indexer->EnableCache(m_filename);
         m_indexer->Build(m_corpus);
     });
 
@@ -656,6 +865,24 @@ bool TextParser<ElemType>::TryReadSample(SequenceBuffer& sequence, size_t& bytes
 template <class ElemType>
 bool TextParser<ElemType>::TryGetInputId(size_t& id, size_t& bytesToRead)
 {
+    if (m_fastParsing)
+    {
+        const char* end = ReadLimit(bytesToRead);
+        const char* next = FindInputNameEnd(m_pos, end);
+        if (next != end && next != m_pos)
+        {
+            auto it = m_aliasToIdMap.find(string(m_pos, next));
+            if (it != m_aliasToIdMap.end())
+            {
+                id = it->second;
+                bytesToRead -= next - m_pos;
+                m_pos = next;
+                return true;
+            }
+        }
+        // unknown or invalid names are reported below.
+    }
+
     char* scratchIndex = m_scratch.get();
 
     while (bytesToRead && CanRead())
@@ -946,6 +1173,19 @@ void TextParser<ElemType>::SkipToNextInput(size_t& bytesToRead)
 {
     while (bytesToRead && CanRead())
     {
+        if (m_fastParsing)
+        {
+            const char* end = ReadLimit(bytesToRead);
+            const char* next = FindInputOrRowEnd(m_pos, end);
+            bytesToRead -= next - m_pos;
+            m_pos = next;
+            if (next != end)
+            {
+                return;
+            }
+            continue;
+        }
+
         char c = *m_pos;
         // skip everything until we hit either an input marker or the end of row.
         if (c == NAME_PREFIX || c == ROW_DELIMITER)
@@ -960,6 +1200,24 @@ void TextParser<ElemType>::SkipToNextInput(size_t& bytesToRead)
 template <class ElemType>
 bool TextParser<ElemType>::TryReadUint64(size_t& value, size_t& bytesToRead)
 {
+    if (m_fastParsing)
+    {
+        // up to 19 decimal digits always fit into uint64.
+        const char* end = ReadLimit(bytesToRead);
+        const char* next = FindNonDigit(m_pos, end);
+        size_t numDigits = next - m_pos;
+        if (next != end && numDigits > 0 && numDigits <= 19)
+        {
+            value = 0;
+            for (; m_pos != next; ++m_pos)
+            {
+                value = value * 10 + (*m_pos - '0');
+            }
+            bytesToRead -= numDigits;
+            return true;
+        }
+    }
+
     value = 0;
     bool found = false;
     while (bytesToRead && CanRead())
@@ -1030,6 +1288,18 @@ bool TextParser<ElemType>::TryReadUint64(size_t& value, size_t& bytesToRead)
 template <class ElemType>
 bool TextParser<ElemType>::TryReadRealNumber(ElemType& value, size_t& bytesToRead)
 {
+    if (m_fastParsing)
+    {
+        const char* next = TryParseRealNumber(m_pos, ReadLimit(bytesToRead), value);
+        if (next != nullptr)
+        {
+            bytesToRead -= next - m_pos;
+            m_pos = next;
+            return true;
+        }
+        // malformed or incomplete numbers are handled below.
+    }
+
     State state = State::Init;
     double coefficient = .0, number = .0, divider = .0;
     bool negative = false;
@@ -1285,6 +1555,24 @@ void TextParser<ElemType>::SetChunkSize(size_t size)
     m_chunkSizeBytes = size;
 }
 
+template <class ElemType>
+void TextParser<ElemType>::SetNumIndexingThreads(size_t numThreads)
+{
+    m_numIndexingThreads = numThreads;
+}
+
+template <class ElemType>
+void TextParser<ElemType>::SetCacheIndex(bool cacheIndex)
+{
+    m_cacheIndex = cacheIndex;
+}
+
+template <class ElemType>
+void TextParser<ElemType>::SetFastParsing(bool fastParsing)
+{
+    m_fastParsing = fastParsing;
+}
+
 template <class ElemType>
 void TextParser<ElemType>::SetNumRetries(unsigned int numRetries)
 {
@@ -117,6 +117,9 @@ private:
     unique_ptr<char[]> m_scratch; // local buffer for string parsing
 
     size_t m_chunkSizeBytes;
+    size_t m_numIndexingThreads;
+    bool m_cacheIndex;
+    bool m_fastParsing; // if true, well-formed tokens are scanned and parsed in bulk (with identical results)
     unsigned int m_traceLevel;
     bool m_hadWarnings;
     unsigned int m_numAllowedErrors;
@@ -171,6 +174,9 @@ private:
     // Returns true if there's still data available.
     bool inline CanRead() { return m_pos != m_bufferEnd || TryRefillBuffer(); }
 
+    // Returns the end of the input that can be read without refilling the buffer.
+    const char* ReadLimit(size_t bytesToRead) const { return m_pos + std::min(bytesToRead, static_cast<size_t>(m_bufferEnd - m_pos)); }
+
     // Returns true if the trace level is greater or equal to 'Warning'
     bool inline ShouldWarn() { m_hadWarnings = true; return m_traceLevel >= Warning; }
 
@@ -192,6 +198,12 @@ private:
 
     void SetChunkSize(size_t size);
 
+    void SetNumIndexingThreads(size_t numThreads);
+
+    void SetCacheIndex(bool cacheIndex);
+
+    void SetFastParsing(bool fastParsing);
+
     void SetNumRetries(unsigned int numRetries);
 
     friend class CNTKTextFormatReaderTestRunner<ElemType>;
@@ -106,6 +106,9 @@ CompositeDataReader::CompositeDataReader(const ConfigParameters& config) :
     // It makes sense to put it to true for cases when deserialization is CPU intensive,
     // i.e. decompression of images.
     bool multiThreadedDeserialization = config(L"multiThreadedDeserialization", ContainsDeserializer(config, L"ImageDeserializer"));
+
+    // Opt-in grouping of sequences of similar length into buckets of this many samples, reduces padding in minibatches.
+    size_t lengthBucketSizeInSamples = randomize ? config(L"lengthBucketSizeInSamples", (size_t)0) : 0;
     if (randomize)
     {
         // By default randomizing the whole data set.
@@ -140,7 +143,7 @@ CompositeDataReader::CompositeDataReader(const ConfigParameters& config) :
 
         bool shouldPrefetch = true;
         m_sequenceEnumerator = std::make_shared<BlockRandomizer>(verbosity, randomizationWindow, deserializer, shouldPrefetch, 
-            multiThreadedDeserialization, maxErrors, sampleBasedRandomizationWindow, GetRandomSeed(config));
+            multiThreadedDeserialization, maxErrors, sampleBasedRandomizationWindow, GetRandomSeed(config), lengthBucketSizeInSamples);
     }
     else
     {
@@ -188,7 +191,8 @@ CompositeDataReader::CompositeDataReader(const ConfigParameters& config) :
             m_streams,
             numAlternatingBuffers,
             localTimeline,
-            m_corpus);
+            m_corpus,
+            config(L"reportPaddingRatio", lengthBucketSizeInSamples > 0));
         break;
     case PackingMode::truncated:
     {
@@ -228,6 +232,7 @@ void CompositeDataReader::CreateDeserializers(const ConfigParameters& readerConf
         // TODO: Should go away in the future. Framing can be done on top of deserializers.
         ConfigParameters p = deserializerConfigs[i];
         p.Insert("frameMode", m_packingMode == PackingMode::sample ? "true" : "false");
+        p.Insert("truncated", m_packingMode == PackingMode::truncated ? "true" : "false");
         p.Insert("precision", m_precision);
         if (!traceLevel.empty()) 
         {
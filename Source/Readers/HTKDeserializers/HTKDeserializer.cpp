@@ -5,6 +5,7 @@
 
 #include "stdafx.h"
 #include "HTKDeserializer.h"
+#include "NeighborAugmentation.h"
 #include "ConfigHelper.h"
 #include "Basics.h"
 #include "StringUtil.h"
@@ -27,6 +28,7 @@ HTKDeserializer::HTKDeserializer(
 {
     // TODO: This should be read in one place, potentially given by SGD.
     m_frameMode = (ConfigValue)cfg("frameMode", "true");
+    m_truncated = (ConfigValue)cfg("truncated", "false");
 
     m_verbosity = cfg(L"verbosity", 0);
 
@@ -45,6 +47,8 @@ HTKDeserializer::HTKDeserializer(
         InvalidArgument("Cannot expand utterances of the primary stream %ls, please change your configuration.", inputName.c_str());
     }
 
+    m_expandContextInNetwork = streamConfig(L"expandContextInNetwork", false);
+
     m_elementType = AreEqualIgnoreCase(precision,  L"float") ? ElementType::tfloat : ElementType::tdouble;
     m_dimension = config.GetFeatureDimension();
     m_dimension = m_dimension * (1 + context.first + context.second);
@@ -67,6 +71,7 @@ HTKDeserializer::HTKDeserializer(
     // not in the configuration of a particular deserializer, but on a higher level in the configuration.
     // Because of that we are using find method below.
     m_frameMode = feature.Find("frameMode", "true");
+    m_truncated = feature.Find("truncated", "false");
 
     ConfigHelper config(feature);
     config.CheckFeatureType();
@@ -85,6 +90,8 @@ HTKDeserializer::HTKDeserializer(
         InvalidArgument("Cannot expand utterances of the primary stream %ls, please change your configuration.", featureName.c_str());
     }
 
+    m_expandContextInNetwork = feature(L"expandContextInNetwork", false);
+
     InitializeChunkDescriptions(config);
     InitializeStreams(featureName);
     InitializeFeatureInformation();
@@ -110,6 +117,34 @@ void HTKDeserializer::InitializeAugmentationWindow(const std::pair<size_t, size_
 
         m_augmentationWindow.first = m_augmentationWindow.second = extent;
     }
+
+    // The context is expanded by the network with SpliceContextWindow(x, left, right).
+    if (m_expandContextInNetwork)
+    {
+        const size_t windowSize = 1 + m_augmentationWindow.first + m_augmentationWindow.second;
+        if (m_frameMode || m_truncated)
+        {
+            // The neighbors of a frame are not in the minibatch in frame mode, and those beyond a cut of truncated BPTT are
+            // in another minibatch. The frames of the windows are gathered here then, with the window as the second axis.
+            // Every window is still expanded by the reader, so this saves no reader memory or bandwidth.
+            fprintf(stderr, "HTKDeserializer: stream '%ls' delivers the frames of the context windows as [%zu x %zu] for SpliceContextWindow(x, %zu, %zu, windowedInput=true) in the network (%s). "
+                "The reader still expands every window in this mode, expandContextInNetwork saves no reader memory or bandwidth.\n",
+                m_streams.front()->m_name.c_str(), m_ioFeatureDimension, windowSize, m_augmentationWindow.first, m_augmentationWindow.second,
+                m_frameMode ? "frame mode" : "truncated BPTT");
+
+            m_streams.front()->m_sampleLayout = make_shared<TensorShape>(m_ioFeatureDimension, windowSize);
+        }
+        else
+        {
+            // The reader delivers the frames of the utterance as they are.
+            fprintf(stderr, "HTKDeserializer: stream '%ls' is not expanded by the reader, expand its context with SpliceContextWindow(x, %zu, %zu) in the network\n",
+                m_streams.front()->m_name.c_str(), m_augmentationWindow.first, m_augmentationWindow.second);
+
+            m_dimension = m_ioFeatureDimension;
+            m_streams.front()->m_sampleLayout = make_shared<TensorShape>(m_dimension);
+            m_augmentationWindow = std::make_pair<size_t, size_t>(0, 0);
+        }
+    }
 }
 
 // Initializes chunks based on the configuration and utterance descriptions.
@@ -489,39 +524,6 @@ private:
     std::vector<double> m_buffer;
 };
 
-// Copies a source into a destination with the specified destination offset.
-static void CopyToOffset(const const_array_ref<float>& source, array_ref<float>& destination, size_t offset)
-{
-    size_t sourceSize = source.size() * sizeof(float);
-    memcpy_s((char*)destination.begin() + sourceSize * offset, sourceSize, &source.front(), sourceSize);
-}
-
-// TODO: Move augmentation to the separate class outside of deserializer.
-// TODO: Check the CNTK Book why different left and right extents are not supported.
-// Augments a frame with a given index with frames to the left and right of it.
-static void AugmentNeighbors(const MatrixAsVectorOfVectors& utterance,
-                             size_t frameIndex,
-                             const size_t leftExtent,
-                             const size_t rightExtent,
-                             array_ref<float>& destination)
-{
-    CopyToOffset(utterance[frameIndex], destination, leftExtent);
-
-    for (size_t currentFrame = frameIndex, n = 1; n <= leftExtent; n++)
-    {
-        if (currentFrame > 0)
-            currentFrame--; // index does not move beyond boundary
-        CopyToOffset(utterance[currentFrame], destination, leftExtent - n);
-    }
-
-    for (size_t currentFrame = frameIndex, n = 1; n <= rightExtent; n++)
-    {
-        if (currentFrame + 1 < utterance.size())
-            currentFrame++; // index does not move beyond boundary
-        CopyToOffset(utterance[currentFrame], destination, leftExtent + n);
-    }
-}
-
 // Get a sequence by its chunk id and sequence id.
 // Sequence ids are guaranteed to be unique inside a chunk.
 void HTKDeserializer::GetSequenceById(ChunkIdType chunkId, size_t id, vector<SequenceDataPtr>& r)
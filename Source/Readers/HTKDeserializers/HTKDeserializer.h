@@ -70,6 +70,9 @@ private:
     // Flag that indicates whether a single speech frames should be exposed as a sequence.
     bool m_frameMode;
 
+    // Flag that indicates whether the utterances are cut into pieces for truncated BPTT.
+    bool m_truncated;
+
     // Used to correlate a sequence key with the sequence inside the chunk when deserializer is running not in primary mode.
     // <key, chunkid, offset inside chunk>, sorted by key to be able to retrieve by binary search.
     std::vector<std::tuple<size_t, ChunkIdType, uint32_t>> m_keyToChunkLocation;
@@ -82,6 +85,13 @@ private:
     // A flag that indicates whether the utterance should be extended to match the lenght of the utterance from the primary deserializer.
     // TODO: This should be moved to the packers when deserializers work in sequence mode only.
     bool m_expandToPrimary;
+
+    // A flag that indicates whether the context window is expanded by the network (SpliceContextWindow) instead of the reader.
+    // The stream then has the dimension of a single frame, which cuts the data passed through the reader by the size of the window.
+    // In frame mode and with truncated BPTT the neighbors of a frame are not necessarily in the same minibatch, the reader
+    // then gathers the frames of the windows as a [dimension x window size] tensor that SpliceContextWindow passes through
+    // with windowedInput=true. In these modes the reader still expands every window and nothing is saved.
+    bool m_expandContextInNetwork;
 };
 
 typedef std::shared_ptr<HTKDeserializer> HTKDeserializerPtr;
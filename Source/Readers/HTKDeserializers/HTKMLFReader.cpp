@@ -110,6 +110,9 @@ HTKMLFReader::HTKMLFReader(const ConfigParameters& readerConfig)
     int verbosity = readerConfig(L"verbosity", 0);
     std::wstring readMethod = config.GetRandomizer();
 
+    // Opt-in grouping of sequences of similar length into buckets of this many samples, reduces padding in minibatches.
+    size_t lengthBucketSizeInSamples = readerConfig(L"lengthBucketSizeInSamples", (size_t)0);
+
     // TODO: this should be bool. Change when config per deserializer is allowed.
     if (AreEqualIgnoreCase(readMethod, std::wstring(L"blockRandomize")))
     {
@@ -118,7 +121,8 @@ HTKMLFReader::HTKMLFReader(const ConfigParameters& readerConfig)
             /*multithreadedGetNextSequences =*/ false, // default
             /*maxNumberOfInvalidSequences =*/ 0, // default
             /*sampleBasedRandomizationWindow =*/ true, // default
-            GetRandomSeed(readerConfig));
+            GetRandomSeed(readerConfig),
+            lengthBucketSizeInSamples);
     }
     else if (AreEqualIgnoreCase(readMethod, std::wstring(L"none")))
     {
@@ -160,7 +164,11 @@ HTKMLFReader::HTKMLFReader(const ConfigParameters& readerConfig)
         m_packer = std::make_shared<FramePacker>(m_sequenceEnumerator, m_streams);
         break;
     case PackingMode::sequence:
-        m_packer = std::make_shared<SequencePacker>(m_sequenceEnumerator, m_streams);
+        m_packer = std::make_shared<SequencePacker>(m_sequenceEnumerator, m_streams,
+            /*numberOfBuffers =*/ 2, // default
+            /*useLocalTimeline =*/ false, // default
+            /*corpus =*/ nullptr, // default
+            readerConfig(L"reportPaddingRatio", lengthBucketSizeInSamples > 0));
         break;
     case PackingMode::truncated:
         m_packer = std::make_shared<TruncatedBPTTPacker>(m_sequenceEnumerator, m_streams);
@@ -76,6 +76,9 @@ private:
     size_t m_dimension;
     size_t m_chunkSizeBytes;
 
+    // Persist the index of MLF files next to them and reuse it in later runs.
+    bool m_cacheIndex;
+
     // Track phone boundaries
     bool m_withPhoneBoundaries;
 
@@ -87,17 +87,34 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         return distance(line.begin(), line.end()) == 1 && *line.begin() == '.';
     }
 
+    void MLFIndexer::Build(CorpusDescriptorPtr corpus)
+    {
+        if (!m_index.IsEmpty())
+            return;
+
+        uint32_t flags = 0;
+        if (m_cache && m_cache->TryLoad(corpus, m_index, flags))
+            return;
+
+        BuildIndex(corpus);
+
+        if (m_cache)
+            m_cache->Store(corpus, m_index, !corpus->IsNumericSequenceKeys(), 0);
+    }
+
+    void MLFIndexer::EnableCache(const std::wstring& inputFile)
+    {
+        m_cache = make_shared<IndexCache>(inputFile, "mlf");
+    }
+
     // Building an index of the MLF file:
     //     MLF file -> MLF Header [MLF Utterance]+
     //     MLF Utterance -> Key EOL [Frame Range EOL]+ "." EOL
     // MLF file should start with the MLF header (State::Header -> State:UtteranceKey).
     // Each utterance starts with an utterance key (State::UtteranceKey -> State::UtteranceFrames).
     // End of utterance is indicated by a single dot on a line (State::UtteranceFrames -> State::UtteranceKey)
-    void MLFIndexer::Build(CorpusDescriptorPtr corpus)
+    void MLFIndexer::BuildIndex(CorpusDescriptorPtr corpus)
     {
-        if (!m_index.IsEmpty())
-            return;
-
         m_index.Reserve(filesize(m_file));
 
         RefillBuffer(); // read the first block of data
@@ -9,6 +9,7 @@
 #include <boost/noncopyable.hpp>
 
 #include "Indexer.h"
+#include "IndexCache.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -19,6 +20,9 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
         void Build(CorpusDescriptorPtr corpus);
 
+        // Enables the persistent index cache of the MLF file (see IndexCache.h).
+        void EnableCache(const std::wstring& inputFile);
+
         // Returns input data index (chunk and sequence metadata)
         const Index& GetIndex() const { return m_index; }
 
@@ -40,12 +44,17 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
         Index m_index;
 
+        std::shared_ptr<IndexCache> m_cache;      // Persistent index cache, null if disabled.
+
         std::string m_lastNonEmptyLine;           // Last non empty estring, used for parsing sequence length.
 
         // fills up the buffer with data from file, all previously buffered data
         // will be overwritten.
         void RefillBuffer();
 
+        // Indexes the MLF file.
+        void BuildIndex(CorpusDescriptorPtr corpus);
+
         // Read lines from the buffer.
         void ReadLines(vector<char>& buffer, vector<boost::iterator_range<char*>>& lines);
         bool TryParseSequenceKey(const boost::iterator_range<char*>& line, size_t& id, std::function<size_t(const std::string&)> keyToId);
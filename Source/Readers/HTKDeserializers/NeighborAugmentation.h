@@ -0,0 +1,48 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include "Platform.h"
+#include "simple_checked_arrays.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Copies a source into a destination with the specified destination offset.
+inline void CopyToOffset(const const_array_ref<float>& source, array_ref<float>& destination, size_t offset)
+{
+    size_t sourceSize = source.size() * sizeof(float);
+    memcpy_s((char*)destination.begin() + sourceSize * offset, sourceSize, &source.front(), sourceSize);
+}
+
+// TODO: Check the CNTK Book why different left and right extents are not supported.
+// Augments a frame with a given index with frames to the left and right of it.
+// 'utterance' is a vector of frames: utterance.size() and utterance[j] returning a const_array_ref<float>.
+// This is the context expansion that SpliceContextWindowNode reproduces in the network.
+template <class FrameVector>
+void AugmentNeighbors(const FrameVector& utterance,
+                      size_t frameIndex,
+                      const size_t leftExtent,
+                      const size_t rightExtent,
+                      array_ref<float>& destination)
+{
+    CopyToOffset(utterance[frameIndex], destination, leftExtent);
+
+    for (size_t currentFrame = frameIndex, n = 1; n <= leftExtent; n++)
+    {
+        if (currentFrame > 0)
+            currentFrame--; // index does not move beyond boundary
+        CopyToOffset(utterance[currentFrame], destination, leftExtent - n);
+    }
+
+    for (size_t currentFrame = frameIndex, n = 1; n <= rightExtent; n++)
+    {
+        if (currentFrame + 1 < utterance.size())
+            currentFrame++; // index does not move beyond boundary
+        CopyToOffset(utterance[currentFrame], destination, leftExtent + n);
+    }
+}
+
+}}}
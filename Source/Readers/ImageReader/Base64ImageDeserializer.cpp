@@ -8,6 +8,7 @@
 #include <inttypes.h>
 #include <opencv2/opencv.hpp>
 #include "Base64ImageDeserializer.h"
+#include "ImageDecoder.h"
 #include "ImageTransformers.h"
 #include "ReaderUtil.h"
 
@@ -111,7 +112,7 @@ namespace Microsoft { namespace MSR { namespace CNTK {
             }
             else
             {
-                image = cv::imdecode(decodedImage, m_deserializer.m_grayscale ? cv::IMREAD_GRAYSCALE : cv::IMREAD_COLOR);
+                image = DecodeImage(reinterpret_cast<const unsigned char*>(decodedImage.data()), decodedImage.size(), m_deserializer.m_grayscale, m_deserializer.m_decodeMinSize);
             }
 
             m_deserializer.PopulateSequenceData(image, classId, copyId, { sequence.m_key, 0 }, result);
@@ -20,19 +20,26 @@ using MultiMap = std::map<std::string, std::vector<size_t>>;
 class ByteReader
 {
 public:
-    ByteReader() = default;
+    // Images are decoded at a reduced resolution if their shorter side stays at least
+    // 'decodeMinSize' pixels, see DecodeImage. 0 decodes at full resolution.
+    explicit ByteReader(size_t decodeMinSize = 0) : m_decodeMinSize(decodeMinSize)
+    {}
     virtual ~ByteReader() = default;
 
     virtual void Register(const MultiMap& sequences) = 0;
     virtual cv::Mat Read(size_t seqId, const std::string& path, bool grayscale) = 0;
 
     DISABLE_COPY_AND_MOVE(ByteReader);
+
+protected:
+    size_t m_decodeMinSize;
 };
 
 class FileByteReader : public ByteReader
 {
 public:
-    FileByteReader(const std::string& expandDirectory) : m_expandDirectory(expandDirectory)
+    FileByteReader(const std::string& expandDirectory, size_t decodeMinSize = 0)
+        : ByteReader(decodeMinSize), m_expandDirectory(expandDirectory)
     {}
 
     void Register(const MultiMap&) override {}
@@ -45,7 +52,7 @@ public:
 class ZipByteReader : public ByteReader
 {
 public:
-    ZipByteReader(const std::string& zipPath);
+    ZipByteReader(const std::string& zipPath, size_t decodeMinSize = 0);
 
     void Register(const std::map<std::string, std::vector<size_t>>& sequences) override;
     cv::Mat Read(size_t seqId, const std::string& path, bool grayscale) override;
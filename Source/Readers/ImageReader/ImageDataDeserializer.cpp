@@ -61,6 +61,7 @@ private:
 // that allows composition of deserializers and transforms on inputs.
 ImageDataDeserializer::ImageDataDeserializer(CorpusDescriptorPtr corpus, const ConfigParameters& config, bool primary) : ImageDeserializerBase(corpus, config, primary)
 {
+    CreateDecodedImageCache(config);
     CreateSequenceDescriptions(corpus, config(L"file"), m_labelGenerator->LabelDimension(), m_multiViewCrop);
 }
 
@@ -76,6 +77,9 @@ ImageDataDeserializer::ImageDataDeserializer(const ConfigParameters& config)
     const auto& feature = m_streams[configHelper.GetFeatureStreamId()];
 
     m_verbosity = config(L"verbosity", 0);
+    m_decodeMinSize = config(L"decodeMinSize", (size_t)0);
+    VerifyDecodeMinSize(m_decodeMinSize);
+    CreateDecodedImageCache(config);
 
     string precision = (ConfigValue)config("precision", "float");
     m_precision = AreEqualIgnoreCase(precision, "float") ? ElementType::tfloat : ElementType::tdouble;
@@ -141,7 +145,7 @@ void ImageDataDeserializer::CreateSequenceDescriptions(CorpusDescriptorPtr corpu
 
     // Creating the default reader with expanded directory to the map file.
     auto mapFileDirectory = ExtractDirectory(mapPath);
-    m_defaultReader = make_unique<FileByteReader>(mapFileDirectory);
+    m_defaultReader = make_unique<FileByteReader>(mapFileDirectory, m_decodeMinSize);
 
     size_t numberOfCopies = isMultiCrop ? ImageDeserializerBase::NumMultiViewCopies : 1;
     static_assert(ImageDeserializerBase::NumMultiViewCopies < std::numeric_limits<uint8_t>::max(), "Do not support more than 256 copies.");
@@ -263,7 +267,7 @@ void ImageDataDeserializer::RegisterByteReader(size_t seqId, const std::string&
     auto r = knownReaders.find(containerPath);
     if (r == knownReaders.end())
     {
-        reader = std::make_shared<ZipByteReader>(containerPath);
+        reader = std::make_shared<ZipByteReader>(containerPath, m_decodeMinSize);
         knownReaders[containerPath] = reader;
         readerSequences[containerPath] = MultiMap();
     }
@@ -282,14 +286,34 @@ void ImageDataDeserializer::RegisterByteReader(size_t seqId, const std::string&
 #endif
 }
 
+void ImageDataDeserializer::CreateDecodedImageCache(const ConfigParameters& config)
+{
+    size_t cacheSizeInBytes = config(L"decodedImageCacheSizeInBytes", (size_t)0);
+    if (cacheSizeInBytes == 0)
+        return;
+
+    m_decodedImageCache = make_unique<DecodedImageCache>(cacheSizeInBytes);
+    if (m_verbosity > 0)
+        fprintf(stderr, "ImageDeserializer: Caching up to %.1f MB of decoded images.\n", cacheSizeInBytes / (1024.0 * 1024.0));
+}
+
 cv::Mat ImageDataDeserializer::ReadImage(size_t seqId, const std::string& path, bool grayscale)
 {
     assert(!path.empty());
 
+    cv::Mat image;
+    if (m_decodedImageCache && m_decodedImageCache->TryGet(seqId, image))
+        return image;
+
     ImageDataDeserializer::SeqReaderMap::const_iterator r;
     if (m_readers.empty() || (r = m_readers.find(seqId)) == m_readers.end())
-        return m_defaultReader->Read(seqId, path, grayscale);
-    return (*r).second->Read(seqId, path, grayscale);
+        image = m_defaultReader->Read(seqId, path, grayscale);
+    else
+        image = (*r).second->Read(seqId, path, grayscale);
+
+    if (m_decodedImageCache && image.data)
+        m_decodedImageCache->Add(seqId, image);
+    return image;
 }
 
 cv::Mat FileByteReader::Read(size_t, const std::string& seqPath, bool grayscale)
@@ -297,7 +321,15 @@ cv::Mat FileByteReader::Read(size_t, const std::string& seqPath, bool grayscale)
     assert(!seqPath.empty());
     auto path = Expand3Dots(seqPath, m_expandDirectory);
 
-    return cv::imread(path, grayscale ? cv::IMREAD_GRAYSCALE : cv::IMREAD_COLOR);
+    if (m_decodeMinSize == 0)
+        return cv::imread(path, grayscale ? cv::IMREAD_GRAYSCALE : cv::IMREAD_COLOR);
+
+    // The size of the image has to be known before decoding, so the file is read and decoded from memory.
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return cv::Mat();
+    std::vector<unsigned char> contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return DecodeImage(contents.data(), contents.size(), grayscale, m_decodeMinSize);
 }
 
 bool ImageDataDeserializer::GetSequenceDescriptionByKey(const KeyType& key, SequenceDescription& result)
@@ -8,6 +8,7 @@
 #include "ImageDeserializerBase.h"
 #include "Config.h"
 #include "ByteReader.h"
+#include "ImageDecoder.h"
 #include <unordered_map>
 #include "CorpusDescriptor.h"
 
@@ -68,6 +69,11 @@ private:
     SeqReaderMap m_readers;
 
     std::unique_ptr<FileByteReader> m_defaultReader;
+
+    // Decoded images that are reused across epochs, nullptr if caching is disabled.
+    std::unique_ptr<DecodedImageCache> m_decodedImageCache;
+
+    void CreateDecodedImageCache(const ConfigParameters& config);
 };
 
 }}}
@@ -0,0 +1,224 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+#include <algorithm>
+#include <opencv2/opencv.hpp>
+#include "ImageDecoder.h"
+#include "Basics.h"
+#ifdef USE_LIBJPEG
+#include <csetjmp>
+#include <cstdio>
+#include <jpeglib.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+bool GetJpegDimensions(const unsigned char* data, size_t size, int& width, int& height)
+{
+    // SOI marker.
+    if (size < 4 || data[0] != 0xFF || data[1] != 0xD8)
+        return false;
+
+    size_t pos = 2;
+    while (pos + 4 <= size)
+    {
+        if (data[pos] != 0xFF)
+            return false;
+
+        unsigned char marker = data[pos + 1];
+        pos += 2;
+
+        // Fill bytes and markers without a segment.
+        if (marker == 0xFF)
+        {
+            pos--;
+            continue;
+        }
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD8))
+            continue;
+
+        // Start of scan or end of image before a frame header.
+        if (marker == 0xDA || marker == 0xD9)
+            return false;
+
+        size_t length = ((size_t)data[pos] << 8) | data[pos + 1];
+        if (length < 2)
+            return false;
+
+        // Frame headers SOF0..SOF15, except DHT (C4), JPG (C8) and DAC (CC).
+        if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC)
+        {
+            if (pos + 7 > size)
+                return false;
+
+            height = (data[pos + 3] << 8) | data[pos + 4];
+            width = (data[pos + 5] << 8) | data[pos + 6];
+            return width > 0 && height > 0;
+        }
+
+        pos += length;
+    }
+
+    return false;
+}
+
+int GetReductionFactor(int width, int height, size_t minSize)
+{
+    size_t shorterSide = (size_t)std::min(width, height);
+    int factor = 8;
+    while (factor > 1 && (shorterSide + factor - 1) / factor < minSize)
+        factor /= 2;
+    return factor;
+}
+
+void VerifyDecodeMinSize(size_t minSize)
+{
+#ifndef USE_LIBJPEG
+    if (minSize > 0)
+        InvalidArgument("decodeMinSize requires the image reader to be built with libjpeg (configure --with-libjpeg, not available on Windows), please remove it from the configuration.");
+#else
+    UNUSED(minSize);
+#endif
+}
+
+#ifdef USE_LIBJPEG
+struct JpegErrorManager
+{
+    jpeg_error_mgr m_base;
+    jmp_buf m_jump;
+};
+
+static void OnJpegError(j_common_ptr cinfo)
+{
+    longjmp(reinterpret_cast<JpegErrorManager*>(cinfo->err)->m_jump, 1);
+}
+
+static void IgnoreJpegMessage(j_common_ptr)
+{
+}
+
+// Decodes a JPEG image at 1/factor of its resolution in the DCT domain (the size is rounded up).
+// Returns false if libjpeg cannot decode the image.
+static bool DecodeJpegReduced(const unsigned char* data, size_t size, bool grayscale, int factor, cv::Mat& image)
+{
+    jpeg_decompress_struct cinfo;
+    JpegErrorManager error;
+    cinfo.err = jpeg_std_error(&error.m_base);
+    error.m_base.error_exit = OnJpegError;
+    error.m_base.output_message = IgnoreJpegMessage;
+    if (setjmp(error.m_jump))
+    {
+        jpeg_destroy_decompress(&cinfo);
+        return false;
+    }
+
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, const_cast<unsigned char*>(data), (unsigned long)size);
+    jpeg_read_header(&cinfo, TRUE);
+
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = factor;
+    cinfo.out_color_space = grayscale ? JCS_GRAYSCALE : JCS_RGB;
+    jpeg_start_decompress(&cinfo);
+
+    image.create((int)cinfo.output_height, (int)cinfo.output_width, grayscale ? CV_8UC1 : CV_8UC3);
+    while (cinfo.output_scanline < cinfo.output_height)
+    {
+        JSAMPROW row = image.ptr<JSAMPLE>((int)cinfo.output_scanline);
+        jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+
+    // OpenCV images are BGR.
+    if (!grayscale)
+        cv::cvtColor(image, image, cv::COLOR_RGB2BGR);
+    return true;
+}
+#endif
+
+cv::Mat DecodeImage(const unsigned char* data, size_t size, bool grayscale, size_t minSize)
+{
+    int width, height;
+    int factor = 1;
+    if (minSize > 0 && GetJpegDimensions(data, size, width, height))
+        factor = GetReductionFactor(width, height, minSize);
+
+    if (factor > 1)
+    {
+#ifdef USE_LIBJPEG
+        // libjpeg is used directly rather than through OpenCV, which can only decode at a reduced resolution
+        // from version 3.2, so that the pixels do not depend on the OpenCV version.
+        cv::Mat image;
+        if (DecodeJpegReduced(data, size, grayscale, factor, image))
+            return image;
+        // Images libjpeg cannot convert (e.g. CMYK) are decoded by OpenCV at full resolution.
+#else
+        LogicError("DecodeImage: decoding at a reduced resolution requires the image reader to be built with libjpeg.");
+#endif
+    }
+
+    cv::Mat encoded(1, (int)size, CV_8UC1, const_cast<unsigned char*>(data));
+    return cv::imdecode(encoded, grayscale ? cv::IMREAD_GRAYSCALE : cv::IMREAD_COLOR);
+}
+
+DecodedImageCache::DecodedImageCache(size_t capacityInBytes)
+    : m_capacityInBytes(capacityInBytes), m_sizeInBytes(0), m_isFull(false)
+{
+}
+
+bool DecodedImageCache::TryGet(size_t seqId, cv::Mat& image)
+{
+    cv::Mat cached;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto found = m_images.find(seqId);
+        if (found == m_images.end())
+            return false;
+        cached = found->second;
+    }
+
+    // Transforms modify images in place, cached images are never handed out.
+    image = cached.clone();
+    return true;
+}
+
+void DecodedImageCache::Add(size_t seqId, const cv::Mat& image)
+{
+    size_t size = image.total() * image.elemSize();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_isFull || m_images.find(seqId) != m_images.end())
+            return;
+
+        if (m_sizeInBytes + size <= m_capacityInBytes)
+        {
+            m_sizeInBytes += size;
+            m_images[seqId] = image.clone();
+            return;
+        }
+
+        m_isFull = true;
+    }
+
+    fprintf(stderr, "DecodedImageCache: the cache is full with %zu images (%.1f MB), other images are decoded in every epoch.\n",
+            GetNumImages(), GetSizeInBytes() / (1024.0 * 1024.0));
+}
+
+size_t DecodedImageCache::GetNumImages() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_images.size();
+}
+
+size_t DecodedImageCache::GetSizeInBytes() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_sizeInBytes;
+}
+
+}}}
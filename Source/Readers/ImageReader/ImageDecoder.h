@@ -0,0 +1,62 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <opencv2/core/mat.hpp>
+#include <mutex>
+#include <unordered_map>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Gets the dimensions of a JPEG image from its frame header without decoding it.
+// Returns false if the data is not a JPEG image or the header cannot be found.
+bool GetJpegDimensions(const unsigned char* data, size_t size, int& width, int& height);
+
+// Largest of 1, 2, 4 and 8 that keeps the shorter side at least 'minSize' pixels (rounded up).
+int GetReductionFactor(int width, int height, size_t minSize);
+
+// Decodes an image in any format supported by OpenCV.
+// If 'minSize' is not 0 and the image is a JPEG, it is decoded at 1/2, 1/4 or 1/8 of its resolution
+// in the DCT domain, using the largest reduction that keeps the shorter side at least 'minSize' pixels.
+// This is much cheaper than decoding at full resolution and scaling the image down afterwards.
+// Reduced decoding uses libjpeg (USE_LIBJPEG, set by configure --with-libjpeg). The Windows build does not use
+// libjpeg, so there it is not available, see VerifyDecodeMinSize().
+cv::Mat DecodeImage(const unsigned char* data, size_t size, bool grayscale, size_t minSize);
+
+// Throws if images cannot be decoded at a reduced resolution, because the reader was built without libjpeg.
+void VerifyDecodeMinSize(size_t minSize);
+
+// Cache of decoded images keyed by sequence id, shared across epochs.
+// Images are added until the cache holds 'capacityInBytes' bytes of pixel data. There is no eviction:
+// the sequences are visited in a new random order every epoch, so any eviction policy would only
+// exchange cached images without improving the hit rate.
+// The cache is thread safe.
+class DecodedImageCache
+{
+public:
+    explicit DecodedImageCache(size_t capacityInBytes);
+
+    // Gets a copy of the cached image of the sequence, the caller may modify it.
+    bool TryGet(size_t seqId, cv::Mat& image);
+
+    // Caches a copy of the image if there is space left.
+    void Add(size_t seqId, const cv::Mat& image);
+
+    size_t GetNumImages() const;
+    size_t GetSizeInBytes() const;
+
+private:
+    DecodedImageCache(const DecodedImageCache&) = delete;
+    DecodedImageCache& operator=(const DecodedImageCache&) = delete;
+
+    const size_t m_capacityInBytes;
+    size_t m_sizeInBytes;
+    bool m_isFull;
+    std::unordered_map<size_t, cv::Mat> m_images;
+    mutable std::mutex m_mutex;
+};
+
+}}}
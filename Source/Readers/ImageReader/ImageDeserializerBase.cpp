@@ -10,6 +10,7 @@
 #include "StringUtil.h"
 #include "ConfigUtil.h"
 #include "ImageTransformers.h"
+#include "ImageDecoder.h"
 #include "SequenceData.h"
 #include "ImageUtil.h"
 
@@ -18,7 +19,7 @@ namespace Microsoft { namespace MSR { namespace CNTK {
     ImageDeserializerBase::ImageDeserializerBase() 
         : DataDeserializerBase(true),
           m_precision(ElementType::tfloat),
-          m_grayscale(false), m_verbosity(0), m_multiViewCrop(false)
+          m_grayscale(false), m_verbosity(0), m_multiViewCrop(false), m_decodeMinSize(0)
     {}
 
     ImageDeserializerBase::ImageDeserializerBase(CorpusDescriptorPtr corpus, const ConfigParameters& config, bool primary)
@@ -71,6 +72,11 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         // TODO: multiview should be done on the level of randomizer/transformers - it is responsiblity of the
         // TODO: randomizer to collect how many copies each transform needs and request same sequence several times.
         m_multiViewCrop = config(L"multiViewCrop", false);
+
+        // Images are usually scaled down to a much smaller size by the transforms, JPEG images can be decoded
+        // close to that size instead. Should be at least the target size divided by the smallest crop ratio.
+        m_decodeMinSize = config(L"decodeMinSize", (size_t)0);
+        VerifyDecodeMinSize(m_decodeMinSize);
     }
 
     void ImageDeserializerBase::PopulateSequenceData(
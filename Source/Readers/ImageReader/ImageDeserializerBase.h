@@ -49,6 +49,10 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         // Flag indicating whether to generate images for multi crop.
         bool m_multiViewCrop;
 
+        // Minimal size of the shorter side of JPEG images decoded at a reduced resolution, 0 to decode at full resolution.
+        // Requires libjpeg (configure --with-libjpeg), not available in the Windows build.
+        size_t m_decodeMinSize;
+
         // Corpus descriptor.
         CorpusDescriptorPtr m_corpus;
     };
@@ -6,6 +6,7 @@
 #include "stdafx.h"
 #include <opencv2/opencv.hpp>
 #include "ByteReader.h"
+#include "ImageDecoder.h"
 
 #ifdef USE_ZIP
 #include <File.h>
@@ -21,8 +22,8 @@ std::string GetZipError(int err)
     return errS;
 }
 
-ZipByteReader::ZipByteReader(const std::string& zipPath)
-    : m_zipPath(zipPath)
+ZipByteReader::ZipByteReader(const std::string& zipPath, size_t decodeMinSize)
+    : ByteReader(decodeMinSize), m_zipPath(zipPath)
 {
     assert(!m_zipPath.empty());
 }
@@ -133,7 +134,7 @@ cv::Mat ZipByteReader::Read(size_t seqId, const std::string& path, bool grayscal
     });
     m_zips.push(std::move(zipFile));
 
-    cv::Mat img = cv::imdecode(contents, grayscale ? cv::IMREAD_GRAYSCALE : cv::IMREAD_COLOR);
+    cv::Mat img = DecodeImage(contents.data(), size, grayscale, m_decodeMinSize);
     assert(nullptr != img.data);
     m_workspace.push(std::move(contents));
     return img;
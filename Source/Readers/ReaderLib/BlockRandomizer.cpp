@@ -13,6 +13,8 @@
 
 #include "DataReader.h"
 #include "ExceptionCapture.h"
+#include "ReaderUtil.h"
+#include "PerformanceProfiler.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -24,7 +26,8 @@ BlockRandomizer::BlockRandomizer(
     bool multithreadedGetNextSequence,
     size_t maxNumberOfInvalidSequences,
     bool sampleBasedRandomizationWindow,
-    size_t seedOffset)
+    size_t seedOffset,
+    size_t lengthBucketSizeInSamples)
     : m_verbosity(verbosity),
       m_deserializer(deserializer),
       m_sweep(SIZE_MAX),
@@ -43,7 +46,8 @@ BlockRandomizer::BlockRandomizer(
     m_launchType = shouldPrefetch ? launch::async : launch::deferred;
 
     m_streams = m_deserializer->GetStreamDescriptions();
-    m_sequenceRandomizer = std::make_shared<SequenceRandomizer>(verbosity, m_deserializer, m_chunkRandomizer);
+    m_chunkCache = std::dynamic_pointer_cast<ChunkCache>(m_deserializer);
+    m_sequenceRandomizer = std::make_shared<SequenceRandomizer>(verbosity, m_deserializer, m_chunkRandomizer, lengthBucketSizeInSamples);
 
     // Calculate total number of samples.
     m_sweepSizeInSamples = 0;
@@ -121,6 +125,8 @@ void BlockRandomizer::PrepareNewSweepIfNeeded(size_t samplePosition)
 // Gets next sequences not exceeding global and local sample counts.
 Sequences BlockRandomizer::GetNextSequences(size_t globalSampleCount, size_t localSampleCount)
 {
+    auto profiler = ProfilerTimeBegin();
+
     // Get next sequence descriptions.
     Sequences result;
     size_t numGlobalSamplesLoaded = 0, numLocalSamplesLoaded = 0;
@@ -153,6 +159,11 @@ Sequences BlockRandomizer::GetNextSequences(size_t globalSampleCount, size_t loc
 
     m_cleaner.Clean(result);
 
+    size_t numSamples = 0, sizeInBytes = 0;
+    if (ReaderStatisticsEnabled())
+        GetSequencesSize(m_streams, result, numSamples, sizeInBytes);
+    ReaderStageEnd(profiler, readerStageRandomize, numSamples, sizeInBytes);
+
     return result;
 }
 
@@ -411,7 +422,7 @@ void BlockRandomizer::LoadDataChunks(const ClosedOpenChunkInterval& windowRange)
                 m_prefetch.wait();
             }
 
-            m_chunks[chunk.m_original->m_id] = m_deserializer->GetChunk(chunk.m_original->m_id);
+            m_chunks[chunk.m_original->m_id] = LoadChunk(m_deserializer, m_streams, chunk.m_original->m_id);
             if (m_verbosity >= Information)
                 fprintf(stderr, "BlockRandomizer::RetrieveDataChunks: paged in randomized chunk %u (original chunk: %u), now %" PRIu64 " chunks in memory\n",
                 chunk.m_chunkId,
@@ -425,6 +436,43 @@ void BlockRandomizer::LoadDataChunks(const ClosedOpenChunkInterval& windowRange)
                 m_chunks.size(),
                 m_chunkRandomizer->GetRandomizedChunks()[windowRange.m_begin].m_chunkId,
                 m_chunkRandomizer->GetRandomizedChunks()[windowRange.m_end - 1].m_chunkId);
+
+    if (ReaderStatisticsEnabled())
+    {
+        size_t numSamples = 0;
+        for (size_t i = windowRange.m_begin; i < windowRange.m_end; ++i)
+        {
+            const auto& chunk = m_chunkRandomizer->GetRandomizedChunks()[i];
+            if (m_chunks.find(chunk.m_original->m_id) != m_chunks.end())
+                numSamples += chunk.m_original->m_numberOfSamples;
+        }
+        ReaderRandomizationWindow(m_chunks.size(), numSamples);
+    }
+
+    if (m_chunkCache)
+    {
+        // Let the cache load the chunks the following windows will need (up to the size of the current window)
+        // in the background, in the order in which they enter the window.
+        const auto& randomizedChunks = m_chunkRandomizer->GetRandomizedChunks();
+        std::vector<ChunkIdType> chunksToPrefetch;
+        for (size_t i = windowRange.m_end; i < randomizedChunks.size() && i < windowRange.m_end + windowRange.Size(); ++i)
+        {
+            const auto& chunk = randomizedChunks[i];
+            if (chunk.m_chunkId % m_config.m_numberOfWorkers == m_config.m_workerRank &&
+                m_chunks.find(chunk.m_original->m_id) == m_chunks.end())
+            {
+                chunksToPrefetch.push_back(chunk.m_original->m_id);
+            }
+        }
+        m_chunkCache->Prefetch(chunksToPrefetch);
+
+        if (m_verbosity >= Notification)
+        {
+            auto statistics = m_chunkCache->GetStatistics();
+            fprintf(stderr, "BlockRandomizer::RetrieveDataChunks: chunk cache hits %" PRIu64 ", misses %" PRIu64 ", evictions %" PRIu64 ", prefetched %" PRIu64 "\n",
+                    statistics.m_hits, statistics.m_misses, statistics.m_evictions, statistics.m_prefetches);
+        }
+    }
 }
 
 // Identifies chunk id that should be prefetched.
@@ -459,7 +507,7 @@ void BlockRandomizer::Prefetch(ChunkIdType chunkId)
         }
 
         m_prefetchedChunk = chunkId;
-        m_prefetch = std::async(m_launchType, [this, chunkId]() { return m_deserializer->GetChunk(chunkId); });
+        m_prefetch = std::async(m_launchType, [this, chunkId]() { return LoadChunk(m_deserializer, m_streams, chunkId); });
 
         if (m_verbosity >= Debug)
             fprintf(stderr, "BlockRandomizer::Prefetch: prefetching original chunk: %u\n", chunkId);
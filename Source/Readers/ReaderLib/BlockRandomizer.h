@@ -12,6 +12,7 @@
 #include "ChunkRandomizer.h"
 #include "SequenceRandomizer.h"
 #include "ReaderUtil.h"
+#include "ChunkCache.h"
 #include <future>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
@@ -25,7 +26,7 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 //         1) if a new sweep is entered, randomize chunk descriptions using ChunkRandomizer, also precalculate randomization windows for all
 //            chunk descriptions
 //         2) if a new chunk is entered, using SequenceRandomizer identify a window of chunks and requested their sequence descriptions from deserializer.
-//         3) randomize sequence descriptions inside the window
+//         3) randomize sequence descriptions inside the window (optionally grouping sequences of similar length, see SequenceRandomizer)
 //         4) return sequence descriptions not exceeding sampleCount/minibatch limit
 //         5) decimate sequence descriptions based on the worker rank
 //         6) request chunks of data based on decimated sequences and return sequence data
@@ -36,6 +37,8 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 class BlockRandomizer : public SequenceEnumerator
 {
 public:
+    // With a non-zero lengthBucketSizeInSamples, sequences of similar length are grouped into buckets of about this
+    // number of samples, which reduces the padding in minibatches of sequences of different lengths.
     BlockRandomizer(
         int verbosity,
         size_t randomizationRange,
@@ -44,7 +47,8 @@ public:
         bool multithreadedGetNextSequences = false,
         size_t maxNumberOfInvalidSequences = 0, // per worker
         bool sampleBasedRandomizationWindow = true,
-        size_t seedOffset = 0);
+        size_t seedOffset = 0,
+        size_t lengthBucketSizeInSamples = 0);
 
     // Starts a new epoch.
     virtual void StartEpoch(const EpochConfiguration& config) override;
@@ -160,6 +164,9 @@ private:
     // Prefetched original chunk id.
     ChunkIdType m_prefetchedChunk;
 
+    // The deserializer as a chunk cache (if it is one), used to prefetch the chunks of the next window.
+    std::shared_ptr<ChunkCache> m_chunkCache;
+
     // Current loaded chunks.
     ClosedOpenChunkInterval m_currentWindowRange;
 
@@ -6,21 +6,198 @@
 #define _CRT_SECURE_NO_WARNINGS
 
 #include "ChunkCache.h"
+#include "ReaderUtil.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+ChunkCache::ChunkCache(IDataDeserializerPtr deserializer, size_t maxSizeInBytes, bool prefetch)
+    : m_deserializer(deserializer),
+      m_maxSizeInBytes(maxSizeInBytes),
+      m_statistics(),
+      m_stopPrefetch(false)
+{
+    if (maxSizeInBytes == 0)
+        InvalidArgument("ChunkCache: the size limit must be greater than zero.");
+
+    m_streams = m_deserializer->GetStreamDescriptions();
+    if (prefetch)
+        m_prefetchThread = std::thread([this]() { PrefetchLoop(); });
+}
+
+ChunkCache::~ChunkCache()
+{
+    if (m_prefetchThread.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            m_stopPrefetch = true;
+            m_prefetchQueue.clear();
+        }
+        m_prefetchCondition.notify_one();
+        m_prefetchThread.join();
+    }
+}
+
 ChunkPtr ChunkCache::GetChunk(ChunkIdType chunkId)
 {
-    auto it = m_chunkMap.find(chunkId);
-    if (it != m_chunkMap.end())
+    auto tryGet = [this, chunkId]() -> ChunkPtr
     {
-        return it->second;
+        auto it = m_chunkMap.find(chunkId);
+        if (it == m_chunkMap.end())
+            return nullptr;
+
+        it->second.m_prefetched = false;
+        m_lru.splice(m_lru.begin(), m_lru, it->second.m_position);
+        m_statistics.m_hits++;
+        return it->second.m_chunk;
+    };
+
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        ChunkPtr chunk = tryGet();
+        if (chunk)
+            return chunk;
     }
- 
+
+    // The chunk could be in flight in the prefetch thread, check again once the deserializer is ours.
+    std::lock_guard<std::mutex> loadLock(m_loadLock);
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        ChunkPtr chunk = tryGet();
+        if (chunk)
+            return chunk;
+    }
+
+    size_t sizeInBytes;
+    ChunkPtr chunk = LoadChunk(chunkId, sizeInBytes);
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_statistics.m_misses++;
+    Insert(chunkId, chunk, sizeInBytes, /*prefetched =*/ false, /*evictPrefetched =*/ true);
+    return chunk;
+}
+
+ChunkPtr ChunkCache::LoadChunk(ChunkIdType chunkId, size_t& sizeInBytes)
+{
     ChunkPtr chunk = m_deserializer->GetChunk(chunkId);
-    m_chunkMap[chunkId] = chunk;
- 
+
+    sizeInBytes = 0;
+    if (m_maxSizeInBytes == SIZE_MAX)
+    {
+        // Sizes are only needed to enforce the limit, do not touch the sequences otherwise.
+        return chunk;
+    }
+
+    size_t numSamples;
+    GetChunkSize(m_deserializer, m_streams, chunkId, chunk, numSamples, sizeInBytes);
     return chunk;
 }
 
+bool ChunkCache::Insert(ChunkIdType chunkId, ChunkPtr chunk, size_t sizeInBytes, bool prefetched, bool evictPrefetched)
+{
+    if (m_chunkMap.find(chunkId) != m_chunkMap.end())
+        return true;
+
+    if (m_maxSizeInBytes != SIZE_MAX)
+    {
+        // Collect the victims first, so that nothing is evicted if the chunk does not fit.
+        std::vector<ChunkIdType> victims;
+        size_t sizeAfterEviction = m_statistics.m_sizeInBytes;
+        for (auto it = m_lru.rbegin(); it != m_lru.rend() && sizeAfterEviction + sizeInBytes > m_maxSizeInBytes; ++it)
+        {
+            const auto& cached = m_chunkMap[*it];
+            if (cached.m_prefetched && !evictPrefetched)
+                continue;
+
+            victims.push_back(*it);
+            sizeAfterEviction -= cached.m_sizeInBytes;
+        }
+
+        // On demand everything can be evicted, a single chunk that exceeds the limit on its own
+        // is still kept until the next insertion.
+        if (sizeAfterEviction + sizeInBytes > m_maxSizeInBytes && prefetched)
+            return false;
+
+        for (auto victim : victims)
+        {
+            auto it = m_chunkMap.find(victim);
+            m_lru.erase(it->second.m_position);
+            m_chunkMap.erase(it);
+            m_statistics.m_evictions++;
+        }
+        m_statistics.m_sizeInBytes = sizeAfterEviction + sizeInBytes;
+    }
+
+    m_lru.push_front(chunkId);
+    m_chunkMap[chunkId] = CachedChunk{ chunk, sizeInBytes, prefetched, m_lru.begin() };
+    return true;
+}
+
+void ChunkCache::Prefetch(const std::vector<ChunkIdType>& chunkIds)
+{
+    if (!m_prefetchThread.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_prefetchQueue.clear();
+        for (auto chunkId : chunkIds)
+        {
+            if (m_chunkMap.find(chunkId) == m_chunkMap.end())
+                m_prefetchQueue.push_back(chunkId);
+        }
+    }
+    m_prefetchCondition.notify_one();
+}
+
+void ChunkCache::PrefetchLoop()
+{
+    for (;;)
+    {
+        ChunkIdType chunkId;
+        {
+            std::unique_lock<std::mutex> lock(m_lock);
+            m_prefetchCondition.wait(lock, [this]() { return m_stopPrefetch || !m_prefetchQueue.empty(); });
+            if (m_stopPrefetch)
+                return;
+
+            chunkId = m_prefetchQueue.front();
+            m_prefetchQueue.pop_front();
+        }
+
+        std::lock_guard<std::mutex> loadLock(m_loadLock);
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            if (m_stopPrefetch)
+                return;
+            if (m_chunkMap.find(chunkId) != m_chunkMap.end())
+                continue;
+        }
+
+        try
+        {
+            size_t sizeInBytes;
+            ChunkPtr chunk = LoadChunk(chunkId, sizeInBytes);
+
+            std::lock_guard<std::mutex> lock(m_lock);
+            m_statistics.m_prefetches++;
+            if (!Insert(chunkId, chunk, sizeInBytes, /*prefetched =*/ true, /*evictPrefetched =*/ false))
+            {
+                // The cache is full of chunks that are needed earlier.
+                m_prefetchQueue.clear();
+            }
+        }
+        catch (const std::exception&)
+        {
+            // Nothing to do, the error is reported when the chunk is requested on demand.
+        }
+    }
+}
+
+ChunkCache::Statistics ChunkCache::GetStatistics() const
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_statistics;
+}
+
 } } }
@@ -6,49 +6,121 @@
 #pragma once
 
 #include <map>
+#include <list>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
 #include "DataDeserializer.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
-// A cache to store the complete dataset (all chunks) in memory. The caching can
-// be switched on/off by a boolean flag in the reader config section, independent 
-// of the randomization and chunking parameters. The caching should only be enabled 
-// when the whole dataset fits in memory.
+// A cache to store loaded chunks in memory across sweeps. The caching can
+// be switched on/off by a boolean flag in the reader config section, independent
+// of the randomization and chunking parameters.
 // Implemented as a wrapping proxy around a deserializer that stores pointers to
-// all chunks it sees in an internal map.
+// the chunks it sees in an internal map.
+//
+// By default the cache is unbounded and keeps the complete dataset (all chunks), in which case
+// it should only be enabled when the whole dataset fits in memory. With a size limit the chunks are
+// evicted in the least recently used order once the memory held by the cache exceeds the limit.
+//
+// If prefetching is enabled, a background thread loads the chunks passed to Prefetch() (by the
+// randomizers, in the order they are going to be needed) into the cache ahead of time. Calls to the
+// underlying deserializer are always serialized, the deserializer does not have to be thread safe.
 class ChunkCache : public IDataDeserializer
 {
 public:
+    // Cache statistics, GetChunk() calls are counted as either hits or misses.
+    struct Statistics
+    {
+        size_t m_hits;        // chunks returned from the cache (including the ones loaded by the prefetch thread)
+        size_t m_misses;      // chunks loaded on demand
+        size_t m_evictions;   // chunks evicted because of the size limit
+        size_t m_prefetches;  // chunks loaded by the prefetch thread
+        size_t m_sizeInBytes; // memory currently held by the cache (only tracked with a size limit)
+    };
+
+    // 'maxSizeInBytes' limits the memory held by the cache (SIZE_MAX - no limit).
+    ChunkCache(IDataDeserializerPtr deserializer, size_t maxSizeInBytes = SIZE_MAX, bool prefetch = false);
 
-    ChunkCache(IDataDeserializerPtr deserializer) : m_deserializer(deserializer) { }
+    ~ChunkCache();
 
     virtual std::vector<StreamDescriptionPtr> GetStreamDescriptions() const override
     {
+        std::lock_guard<std::mutex> loadLock(m_loadLock);
         return m_deserializer->GetStreamDescriptions();
     }
 
     virtual ChunkDescriptions GetChunkDescriptions() override
     {
+        std::lock_guard<std::mutex> loadLock(m_loadLock);
         return m_deserializer->GetChunkDescriptions();
     }
 
     virtual void GetSequencesForChunk(ChunkIdType chunkId, std::vector<SequenceDescription>& descriptions) override
     {
+        std::lock_guard<std::mutex> loadLock(m_loadLock);
         return m_deserializer->GetSequencesForChunk(chunkId, descriptions);
     }
 
     virtual bool GetSequenceDescription(const SequenceDescription& primary, SequenceDescription& description) override
     {
+        std::lock_guard<std::mutex> loadLock(m_loadLock);
         return m_deserializer->GetSequenceDescription(primary, description);
     }
 
     // Gets chunk data given its id.
     virtual ChunkPtr GetChunk(ChunkIdType chunkId);
 
+    // Replaces the list of chunks to be loaded by the prefetch thread, in the order they are going to be requested.
+    // Prefetching stops early if a chunk does not fit into the cache without evicting a prefetched chunk
+    // that has not been requested yet. Does nothing if prefetching is disabled.
+    void Prefetch(const std::vector<ChunkIdType>& chunkIds);
+
+    Statistics GetStatistics() const;
+
 private:
-    // A map of currently loaded chunks
-    std::map<size_t, ChunkPtr> m_chunkMap;
+    struct CachedChunk
+    {
+        ChunkPtr m_chunk;
+        size_t m_sizeInBytes;
+        bool m_prefetched; // loaded by the prefetch thread and not requested yet
+        std::list<ChunkIdType>::iterator m_position; // position in the LRU list
+    };
+
+    // Loads the chunk from the deserializer, returns the chunk and its size in bytes.
+    ChunkPtr LoadChunk(ChunkIdType chunkId, size_t& sizeInBytes);
+
+    // Adds a chunk to the cache and evicts the least recently used ones if the size limit is exceeded.
+    // Prefetched chunks that have not been requested yet are only evicted if 'evictPrefetched' is set.
+    // Returns false if the chunk did not fit, the cache is unchanged then. Expects m_lock to be held.
+    bool Insert(ChunkIdType chunkId, ChunkPtr chunk, size_t sizeInBytes, bool prefetched, bool evictPrefetched);
+
+    // Main loop of the prefetch thread.
+    void PrefetchLoop();
+
     IDataDeserializerPtr m_deserializer;
+    std::vector<StreamDescriptionPtr> m_streams;
+    const size_t m_maxSizeInBytes;
+
+    // A map of currently cached chunks
+    std::map<ChunkIdType, CachedChunk> m_chunkMap;
+    // Chunk ids in the order of use, the most recently used chunk first.
+    std::list<ChunkIdType> m_lru;
+    Statistics m_statistics;
+
+    // Chunks to be loaded by the prefetch thread.
+    std::deque<ChunkIdType> m_prefetchQueue;
+    bool m_stopPrefetch;
+    std::thread m_prefetchThread;
+
+    // Protects the cache state above.
+    mutable std::mutex m_lock;
+    std::condition_variable m_prefetchCondition;
+    // Serializes all calls to the underlying deserializer, including the ones that only read descriptions,
+    // because the prefetch thread may be loading a chunk concurrently. Never acquired while holding m_lock.
+    mutable std::mutex m_loadLock;
 
     DISABLE_COPY_AND_MOVE(ChunkCache);
 };
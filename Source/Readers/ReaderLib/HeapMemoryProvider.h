@@ -6,6 +6,7 @@
 #pragma once
 
 #include <algorithm>
+#include <CPUCachingMemAllocator.h>
 #include "MemoryProvider.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
@@ -14,16 +15,30 @@ class HeapMemoryProvider : public MemoryProvider
 {
     static const size_t size_of_first_pointer = sizeof(void*);
 
+    // The caching allocator if it was enabled when the provider was created, the global heap otherwise.
+    MemAllocator* m_allocator;
+
 public:
+    HeapMemoryProvider()
+        : m_allocator(CPUCachingMemAllocator::GetEnabledInstance())
+    {
+    }
+
     virtual void* Alloc(size_t elementSize, size_t numberOfElements) override
     {
+        if (m_allocator)
+            return m_allocator->Malloc(elementSize * numberOfElements);
+
         // Currently not alligned.
         return ::operator new(elementSize * numberOfElements);
     }
 
     virtual void Free(void* p) override
     {
-        ::operator delete(p);
+        if (m_allocator)
+            m_allocator->Free(p);
+        else
+            ::operator delete(p);
     }
 };
 
@@ -0,0 +1,256 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define __STDC_FORMAT_MACROS
+#define _CRT_SECURE_NO_WARNINGS
+#include <inttypes.h>
+#include <sys/stat.h>
+#include "IndexCache.h"
+#include "MemoryMappedFile.h"
+#include "fileutil.h"
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+using std::string;
+using std::wstring;
+
+static const uint64_t IndexCacheMagic = 0x5844494b544e43ull; // "CNTKIDX"
+static const uint32_t IndexCacheVersion = 1;
+
+namespace {
+
+enum class IndexCacheKeys : uint32_t
+{
+    Ids = 0,     // sequence keys are stored as they are
+    Strings = 1, // sequence keys are stored as strings and have to be mapped through the corpus
+};
+
+// Layout of the cache file:
+//   header
+//   description (input file and parameters, header.m_descriptionSize bytes)
+//   header.m_numSequences sequence records, in file order
+//   key strings (32 bit length followed by the characters), only with IndexCacheKeys::Strings
+struct IndexCacheHeader
+{
+    uint64_t m_magic;
+    uint32_t m_version;
+    uint32_t m_flags;
+    uint64_t m_inputSize;
+    int64_t m_inputTime;
+    uint64_t m_numSequences;
+    uint32_t m_keys;
+    uint32_t m_descriptionSize;
+};
+
+struct IndexCacheSequence
+{
+    uint64_t m_offset;
+    uint64_t m_key; // sequence key, or the offset of the key string in the key section
+    uint32_t m_size;
+    uint32_t m_numberOfSamples;
+};
+
+static_assert(sizeof(IndexCacheHeader) == 48 && sizeof(IndexCacheSequence) == 24, "Unexpected padding in the index cache layout.");
+
+}
+
+IndexCache::IndexCache(const wstring& inputFile, const string& parameters)
+    : m_inputFile(inputFile), m_cacheFile(inputFile + L".cntkidx"), m_parameters(parameters)
+{
+}
+
+bool IndexCache::TryGetDescription(CorpusDescriptorPtr corpus, uint64_t& inputSize, int64_t& inputTime, string& description) const
+{
+#ifdef _WIN32
+    struct _stat64 inputStat;
+    if (_wstat64(m_inputFile.c_str(), &inputStat) != 0)
+        return false;
+#else
+    struct stat inputStat;
+    if (stat(msra::strfun::utf8(m_inputFile).c_str(), &inputStat) != 0)
+        return false;
+#endif
+    inputSize = inputStat.st_size;
+    inputTime = inputStat.st_mtime;
+
+    // Symbolic keys are stored as strings, but numeric and hashed keys as ids, so the key mode is part of the description.
+    const char* keys = corpus->IsNumericSequenceKeys() ? "numeric" : (corpus->IsHashedSequenceKeys() ? "hashed" : "symbolic");
+    description = msra::strfun::utf8(m_inputFile) + "\n" + m_parameters + "\nkeys=" + keys;
+    return true;
+}
+
+bool IndexCache::TryLoad(CorpusDescriptorPtr corpus, Index& index, uint32_t& flags)
+{
+    if (!index.IsEmpty())
+        LogicError("Index cache can only be loaded into an empty index.");
+
+    uint64_t inputSize;
+    int64_t inputTime;
+    string description;
+    if (!fexists(m_cacheFile) || !TryGetDescription(corpus, inputSize, inputTime, description))
+        return false;
+
+    std::shared_ptr<byte> data;
+    size_t dataSize = 0;
+    try
+    {
+        // Mapped regions stay valid after the file object is gone.
+        MemoryMappedFile file(m_cacheFile);
+        dataSize = static_cast<size_t>(file.Size());
+        if (dataSize < sizeof(IndexCacheHeader))
+            return false;
+        data = file.MapRegion(0, dataSize);
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "WARNING: Cannot read index cache '%ls', the input will be indexed again: %s\n", m_cacheFile.c_str(), e.what());
+        return false;
+    }
+
+    const char* begin = reinterpret_cast<const char*>(data.get());
+    IndexCacheHeader header;
+    memcpy(&header, begin, sizeof(header));
+    if (header.m_magic != IndexCacheMagic || header.m_version != IndexCacheVersion ||
+        header.m_inputSize != inputSize || header.m_inputTime != inputTime ||
+        header.m_descriptionSize != description.size() ||
+        dataSize - sizeof(header) < description.size() ||
+        memcmp(begin + sizeof(header), description.data(), description.size()) != 0)
+    {
+        // Written for another version of the input or other parameters.
+        return false;
+    }
+
+    const char* sequences = begin + sizeof(header) + description.size();
+    const size_t available = begin + dataSize - sequences;
+    if (header.m_numSequences > available / sizeof(IndexCacheSequence) ||
+        (header.m_keys != (uint32_t)IndexCacheKeys::Ids && header.m_keys != (uint32_t)IndexCacheKeys::Strings))
+    {
+        fprintf(stderr, "WARNING: Index cache '%ls' is corrupted, the input will be indexed again.\n", m_cacheFile.c_str());
+        return false;
+    }
+
+    const bool stringKeys = header.m_keys == (uint32_t)IndexCacheKeys::Strings;
+    const char* keys = sequences + header.m_numSequences * sizeof(IndexCacheSequence);
+    const size_t keysSize = begin + dataSize - keys;
+
+    // Validate all records first, so that neither the index nor the corpus are touched if the cache is corrupted.
+    IndexCacheSequence sequence;
+    for (uint64_t i = 0; i < header.m_numSequences; ++i)
+    {
+        memcpy(&sequence, sequences + i * sizeof(IndexCacheSequence), sizeof(sequence));
+        bool valid = sequence.m_offset <= inputSize && sequence.m_size <= inputSize - sequence.m_offset;
+        if (valid && stringKeys)
+        {
+            uint32_t keySize = 0;
+            valid = sequence.m_key <= keysSize && keysSize - sequence.m_key >= sizeof(keySize);
+            if (valid)
+            {
+                memcpy(&keySize, keys + sequence.m_key, sizeof(keySize));
+                valid = keySize <= keysSize - sequence.m_key - sizeof(keySize);
+            }
+        }
+
+        if (!valid)
+        {
+            fprintf(stderr, "WARNING: Index cache '%ls' is corrupted, the input will be indexed again.\n", m_cacheFile.c_str());
+            return false;
+        }
+    }
+
+    // Keys are mapped in file order, the same order in which the indexer would have seen them.
+    for (uint64_t i = 0; i < header.m_numSequences; ++i)
+    {
+        memcpy(&sequence, sequences + i * sizeof(IndexCacheSequence), sizeof(sequence));
+        size_t key = static_cast<size_t>(sequence.m_key);
+        if (stringKeys)
+        {
+            uint32_t keySize;
+            memcpy(&keySize, keys + sequence.m_key, sizeof(keySize));
+            key = corpus->KeyToId(string(keys + sequence.m_key + sizeof(keySize), keySize));
+        }
+
+        index.AddSequence(SequenceDescriptor{ key, sequence.m_numberOfSamples }, sequence.m_offset, sequence.m_offset + sequence.m_size);
+    }
+
+    flags = header.m_flags;
+    return true;
+}
+
+void IndexCache::Store(CorpusDescriptorPtr corpus, const Index& index, bool symbolicKeys, uint32_t flags)
+{
+    IndexCacheHeader header;
+    string description;
+    if (!TryGetDescription(corpus, header.m_inputSize, header.m_inputTime, description))
+    {
+        fprintf(stderr, "WARNING: Cannot access input file '%ls', index cache is not written.\n", m_inputFile.c_str());
+        return;
+    }
+
+    // Hashed keys do not depend on the order of the keys, they are stored as they are.
+    const bool stringKeys = symbolicKeys && !corpus->IsHashedSequenceKeys();
+
+    std::vector<IndexCacheSequence> sequences;
+    string keys;
+    for (const auto& chunk : index.Chunks())
+    {
+        for (const auto& s : chunk.Sequences())
+        {
+            IndexCacheSequence sequence;
+            sequence.m_offset = chunk.m_offset + s.OffsetInChunk();
+            sequence.m_size = s.SizeInBytes();
+            sequence.m_numberOfSamples = s.m_numberOfSamples;
+            sequence.m_key = s.m_key;
+            if (stringKeys)
+            {
+                string key = corpus->IdToKey(s.m_key);
+                uint32_t keySize = static_cast<uint32_t>(key.size());
+                sequence.m_key = keys.size();
+                keys.append(reinterpret_cast<const char*>(&keySize), sizeof(keySize));
+                keys.append(key);
+            }
+            sequences.push_back(sequence);
+        }
+    }
+
+    header.m_magic = IndexCacheMagic;
+    header.m_version = IndexCacheVersion;
+    header.m_flags = flags;
+    header.m_numSequences = sequences.size();
+    header.m_keys = (uint32_t)(stringKeys ? IndexCacheKeys::Strings : IndexCacheKeys::Ids);
+    header.m_descriptionSize = static_cast<uint32_t>(description.size());
+
+    // The cache is written to a temporary file first, so that other jobs that index the same input
+    // at the same time never see a partially written cache.
+#ifdef _WIN32
+    wstring temporaryFile = m_cacheFile + L"." + std::to_wstring(GetCurrentProcessId()) + L".tmp";
+#else
+    wstring temporaryFile = m_cacheFile + L"." + std::to_wstring(getpid()) + L".tmp";
+#endif
+    FILE* file = nullptr;
+    try
+    {
+        file = fopenOrDie(temporaryFile, L"wb");
+        fwriteOrDie(&header, sizeof(header), 1, file);
+        fwriteOrDie(description.data(), 1, description.size(), file);
+        fwriteOrDie(sequences, file);
+        fwriteOrDie(keys.data(), 1, keys.size(), file);
+        fcloseOrDie(file);
+        file = nullptr;
+        renameOrDie(temporaryFile, m_cacheFile);
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "WARNING: Cannot write index cache '%ls': %s\n", m_cacheFile.c_str(), e.what());
+        if (file != nullptr)
+            fclose(file);
+        if (fexists(temporaryFile))
+            _wunlink(temporaryFile.c_str());
+    }
+}
+
+}}}
@@ -0,0 +1,49 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include "Indexer.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Persistent cache of the index of an input file, so that the input does not have to be scanned again on every run.
+// The cache is a binary sidecar file next to the input ("<input>.cntkidx") that contains the list of sequences
+// in file order (offset, size, number of samples and key). It is only used if it was written for the same input
+// path, size and modification time and with the same indexer parameters, otherwise the input is indexed again and
+// the cache is overwritten. Chunks are not stored, they are recomputed from the sequences for the current chunk size.
+class IndexCache
+{
+public:
+    // 'parameters' describes everything, apart from the input file itself, that affects sequence boundaries,
+    // sample counts or keys (e.g. the main stream or the sequence id mode of the indexer).
+    IndexCache(const std::wstring& inputFile, const std::string& parameters);
+
+    // Fills the (empty) index from the cache file, mapping the cache file into memory.
+    // Returns false if there is no valid cache for the input file, the index is left untouched in this case.
+    // 'flags' receives the value passed to Store().
+    bool TryLoad(CorpusDescriptorPtr corpus, Index& index, uint32_t& flags);
+
+    // Writes the index to the cache file. If 'symbolicKeys' is set, the sequence keys were obtained through
+    // corpus->KeyToId, they are stored as strings and mapped through the corpus again when the cache is loaded.
+    // Failures (e.g. a read-only input directory) are reported as warnings, the cache is simply not written then.
+    void Store(CorpusDescriptorPtr corpus, const Index& index, bool symbolicKeys, uint32_t flags);
+
+    const std::wstring& CacheFile() const { return m_cacheFile; }
+
+private:
+    // Returns the description of the input file and the parameters stored in (and compared against) the cache header.
+    bool TryGetDescription(CorpusDescriptorPtr corpus, uint64_t& inputSize, int64_t& inputTime, std::string& description) const;
+
+    std::wstring m_inputFile;
+    std::wstring m_cacheFile;
+    std::string m_parameters;
+
+    DISABLE_COPY_AND_MOVE(IndexCache);
+};
+
+}}}
@@ -9,24 +9,46 @@
 #include "Indexer.h"
 #include <boost/utility/string_ref.hpp>
 #include <boost/algorithm/string.hpp>
+#include <mutex>
+#include <thread>
+#include "ExceptionCapture.h"
+#include "IndexCache.h"
 
 using std::string;
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// Ranges smaller than this are not worth a separate task (default, see Indexer::SetMinRangeSize()).
+static const size_t ParallelIndexingMinRangeSize = 16 * 1024 * 1024;
+// Number of ranges per thread, more ranges balance the load better if lines are scanned at different speeds.
+static const size_t ParallelIndexingRangesPerThread = 4;
+
 Indexer::Indexer(FILE* file, bool primary, bool skipSequenceIds, char streamPrefix, size_t chunkSize, const std::string& mainStream, size_t bufferSize) :
     m_streamPrefix(streamPrefix),
     m_buffer(bufferSize, !mainStream.empty()),
+    m_bufferSize(bufferSize),
     m_file(file),
     m_hasSequenceIds(!skipSequenceIds),
     m_index(chunkSize, primary),
-    m_mainStream(mainStream)
+    m_mainStream(mainStream),
+    m_numThreads(1),
+    m_minRangeSize(ParallelIndexingMinRangeSize)
 {
     if (m_file == nullptr)
         RuntimeError("Input file not open for reading");
     m_fileSize = filesize(file);
 }
 
+void Indexer::SetNumThreads(size_t numThreads)
+{
+    m_numThreads = numThreads > 0 ? numThreads : std::max(1u, std::thread::hardware_concurrency());
+}
+
+void Indexer::SetMinRangeSize(size_t minRangeSize)
+{
+    m_minRangeSize = std::max<size_t>(1, minRangeSize);
+}
+
 void Indexer::BuildFromLines()
 {
     m_hasSequenceIds = false;
@@ -52,6 +74,17 @@ void Indexer::BuildFromLines()
     }
 }
 
+void Indexer::EnableCache(const std::wstring& inputFile)
+{
+    // Everything that affects sequence boundaries, sample counts or keys. The chunk size does not,
+    // chunks are recomputed when the cache is loaded.
+    std::string parameters = "ctf"
+        ";skipSequenceIds=" + std::to_string(!m_hasSequenceIds) +
+        ";streamPrefix=" + std::string(1, m_streamPrefix) +
+        ";mainStream=" + m_mainStream;
+    m_cache = std::make_shared<IndexCache>(inputFile, parameters);
+}
+
 void Indexer::Build(CorpusDescriptorPtr corpus)
 {
     if (!m_index.IsEmpty())
@@ -59,6 +92,31 @@ void Indexer::Build(CorpusDescriptorPtr corpus)
         return;
     }
 
+    // Flags stored in the index cache.
+    const uint32_t hasSequenceIdsFlag = 1;
+
+    uint32_t flags = 0;
+    if (m_cache && m_cache->TryLoad(corpus, m_index, flags))
+    {
+        m_hasSequenceIds = (flags & hasSequenceIdsFlag) != 0;
+        m_index.MapSequenceKeyToLocation();
+        // Leave the file at the same position as after indexing.
+        fsetpos(m_file, m_fileSize);
+        return;
+    }
+
+    BuildIndex(corpus);
+
+    if (m_cache)
+    {
+        // Without sequence ids the keys are line numbers, otherwise they come from the corpus.
+        bool symbolicKeys = m_hasSequenceIds && !corpus->IsNumericSequenceKeys();
+        m_cache->Store(corpus, m_index, symbolicKeys, m_hasSequenceIds ? hasSequenceIdsFlag : 0);
+    }
+}
+
+void Indexer::BuildIndex(CorpusDescriptorPtr corpus)
+{
     // Create a lambda to read symbolic or numeric sequence ids,
     // depending on what the corpus expects.
     std::function<bool(size_t&)> tryGetSequenceId;
@@ -85,7 +143,17 @@ void Indexer::Build(CorpusDescriptorPtr corpus)
             RuntimeError("Corpus expects non-numeric sequence keys present but the input file does not have them."
                 "Please use the configuration to enable numeric keys instead.");
 
-        BuildFromLines();
+        if (m_numThreads > 1)
+            BuildInParallel(corpus, m_buffer.GetFileOffset(), /*fromLines=*/true);
+        else
+            BuildFromLines();
+        m_index.MapSequenceKeyToLocation();
+        return;
+    }
+
+    if (m_numThreads > 1)
+    {
+        BuildInParallel(corpus, m_buffer.GetFileOffset(), /*fromLines=*/false);
         m_index.MapSequenceKeyToLocation();
         return;
     }
@@ -131,6 +199,247 @@ void Indexer::Build(CorpusDescriptorPtr corpus)
     m_index.MapSequenceKeyToLocation();
 }
 
+// -----------------------------------------------------------------------
+// parallel indexing
+// -----------------------------------------------------------------------
+
+namespace {
+
+// Reads complete lines from the byte range [begin, end) of a file that is shared with other threads.
+// The range is expected to start at the beginning of a line, lines are returned including the trailing new line (if any).
+class RangeLineReader
+{
+public:
+    RangeLineReader(FILE* file, std::mutex& fileLock, int64_t begin, int64_t end, size_t bufferSize)
+        : m_file(file), m_fileLock(fileLock), m_nextReadOffset(begin), m_end(end),
+          m_data(bufferSize), m_dataOffset(begin), m_pos(0), m_size(0)
+    {
+    }
+
+    // Returns false at the end of the range, otherwise [line, lineEnd) is the next line and 'offset' is where it starts in the file.
+    bool NextLine(const char*& line, const char*& lineEnd, int64_t& offset)
+    {
+        for (;;)
+        {
+            const char* begin = m_data.data() + m_pos;
+            const char* end = m_data.data() + m_size;
+            const char* newLine = (const char*)memchr(begin, g_rowDelimiter, end - begin);
+            if (newLine || (m_nextReadOffset == m_end && begin != end)) // the last line of the file may not be terminated
+            {
+                line = begin;
+                lineEnd = newLine ? newLine + 1 : end;
+                offset = m_dataOffset + m_pos;
+                m_pos = lineEnd - m_data.data();
+                return true;
+            }
+
+            if (m_nextReadOffset == m_end)
+                return false;
+
+            // Keep the partial line, growing the buffer if it does not leave space for new data.
+            m_size -= m_pos;
+            memmove(m_data.data(), begin, m_size);
+            m_dataOffset += m_pos;
+            m_pos = 0;
+            if (m_size == m_data.size())
+                m_data.resize(2 * m_data.size());
+
+            size_t count = (size_t)std::min<int64_t>(m_data.size() - m_size, m_end - m_nextReadOffset);
+            {
+                std::lock_guard<std::mutex> lock(m_fileLock);
+                fsetpos(m_file, m_nextReadOffset);
+                freadOrDie(m_data.data() + m_size, 1, count, m_file);
+            }
+            m_nextReadOffset += count;
+            m_size += count;
+        }
+    }
+
+private:
+    FILE* m_file;
+    std::mutex& m_fileLock;
+    int64_t m_nextReadOffset;
+    const int64_t m_end;
+
+    std::vector<char> m_data;
+    int64_t m_dataOffset; // file offset of m_data[0]
+    size_t m_pos;         // current position in m_data
+    size_t m_size;        // number of valid bytes in m_data
+};
+
+// Consecutive lines of a range that have the same sequence id (or no sequence id at all, if m_hasId is false,
+// in which case they belong to the sequence that precedes them).
+struct LineRun
+{
+    int64_t m_offset;
+    uint32_t m_numberOfSamples;
+    bool m_hasId;
+    size_t m_id;       // numeric sequence id
+    std::string m_key; // symbolic sequence key, mapped to an id when the ranges are merged
+};
+
+}
+
+int64_t Indexer::FindLineStart(int64_t offset)
+{
+    // Look for the new line that terminates the line containing offset - 1.
+    std::vector<char> buffer(64 * 1024);
+    int64_t position = offset - 1;
+    while (position < m_fileSize)
+    {
+        size_t count = (size_t)std::min<int64_t>(buffer.size(), m_fileSize - position);
+        fsetpos(m_file, position);
+        freadOrDie(buffer.data(), 1, count, m_file);
+        const char* newLine = (const char*)memchr(buffer.data(), g_rowDelimiter, count);
+        if (newLine)
+            return position + (newLine - buffer.data()) + 1;
+        position += count;
+    }
+    return m_fileSize;
+}
+
+void Indexer::BuildInParallel(CorpusDescriptorPtr corpus, int64_t startOffset, bool fromLines)
+{
+    if (fromLines)
+        m_hasSequenceIds = false;
+
+    // Split the file into ranges of about equal size, and move each boundary to the start of a line,
+    // so that every line is scanned by exactly one range.
+    size_t numRanges = (size_t)std::max<int64_t>(1, std::min<int64_t>(m_numThreads * ParallelIndexingRangesPerThread, (m_fileSize - startOffset) / (int64_t)m_minRangeSize));
+    std::vector<int64_t> rangeStarts(numRanges + 1);
+    rangeStarts[0] = startOffset;
+    for (size_t i = 1; i < numRanges; i++)
+        rangeStarts[i] = std::max(rangeStarts[i - 1], FindLineStart(startOffset + (m_fileSize - startOffset) * (int64_t)i / (int64_t)numRanges));
+    rangeStarts[numRanges] = m_fileSize;
+
+    const bool numericKeys = corpus->IsNumericSequenceKeys();
+    std::mutex fileLock;
+    std::vector<std::vector<LineRun>> runs(numRanges);     // per range, if !fromLines
+    std::vector<std::vector<int64_t>> lines(numRanges);    // per range, if fromLines
+
+    // Scans a single range. Mirrors the line handling of Build() and BuildFromLines().
+    auto indexRange = [&](int rangeIndex)
+    {
+        RangeLineReader reader(m_file, fileLock, rangeStarts[rangeIndex], rangeStarts[rangeIndex + 1], m_bufferSize);
+        const char* line;
+        const char* lineEnd;
+        int64_t offset;
+        if (fromLines)
+        {
+            while (reader.NextLine(line, lineEnd, offset))
+                lines[rangeIndex].push_back(offset);
+            return;
+        }
+
+        auto& rangeRuns = runs[rangeIndex];
+        while (reader.NextLine(line, lineEnd, offset))
+        {
+            // Try to get the sequence id at the start of the line.
+            const char* idEnd = line;
+            size_t id = 0;
+            if (numericKeys)
+            {
+                for (; idEnd != lineEnd && isdigit(*idEnd); ++idEnd)
+                {
+                    size_t temp = id;
+                    id = id * 10 + (*idEnd - '0');
+                    if (temp > id)
+                        RuntimeError("Overflow while reading a numeric sequence id (%zu-bit value).", sizeof(id));
+                }
+            }
+            else
+            {
+                while (idEnd != lineEnd && !isspace(*idEnd))
+                    ++idEnd;
+            }
+
+            // An id that runs into the end of file does not count, and neither does the rest of this (last) line.
+            if (idEnd == lineEnd)
+                continue;
+
+            bool hasId = idEnd != line;
+            uint32_t numberOfSamples = 1;
+            if (!m_mainStream.empty())
+            {
+                boost::string_ref s(idEnd, lineEnd - idEnd);
+                numberOfSamples = s.find(m_mainStream) != boost::string_ref::npos ? 1 : 0;
+            }
+
+            bool sameRun = !rangeRuns.empty() && (!hasId ||
+                (rangeRuns.back().m_hasId &&
+                 (numericKeys ? rangeRuns.back().m_id == id : boost::string_ref(rangeRuns.back().m_key) == boost::string_ref(line, idEnd - line))));
+            if (sameRun)
+            {
+                rangeRuns.back().m_numberOfSamples += numberOfSamples;
+                continue;
+            }
+
+            rangeRuns.push_back(LineRun{ offset, numberOfSamples, hasId, id, numericKeys || !hasId ? std::string() : std::string(line, idEnd) });
+        }
+    };
+
+    ExceptionCapture capture;
+#pragma omp parallel for schedule(dynamic) num_threads((int)m_numThreads)
+    for (int i = 0; i < (int)numRanges; ++i)
+        capture.SafeRun(indexRange, i);
+    capture.RethrowIfHappened();
+
+    // Merge the ranges in file order, adding the sequences to the index exactly as Build() would.
+    if (fromLines)
+    {
+        size_t lineNumber = 0;
+        for (size_t i = 0; i < numRanges; i++)
+        {
+            for (size_t j = 0; j < lines[i].size(); j++, lineNumber++)
+            {
+                int64_t endOffset = j + 1 < lines[i].size() ? lines[i][j + 1] : rangeStarts[i + 1];
+                m_index.AddSequence(SequenceDescriptor{ lineNumber, 1 }, lines[i][j], endOffset);
+            }
+            std::vector<int64_t>().swap(lines[i]);
+        }
+        fsetpos(m_file, m_fileSize);
+        return;
+    }
+
+    bool first = true;
+    size_t previousId = 0;
+    int64_t sequenceOffset = startOffset;
+    uint32_t numberOfSamples = 0;
+    for (size_t i = 0; i < numRanges; i++)
+    {
+        for (const auto& run : runs[i])
+        {
+            if (!run.m_hasId)
+            {
+                if (first)
+                    RuntimeError("Expected a sequence id at the offset %" PRIi64 ", none was found.", run.m_offset);
+                numberOfSamples += run.m_numberOfSamples;
+                continue;
+            }
+
+            size_t id = numericKeys ? run.m_id : corpus->KeyToId(run.m_key);
+            if (first || id != previousId)
+            {
+                if (!first)
+                    m_index.AddSequence(SequenceDescriptor{ previousId, numberOfSamples }, sequenceOffset, run.m_offset);
+                first = false;
+                sequenceOffset = run.m_offset;
+                previousId = id;
+                numberOfSamples = 0;
+            }
+            numberOfSamples += run.m_numberOfSamples;
+        }
+        std::vector<LineRun>().swap(runs[i]);
+    }
+
+    if (first)
+        RuntimeError("Expected a sequence id at the offset %" PRIi64 ", none was found.", startOffset);
+    m_index.AddSequence(SequenceDescriptor{ previousId, numberOfSamples }, sequenceOffset, m_fileSize);
+
+    // leave the file at the end, as the serial indexer does
+    fsetpos(m_file, m_fileSize);
+}
+
 void Indexer::SkipLine()
 {
     while (!m_buffer.Eof())
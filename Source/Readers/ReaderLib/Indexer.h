@@ -6,6 +6,7 @@
 #pragma once
 
 #include <stdint.h>
+#include <memory>
 #include <vector>
 #include "DataDeserializer.h"
 #include "CorpusDescriptor.h"
@@ -179,6 +180,8 @@ public:
     DISABLE_COPY_AND_MOVE(Index);
 };
 
+class IndexCache;
+
 // A helper class that does a pass over the input file building up
 // an index consisting of sequence and chunk descriptors (which among 
 // others specify size and file offset of the respective structure).
@@ -193,6 +196,19 @@ public:
     // sequences.
     void Build(CorpusDescriptorPtr corpus);
 
+    // Sets the number of threads used to build the index (0 = number of cores).
+    // With more than one thread, large files are split into byte ranges that are scanned concurrently.
+    // The resulting index is identical to the one built by a single thread.
+    void SetNumThreads(size_t numThreads);
+
+    // Sets the smallest byte range that is indexed as a separate task when indexing in parallel (16MB by default).
+    // Files with less than this many bytes per thread use fewer ranges.
+    void SetMinRangeSize(size_t minRangeSize);
+
+    // Enables the persistent index cache of the input file (see IndexCache.h). Build() then restores
+    // the index from the cache when it is valid, otherwise indexes the input and writes the cache.
+    void EnableCache(const std::wstring& inputFile);
+
     // Returns input data index (chunk and sequence metadata)
     const Index& GetIndex() const { return m_index; }
 
@@ -210,6 +226,7 @@ private:
     FILE* m_file;
     int64_t m_fileSize;
     MemoryBuffer m_buffer;
+    size_t m_bufferSize;
     bool m_hasSequenceIds; // true, when input contains one sequence per line 
                            // or when sequence id column was ignored during indexing.
 
@@ -221,6 +238,18 @@ private:
 
     const char m_streamPrefix;
 
+    // Number of threads used by Build().
+    size_t m_numThreads;
+
+    // Smallest byte range indexed as a separate task by BuildInParallel().
+    size_t m_minRangeSize;
+
+    // Persistent index cache, null if disabled.
+    std::shared_ptr<IndexCache> m_cache;
+
+    // Indexes the input file.
+    void BuildIndex(CorpusDescriptorPtr corpus);
+
     // Moves the buffer position to the beginning of the next line.
     void SkipLine();
 
@@ -244,6 +273,14 @@ private:
     // the corresponding sequence id.
     void BuildFromLines();
 
+    // Same as Build() (or BuildFromLines(), if fromLines is set) for the part of the file starting at 'startOffset',
+    // but the file is split into byte ranges that are indexed on m_numThreads threads. The results of all ranges
+    // are then merged in file order.
+    void BuildInParallel(CorpusDescriptorPtr corpus, int64_t startOffset, bool fromLines);
+
+    // Returns the offset of the first line that starts at or after 'offset'.
+    int64_t FindLineStart(int64_t offset);
+
     DISABLE_COPY_AND_MOVE(Indexer);
 };
 
@@ -0,0 +1,116 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define __STDC_FORMAT_MACROS
+#define _CRT_SECURE_NO_WARNINGS
+#include <inttypes.h>
+#include "MemoryMappedFile.h"
+#include <errno.h>
+#include <string.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+#ifdef _WIN32
+
+MemoryMappedFile::MemoryMappedFile(const std::wstring& filename)
+    : m_filename(filename), m_file(INVALID_HANDLE_VALUE), m_mapping(NULL)
+{
+    m_file = CreateFileW(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (m_file == INVALID_HANDLE_VALUE)
+        RuntimeError("Error opening file '%ls' for memory mapping: %d.", filename.c_str(), (int)GetLastError());
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(m_file, &fileSize))
+        RuntimeError("Error getting the size of file '%ls': %d.", filename.c_str(), (int)GetLastError());
+    m_fileSize = fileSize.QuadPart;
+
+    m_mapping = CreateFileMappingW(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (m_mapping == NULL)
+        RuntimeError("Error memory mapping file '%ls': %d.", filename.c_str(), (int)GetLastError());
+
+    SYSTEM_INFO systemInfo;
+    GetSystemInfo(&systemInfo);
+    m_alignment = systemInfo.dwAllocationGranularity;
+}
+
+MemoryMappedFile::~MemoryMappedFile()
+{
+    // Mapped views keep their own reference to the mapping, so outstanding regions stay valid.
+    if (m_mapping != NULL)
+        CloseHandle(m_mapping);
+    if (m_file != INVALID_HANDLE_VALUE)
+        CloseHandle(m_file);
+}
+
+#else
+
+MemoryMappedFile::MemoryMappedFile(const std::wstring& filename)
+    : m_filename(filename), m_file(-1)
+{
+    m_file = open(msra::strfun::utf8(filename).c_str(), O_RDONLY);
+    if (m_file < 0)
+        RuntimeError("Error opening file '%ls' for memory mapping: %s.", filename.c_str(), strerror(errno));
+
+    struct stat fileStat;
+    if (fstat(m_file, &fileStat) != 0)
+    {
+        close(m_file);
+        RuntimeError("Error getting the size of file '%ls': %s.", filename.c_str(), strerror(errno));
+    }
+    m_fileSize = fileStat.st_size;
+
+    m_alignment = (size_t)sysconf(_SC_PAGESIZE);
+}
+
+MemoryMappedFile::~MemoryMappedFile()
+{
+    // Mappings do not depend on the file descriptor, so outstanding regions stay valid.
+    if (m_file >= 0)
+        close(m_file);
+}
+
+#endif
+
+std::shared_ptr<byte> MemoryMappedFile::MapRegion(int64_t offset, size_t size)
+{
+    if (offset < 0 || offset + (int64_t)size > m_fileSize)
+        RuntimeError("Requested region (offset %" PRId64 ", size %" PRIu64 ") is outside of file '%ls'.",
+                     offset, (uint64_t)size, m_filename.c_str());
+
+    // The mapping has to start at an aligned offset, so map a few extra bytes in front of the region.
+    int64_t alignedOffset = offset - offset % (int64_t)m_alignment;
+    size_t padding = (size_t)(offset - alignedOffset);
+    size_t mappedSize = size + padding;
+    if (mappedSize == 0)
+        return std::shared_ptr<byte>();
+
+#ifdef _WIN32
+    void* mapped = MapViewOfFile(m_mapping, FILE_MAP_READ, (DWORD)(alignedOffset >> 32), (DWORD)(alignedOffset & 0xffffffff), mappedSize);
+    if (mapped == NULL)
+        RuntimeError("Error mapping region (offset %" PRId64 ", size %" PRIu64 ") of file '%ls': %d.",
+                     offset, (uint64_t)size, m_filename.c_str(), (int)GetLastError());
+    auto unmap = [mapped](byte*) { UnmapViewOfFile(mapped); };
+#else
+    void* mapped = mmap(nullptr, mappedSize, PROT_READ, MAP_SHARED, m_file, (off_t)alignedOffset);
+    if (mapped == MAP_FAILED)
+        RuntimeError("Error mapping region (offset %" PRId64 ", size %" PRIu64 ") of file '%ls': %s.",
+                     offset, (uint64_t)size, m_filename.c_str(), strerror(errno));
+
+    // Start asynchronous readahead of the whole region. Regions are mapped when the randomizer pages in
+    // or prefetches a chunk, so the readahead follows the randomization window.
+    madvise(mapped, mappedSize, MADV_WILLNEED);
+    auto unmap = [mapped, mappedSize](byte*) { munmap(mapped, mappedSize); };
+#endif
+
+    return std::shared_ptr<byte>((byte*)mapped + padding, unmap);
+}
+
+}}}
@@ -0,0 +1,46 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <stdint.h>
+#include "Basics.h"
+#include "basetypes.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Read-only memory mapping of an input file.
+// Regions of the file are mapped on demand, and each region is owned by the shared pointer returned from MapRegion(),
+// so a region stays valid until its last reference is released, even after the MemoryMappedFile itself is gone.
+class MemoryMappedFile
+{
+public:
+    explicit MemoryMappedFile(const std::wstring& filename);
+    ~MemoryMappedFile();
+
+    // Maps 'size' bytes starting at 'offset' and returns a pointer to the first of them.
+    // The kernel is asked to start reading the region in (readahead), but the call does not wait for it.
+    std::shared_ptr<byte> MapRegion(int64_t offset, size_t size);
+
+    int64_t Size() const { return m_fileSize; }
+
+    DISABLE_COPY_AND_MOVE(MemoryMappedFile);
+
+private:
+    std::wstring m_filename;
+    int64_t m_fileSize;
+    // Mapped regions have to start at a multiple of this.
+    size_t m_alignment;
+#ifdef _WIN32
+    HANDLE m_file;
+    HANDLE m_mapping;
+#else
+    int m_file;
+#endif
+};
+
+}}}
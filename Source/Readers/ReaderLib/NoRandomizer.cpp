@@ -9,12 +9,18 @@
 #include "NoRandomizer.h"
 #include "DataReader.h"
 #include "ExceptionCapture.h"
+#include "ReaderUtil.h"
+#include "PerformanceProfiler.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// Number of chunks following the current one that are prefetched into the chunk cache.
+static const ChunkIdType NumChunksToPrefetch = 2;
+
     NoRandomizer::NoRandomizer(IDataDeserializerPtr deserializer, bool multithreadedGetNextSequences, size_t maxNumberOfInvalidSequences)
     : m_deserializer(deserializer),
       m_currentChunkPosition(CHUNKID_MAX),
+      m_prefetchPosition(CHUNKID_MAX),
       m_globalSamplePosition(0),
       m_globalSequencePosition(0),
       m_sweepSizeInSamples(0),
@@ -25,6 +31,7 @@ namespace Microsoft { namespace MSR { namespace CNTK {
     assert(deserializer != nullptr);
     m_streams = m_deserializer->GetStreamDescriptions();
     m_chunkDescriptions = m_deserializer->GetChunkDescriptions();
+    m_chunkCache = std::dynamic_pointer_cast<ChunkCache>(m_deserializer);
 
     size_t sampleCount = 0;
     for (const auto& chunk : m_chunkDescriptions)
@@ -159,6 +166,9 @@ Sequences NoRandomizer::GetNextSequences(size_t globalSampleCount, size_t localS
     if (localSampleCount == 0)
         LogicError("Local sample count must not be zero.");
 
+    // Only calls that return data are recorded.
+    auto profiler = ProfilerTimeBegin();
+
     Sequences result;
     size_t endOfEpochPosition = GetEndOfEpochPosition();
     if (m_globalSamplePosition >= endOfEpochPosition)
@@ -203,7 +213,7 @@ Sequences NoRandomizer::GetNextSequences(size_t globalSampleCount, size_t localS
             }
             else
             {
-                chunks[s.m_chunkId] = m_deserializer->GetChunk(s.m_chunkId);
+                chunks[s.m_chunkId] = LoadChunk(m_deserializer, m_streams, s.m_chunkId);
             }
         }
     }
@@ -211,6 +221,24 @@ Sequences NoRandomizer::GetNextSequences(size_t globalSampleCount, size_t localS
     // swap current chunks with new ones:
     m_chunks.swap(chunks);
 
+    if (ReaderStatisticsEnabled())
+    {
+        size_t numSamples = 0;
+        for (const auto& c : m_chunks)
+            numSamples += m_chunkDescriptions[c.first]->m_numberOfSamples;
+        ReaderRandomizationWindow(m_chunks.size(), numSamples);
+    }
+
+    // The input is read sequentially, let the cache load the next chunks in the background.
+    if (m_chunkCache && m_prefetchPosition != m_currentChunkPosition)
+    {
+        m_prefetchPosition = m_currentChunkPosition;
+        std::vector<ChunkIdType> chunksToPrefetch;
+        for (ChunkIdType i = 1; i <= NumChunksToPrefetch && i < m_chunkDescriptions.size(); ++i)
+            chunksToPrefetch.push_back((m_currentChunkPosition + i) % m_chunkDescriptions.size());
+        m_chunkCache->Prefetch(chunksToPrefetch);
+    }
+
     auto process = [&](int i) -> void {
         std::vector<SequenceDataPtr> sequence;
         const auto& sequenceDescription = m_sequenceBuffer[i];
@@ -244,6 +272,12 @@ Sequences NoRandomizer::GetNextSequences(size_t globalSampleCount, size_t localS
     }
 
     m_cleaner.Clean(result);
+
+    size_t numSamples = 0, sizeInBytes = 0;
+    if (ReaderStatisticsEnabled())
+        GetSequencesSize(m_streams, result, numSamples, sizeInBytes);
+    ReaderStageEnd(profiler, readerStageRandomize, numSamples, sizeInBytes);
+
     return result;
 }
 
@@ -7,6 +7,7 @@
 
 #include <vector>
 #include "SequenceEnumerator.h"
+#include "ChunkCache.h"
 #include "DataDeserializer.h"
 #include "ReaderUtil.h"
 
@@ -76,6 +77,12 @@ private:
     // Current chunk data id.
     ChunkIdType m_currentChunkId;
 
+    // The deserializer as a chunk cache (if it is one), used to prefetch the chunks that follow the current one.
+    std::shared_ptr<ChunkCache> m_chunkCache;
+
+    // Chunk position for which the last prefetch was requested.
+    ChunkIdType m_prefetchPosition;
+
     // Current window of sequence descriptions.
     std::vector<SequenceDescription> m_sequenceWindow;
 
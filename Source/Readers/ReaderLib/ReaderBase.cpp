@@ -7,6 +7,8 @@
 #include "ReaderBase.h"
 #include "CudaMemoryProvider.h"
 #include "HeapMemoryProvider.h"
+#include "ReaderUtil.h"
+#include "PerformanceProfiler.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -60,7 +62,20 @@ void ReaderBase::StartEpoch(const EpochConfiguration& config, const std::map<std
 Minibatch ReaderBase::ReadMinibatch()
 {
     assert(m_packer != nullptr);
-    return m_packer->ReadMinibatch();
+    auto profiler = ProfilerTimeBegin();
+    Minibatch minibatch = m_packer->ReadMinibatch();
+
+    size_t numSamples = 0, sizeInBytes = 0;
+    if (ReaderStatisticsEnabled() && !minibatch.m_data.empty())
+    {
+        auto streams = m_sequenceEnumerator->GetStreamDescriptions();
+        numSamples = minibatch.m_data.front()->m_layout->GetActualNumSamples();
+        for (size_t i = 0; i < streams.size() && i < minibatch.m_data.size(); ++i)
+            sizeInBytes += GetStreamMinibatchSizeInBytes(*streams[i], minibatch.m_data[i]);
+    }
+    ReaderStageEnd(profiler, readerStagePack, numSamples, sizeInBytes);
+
+    return minibatch;
 }
 
 size_t ReaderBase::GetCurrentSamplePosition()
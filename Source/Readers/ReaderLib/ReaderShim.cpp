@@ -18,15 +18,33 @@
 #include "DataReader.h"
 #include "ReaderShim.h"
 #include "DataTransferer.h"
+#include "ReaderUtil.h"
 #include "PerformanceProfiler.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+// Default maximum number of minibatches prefetched ahead of the network.
+static const size_t DefaultMaxPrefetchDepth = 4;
+
+// The prefetch depth is adapted after every window of this many minibatches. It is increased if the main
+// thread waited for the prefetch more than the upper fraction of the time of the window, and decreased if
+// it waited less than the lower fraction during several windows in a row.
+static const size_t PrefetchAdaptationWindow = 16;
+static const double PrefetchStallRatioIncrease = 0.05;
+static const double PrefetchStallRatioDecrease = 0.01;
+static const size_t PrefetchCalmWindowsDecrease = 8;
+
 template <class ElemType>
 ReaderShim<ElemType>::ReaderShim() :
     m_deviceId(CPUDEVICE),
     m_dataTransferers(2, DataTransfererPtr()),
-    m_currentDataTransferIndex(0),
+    m_nextDataTransferIndex(0),
+    m_prefetchDepth(1),
+    m_minPrefetchDepth(1),
+    m_maxPrefetchDepth(1),
+    m_windowMinibatches(0),
+    m_windowWaitSeconds(0),
+    m_calmWindows(0),
     m_endOfEpoch(false),
     m_endOfSweep(false),
     m_currentSamplePosition(0),
@@ -60,6 +78,18 @@ void ReaderShim<ElemType>::Init(const ConfigParameters& config)
     // otherwise deferring - synchronous execution during .get() call
     m_launchType = prefetch ? launch::async : launch::deferred;
 
+    // Number of minibatches read ahead. Without prefetch a single minibatch is read on demand.
+    if (prefetch)
+    {
+        m_minPrefetchDepth = config(L"prefetchDepth", (size_t)1);
+        m_maxPrefetchDepth = config(L"maxPrefetchDepth", std::max(m_minPrefetchDepth, DefaultMaxPrefetchDepth));
+        if (m_minPrefetchDepth == 0 || m_maxPrefetchDepth < m_minPrefetchDepth)
+            InvalidArgument("ReaderShim: expected 0 < prefetchDepth <= maxPrefetchDepth, got prefetchDepth %d, maxPrefetchDepth %d.",
+                            (int)m_minPrefetchDepth, (int)m_maxPrefetchDepth);
+    }
+    m_prefetchDepth = m_minPrefetchDepth;
+    m_dataTransferers.assign(m_maxPrefetchDepth + 1, DataTransfererPtr());
+
     m_numParallelSequences = numberOfuttsPerMinibatchForAllEpochs[0];
 
     if (!m_reader)
@@ -104,32 +134,21 @@ void ReaderShim<ElemType>::SetCurrentSamplePosition(size_t currentSamplePosition
     if (m_currentSamplePosition == currentSamplePosition)
         return;
 
-    // Make sure there are no outstanding reads.
-    if (m_prefetchTask.valid())
-        m_prefetchTask.wait();
-
-    // Let's check that there is no outstanding copies.
-    // Wait on all events if there are any pending copy operations in flight.
-    if (m_dataTransferers[m_currentDataTransferIndex])
-        m_dataTransferers[m_currentDataTransferIndex]->WaitForCopyCPUToGPU();
+    // The prefetched minibatches follow the old position, drop them.
+    DiscardPrefetchedMinibatches(/*rethrowErrors =*/ false);
 
     // Set current position.
     m_reader->SetCurrentSamplePosition(currentSamplePosition);
     m_endOfEpoch = false;
     m_currentSamplePosition = m_reader->GetCurrentSamplePosition();
+    m_windowMinibatches = 0;
 }
 
 template <class ElemType>
 void ReaderShim<ElemType>::SetConfiguration(const ReaderConfiguration& config, const std::map<std::wstring, int>& inputDescriptions)
 {
-    // Make sure there are no outstanding reads.
-    if (m_prefetchTask.valid())
-        m_prefetchTask.get();
-
-    // Let's check that there is no outstanding copies.
-    // Wait on all events if there are any pending copy operations in flight.
-    if (m_dataTransferers[m_currentDataTransferIndex])
-        m_dataTransferers[m_currentDataTransferIndex]->WaitForCopyCPUToGPU();
+    // The prefetched minibatches were read with the old configuration, drop them.
+    DiscardPrefetchedMinibatches(/*rethrowErrors =*/ true);
 
     m_reader->SetConfiguration(config, inputDescriptions);
     m_reader->SetCurrentSamplePosition(m_currentSamplePosition);
@@ -139,13 +158,7 @@ template <class ElemType>
 void ReaderShim<ElemType>::StartEpoch(const EpochConfiguration& config, const std::unordered_set<InputStreamDescription>& inputs)
 {
     // For adaptive minibatch, make sure there are no outstanding reads.
-    if (m_prefetchTask.valid())
-        m_prefetchTask.get();
-
-    // Let's check that there is no outstanding copies.
-    // Wait on all events if there are any pending copy operations in flight.
-    if (m_dataTransferers[m_currentDataTransferIndex])
-        m_dataTransferers[m_currentDataTransferIndex]->WaitForCopyCPUToGPU();
+    DiscardPrefetchedMinibatches(/*rethrowErrors =*/ true);
 
     // Now we can be sure, no prefetch thread is running and there are no outstanding memcopies.
     // Let's check that requested devices are ok and see whether we need to change our data transferers.
@@ -166,40 +179,154 @@ void ReaderShim<ElemType>::StartEpoch(const EpochConfiguration& config, const st
         // Device changed. Let's change the data transferers.
         m_deviceId = deviceId;
         m_dataTransferers.clear();
-        // We need two in order to support two operations in flight.
-        m_dataTransferers.push_back(m_deviceId == CPUDEVICE ? nullptr : CreatePrefetchDataTransferer(m_deviceId));
-        m_dataTransferers.push_back(m_deviceId == CPUDEVICE ? nullptr : CreatePrefetchDataTransferer(m_deviceId));
+        // We need one for every prefetch in flight and one for the minibatch the main thread waits for.
+        for (size_t i = 0; i <= m_maxPrefetchDepth; ++i)
+            m_dataTransferers.push_back(m_deviceId == CPUDEVICE ? nullptr : CreatePrefetchDataTransferer(m_deviceId));
     }
 
-    // Let's create the buffers for the prefetch thread.
+    // Let's create the buffers for the prefetch thread, one for every prefetch in flight.
+    // Buffer 0 is used first, further ones only if the prefetch depth grows.
+    m_prefetchBuffers.assign(m_maxPrefetchDepth, std::unordered_map<std::wstring, StreamPrefetchBuffer>());
+    m_freePrefetchBuffers.clear();
+    for (size_t b = m_maxPrefetchDepth; b-- > 0;)
+        m_freePrefetchBuffers.push_back(b);
+
     std::map<std::wstring, int> inputDescriptions;
     for (const auto& i : inputs)
     {
         inputDescriptions[i.GetStreamName()] = i.GetDeviceId();
         // Creating buffers with the same properties the network expects.
-        m_prefetchBuffers[i.GetStreamName()] = StreamPrefetchBuffer
+        for (auto& buffers : m_prefetchBuffers)
         {
-            std::make_shared<Matrix<ElemType>>(0, 0, i.GetDeviceId(), i.GetMatrixType(), i.GetMatrixFormat()),
-            std::make_shared<MBLayout>()
-        };
+            buffers[i.GetStreamName()] = StreamPrefetchBuffer
+            {
+                std::make_shared<Matrix<ElemType>>(0, 0, i.GetDeviceId(), i.GetMatrixType(), i.GetMatrixFormat()),
+                std::make_shared<MBLayout>()
+            };
+        }
     }
 
     m_endOfEpoch = false;
     m_reader->StartEpoch(config, inputDescriptions);
     m_currentSamplePosition = m_reader->GetCurrentSamplePosition();
+    m_windowMinibatches = 0;
 }
 
 template <class ElemType>
 void ReaderShim<ElemType>::StartAsyncPrefetching()
 {
-    auto localCurrentDataTransferIndex = m_currentDataTransferIndex;
-    // Starting the prefetch task. There is always a single async read in flight.
-    // When the network requests a new minibatch, we wait for the current async to finish, swap the buffers
-    // and kick off the new prefetch.
-    m_prefetchTask = std::async(m_launchType, [this, localCurrentDataTransferIndex]()
+    // Starting the prefetch tasks. There are up to m_prefetchDepth async reads in flight.
+    // When the network requests a new minibatch, we wait for the oldest one to finish, swap the buffers
+    // and kick off new prefetches. Each prefetch waits for the previous one, so that the reader is used
+    // by one thread at a time and minibatches are read in order. Prefetches behind the end of the epoch
+    // do not read.
+    while (m_prefetchQueue.size() < m_prefetchDepth && !m_freePrefetchBuffers.empty())
+    {
+        size_t bufferIndex = m_freePrefetchBuffers.back();
+        m_freePrefetchBuffers.pop_back();
+
+        size_t dataTransferIndex = m_nextDataTransferIndex;
+        m_nextDataTransferIndex = (m_nextDataTransferIndex + 1) % m_dataTransferers.size();
+
+        // Record an event that prefetch can wait on to ensure that prior compute has finished
+        // with the matrices the buffer got from the network.
+        if (m_dataTransferers[dataTransferIndex])
+            m_dataTransferers[dataTransferIndex]->RecordComputeStreamSyncPoint();
+
+        std::shared_future<PrefetchResult> previous;
+        if (!m_prefetchQueue.empty())
+            previous = m_prefetchQueue.back().m_result;
+
+        auto result = std::async(m_launchType, [this, previous, bufferIndex, dataTransferIndex]()
+        {
+            if (previous.valid())
+            {
+                const auto& previousResult = previous.get();
+                if (previousResult.m_isEndOfEpoch)
+                    return PrefetchResult{ previousResult.m_isEndOfSweep, true, false, previousResult.m_samplePosition, nullptr };
+            }
+
+            return PrefetchMinibatch(bufferIndex, dataTransferIndex);
+        });
+
+        m_prefetchQueue.push_back(PrefetchTask{ result.share(), bufferIndex, dataTransferIndex });
+    }
+}
+
+template <class ElemType>
+void ReaderShim<ElemType>::DiscardPrefetchedMinibatches(bool rethrowErrors)
+{
+    // Make sure there are no outstanding reads.
+    std::exception_ptr error;
+    for (const auto& task : m_prefetchQueue)
+    {
+        try
+        {
+            task.m_result.get();
+        }
+        catch (...)
+        {
+            if (!error)
+                error = std::current_exception();
+        }
+    }
+
+    // Let's check that there is no outstanding copies.
+    // Wait on all events if there are any pending copy operations in flight.
+    for (const auto& task : m_prefetchQueue)
+    {
+        if (m_dataTransferers[task.m_dataTransferIndex])
+            m_dataTransferers[task.m_dataTransferIndex]->WaitForCopyCPUToGPU();
+        m_freePrefetchBuffers.push_back(task.m_bufferIndex);
+    }
+    m_prefetchQueue.clear();
+
+    if (error && rethrowErrors)
+        std::rethrow_exception(error);
+}
+
+template <class ElemType>
+void ReaderShim<ElemType>::AdaptPrefetchDepth(double waitSeconds)
+{
+    if (m_minPrefetchDepth == m_maxPrefetchDepth)
+        return;
+
+    auto now = std::chrono::steady_clock::now();
+    if (m_windowMinibatches == 0)
     {
-        return PrefetchMinibatch(localCurrentDataTransferIndex);
-    });
+        // The window starts after the first minibatch of an epoch, the wait for it is not a stall.
+        m_windowStart = now;
+        m_windowWaitSeconds = 0;
+        m_windowMinibatches = 1;
+        return;
+    }
+
+    m_windowWaitSeconds += waitSeconds;
+    if (m_windowMinibatches++ < PrefetchAdaptationWindow)
+        return;
+
+    double windowSeconds = std::chrono::duration<double>(now - m_windowStart).count();
+    double stallRatio = windowSeconds > 0 ? m_windowWaitSeconds / windowSeconds : 0;
+    if (stallRatio > PrefetchStallRatioIncrease)
+    {
+        m_calmWindows = 0;
+        if (m_prefetchDepth < m_maxPrefetchDepth)
+            m_prefetchDepth++;
+    }
+    else if (stallRatio < PrefetchStallRatioDecrease)
+    {
+        if (++m_calmWindows >= PrefetchCalmWindowsDecrease && m_prefetchDepth > m_minPrefetchDepth)
+        {
+            m_calmWindows = 0;
+            m_prefetchDepth--;
+        }
+    }
+    else
+        m_calmWindows = 0;
+
+    m_windowStart = now;
+    m_windowWaitSeconds = 0;
+    m_windowMinibatches = 1;
 }
 
 string EnumerateInputs(const unordered_map<wstring, size_t>& nameToStreamId)
@@ -249,41 +376,39 @@ bool ReaderShim<ElemType>::GetMinibatch(StreamMinibatchInputs& matrices)
         }
     }
 
-    if (!m_prefetchTask.valid())
+    if (m_prefetchQueue.empty())
         StartAsyncPrefetching();
 
-    auto result = m_prefetchTask.get();
+    auto profiler = ProfilerTimeBegin();
+    auto waitStart = std::chrono::steady_clock::now();
+    auto result = m_prefetchQueue.front().m_result.get();
+    double waitSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - waitStart).count();
+    ReaderStageEnd(profiler, readerStageWaitForPrefetch, 0, 0);
 
-    // Ok, prefetch is done.
+    // Ok, prefetch is done. Async memcpy for it already started on the prefetch thread.
+    auto task = m_prefetchQueue.front();
+    m_prefetchQueue.pop_front();
 
     // Let's update our sample position.
-    m_currentSamplePosition = m_reader->GetCurrentSamplePosition();
+    m_currentSamplePosition = result.m_samplePosition;
 
     m_endOfEpoch = result.m_isEndOfEpoch;
     m_endOfSweep = result.m_isEndOfSweep;
     if (m_endOfEpoch && !result.m_isDataAvailable)
     {
         // No data and end of epoch, simply return.
+        m_freePrefetchBuffers.push_back(task.m_bufferIndex);
         return false;
     }
 
-    // Remember current data transfer, async memcpy for it already started on the prefetch thread.
-    auto currentDataTransferIndex = m_currentDataTransferIndex;
-
-    matrices.m_getKeyById = m_getKeyById;
-
-    // Let's update the current data transferer.
-    m_currentDataTransferIndex = (m_currentDataTransferIndex + 1) % 2;
-
-    // Record an event that prefetch can wait on to ensure that prior compute has finished.
-    if (m_dataTransferers[m_currentDataTransferIndex])
-        m_dataTransferers[m_currentDataTransferIndex]->RecordComputeStreamSyncPoint();
+    matrices.m_getKeyById = result.m_getKeyById;
 
     // We have some data - let's swap the matrices.
     // We cannot simply change pointers because it seems they are remembered deeper in the network.
+    auto& prefetchBuffers = m_prefetchBuffers[task.m_bufferIndex];
     for (auto i = matrices.begin(); i != matrices.end(); ++i)
     {
-        std::swap(i->second.GetMatrix<ElemType>(), *m_prefetchBuffers[i->first].m_matrix);
+        std::swap(i->second.GetMatrix<ElemType>(), *prefetchBuffers[i->first].m_matrix);
 
         // Resetting layouts.
         i->second.pMBLayout->Init(1, 0);
@@ -295,7 +420,7 @@ bool ReaderShim<ElemType>::GetMinibatch(StreamMinibatchInputs& matrices)
     // Let's now check the layouts and throw if the same layout is being assigned twice.
     for (auto i = matrices.begin(); i != matrices.end(); ++i)
     {
-        auto streamLayout = m_prefetchBuffers[i->first].m_mbLayout;
+        auto streamLayout = prefetchBuffers[i->first].m_mbLayout;
         auto& layout = i->second.pMBLayout;
         if (layout->GetNumCols() == 0) // just initialized, let's take the layout of the reader.
         {
@@ -316,33 +441,41 @@ bool ReaderShim<ElemType>::GetMinibatch(StreamMinibatchInputs& matrices)
     // So pick up the first one.
     m_numParallelSequences = matrices.begin()->second.pMBLayout->GetNumParallelSequences();
 
-    // It is time to issue the next prefetch.
+    // The buffer now holds the matrices of the previous minibatch, it can be refilled as soon as
+    // the compute using them has finished.
+    m_freePrefetchBuffers.push_back(task.m_bufferIndex);
+
+    // It is time to issue the next prefetches.
     if (!m_endOfEpoch)
     {
+        AdaptPrefetchDepth(waitSeconds);
         StartAsyncPrefetching();
     }
 
-    // Let's wait till the previous memcopy has finished.
-    if (m_dataTransferers[currentDataTransferIndex])
-        m_dataTransferers[currentDataTransferIndex]->WaitForCopyCPUToGPU();
+    // Let's wait till the memcopy of this minibatch has finished.
+    if (m_dataTransferers[task.m_dataTransferIndex])
+        m_dataTransferers[task.m_dataTransferIndex]->WaitForCopyCPUToGPU();
 
     return result.m_isDataAvailable;
 }
 
 template <class ElemType>
-typename ReaderShim<ElemType>::PrefetchResult ReaderShim<ElemType>::PrefetchMinibatch(size_t currentDataTransferIndex)
+typename ReaderShim<ElemType>::PrefetchResult ReaderShim<ElemType>::PrefetchMinibatch(size_t bufferIndex, size_t currentDataTransferIndex)
 {
     PROFILE_SCOPE(profilerEvtPrefetchMinibatch);
 
+    auto& prefetchBuffers = m_prefetchBuffers[bufferIndex];
+
     // Resetting layouts.
-    for (auto& mx : m_prefetchBuffers)
+    for (auto& mx : prefetchBuffers)
         mx.second.m_mbLayout = std::make_shared<MBLayout>();
 
     Minibatch minibatch = m_reader->ReadMinibatch();
+    size_t samplePosition = m_reader->GetCurrentSamplePosition();
 
     // If there is no data we can simply return.
     if (minibatch.m_data.empty())
-        return PrefetchResult{ minibatch.m_endOfSweep, minibatch.m_endOfEpoch, false };
+        return PrefetchResult{ minibatch.m_endOfSweep, minibatch.m_endOfEpoch, false, samplePosition, nullptr };
 
     // Ok we have some data. Let's load it to GPU.
     // But before we need to make sure that corresponding compute has already finished from the last iteration.
@@ -351,23 +484,30 @@ typename ReaderShim<ElemType>::PrefetchResult ReaderShim<ElemType>::PrefetchMini
     if (m_dataTransferers[currentDataTransferIndex])
         m_dataTransferers[currentDataTransferIndex]->WaitForSyncPointOnAssignStreamAsync();
 
-    m_getKeyById = minibatch.m_getKeyById;
-
-    for (auto& mx : m_prefetchBuffers)
+    auto profiler = ProfilerTimeBegin();
+    size_t numSamples = 0, sizeInBytes = 0;
+    for (auto& mx : prefetchBuffers)
     {
-        size_t streamId = m_nameToStreamId[mx.first];
+        size_t streamId = m_nameToStreamId.at(mx.first);
         const auto& stream = minibatch.m_data[streamId];
         mx.second.m_mbLayout = stream->m_layout;
 
         size_t sampleSize = m_streams[streamId]->m_sampleLayout->GetNumElements();
         FillMatrixFromStream(m_streams[streamId]->m_storageType, mx.second.m_matrix.get(), sampleSize, stream, m_dataTransferers[currentDataTransferIndex].get());
+
+        if (ReaderStatisticsEnabled())
+        {
+            numSamples = std::max(numSamples, stream->m_layout->GetActualNumSamples());
+            sizeInBytes += GetStreamMinibatchSizeInBytes(*m_streams[streamId], stream);
+        }
     }
+    ReaderStageEnd(profiler, readerStageTransfer, numSamples, sizeInBytes);
 
     // Let's record that we started the copy, so that the main thread can wait afterwards.
     if (m_dataTransferers[currentDataTransferIndex])
         m_dataTransferers[currentDataTransferIndex]->RecordCPUToGPUCopy();
 
-    return PrefetchResult{ minibatch.m_endOfSweep, minibatch.m_endOfEpoch, true };
+    return PrefetchResult{ minibatch.m_endOfSweep, minibatch.m_endOfEpoch, true, samplePosition, minibatch.m_getKeyById };
 }
 
 
@@ -427,6 +567,20 @@ size_t ReaderShim<ElemType>::GetCurrentSamplePosition()
     return m_currentSamplePosition;
 }
 
+template <class ElemType>
+std::vector<InputStreamDescription> ReaderShim<ElemType>::GetInputStreamDescriptions(int deviceId)
+{
+    std::vector<InputStreamDescription> streams;
+    for (const auto& s : m_streams)
+    {
+        if (s->m_storageType == StorageType::dense)
+            streams.push_back(InputStreamDescription(s->m_name, deviceId, MatrixType::DENSE, matrixFormatDense));
+        else
+            streams.push_back(InputStreamDescription(s->m_name, deviceId, MatrixType::SPARSE, matrixFormatSparseCSC));
+    }
+    return streams;
+}
+
 template class ReaderShim<float>;
 template class ReaderShim<double>;
 } } }
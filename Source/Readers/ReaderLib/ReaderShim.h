@@ -11,6 +11,8 @@
 #include <unordered_map>
 #include <string>
 #include <future>
+#include <deque>
+#include <chrono>
 #include "DataReader.h"
 #include "Reader.h"
 
@@ -47,10 +49,11 @@ public:
         // Make sure there are no outstanding reads.
         // Future destructor does not wait as of 2013 so probably it is not in VS2013:
         // More info can be found here http://www.open-std.org/jtc1/sc22/wg21/docs/papers/2013/n3679.html.
-        if (m_prefetchTask.valid())
+        // The prefetches run one after another, so waiting for the last one waits for all.
+        if (!m_prefetchQueue.empty())
         {
             // If there are some, give them time to finish.
-            m_prefetchTask.wait_for(std::chrono::seconds(5));
+            m_prefetchQueue.back().m_result.wait_for(std::chrono::seconds(5));
             // TODO: if the prefetch is still valid, print a warning here!
         }
 
@@ -92,6 +95,8 @@ public:
 
     virtual size_t GetCurrentSamplePosition() override;
 
+    virtual std::vector<InputStreamDescription> GetInputStreamDescriptions(int deviceId) override;
+
     void SetCurrentSamplePosition(size_t currentSamplePosition);
 
     void SetConfiguration(const ReaderConfiguration& config, const std::map<std::wstring, int>& inputDescriptions);
@@ -108,18 +113,42 @@ public:
 
 private:
 
+    // Starts prefetches until the current prefetch depth is reached.
     void StartAsyncPrefetching();
 
+    // Waits for all outstanding prefetches and drops their minibatches. Errors of the prefetches are rethrown if requested.
+    void DiscardPrefetchedMinibatches(bool rethrowErrors);
+
+    // Adapts the prefetch depth to the time the main thread spent waiting for prefetched minibatches.
+    void AdaptPrefetchDepth(double waitSeconds);
+
     struct PrefetchResult
     {
         bool m_isEndOfSweep;
         bool m_isEndOfEpoch;
         bool m_isDataAvailable;
+
+        // Sample position of the reader after this minibatch.
+        size_t m_samplePosition;
+
+        // Id to key mapping of this minibatch.
+        std::function<std::string(size_t)> m_getKeyById;
     };
 
-    PrefetchResult PrefetchMinibatch(size_t currentDataTransferIndex);
+    PrefetchResult PrefetchMinibatch(size_t bufferIndex, size_t dataTransferIndex);
+
+    // A minibatch that is being prefetched or is ready.
+    // Prefetches run one after another, each one waits for the result of the previous one.
+    struct PrefetchTask
+    {
+        std::shared_future<PrefetchResult> m_result;
+        size_t m_bufferIndex;
+        size_t m_dataTransferIndex;
+    };
+
+    // Outstanding prefetches, in the order of the minibatches.
+    std::deque<PrefetchTask> m_prefetchQueue;
 
-    std::future<PrefetchResult> m_prefetchTask;
     ReaderPtr m_reader;
     ReaderFactory m_factory;
     bool m_endOfEpoch;
@@ -131,6 +160,18 @@ private:
     std::vector<StreamDescriptionPtr> m_streams;
     launch m_launchType;
 
+    // Number of minibatches prefetched ahead of the network. Adapted between the minimum and the
+    // maximum depth based on the fraction of time the main thread waits for the prefetch.
+    size_t m_prefetchDepth;
+    size_t m_minPrefetchDepth;
+    size_t m_maxPrefetchDepth;
+
+    // Statistics of the current adaptation window.
+    size_t m_windowMinibatches;
+    double m_windowWaitSeconds;
+    std::chrono::steady_clock::time_point m_windowStart;
+    size_t m_calmWindows;
+
     // Data structure required for prefetch.
     struct StreamPrefetchBuffer
     {
@@ -138,28 +179,29 @@ private:
         MBLayoutPtr m_mbLayout;
     };
 
-    // Intermediate buffer where the prefetch thread puts its data to.
-    // When the main thread enters GetMinibatch it swaps the matrices from this buffer,
+    // Intermediate buffers where the prefetch thread puts its data to, one per minibatch in flight.
+    // When the main thread enters GetMinibatch it swaps the matrices from the oldest buffer,
     // triggers the next prefetch and waits if memCpy is still in progress.
-    std::unordered_map<std::wstring, StreamPrefetchBuffer> m_prefetchBuffers;
+    std::vector<std::unordered_map<std::wstring, StreamPrefetchBuffer>> m_prefetchBuffers;
 
-    // Alternating data transfer operations. In the current version these are only two - 
-    // currently waiting on the main thread and the one that can be started by the prefetch thread 
-    // in the meantime.
-    std::vector<DataTransfererPtr> m_dataTransferers;
+    // Buffers not used by an outstanding prefetch. The most recently used buffer is reused first,
+    // so that only as many buffers are filled as the prefetch depth requires.
+    std::vector<size_t> m_freePrefetchBuffers;
 
-    // Id to key mapping.
-    std::function<std::string(size_t)> m_getKeyById;
+    // Data transfer operations, used in turn by consecutive minibatches. There is one more than the
+    // maximum prefetch depth - the one the main thread is waiting for and the ones of the prefetches
+    // in flight.
+    std::vector<DataTransfererPtr> m_dataTransferers;
 
-    // Current data transfer. Flips 0 and 1.
-    // Can be changed only from the main thread with no ongoing prefetch.
-    size_t m_currentDataTransferIndex; 
+    // Data transfer of the next prefetch.
+    // Can be changed only from the main thread.
+    size_t m_nextDataTransferIndex;
 
     // Device id.
     int m_deviceId;
 
     // Current sample position of the reader on the global timeline.
-    // We have to remember the value locally before starting prefetch.
+    // We have to remember the value locally because the reader runs ahead of the network.
     // The value is updated only from the main thread (in StartEpoch/GetMinibatch)
     size_t m_currentSamplePosition;
 
@@ -5,6 +5,8 @@
 
 #include "Config.h"
 #include "DataReader.h"
+#include "ReaderUtil.h"
+#include "PerformanceProfiler.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
     
@@ -34,4 +36,99 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         return randomizeAuto;
     }
 
+    size_t GetSequenceSizeInBytes(const StreamDescription& stream, const SequenceDataPtr& data)
+    {
+        size_t elementSize = GetSizeByType(stream.m_elementType);
+        if (stream.m_storageType == StorageType::dense)
+        {
+            const auto& layout = data->m_sampleLayout ? data->m_sampleLayout : stream.m_sampleLayout;
+            return data->m_numberOfSamples * layout->GetNumElements() * elementSize;
+        }
+
+        auto sparse = std::static_pointer_cast<SparseSequenceData>(data);
+        return sparse->m_totalNnzCount * (elementSize + sizeof(IndexType)) +
+               sparse->m_nnzCounts.size() * sizeof(IndexType);
+    }
+
+    void GetChunkSize(IDataDeserializerPtr deserializer, const std::vector<StreamDescriptionPtr>& streams, ChunkIdType chunkId, ChunkPtr chunk, size_t& numSamples, size_t& sizeInBytes)
+    {
+        std::vector<SequenceDescription> sequences;
+        deserializer->GetSequencesForChunk(chunkId, sequences);
+
+        numSamples = 0;
+        sizeInBytes = 0;
+        std::vector<SequenceDataPtr> data;
+        for (const auto& sequence : sequences)
+        {
+            numSamples += sequence.m_numberOfSamples;
+
+            data.clear();
+            chunk->GetSequence(sequence.m_indexInChunk, data);
+            for (size_t i = 0; i < streams.size() && i < data.size(); ++i)
+                sizeInBytes += GetSequenceSizeInBytes(*streams[i], data[i]);
+        }
+    }
+
+    void EstimateChunkSize(IDataDeserializerPtr deserializer, const std::vector<StreamDescriptionPtr>& streams, ChunkIdType chunkId, size_t& numSamples, size_t& sizeInBytes)
+    {
+        std::vector<SequenceDescription> sequences;
+        deserializer->GetSequencesForChunk(chunkId, sequences);
+
+        numSamples = 0;
+        for (const auto& sequence : sequences)
+            numSamples += sequence.m_numberOfSamples;
+
+        // The number of non-zero values of sparse samples is only known after decoding, they are counted
+        // with one value per sample, which is exact for one-hot labels.
+        sizeInBytes = 0;
+        for (const auto& stream : streams)
+        {
+            size_t elementSize = GetSizeByType(stream->m_elementType);
+            if (stream->m_storageType == StorageType::dense)
+                sizeInBytes += stream->m_sampleLayout ? numSamples * stream->m_sampleLayout->GetNumElements() * elementSize : 0;
+            else
+                sizeInBytes += numSamples * (elementSize + 2 * sizeof(IndexType));
+        }
+    }
+
+    void GetSequencesSize(const std::vector<StreamDescriptionPtr>& streams, const Sequences& sequences, size_t& numSamples, size_t& sizeInBytes)
+    {
+        numSamples = 0;
+        sizeInBytes = 0;
+        for (size_t i = 0; i < streams.size() && i < sequences.m_data.size(); ++i)
+        {
+            for (const auto& data : sequences.m_data[i])
+            {
+                if (i == 0)
+                    numSamples += data->m_numberOfSamples;
+                sizeInBytes += GetSequenceSizeInBytes(*streams[i], data);
+            }
+        }
+    }
+
+    size_t GetStreamMinibatchSizeInBytes(const StreamDescription& stream, const StreamMinibatchPtr& data)
+    {
+        size_t elementSize = GetSizeByType(stream.m_elementType);
+        size_t numCols = data->m_layout->GetNumCols();
+        if (stream.m_storageType == StorageType::dense)
+            return numCols * stream.m_sampleLayout->GetNumElements() * elementSize;
+
+        // CSC format: the nnz count, followed by the values, the row indices and the column offsets.
+        size_t nnzCount = *reinterpret_cast<const size_t*>(data->m_data);
+        return sizeof(size_t) + nnzCount * (elementSize + sizeof(IndexType)) + (numCols + 1) * sizeof(IndexType);
+    }
+
+    ChunkPtr LoadChunk(IDataDeserializerPtr deserializer, const std::vector<StreamDescriptionPtr>& streams, ChunkIdType chunkId)
+    {
+        // The sizes are computed before starting the timer, so that only the deserializer is measured.
+        size_t numSamples = 0, sizeInBytes = 0;
+        if (ReaderStatisticsEnabled())
+            EstimateChunkSize(deserializer, streams, chunkId, numSamples, sizeInBytes);
+
+        auto profiler = ProfilerTimeBegin();
+        ChunkPtr chunk = deserializer->GetChunk(chunkId);
+        ReaderStageEnd(profiler, readerStageLoadChunk, numSamples, sizeInBytes);
+        return chunk;
+    }
+
 }}}
@@ -16,6 +16,25 @@ class ConfigParameters;
 
 size_t GetRandomizationWindowFromConfig(const ConfigParameters& config);
 
+// Returns the size of the data of a sequence in memory.
+size_t GetSequenceSizeInBytes(const StreamDescription& stream, const SequenceDataPtr& data);
+
+// Returns the number of samples (of the first stream) and the size in memory of all streams of a chunk, computed from all its sequences.
+void GetChunkSize(IDataDeserializerPtr deserializer, const std::vector<StreamDescriptionPtr>& streams, ChunkIdType chunkId, ChunkPtr chunk, size_t& numSamples, size_t& sizeInBytes);
+
+// Returns the number of samples (of the first stream) and the estimated size in memory of all streams of a chunk, computed from
+// the sequence descriptions and the sample layouts only, i.e. without touching the data of the chunk.
+void EstimateChunkSize(IDataDeserializerPtr deserializer, const std::vector<StreamDescriptionPtr>& streams, ChunkIdType chunkId, size_t& numSamples, size_t& sizeInBytes);
+
+// Returns the number of samples (of the first stream) and the size in memory of all streams of the sequences.
+void GetSequencesSize(const std::vector<StreamDescriptionPtr>& streams, const Sequences& sequences, size_t& numSamples, size_t& sizeInBytes);
+
+// Returns the size in memory of a packed stream of a minibatch.
+size_t GetStreamMinibatchSizeInBytes(const StreamDescription& stream, const StreamMinibatchPtr& data);
+
+// Loads a chunk from the deserializer, recording the load in the reader statistics of the profiler.
+ChunkPtr LoadChunk(IDataDeserializerPtr deserializer, const std::vector<StreamDescriptionPtr>& streams, ChunkIdType chunkId);
+
 inline size_t GetRandomSeed(const ConfigParameters& config)
 {
     return config(L"randomizationSeed", size_t(0));
@@ -43,7 +43,11 @@ Minibatch SequencePacker::ReadMinibatch()
 
     Minibatch minibatch(sequences.m_endOfSweep, sequences.m_endOfEpoch);
     if (batch.empty())
+    {
+        if (m_reportPaddingRatio && sequences.m_endOfEpoch)
+            PrintPaddingRatio();
         return minibatch;
+    }
 
     auto& currentBuffer = m_streamBuffers[m_currentBufferIndex];
 
@@ -71,6 +75,16 @@ Minibatch SequencePacker::ReadMinibatch()
 
     EstablishIdToKey(minibatch, sequences);
 
+    if (m_reportPaddingRatio)
+    {
+        // All streams share the sequences, so the padding of the first one is representative.
+        const auto& layout = minibatch.m_data.front()->m_layout;
+        m_numLayoutColumns += layout->GetNumCols();
+        m_numPaddingColumns += layout->GetNumCols() - layout->GetActualNumSamples();
+        if (sequences.m_endOfEpoch)
+            PrintPaddingRatio();
+    }
+
     m_currentBufferIndex = (m_currentBufferIndex + 1) % m_numberOfBuffers;
     return minibatch;
 }
@@ -102,6 +116,16 @@ void SequencePacker::SetConfiguration(const ReaderConfiguration& config, const s
     }
 }
 
+// Prints the ratio of gaps in the minibatch layouts since the last call.
+void SequencePacker::PrintPaddingRatio()
+{
+    fprintf(stderr, "SequencePacker: padding ratio of the epoch %.2f%% (%" PRIu64 " gaps in %" PRIu64 " minibatch columns)\n",
+        m_numLayoutColumns == 0 ? 0.0 : 100.0 * m_numPaddingColumns / m_numLayoutColumns,
+        m_numPaddingColumns,
+        m_numLayoutColumns);
+    m_numLayoutColumns = m_numPaddingColumns = 0;
+}
+
 void SequencePacker::CheckSampleShape(const std::vector<SequenceDataPtr>& minibatch, StreamDescriptionPtr outputStream)
 {
     assert(!minibatch.empty());
@@ -19,11 +19,15 @@ public:
         const std::vector<StreamDescriptionPtr>& streams,
         size_t numberOfBuffers = 2,
         bool useLocalTimeline = false,
-        CorpusDescriptorPtr corpus = nullptr) :
+        CorpusDescriptorPtr corpus = nullptr,
+        bool reportPaddingRatio = false) :
         PackerBase(corpus, sequenceEnumerator, streams, numberOfBuffers),
         m_useLocalTimeline(useLocalTimeline),
         m_globalMinibatchSizeInSamples(0),
-        m_localMinibatchSizeInSamples(0)
+        m_localMinibatchSizeInSamples(0),
+        m_reportPaddingRatio(reportPaddingRatio),
+        m_numLayoutColumns(0),
+        m_numPaddingColumns(0)
     {}
 
     virtual Minibatch ReadMinibatch() override;
@@ -39,6 +43,9 @@ protected:
     // the actual packing.
     virtual MBLayoutPtr CreateMBLayout(const StreamBatch& batch);
 
+    // Prints the ratio of gaps in the minibatch layouts since the last call.
+    void PrintPaddingRatio();
+
     // Helper function to check the sample shape of input samples.
     void CheckSampleShape(const std::vector<SequenceDataPtr>& minibatch, StreamDescriptionPtr outputStream);
 
@@ -51,6 +58,13 @@ protected:
     // A minibatch size for this worker in global samples.
     size_t m_globalMinibatchSizeInSamples;
 
+    // A flag indicating whether to print the ratio of gaps in the minibatch layouts at the end of each epoch.
+    bool m_reportPaddingRatio;
+
+    // Number of columns and of gap columns in the minibatch layouts of the current epoch.
+    size_t m_numLayoutColumns;
+    size_t m_numPaddingColumns;
+
 };
 
 typedef std::shared_ptr<SequencePacker> SequencePackerPtr;
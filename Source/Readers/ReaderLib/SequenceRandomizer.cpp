@@ -18,8 +18,10 @@ namespace Microsoft { namespace MSR { namespace CNTK {
     SequenceRandomizer::SequenceRandomizer(
         int verbosity,
         IDataDeserializerPtr deserializer,
-        ChunkRandomizerPtr chunkRandomizer)
+        ChunkRandomizerPtr chunkRandomizer,
+        size_t lengthBucketSizeInSamples)
         : m_verbosity(verbosity),
+        m_lengthBucketSizeInSamples(lengthBucketSizeInSamples),
         m_randomizedChunks(chunkRandomizer->GetRandomizedChunks()),
         m_chunkWindowBegin(0),
         m_randomizedWindowEnd(0),
@@ -229,9 +231,15 @@ namespace Microsoft { namespace MSR { namespace CNTK {
             }
         }
 
+        // The sequences of the chunk are at their final position, group them by length if requested.
+        size_t randomizedChunk = m_randomizedWindowEnd - m_chunkWindowBegin;
+        if (m_lengthBucketSizeInSamples > 0)
+        {
+            GroupSequencesByLength(m_sequenceWindow[randomizedChunk]);
+        }
+
         // Let's recalculate number of samples in the randomized chunks for efficient indexing in seek.
         size_t sampleCount = 0;
-        size_t randomizedChunk = m_randomizedWindowEnd - m_chunkWindowBegin;
         for (size_t index = 0; index < m_sequenceWindow[randomizedChunk].size(); index++)
         {
             sampleCount += m_sequenceWindow[randomizedChunk][index].m_numberOfSamples;
@@ -259,6 +267,39 @@ namespace Microsoft { namespace MSR { namespace CNTK {
                 m_randomizationCursor);
     }
 
+    // Groups the sequences of a randomized chunk into shuffled buckets of sequences of similar length.
+    void SequenceRandomizer::GroupSequencesByLength(std::vector<RandomizedSequenceDescription>& sequences)
+    {
+        // The sort is stable, so sequences of the same length keep their random order.
+        m_bufferSortedSequences.assign(sequences.begin(), sequences.end());
+        std::stable_sort(m_bufferSortedSequences.begin(), m_bufferSortedSequences.end(),
+            [](const RandomizedSequenceDescription& a, const RandomizedSequenceDescription& b) { return a.m_numberOfSamples < b.m_numberOfSamples; });
+
+        // Cut the sorted sequences into buckets of [begin, end) sequence indices.
+        m_bufferBuckets.clear();
+        size_t bucketBegin = 0;
+        size_t bucketSamples = 0;
+        for (size_t i = 0; i < m_bufferSortedSequences.size(); ++i)
+        {
+            bucketSamples += m_bufferSortedSequences[i].m_numberOfSamples;
+            if (bucketSamples >= m_lengthBucketSizeInSamples || i + 1 == m_bufferSortedSequences.size())
+            {
+                m_bufferBuckets.push_back(std::make_pair(bucketBegin, i + 1));
+                bucketBegin = i + 1;
+                bucketSamples = 0;
+            }
+        }
+
+        // Shuffle the buckets, otherwise the chunk would always go from short to long sequences.
+        RandomShuffleMT(m_bufferBuckets, m_rng);
+
+        sequences.clear();
+        for (const auto& bucket : m_bufferBuckets)
+        {
+            sequences.insert(sequences.end(), m_bufferSortedSequences.begin() + bucket.first, m_bufferSortedSequences.begin() + bucket.second);
+        }
+    }
+
     // Sets current cursor to the given sample offset.
     // If offset is in the middle of the sequence, the next sequence is picked up.
     // If there is no sequence, an offset outside the sweep is returned.
@@ -27,6 +27,12 @@ struct RandomizedSequenceDescription
 };
 
 // Class that given randomized chunks, randomizes sequence descriptions in a window of chunks.
+//
+// Optionally, once the sequences of a chunk have reached their final position, they are grouped by length: the
+// sequences of the chunk are sorted by their number of samples, cut into buckets of lengthBucketSizeInSamples samples
+// and the buckets are shuffled. Consecutive sequences then have similar lengths, so minibatches need less padding.
+// The sequences stay in their chunk, so the decimation by chunk and the sample positions of chunks are not affected,
+// and the buckets are shuffled with the random generator of the sweep, so all workers see the same timeline.
 // TODO: This code is still based on the old behavior, so that all current tests pass.
 // TODO: Can be simplified if we only randomized sequences forward.
 class SequenceRandomizer
@@ -35,7 +41,8 @@ public:
     SequenceRandomizer(
         int verbosity,
         IDataDeserializerPtr deserializer,
-        ChunkRandomizerPtr chunkRandomizer);
+        ChunkRandomizerPtr chunkRandomizer,
+        size_t lengthBucketSizeInSamples = 0);
 
     // Resets the current sweep according to the randomization seed provided.
     void Reset(size_t seed);
@@ -58,6 +65,9 @@ private:
     // Randomize one more chunk if needed after the chunk cursor has been incremented.
     void RandomizeNextChunkIfNeeded();
 
+    // Groups the sequences of a randomized chunk into shuffled buckets of sequences of similar length.
+    void GroupSequencesByLength(std::vector<RandomizedSequenceDescription>& sequences);
+
     // Checks if the randomized sequence is valid for a target chunk.
     bool IsValidForPosition(ChunkIdType chunkIndex, const RandomizedSequenceDescription& seqDesc) const;
 
@@ -156,6 +166,13 @@ private:
     // General configuration
     int m_verbosity;
 
+    // Size of the buckets of sequences of similar length in samples, 0 if sequences are not grouped by length.
+    size_t m_lengthBucketSizeInSamples;
+
+    // Buffers used for grouping sequences by length without memory reallocation.
+    std::vector<RandomizedSequenceDescription> m_bufferSortedSequences;
+    std::vector<std::pair<size_t, size_t>> m_bufferBuckets;
+
     std::mt19937_64 m_rng;
 };
 
@@ -10,6 +10,8 @@
 #include "Transformer.h"
 #include "SequenceEnumerator.h"
 #include "ExceptionCapture.h"
+#include "ReaderUtil.h"
+#include "PerformanceProfiler.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -76,6 +78,7 @@ public:
     virtual Sequences GetNextSequences(size_t globalSampleCount, size_t localSampleCount) override
     {
         assert(m_sequenceProvider != nullptr);
+        auto profiler = ProfilerTimeBegin();
         Sequences sequences = m_sequenceProvider->GetNextSequences(globalSampleCount, localSampleCount);
         if (sequences.m_data.empty())
         {
@@ -96,6 +99,12 @@ public:
         }
 
         capture.RethrowIfHappened();
+
+        size_t numSamples = 0, sizeInBytes = 0;
+        if (ReaderStatisticsEnabled())
+            GetSequencesSize(m_outputStreams, sequences, numSamples, sizeInBytes);
+        ReaderStageEnd(profiler, readerStageTransform, numSamples, sizeInBytes);
+
         return sequences;
     }
 
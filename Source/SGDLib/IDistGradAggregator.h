@@ -19,6 +19,17 @@ public:
     // Returns a boolean indicating if any samples were processed
     virtual bool AggregateGradients(const std::vector<Matrix<ElemType>*>& gradients, DistGradHeader* headerCPU, bool resetState) = 0;
 
+    // Returns a boolean indicating if the aggregator wants to be told when gradients become final during backprop
+    virtual bool OverlapsAggregationWithBackprop() const
+    {
+        return false;
+    }
+
+    // Called during backprop for each gradient once it is final, in the order backprop produces them. This allows to start
+    // aggregating it while backprop continues; AggregateGradients() is still called for all gradients afterwards.
+    virtual void OnGradientReady(Matrix<ElemType>* /*gradient*/)
+    {}
+
     size_t NumProc()
     {
         return m_mpi->NumNodesInUse();
@@ -0,0 +1,315 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include "IDistGradAggregator.h"
+#include "MatrixQuantizerImpl.h"
+#include "QuantizedMatrix.h"
+#include "TimerUtility.h"
+#include <memory>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// Aggregates N-bit quantized gradients with error feedback, on the CPU.
+//
+// The columns of every gradient matrix are divided into one stripe per node. Each node quantizes its gradient (adding the
+// quantization error of the previous minibatch, which it keeps as residual) and sends every stripe to the node that owns it
+// (reduce-scatter). The owner sums the stripes it receives, quantizes the sum with a residual of its own and sends it
+// to all nodes (allgather), which unquantize all stripes into the aggregated gradient. Compared with full precision
+// aggregation this cuts the volume sent over the network by up to 32x for 1-bit float gradients.
+template <class ElemType>
+class QuantizedDistGradAggregator : public IDistGradAggregator<ElemType>
+{
+    UsingIDistGradAggregatorMembers;
+
+public:
+    QuantizedDistGradAggregator(const MPIWrapperPtr& mpi, int numGradientBits, bool zeroThresholdFor1Bit, int syncStatsTrace)
+        : IDistGradAggregator<ElemType>(mpi), m_numGradientBits(numGradientBits), m_zeroThresholdFor1Bit(zeroThresholdFor1Bit), m_syncStatsTrace(syncStatsTrace),
+        m_iterationCount(0), m_initialized(false)
+    {
+        // Quantized values are packed into 64-bit words
+        if (numGradientBits < 1 || numGradientBits >= 8 * sizeof(ElemType) || (numGradientBits & (numGradientBits - 1)) != 0)
+            InvalidArgument("Quantized gradient aggregation requires the number of gradient bits to be a power of 2 less than %d.", (int)(8 * sizeof(ElemType)));
+    }
+
+    ~QuantizedDistGradAggregator()
+    {
+        for (size_t i = 0; i < m_recvHeaders.size(); ++i)
+            DistGradHeader::Destroy(m_recvHeaders[i]);
+    }
+
+    // Aggregate the gradient matrices across all nodes
+    bool AggregateGradients(const std::vector<Matrix<ElemType>*>& gradients, DistGradHeader* headerCPU, bool resetState) override
+    {
+        ResetState(gradients, headerCPU->numEvalNode, resetState);
+        bool showSyncPerfStats = (m_syncStatsTrace > 0) && ((m_iterationCount % m_syncStatsTrace) == 0);
+        m_iterationCount++;
+
+        Timer aggregationTimer;
+        if (showSyncPerfStats)
+            aggregationTimer.Start();
+
+        const size_t numGradMatrices = gradients.size();
+        const size_t numNodes = NumProc();
+        const size_t myRank = MyRank();
+
+        if (headerCPU->numSamples == 0)
+        {
+            assert(headerCPU->criterion == 0.0);
+            assert(headerCPU->numSamplesWithLabel == 0);
+
+            // If the current node did not process any samples, the gradients should be zero'd. The residuals are still sent.
+            for (size_t i = 0; i < numGradMatrices; ++i)
+                gradients[i]->SetValue(0);
+        }
+
+        // Post the receives of the stripes this node aggregates
+        // The stripes of gradient i are tagged with i, the aggregated stripes with numGradMatrices + 1 + i
+        std::vector<std::vector<MPI_Request>> recvStripeRequests(numGradMatrices);
+        for (size_t i = 0; i < numGradMatrices; ++i)
+        {
+            auto& stripes = m_recvStripes[i];
+            for (size_t j = 0; j < numNodes; ++j)
+            {
+                if (j == myRank || !stripes[j])
+                    continue;
+
+                recvStripeRequests[i].push_back(MPI_Request());
+                m_mpi->Irecv(stripes[j]->Buffer(), (int)stripes[j]->GetSize(), MPI_CHAR, (int)j, (int)i, &recvStripeRequests[i].back()) || MpiFail("MPI_Irecv");
+            }
+        }
+
+        // Initiate receive of the header on the main node
+        // We use a tag of 'numGradMatrices' for the pre-aggregation header
+        std::vector<MPI_Request> recvHeaderRequests(numNodes - 1);
+        if (m_mpi->IsMainNode())
+        {
+            for (size_t j = 0; j < numNodes - 1; ++j)
+            {
+                int source = (j >= myRank) ? (j + 1) : j;
+                m_mpi->Irecv(m_recvHeaders[j], m_recvHeaders[j]->Size(), MPI_CHAR, source, (int)numGradMatrices, &(recvHeaderRequests[j])) || MpiFail("MPI_Irecv");
+            }
+        }
+
+        // Send the headers from all nodes but the main node
+        MPI_Request sendHeaderRequest;
+        if (!m_mpi->IsMainNode())
+            m_mpi->Isend(headerCPU, headerCPU->Size(), MPI_CHAR, m_mpi->MainNodeRank(), (int)numGradMatrices, &sendHeaderRequest) || MpiFail("MPI_Isend");
+
+        // Reduce-scatter: quantize the gradients with their residuals and send every stripe to its owner
+        std::vector<std::vector<MPI_Request>> sendStripeRequests(numGradMatrices);
+        for (size_t i = 0; i < numGradMatrices; ++i)
+        {
+            m_quantizer->QuantizeAsync(*gradients[i], *m_residuals[i], *m_quantizedGradients[i], *m_residuals[i], m_zeroThresholdFor1Bit);
+            m_quantizer->WaitQuantizeAsyncDone();
+
+            for (size_t j = 0; j < numNodes; ++j)
+            {
+                if (j == myRank || GetStripeNumCols(i, j) == 0)
+                    continue;
+
+                auto stripe = GetQuantizedStripe(i, j);
+                sendStripeRequests[i].push_back(MPI_Request());
+                m_mpi->Isend(stripe.Buffer(), (int)stripe.GetSize(), MPI_CHAR, (int)j, (int)i, &sendStripeRequests[i].back()) || MpiFail("MPI_Isend");
+            }
+        }
+
+        // Sum up the stripes of this node and allgather the quantized sums
+        std::vector<std::vector<MPI_Request>> allGatherRequests(numGradMatrices);
+        for (size_t i = 0; i < numGradMatrices; ++i)
+        {
+            // The send buffers of the reduce-scatter are reused to receive the aggregated stripes
+            if (!sendStripeRequests[i].empty())
+                m_mpi->Waitall((int)sendStripeRequests[i].size(), sendStripeRequests[i].data(), MPI_STATUSES_IGNORE) || MpiFail("MPI_Waitall");
+
+            for (size_t j = 0; j < numNodes; ++j)
+            {
+                if (j == myRank || GetStripeNumCols(i, j) == 0)
+                    continue;
+
+                auto stripe = GetQuantizedStripe(i, j);
+                allGatherRequests[i].push_back(MPI_Request());
+                m_mpi->Irecv(stripe.Buffer(), (int)stripe.GetSize(), MPI_CHAR, (int)j, (int)(numGradMatrices + 1 + i), &allGatherRequests[i].back()) || MpiFail("MPI_Irecv");
+            }
+
+            if (!m_stripeSums[i])
+                continue;
+
+            // The own stripe is taken quantized as well, its quantization error is in the residual like for the other nodes
+            auto myStripe = GetQuantizedStripe(i, myRank);
+            m_quantizer->UnquantizeAsync(myStripe, *m_stripeSums[i], false);
+            m_quantizer->WaitUnquantizeAsyncDone();
+
+            if (!recvStripeRequests[i].empty())
+                m_mpi->Waitall((int)recvStripeRequests[i].size(), recvStripeRequests[i].data(), MPI_STATUSES_IGNORE) || MpiFail("MPI_Waitall");
+
+            for (size_t j = 0; j < numNodes; ++j)
+            {
+                if (j == myRank)
+                    continue;
+
+                m_quantizer->UnquantizeAsync(*m_recvStripes[i][j], *m_stripeSums[i], true);
+                m_quantizer->WaitUnquantizeAsyncDone();
+            }
+
+            m_quantizer->QuantizeAsync(*m_stripeSums[i], *m_stripeResiduals[i], myStripe, *m_stripeResiduals[i], m_zeroThresholdFor1Bit);
+            m_quantizer->WaitQuantizeAsyncDone();
+
+            for (size_t j = 0; j < numNodes; ++j)
+            {
+                if (j == myRank)
+                    continue;
+
+                allGatherRequests[i].push_back(MPI_Request());
+                m_mpi->Isend(myStripe.Buffer(), (int)myStripe.GetSize(), MPI_CHAR, (int)j, (int)(numGradMatrices + 1 + i), &allGatherRequests[i].back()) || MpiFail("MPI_Isend");
+            }
+        }
+
+        // On the main node wait for the headers to arrive and aggregate
+        if (m_mpi->IsMainNode())
+        {
+            size_t numNodesHeadersReceivedFrom = 0;
+            while (numNodesHeadersReceivedFrom < (numNodes - 1))
+            {
+                int idx = MPI_UNDEFINED;
+                m_mpi->Waitany(recvHeaderRequests.size(), recvHeaderRequests.data(), &idx, MPI_STATUS_IGNORE) || MpiFail("MPI_Waitany");
+                if (idx == MPI_UNDEFINED)
+                {
+                    break;
+                }
+
+                numNodesHeadersReceivedFrom++;
+
+                headerCPU->Aggregate(m_recvHeaders[idx], true);
+            }
+
+            assert(numNodesHeadersReceivedFrom == (numNodes - 1));
+        }
+
+        // Broadcast the aggregated header to all nodes
+        m_mpi->Bcast(headerCPU, headerCPU->Size(), MPI_CHAR, m_mpi->MainNodeRank());
+
+        // Wait for the aggregated stripes and unquantize them into the gradients
+        for (size_t i = 0; i < numGradMatrices; ++i)
+        {
+            if (!allGatherRequests[i].empty())
+                m_mpi->Waitall((int)allGatherRequests[i].size(), allGatherRequests[i].data(), MPI_STATUSES_IGNORE) || MpiFail("MPI_Waitall");
+
+            m_quantizer->UnquantizeAsync(*m_quantizedGradients[i], *gradients[i], false);
+            m_quantizer->WaitUnquantizeAsyncDone();
+        }
+
+        // Wait for completion of the async send requests
+        if (!m_mpi->IsMainNode())
+            m_mpi->Wait(&sendHeaderRequest, MPI_STATUSES_IGNORE) || MpiFail("MPI_Wait");
+
+        if (showSyncPerfStats)
+        {
+            aggregationTimer.Stop();
+            double gradientAggregationTime = aggregationTimer.ElapsedSeconds();
+            fprintf(stderr, "Actual gradient aggregation time: %.6g\n", gradientAggregationTime);
+        }
+
+        return (headerCPU->numSamples != 0);
+    }
+
+private:
+    // The columns of gradient i owned by node j
+    size_t GetStripeStartCol(size_t i, size_t j)
+    {
+        return m_quantizedGradients[i]->GetNumCols() * j / NumProc();
+    }
+
+    size_t GetStripeNumCols(size_t i, size_t j)
+    {
+        return GetStripeStartCol(i, j + 1) - GetStripeStartCol(i, j);
+    }
+
+    QuantizedMatrix<ElemType> GetQuantizedStripe(size_t i, size_t j)
+    {
+        return m_quantizedGradients[i]->ColumnSlice(GetStripeStartCol(i, j), GetStripeNumCols(i, j));
+    }
+
+    void ResetState(const std::vector<Matrix<ElemType>*>& gradients, int numEvalNodes, bool resetState)
+    {
+        // When called the first time let's setup the quantization buffers
+        if (!m_initialized)
+        {
+            m_initialized = true;
+            m_quantizer.reset(MatrixQuantizerImpl<ElemType>::Create(CPUDEVICE, false));
+
+            const size_t numNodes = NumProc();
+            const size_t myRank = MyRank();
+            for (size_t i = 0; i < gradients.size(); i++)
+            {
+                // Make sure none of the gradient matrixes are sparse or on the GPU - the exchange is done on the CPU
+                if (gradients[i]->GetMatrixType() != DENSE)
+                    RuntimeError("Gradient aggregation for sparse gradient matrices is currently unsupported!");
+                if (gradients[i]->GetDeviceId() != CPUDEVICE)
+                    RuntimeError("Quantized gradient aggregation without the 1-bit SGD module is only supported for gradients on the CPU!");
+
+                size_t numRows = gradients[i]->GetNumRows();
+                size_t numCols = gradients[i]->GetNumCols();
+                m_residuals.push_back(std::make_unique<Matrix<ElemType>>(Matrix<ElemType>::Zeros(numRows, numCols, CPUDEVICE)));
+                m_quantizedGradients.push_back(std::make_unique<QuantizedMatrix<ElemType>>(numRows, numCols, m_numGradientBits, CPUDEVICE));
+
+                size_t stripeNumCols = GetStripeNumCols(i, myRank);
+                m_stripeSums.push_back(stripeNumCols == 0 ? nullptr : std::make_unique<Matrix<ElemType>>(numRows, stripeNumCols, CPUDEVICE));
+                m_stripeResiduals.push_back(stripeNumCols == 0 ? nullptr : std::make_unique<Matrix<ElemType>>(Matrix<ElemType>::Zeros(numRows, stripeNumCols, CPUDEVICE)));
+
+                m_recvStripes.push_back(std::vector<std::unique_ptr<QuantizedMatrix<ElemType>>>(numNodes));
+                for (size_t j = 0; j < numNodes; ++j)
+                {
+                    if (j != myRank && stripeNumCols > 0)
+                        m_recvStripes[i][j] = std::make_unique<QuantizedMatrix<ElemType>>(numRows, stripeNumCols, m_numGradientBits, CPUDEVICE);
+                }
+            }
+
+            if (m_mpi->IsMainNode())
+            {
+                for (size_t i = 0; i < NumProc() - 1; ++i)
+                    m_recvHeaders.push_back(DistGradHeader::Create(numEvalNodes));
+            }
+        }
+        else if (resetState)
+        {
+            // Drop the quantization errors carried over from before
+            for (size_t i = 0; i < m_residuals.size(); i++)
+            {
+                m_residuals[i]->SetValue(0);
+                if (m_stripeResiduals[i])
+                    m_stripeResiduals[i]->SetValue(0);
+            }
+        }
+    }
+
+private:
+    std::unique_ptr<MatrixQuantizerImpl<ElemType>> m_quantizer;
+
+    const int m_numGradientBits;
+    const bool m_zeroThresholdFor1Bit;
+
+    // Per gradient: the quantization error of the previous minibatch and the quantized gradient
+    std::vector<std::unique_ptr<Matrix<ElemType>>> m_residuals;
+    std::vector<std::unique_ptr<QuantizedMatrix<ElemType>>> m_quantizedGradients;
+
+    // Per gradient, for the stripe of this node: the sum over the nodes, its quantization error and the stripes received from the other nodes
+    // (nullptr if the stripe is empty)
+    std::vector<std::unique_ptr<Matrix<ElemType>>> m_stripeSums;
+    std::vector<std::unique_ptr<Matrix<ElemType>>> m_stripeResiduals;
+    std::vector<std::vector<std::unique_ptr<QuantizedMatrix<ElemType>>>> m_recvStripes;
+
+    std::vector<DistGradHeader*> m_recvHeaders;
+
+    int m_syncStatsTrace;
+
+    // Only used for controlling frequency of measuring/showing gradient aggregation perf stats
+    size_t m_iterationCount;
+
+    bool m_initialized;
+};
+} } }
@@ -16,6 +16,7 @@
 #include "MatrixQuantizerImpl.h"
 #include "InputAndParamNodes.h"
 #include "AccumulatorAggregation.h"
+#include "QuantizedDistGradAggregator.h"
 
 #ifdef CNTK_PARALLEL_TRAINING_SUPPORT
 //static inline bool operator==(const std::pair<double,size_t>& a, double b) { assert(b==0); return a.first == b; }
@@ -1085,6 +1086,9 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
 
             if (m_bufferedAsyncGradientAggregation)
                 fprintf(stderr, ", BufferedAsyncGradientAggregation is ENABLED");
+
+            if (m_distGradAgg->OverlapsAggregationWithBackprop())
+                fprintf(stderr, ", gradient aggregation overlaps backprop in %d KB buckets", (int)(m_gradientBucketSizeInBytes / 1024));
         }
 
         if (useAsyncGradientAggregation)
@@ -1231,6 +1235,10 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
             // We optionally break the minibatch into sub-minibatches.
             // This, when enabled, is used when a full minibatch does not fit into GPU RAM.
             size_t actualNumSubminibatches = numSubminibatchesNeeded <= 1 ? 1 : smbDispatcher.GetMinibatchIntoCache(*trainSetDataReader, *net, *inputMatrices, numSubminibatchesNeeded);
+
+            // Fit the memory sharing to the (sub-)minibatch size if enabled. Nothing has been computed for this minibatch yet.
+            net->PlanMemoryForMinibatchSize((net->GetMBLayoutPtrOfNetwork()->GetNumCols() + actualNumSubminibatches - 1) / actualNumSubminibatches);
+
             for (size_t ismb = 0; ismb < actualNumSubminibatches; ismb++)
             {
                 if (actualNumSubminibatches > 1)
@@ -1253,7 +1261,21 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
                 // ===========================================================
 
                 if (learnRatePerSample > 0.01 * m_minLearnRate) // only compute gradient when learning rate is large enough
-                    net->Backprop(criterionNodes[0]);
+                {
+                    // let the aggregator start aggregating the final gradients while backprop continues
+                    // With sub-minibatches the gradients are only final once the dispatcher has accumulated all of them,
+                    // so they are aggregated after the sub-minibatch loop instead.
+                    if (useGradientAggregation && m_distGradAgg->OverlapsAggregationWithBackprop() && actualNumSubminibatches == 1)
+                    {
+                        net->Backprop(criterionNodes[0], [this](const ComputationNodeBasePtr& node)
+                        {
+                            if (node->IsParameterUpdateRequired())
+                                m_distGradAgg->OnGradientReady(&dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Gradient());
+                        });
+                    }
+                    else
+                        net->Backprop(criterionNodes[0]);
+                }
 
                 // house-keeping for sub-minibatching
                 if (actualNumSubminibatches > 1)
@@ -1378,6 +1400,10 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
 #if 0
             if (numSamplesInMinibatch != aggregateNumSamples)
                 fprintf(stderr, "SGD: using true #samples %d instead of MB size %d\n", (int)numSamplesInMinibatch, (int)aggregateNumSamples);
+#endif
+            auto fusedUpdate = CreateFusedParameterUpdate(numSamplesInMinibatch);
+#ifdef _DEBUG
+            std::vector<ComputationNodeBasePtr> fusedNodes;
 #endif
             auto smoothedGradientIter = smoothedGradients.begin();
             auto smoothedCountIter = smoothedCounts.begin();
@@ -1395,20 +1421,45 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
                     double momentumPerSample = GetMomentumPerSample(epochNumber /*BUGBUG workaround:*/, net->GetMBLayoutPtrOfNetwork()->GetNumParallelSequences());
                     // TODO: Check why l2Factor is not applied to L1. Bug?
                     // BUGBUG (Issue #95): Access to net MBLayout can no longer be done if we have multiple input layouts
-                    UpdateWeights(dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value(),
-                                  dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Gradient(),
-                                  *smoothedGradientIter, *smoothedCountIter,
-                                  nodeDependentLearningRatePerSample, momentumPerSample,
-                                  numSamplesInMinibatch,
-                                  m_L2RegWeight * nodeDependentRegMultiplier, m_L1RegWeight * nodeDependentRegMultiplier,
-                                  m_needAveMultiplier, m_useNesterovMomentum);
-                    node->BumpEvalTimeStamp();
+                    if (!fusedUpdate ||
+                        !AddToFusedParameterUpdate(*fusedUpdate,
+                                                   dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value(),
+                                                   dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Gradient(),
+                                                   *smoothedGradientIter, *smoothedCountIter,
+                                                   nodeDependentLearningRatePerSample, momentumPerSample,
+                                                   numSamplesInMinibatch,
+                                                   m_L2RegWeight * nodeDependentRegMultiplier, m_L1RegWeight * nodeDependentRegMultiplier))
+                    {
+                        UpdateWeights(dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value(),
+                                      dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Gradient(),
+                                      *smoothedGradientIter, *smoothedCountIter,
+                                      nodeDependentLearningRatePerSample, momentumPerSample,
+                                      numSamplesInMinibatch,
+                                      m_L2RegWeight * nodeDependentRegMultiplier, m_L1RegWeight * nodeDependentRegMultiplier,
+                                      m_needAveMultiplier, m_useNesterovMomentum);
+#ifdef _DEBUG
+                        if (dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value().HasNan("TrainOneEpoch/UpdateWeights(): "))
+                            LogicError("%ls %ls operation has NaNs in functionValues after parameter update.", node->NodeName().c_str(), node->OperationName().c_str());
+#endif
+                    }
 #ifdef _DEBUG
-                    if (dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value().HasNan("TrainOneEpoch/UpdateWeights(): "))
-                        LogicError("%ls %ls operation has NaNs in functionValues after parameter update.", node->NodeName().c_str(), node->OperationName().c_str());
+                    else
+                        fusedNodes.push_back(node);
 #endif
+                    node->BumpEvalTimeStamp();
                 }
             }
+
+            // the parameters collected above are updated all at once
+            if (fusedUpdate)
+                fusedUpdate->Apply();
+#ifdef _DEBUG
+            for (auto& node : fusedNodes)
+            {
+                if (dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value().HasNan("TrainOneEpoch/UpdateWeights(): "))
+                    LogicError("%ls %ls operation has NaNs in functionValues after parameter update.", node->NodeName().c_str(), node->OperationName().c_str());
+            }
+#endif
         }
 
 
@@ -2276,7 +2327,9 @@ void SGD<ElemType>::InitDistGradAgg(int numEvalNodes, int numGradientBits, int d
         else
             m_distGradAgg = std::make_shared<AllReduceDistGradAggregator<ElemType>>(m_mpi, numGradientBits, m_zeroThresholdFor1Bit, true /*useQuantizationForSelfStripe*/, m_bufferedAsyncGradientAggregation, traceLevel, m_syncStatsTrace);
 #else
-        RuntimeError("Gradient quantization is unsupported in CNTK binaries built without quantized gradient aggregation support!");
+        if (m_bufferedAsyncGradientAggregation)
+            fprintf(stderr, "WARNING: Buffered async gradient aggregation is not supported with quantization, gradients are aggregated synchronously.\n");
+        m_distGradAgg = std::make_shared<QuantizedDistGradAggregator<ElemType>>(m_mpi, numGradientBits, m_zeroThresholdFor1Bit, m_syncStatsTrace);
 #endif // !CNTK_PARALLEL_TRAINING_SUPPORT
     }
     else
@@ -2286,7 +2339,7 @@ void SGD<ElemType>::InitDistGradAgg(int numEvalNodes, int numGradientBits, int d
         if (Globals::UseV2Aggregator()) // Currently used to check V2 against baselines.
             m_distGradAgg = std::make_shared<V2SimpleDistGradAggregator<ElemType>>(m_mpi, m_bufferedAsyncGradientAggregation, deviceId, m_syncStatsTrace, ::CNTK::MPICommunicator(m_packThresholdSizeInBytes));
         else
-            m_distGradAgg = std::make_shared<SimpleDistGradAggregator<ElemType>>(m_mpi, m_bufferedAsyncGradientAggregation, deviceId, m_syncStatsTrace, m_packThresholdSizeInBytes);
+            m_distGradAgg = std::make_shared<SimpleDistGradAggregator<ElemType>>(m_mpi, m_bufferedAsyncGradientAggregation, deviceId, m_syncStatsTrace, m_packThresholdSizeInBytes, m_gradientBucketSizeInBytes);
     }
 
     m_gradHeader.reset(DistGradHeader::Create(numEvalNodes), [](DistGradHeader* ptr) { DistGradHeader::Destroy(ptr); });
@@ -2438,6 +2491,60 @@ void SGD<ElemType>::UpdateWeights(Matrix<ElemType>& functionValues, Matrix<ElemT
 }
 
 // protected:
+template <class ElemType>
+std::unique_ptr<FusedParameterUpdate<ElemType>> SGD<ElemType>::CreateFusedParameterUpdate(size_t actualMBSize) const
+{
+    // AdaGrad and RmsProp normalize by a multiplier over the whole matrix, and noise is injected per matrix.
+    GradientsUpdateType adpType = GradUpdateType();
+    if (!m_useFusedParameterUpdate || GradientUpdateNoiseStd() > 0 ||
+        (adpType != GradientsUpdateType::None && adpType != GradientsUpdateType::FSAdaGrad))
+        return nullptr;
+
+    typename FusedParameterUpdate<ElemType>::Options options;
+    if (adpType == GradientsUpdateType::FSAdaGrad)
+    {
+        options.rule = FusedParameterUpdate<ElemType>::Rule::FSAdaGrad;
+        options.varMomentum = exp(-1.0 * actualMBSize / m_gradType.varianceTimeConstant);
+    }
+    else
+        options.rule = m_useNesterovMomentum ? FusedParameterUpdate<ElemType>::Rule::Nesterov : FusedParameterUpdate<ElemType>::Rule::MomentumSGD;
+
+    if (m_clippingThresholdPerSample != std::numeric_limits<double>::infinity())
+        options.clippingThreshold = m_clippingThresholdPerSample * actualMBSize;
+    options.clippingWithTruncation = m_gradientClippingWithTruncation;
+
+    return std::unique_ptr<FusedParameterUpdate<ElemType>>(new FusedParameterUpdate<ElemType>(options));
+}
+
+template <class ElemType>
+bool SGD<ElemType>::AddToFusedParameterUpdate(FusedParameterUpdate<ElemType>& fusedUpdate,
+                                              Matrix<ElemType>& functionValues, Matrix<ElemType>& gradientValues,
+                                              Matrix<ElemType>& smoothedGradientValues, double& smoothedCount,
+                                              const double learnRatePerSample, const double momentumPerSample,
+                                              size_t actualMBSize,
+                                              const double L2RegWeight, const double L1RegWeight) const
+{
+    assert(actualMBSize > 0);
+    if (!fusedUpdate.CanAdd(functionValues, gradientValues, smoothedGradientValues))
+        return false;
+
+    // same settings as in UpdateWeights()
+    typename FusedParameterUpdate<ElemType>::ParameterOptions options;
+    options.learningRate = learnRatePerSample;
+    options.momentum = MomentumPerMB(momentumPerSample, actualMBSize);
+    options.l2RegWeight = L2RegWeight * actualMBSize;
+    options.l1Threshold = learnRatePerSample * L1RegWeight * actualMBSize;
+    if (GradUpdateType() == GradientsUpdateType::FSAdaGrad)
+    {
+        const double varMomentum = exp(-1.0 * actualMBSize / m_gradType.varianceTimeConstant);
+        smoothedCount = varMomentum * smoothedCount + (1.0 - varMomentum) * actualMBSize;
+        options.adaMul = m_gradType.targetAdagradAvDenom * sqrt(smoothedCount);
+    }
+
+    fusedUpdate.Add(functionValues, gradientValues, smoothedGradientValues, options);
+    return true;
+}
+
 template <class ElemType>
 void SGD<ElemType>::ClipGradient(Matrix<ElemType>& gradient, const size_t actualMBSize) const
 {
@@ -2965,6 +3072,7 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
 
     m_gradientClippingWithTruncation = configSGD(L"gradientClippingWithTruncation", true);
     m_clippingThresholdPerSample = configSGD(L"clippingThresholdPerSample", numeric_limits<double>::infinity());
+    m_useFusedParameterUpdate = configSGD(L"useFusedParameterUpdate", false);
 
     // sequence-training parameters
     m_hSmoothingWeight = configSGD(L"hSmoothingWeight", 0.95);
@@ -3119,6 +3227,7 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     m_numGradientBits = vector<int>{8 * (int)sizeofElemType}; // means no quantization
     m_zeroThresholdFor1Bit = true;
     m_bufferedAsyncGradientAggregation = false;
+    m_gradientBucketSizeInBytes = 0;
     m_enableDistributedMBReading = false;
     m_parallelizationStartEpochNum = 0;
     m_modelAggregationBlockSize = 0; 
@@ -3152,6 +3261,8 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
             m_numGradientBits = configDataParallelSGD(L"gradientBits", ConfigRecordType::Array(intargvector(vector<int>{defaultGradientBits})));
             m_zeroThresholdFor1Bit = configDataParallelSGD(L"useZeroThresholdFor1BitQuantization", true);
             m_bufferedAsyncGradientAggregation = configDataParallelSGD(L"useBufferedAsyncGradientAggregation", false);
+            if (configDataParallelSGD(L"overlapGradientAggregation", false))
+                m_gradientBucketSizeInBytes = configDataParallelSGD(L"gradientBucketSizeInKB", DEFAULT_GRADIENT_BUCKET_SIZE_IN_KB) * 1024;
             for (size_t i = 0; i < m_numGradientBits.size(); i++)
             {
                 if (m_numGradientBits[i] < 1 || m_numGradientBits[i] > defaultGradientBits)
@@ -20,6 +20,7 @@
 #include "Profiler.h"
 #include "MASGD.h"
 #include "ASGDHelper.h"
+#include "FusedParameterUpdate.h"
 #include <map>
 using namespace std; // ugh! TODO: get rid of this from .h files!!!
 
@@ -211,6 +212,9 @@ protected:
     bool m_gradientClippingWithTruncation;
     double m_clippingThresholdPerSample;
 
+    // update all dense CPU parameters of a minibatch in one fused pass (see FusedParameterUpdate)
+    bool m_useFusedParameterUpdate;
+
     intargvector m_numSamples4Search;
     size_t m_numBestSearchEpoch;
 
@@ -292,6 +296,8 @@ protected:
     // Data parallel SGD training parameters
     intargvector m_numGradientBits;
     bool m_bufferedAsyncGradientAggregation;
+    // overlap the gradient aggregation with backprop in buckets of this size, 0 to aggregate after backprop
+    size_t m_gradientBucketSizeInBytes;
     bool m_zeroThresholdFor1Bit;
 
     // Parallel training related with MA / BM
@@ -531,6 +537,16 @@ public:
 protected:
     void ClipGradient(Matrix<ElemType>& gradient, const size_t actualMBSize) const;
 
+    // Returns the fused update for the current update rule, or nullptr if the rule is only implemented by UpdateWeights().
+    std::unique_ptr<FusedParameterUpdate<ElemType>> CreateFusedParameterUpdate(size_t actualMBSize) const;
+    // Same as UpdateWeights(), but deferred until fusedUpdate.Apply(). Returns false if the parameter has to be updated by UpdateWeights().
+    bool AddToFusedParameterUpdate(FusedParameterUpdate<ElemType>& fusedUpdate,
+                                   Matrix<ElemType>& functionValues, Matrix<ElemType>& gradientValues,
+                                   Matrix<ElemType>& smoothedGradient, double& smoothedCount,
+                                   const double learnRatePerSample, const double momentumPerSample,
+                                   size_t actualMBSize,
+                                   const double L2RegWeight, const double L1RegWeight) const;
+
     void SaveCheckPointInfo(const size_t epoch, const size_t totalSamplesSeen, // TODO: combine totalSamplesSeen and prevCriterion into a EpochCriterion type
                             const double learnRatePerSample,
                             const std::list<Matrix<ElemType>>& smoothedGradients,
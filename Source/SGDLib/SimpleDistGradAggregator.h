@@ -23,10 +23,17 @@ class SimpleDistGradAggregator : public IDistGradAggregator<ElemType>
     UsingIDistGradAggregatorMembers;
 
 public:
-    SimpleDistGradAggregator(const MPIWrapperPtr& mpi, bool useAsyncAggregation, int deviceId, int syncStatsTrace, size_t packThresholdSizeInBytes = DEFAULT_PACK_THRESHOLD_SIZE_IN_BYTES)
+    // A non-zero 'bucketSizeInBytes' overlaps the aggregation with backprop, see OnGradientReady().
+    SimpleDistGradAggregator(const MPIWrapperPtr& mpi, bool useAsyncAggregation, int deviceId, int syncStatsTrace, size_t packThresholdSizeInBytes = DEFAULT_PACK_THRESHOLD_SIZE_IN_BYTES, size_t bucketSizeInBytes = 0)
         : IDistGradAggregator<ElemType>(mpi), m_useAsyncAggregation(useAsyncAggregation), m_initialized(false), m_bufferedGradHeader(nullptr), m_syncStatsTrace(syncStatsTrace),
-        m_iterationCount(0), m_nccl(deviceId, mpi), m_packThresholdSizeInBytes(packThresholdSizeInBytes)
-    {}
+        m_iterationCount(0), m_nccl(deviceId, mpi), m_packThresholdSizeInBytes(packThresholdSizeInBytes), m_bucketSizeInBytes(bucketSizeInBytes), m_useBuckets(false), m_numBucketsStarted(0)
+    {
+        if (m_bucketSizeInBytes > 0 && (useAsyncAggregation || deviceId != CPUDEVICE))
+        {
+            fprintf(stderr, "WARNING: Overlapping gradient aggregation with backprop is only supported for synchronous aggregation on the CPU, gradients will be aggregated after backprop.\n");
+            m_bucketSizeInBytes = 0;
+        }
+    }
 
     ~SimpleDistGradAggregator()
     {
@@ -118,6 +125,11 @@ public:
 
             return false;
         }
+        else if (m_useBuckets)
+        {
+            AggregateGradientsInBuckets(gradients, headerCPU, showSyncPerfStats);
+            return (headerCPU->numSamples != 0);
+        }
         else
         {
             AggregateGradientsImpl(gradients, headerCPU, showSyncPerfStats);
@@ -125,6 +137,39 @@ public:
         }
     }
 
+    bool OverlapsAggregationWithBackprop() const override
+    {
+        return m_bucketSizeInBytes > 0;
+    }
+
+    // The gradients are grouped into buckets of about m_bucketSizeInBytes in the order backprop produces them, which is
+    // recorded during the first minibatch. The allreduce of a bucket starts as soon as its last gradient is final, so
+    // that communication overlaps with the rest of backprop. Buckets are started in the same order on all nodes.
+    void OnGradientReady(Matrix<ElemType>* gradient) override
+    {
+        if (!m_initialized)
+        {
+            if (m_bucketSizeInBytes > 0 && std::find(m_gradientReadyOrder.begin(), m_gradientReadyOrder.end(), gradient) == m_gradientReadyOrder.end())
+                m_gradientReadyOrder.push_back(gradient);
+            return;
+        }
+
+        auto iter = m_gradientBucketIndex.find(gradient);
+        if (!m_useBuckets || iter == m_gradientBucketIndex.end())
+            return;
+
+        auto& bucket = m_buckets[iter->second];
+        if (bucket.m_numPendingGradients == 0)
+            LogicError("OnGradientReady: gradient reported ready twice in the same minibatch.");
+
+        if (--bucket.m_numPendingGradients == 0)
+        {
+            // Buckets complete in order unless backprop order changed, start all complete ones in order.
+            while (m_numBucketsStarted < m_buckets.size() && m_buckets[m_numBucketsStarted].m_numPendingGradients == 0)
+                StartBucketAllReduce(m_buckets[m_numBucketsStarted++]);
+        }
+    }
+
 private:
     std::shared_ptr<ElemType> AllocateIntermediateBuffer(int deviceID, size_t numElements)
     {
@@ -165,10 +210,14 @@ private:
                 m_allocator.reset(new CUDAPageLockedMemAllocator(deviceId));
             }
 
+            if (m_bucketSizeInBytes > 0)
+                CreateBuckets(gradients);
+
             size_t packedGradientsSizeInElements = 0;
             for (size_t i = 0; i < gradients.size(); i++)
             {
-                if (!m_useAsyncAggregation && sizeof(ElemType) * gradients[i]->GetNumElements() <= m_packThresholdSizeInBytes)
+                // Bucketed gradients are packed per bucket instead
+                if (!m_useBuckets && !m_useAsyncAggregation && sizeof(ElemType) * gradients[i]->GetNumElements() <= m_packThresholdSizeInBytes)
                 {
                     packedGradientsSizeInElements += gradients[i]->GetNumElements();
                     m_packedGradientsIndex.push_back(i);
@@ -249,6 +298,151 @@ private:
         }
     }
 
+    // Gradients that are reduced together when overlapping the aggregation with backprop
+    struct GradientBucket
+    {
+        std::vector<Matrix<ElemType>*> m_gradients;
+        std::unique_ptr<Matrix<ElemType>> m_buffer; // packed gradients, nullptr if the bucket holds a single gradient
+        size_t m_numElements = 0;
+        size_t m_numPendingGradients = 0;           // not yet final in the current minibatch
+        MPI_Request m_request;
+    };
+
+    void CreateBuckets(const std::vector<Matrix<ElemType>*>& gradients)
+    {
+        // Gradients in the order backprop produced them in the first minibatch, then the ones it did not produce.
+        // Without a recorded order the gradients are taken in reverse, which is backprop order if they come in evaluation order.
+        std::vector<size_t> order;
+        for (auto gradient : m_gradientReadyOrder)
+        {
+            auto iter = std::find(gradients.begin(), gradients.end(), gradient);
+            if (iter != gradients.end())
+                order.push_back(iter - gradients.begin());
+        }
+        for (size_t i = gradients.size(); i-- > 0;)
+        {
+            if (std::find(order.begin(), order.end(), i) == order.end())
+                order.push_back(i);
+        }
+        m_gradientReadyOrder.clear();
+
+        // All nodes must form the same buckets, use the order of the main node.
+        m_mpi->Bcast(order.data(), order.size(), m_mpi->MainNodeRank());
+
+        const size_t bucketSizeInElements = std::max<size_t>(1, m_bucketSizeInBytes / sizeof(ElemType));
+        m_buckets.clear();
+        m_gradientBucketIndex.clear();
+        for (size_t i : order)
+        {
+            size_t numElements = gradients[i]->GetNumElements();
+            if (m_buckets.empty() || (m_buckets.back().m_numElements > 0 && m_buckets.back().m_numElements + numElements > bucketSizeInElements))
+                m_buckets.push_back(GradientBucket());
+
+            m_buckets.back().m_gradients.push_back(gradients[i]);
+            m_buckets.back().m_numElements += numElements;
+            m_gradientBucketIndex[gradients[i]] = m_buckets.size() - 1;
+        }
+
+        for (auto& bucket : m_buckets)
+        {
+            // Buckets with a single gradient are reduced in place
+            if (bucket.m_gradients.size() > 1)
+                bucket.m_buffer.reset(new Matrix<ElemType>(1, bucket.m_numElements, CPUDEVICE));
+            bucket.m_numPendingGradients = bucket.m_gradients.size();
+        }
+
+        m_numBucketsStarted = 0;
+        m_useBuckets = !m_buckets.empty();
+    }
+
+    void StartBucketAllReduce(GradientBucket& bucket)
+    {
+        ElemType* reductionBuffer = bucket.m_gradients[0]->Data();
+        if (bucket.m_buffer)
+        {
+            size_t offset = 0;
+            for (auto gradient : bucket.m_gradients)
+            {
+                bucket.m_buffer->ColumnSlice(offset, gradient->GetNumElements()).AssignValuesOf(gradient->Reshaped(1, gradient->GetNumElements()));
+                offset += gradient->GetNumElements();
+            }
+            reductionBuffer = bucket.m_buffer->Data();
+        }
+
+        m_mpi->AllReduceAsync(reductionBuffer, bucket.m_numElements, &bucket.m_request);
+    }
+
+    void AggregateGradientsInBuckets(const std::vector<Matrix<ElemType>*>& gradients, DistGradHeader* headerCPU, bool showSyncPerfStats)
+    {
+        Timer aggregationTimer;
+        if (showSyncPerfStats)
+            aggregationTimer.Start();
+
+        if (headerCPU->numSamples == 0)
+        {
+            assert(headerCPU->criterion == 0.0);
+            assert(headerCPU->numSamplesWithLabel == 0);
+
+            // If the current node did not process any samples, there was no backprop and the gradients should be zero'd
+            if (m_numBucketsStarted > 0)
+                LogicError("Gradients were reported ready for aggregation in a minibatch without samples!");
+
+            for (size_t i = 0; i < gradients.size(); ++i)
+                gradients[i]->SetValue(0);
+        }
+
+        // Start the buckets whose gradients were not reported ready, i.e. all of them if backprop was skipped or ran
+        // in sub-minibatches (the accumulated gradients only become final after backprop, see SGD::TrainOneEpoch())
+        while (m_numBucketsStarted < m_buckets.size())
+            StartBucketAllReduce(m_buckets[m_numBucketsStarted++]);
+
+        // Aggregate the header while the gradients are being reduced
+        // We use a tag of 'numGradMatrices' for the pre-aggregation header
+        MPI_Request sendHeaderRequest;
+        if (m_mpi->IsMainNode())
+        {
+            for (size_t j = 0; j < NumProc() - 1; ++j)
+            {
+                int source = (j >= MyRank()) ? (j + 1) : j;
+                m_mpi->Recv(m_recvHeaders[j], m_recvHeaders[j]->Size(), MPI_CHAR, source, gradients.size(), MPI_STATUS_IGNORE) || MpiFail("MPI_Recv");
+                headerCPU->Aggregate(m_recvHeaders[j], true);
+            }
+        }
+        else
+            m_mpi->Isend(headerCPU, headerCPU->Size(), MPI_CHAR, m_mpi->MainNodeRank(), gradients.size(), &sendHeaderRequest) || MpiFail("MPI_Isend");
+
+        // Broadcast the aggregated header to all nodes
+        m_mpi->Bcast(headerCPU, headerCPU->Size(), MPI_CHAR, m_mpi->MainNodeRank());
+
+        // Wait for the allreduce operations to finish and copy the packed gradients back
+        for (auto& bucket : m_buckets)
+        {
+            m_mpi->Wait(&bucket.m_request, MPI_STATUSES_IGNORE) || MpiFail("MPI_Wait");
+            if (bucket.m_buffer)
+            {
+                size_t offset = 0;
+                for (auto gradient : bucket.m_gradients)
+                {
+                    gradient->AssignValuesOf(bucket.m_buffer->ColumnSlice(offset, gradient->GetNumElements()).Reshaped(gradient->GetNumRows(), gradient->GetNumCols()));
+                    offset += gradient->GetNumElements();
+                }
+            }
+            bucket.m_numPendingGradients = bucket.m_gradients.size();
+        }
+        m_numBucketsStarted = 0;
+
+        // Wait for completion of the async send requests
+        if (!m_mpi->IsMainNode())
+            m_mpi->Wait(&sendHeaderRequest, MPI_STATUSES_IGNORE) || MpiFail("MPI_Wait");
+
+        if (showSyncPerfStats)
+        {
+            aggregationTimer.Stop();
+            double gradientAggregationTime = aggregationTimer.ElapsedSeconds();
+            fprintf(stderr, "Gradient aggregation time after backprop: %.6g\n", gradientAggregationTime);
+        }
+    }
+
     void AggregateGradientsImpl(const std::vector<Matrix<ElemType>*>& gradients, DistGradHeader* headerCPU, bool showSyncPerfStats)
     {
         Timer aggregationTimer;
@@ -463,6 +657,14 @@ private:
     std::vector<size_t> m_packedGradientsIndex;
     std::vector<size_t> m_gradientIndexToAggregate;
 
+    // Overlapping the aggregation with backprop (see OnGradientReady)
+    size_t m_bucketSizeInBytes; // 0 if not overlapping
+    bool m_useBuckets;
+    std::vector<GradientBucket> m_buckets;
+    std::unordered_map<const Matrix<ElemType>*, size_t> m_gradientBucketIndex;
+    std::vector<Matrix<ElemType>*> m_gradientReadyOrder; // recorded before the buckets are created
+    size_t m_numBucketsStarted;                          // buckets are started in order
+
     int m_syncStatsTrace;
 
     // Only used for controlling frequency of measuring/showing gradient aggregation perf stats
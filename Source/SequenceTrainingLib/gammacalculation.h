@@ -8,6 +8,7 @@
 #include "Matrix.h"
 #include "CUDAPageLockedMemAllocator.h"
 
+#include <exception>
 #include <memory>
 #include <vector>
 
@@ -100,7 +101,6 @@ public:
     {
         // check total frame number to be added ?
         // int deviceid = loglikelihood.GetDeviceId();
-        size_t boundaryframenum;
         std::vector<size_t> validframes; // [s] cursor pointing to next utterance begin within a single parallel sequence [s]
         validframes.assign(samplesInRecurrentStep, 0);
         ElemType objectValue = 0.0;
@@ -126,6 +126,82 @@ public:
             assert(T == pMBLayout->GetNumTimeSteps());
         }
 
+        // On the CPU the lattices of the minibatch are processed in parallel: the logLLs of all utterances are copied first,
+        // then forwardbackward() runs on multiple threads, each writing only the stripes of its own utterance, and finally
+        // the gammas and the objective are collected in utterance order, so the results are the same as when done serially.
+        // On the GPU the lattices share the device-side state and are processed one after another.
+        const bool parallelcpu = m_deviceid == CPUDEVICE && !parallellattice.enabled() && lattices.size() > 1;
+
+        std::vector<size_t> latticets(lattices.size());          // [i] first column of utterance [i] in pred, dengammas, uids and boundaries
+        std::vector<size_t> latticemapi(lattices.size());        // [i] parallel-sequence index of utterance [i]
+        std::vector<size_t> latticevalidframes(lattices.size()); // [i] first time step of utterance [i] within its parallel sequence
+        std::vector<double> numavlogps(lattices.size());
+        std::vector<double> denavlogps(lattices.size());
+
+        // compute the denominator gammas for utterance [i]
+        auto calgammaforlattice = [&](size_t i)
+        {
+            const size_t ts = latticets[i];
+            const size_t numframes = lattices[i]->getnumframes();
+
+            msra::dbn::matrixstripe predstripe(pred, ts, numframes);           // logLLs for this utterance
+            msra::dbn::matrixstripe dengammasstripe(dengammas, ts, numframes); // denominator gammas
+            array_ref<size_t> uidsstripe(&uids[ts], numframes);
+            array_ref<size_t> boundariesstripe(&boundaries[ts], doreferencealign ? numframes : 0);
+
+            // auto_timer dengammatimer;
+            denavlogps[i] = lattices[i]->second.forwardbackward(parallellattice,
+                                                                (const msra::math::ssematrixbase&) predstripe, (const msra::asr::simplesenonehmm&) m_hset,
+                                                                (msra::math::ssematrixbase&) dengammasstripe, (msra::math::ssematrixbase&) gammasbuffer /*empty, not used*/,
+                                                                lmf, wp, amf, boostmmifactor, seqsMBRmode, uidsstripe, boundariesstripe);
+        };
+
+        // copy the gammas and the reference alignment of utterance [i] into the CNTK matrices and add up the objective
+        auto collectgammaforlattice = [&](size_t i)
+        {
+            const size_t ts = latticets[i];
+            const size_t numframes = lattices[i]->getnumframes();
+            const size_t mapi = latticemapi[i];
+
+            msra::dbn::matrixstripe dengammasstripe(dengammas, ts, numframes);
+            array_ref<size_t> uidsstripe(&uids[ts], numframes);
+
+            objectValue += (ElemType)((numavlogps[i] - denavlogps[i]) * numframes);
+
+            if (samplesInRecurrentStep == 1)
+            {
+                tempmatrix = gammafromlattice.ColumnSlice(ts, numframes);
+            }
+
+            // copy gamma to tempmatrix
+            if (m_deviceid == CPUDEVICE)
+            {
+                CopyFromSSEMatrixToCNTKMatrix(dengammasstripe, numrows, numframes, tempmatrix, gammafromlattice.GetDeviceId());
+            }
+            else
+                parallellattice.getgamma(tempmatrix);
+
+            // set gamma for multi channel
+            if (samplesInRecurrentStep > 1)
+            {
+                Microsoft::MSR::CNTK::Matrix<ElemType> gammaFromLatticeForCurrentParallelUtterance = gammafromlattice.ColumnSlice(mapi + (latticevalidframes[i] * samplesInRecurrentStep), ((numframes - 1) * samplesInRecurrentStep) + 1);
+                gammaFromLatticeForCurrentParallelUtterance.CopyColumnsStrided(tempmatrix, numframes, 1, samplesInRecurrentStep);
+            }
+
+            if (doreferencealign)
+            {
+                for (size_t nframe = 0; nframe < numframes; nframe++)
+                {
+                    size_t uid = uidsstripe[nframe];
+                    if (samplesInRecurrentStep > 1)
+                        labels(uid, (nframe + latticevalidframes[i]) * samplesInRecurrentStep + mapi) = 1.0;
+                    else
+                        labels(uid, ts + nframe) = 1.0;
+                }
+            }
+            fprintf(stderr, "dengamma value %f\n", denavlogps[i]);
+        };
+
         size_t mapi = 0; // parallel-sequence index for utterance [i]
         // cal gamma for each utterance
         size_t ts = 0;
@@ -186,16 +262,13 @@ public:
                 }
             }
 
-            array_ref<size_t> uidsstripe(&uids[ts], numframes);
+            latticets[i] = ts;
+            latticemapi[i] = mapi;
+            latticevalidframes[i] = validframes[mapi];
 
-            if (doreferencealign)
-            {
-                boundaryframenum = numframes;
-            }
-            else
-                boundaryframenum = 0;
-            array_ref<size_t> boundariesstripe(&boundaries[ts], boundaryframenum);
+            array_ref<size_t> uidsstripe(&uids[ts], numframes);
 
+            // the numerator score is taken before forwardbackward() may overwrite the uids with the reference alignment
             double numavlogp = 0;
             foreach_column (t, dengammasstripe) // we do not allocate memory for numgamma now, should be the same as numgammasstripe
             {
@@ -203,49 +276,41 @@ public:
                 numavlogp += predstripe(s, t) / amf;
             }
             numavlogp /= numframes;
+            numavlogps[i] = numavlogp;
 
-            // auto_timer dengammatimer;
-            double denavlogp = lattices[i]->second.forwardbackward(parallellattice,
-                                                                   (const msra::math::ssematrixbase&) predstripe, (const msra::asr::simplesenonehmm&) m_hset,
-                                                                   (msra::math::ssematrixbase&) dengammasstripe, (msra::math::ssematrixbase&) gammasbuffer /*empty, not used*/,
-                                                                   lmf, wp, amf, boostmmifactor, seqsMBRmode, uidsstripe, boundariesstripe);
-            objectValue += (ElemType)((numavlogp - denavlogp) * numframes);
-
-            if (samplesInRecurrentStep == 1)
-            {
-                tempmatrix = gammafromlattice.ColumnSlice(ts, numframes);
-            }
-
-            // copy gamma to tempmatrix
-            if (m_deviceid == CPUDEVICE)
+            if (!parallelcpu)
             {
-                CopyFromSSEMatrixToCNTKMatrix(dengammas, numrows, numframes, tempmatrix, gammafromlattice.GetDeviceId());
+                calgammaforlattice(i);
+                collectgammaforlattice(i);
             }
-            else
-                parallellattice.getgamma(tempmatrix);
 
-            // set gamma for multi channel
             if (samplesInRecurrentStep > 1)
-            {
-                Microsoft::MSR::CNTK::Matrix<ElemType> gammaFromLatticeForCurrentParallelUtterance = gammafromlattice.ColumnSlice(mapi + (validframes[mapi] * samplesInRecurrentStep), ((numframes - 1) * samplesInRecurrentStep) + 1);
-                gammaFromLatticeForCurrentParallelUtterance.CopyColumnsStrided(tempmatrix, numframes, 1, samplesInRecurrentStep);
-            }
+                validframes[mapi] += numframes; // advance the cursor within the parallel sequence
+            ts += numframes;
+        }
 
-            if (doreferencealign)
+        if (parallelcpu)
+        {
+            std::exception_ptr latticeexception;
+#pragma omp parallel for schedule(dynamic)
+            for (int i = 0; i < (int) lattices.size(); i++)
             {
-                for (size_t nframe = 0; nframe < numframes; nframe++)
+                try
                 {
-                    size_t uid = uidsstripe[nframe];
-                    if (samplesInRecurrentStep > 1)
-                        labels(uid, (nframe + validframes[mapi]) * samplesInRecurrentStep + mapi) = 1.0;
-                    else
-                        labels(uid, ts + nframe) = 1.0;
+                    calgammaforlattice(i);
+                }
+                catch (...)
+                {
+#pragma omp critical(calgammaformbexception)
+                    if (!latticeexception)
+                        latticeexception = std::current_exception();
                 }
             }
-            if (samplesInRecurrentStep > 1)
-                validframes[mapi] += numframes; // advance the cursor within the parallel sequence
-            fprintf(stderr, "dengamma value %f\n", denavlogp);
-            ts += numframes;
+            if (latticeexception)
+                std::rethrow_exception(latticeexception);
+
+            for (size_t i = 0; i < lattices.size(); i++)
+                collectgammaforlattice(i);
         }
         functionValues.SetValue(objectValue);
     }
@@ -15,12 +15,16 @@
 #include <unordered_map>
 #include <list>
 #include <stdexcept>
+#include <exception>
 
 using namespace std;
 
 #define VIRGINLOGZERO (10 * LOGZERO) // used for printing statistics on unseen states
 #undef CPU_VERIFICATION
 
+// lattices with fewer edges are aligned by a single thread, the threading overhead would outweigh the gain
+static const size_t parallelforwardbackwardminedges = 256;
+
 #ifdef _WIN32
 int msra::numa::node_override = -1; // for numahelpers.h
 #endif
@@ -952,26 +956,50 @@ void lattice::forwardbackwardalign(parallelstate &parallelstate,
             parallelstate.getedgeacscores(edgeacscoresgpu);
             parallelstate.copyalignments(thisedgealignmentsgpu);
         }
-        foreach_index (j, edges)
+        // The edges are independent of each other and each writes only its own score, gammas and alignment, so large
+        // lattices are processed by multiple threads with results identical to the serial loop. When called for multiple
+        // lattices in parallel (see GammaCalculation), this region is nested and therefore runs on the calling thread only.
+        thisedgealignments.getalignmentsbuffer(); // operator[] allocates the buffer on first use, do it before going parallel
+        std::exception_ptr edgeexception;
+#pragma omp parallel for schedule(dynamic, 16) if (edges.size() >= parallelforwardbackwardminedges && !cpuverification)
+        for (int j = 0; j < (int) edges.size(); j++)
         {
-            const edgeinfowithscores &e = edges[j];
-            const size_t ts = nodes[e.S].t;
-            const size_t te = nodes[e.E].t;
-            if (ts == te) // dummy !NULL edge at end
-                edgeacscores[j] = 0.0f;
-            else
+            try
             {
-                const auto &aligntokens = getaligninfo(j); // get alignment tokens
-                const auto edgeLLs = msra::math::ssematrixstriperef<msra::math::ssematrixbase>(const_cast<msra::math::ssematrixbase &>(logLLs), ts, te - ts);
-                if (minlogpp > LOGZERO && origlogpps[j] < minlogpp)
-                    edgeacscores[j] = LOGZERO; // will kill word level forwardbackward hypothesis
-                else if (softalignstates)
-                    edgeacscores[j] = forwardbackwardedge(aligntokens, hset, edgeLLs, *abcs[j], j);
+                const edgeinfowithscores &e = edges[j];
+                const size_t ts = nodes[e.S].t;
+                const size_t te = nodes[e.E].t;
+                if (ts == te) // dummy !NULL edge at end
+                    edgeacscores[j] = 0.0f;
                 else
-                    edgeacscores[j] = alignedge(aligntokens, hset, edgeLLs, *abcs[j], j, returnsenoneids, thisedgealignments[j]);
+                {
+                    const auto &aligntokens = getaligninfo(j); // get alignment tokens
+                    const auto edgeLLs = msra::math::ssematrixstriperef<msra::math::ssematrixbase>(const_cast<msra::math::ssematrixbase &>(logLLs), ts, te - ts);
+                    if (minlogpp > LOGZERO && origlogpps[j] < minlogpp)
+                        edgeacscores[j] = LOGZERO; // will kill word level forwardbackward hypothesis
+                    else if (softalignstates)
+                        edgeacscores[j] = forwardbackwardedge(aligntokens, hset, edgeLLs, *abcs[j], j);
+                    else
+                        edgeacscores[j] = alignedge(aligntokens, hset, edgeLLs, *abcs[j], j, returnsenoneids, thisedgealignments[j]);
+                }
+            }
+            catch (...)
+            {
+#pragma omp critical(forwardbackwardalignexception)
+                if (!edgeexception)
+                    edgeexception = std::current_exception();
             }
+        }
+        if (edgeexception)
+            std::rethrow_exception(edgeexception);
+
+        foreach_index (j, edges)
+        {
             if (cpuverification)
             {
+                const edgeinfowithscores &e = edges[j];
+                const size_t ts = nodes[e.S].t;
+                const size_t te = nodes[e.E].t;
                 const auto &aligntokens = getaligninfo(j); // get alignment tokens
                 bool edgehassil = false;
                 foreach_index (i, aligntokens)
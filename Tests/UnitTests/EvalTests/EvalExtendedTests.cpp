@@ -7,6 +7,7 @@
 #include "ComputationNode.h"
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
+#include <thread>
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -292,9 +293,10 @@ BOOST_AUTO_TEST_CASE(EvalSparseTimesTest)
     eval->Destroy();
 }
 
-BOOST_AUTO_TEST_CASE(EvalRNNTest)
+// Single LSTM layer with 4 inputs and 4 outputs
+static std::string LSTMModelDefinition()
 {
-    std::string modelDefinition =
+    return
         "deviceId = -1 \n"
         "precision = \"float\" \n"
         "traceLevel = 1 \n"
@@ -350,6 +352,11 @@ BOOST_AUTO_TEST_CASE(EvalRNNTest)
             "FeatureNodes = (i1) \n"
             "outputNodes = (o1) \n"
          "] \n";
+}
+
+BOOST_AUTO_TEST_CASE(EvalRNNTest)
+{
+    std::string modelDefinition = LSTMModelDefinition();
 
     VariableSchema inputLayouts;
     VariableSchema outputLayouts;
@@ -415,5 +422,145 @@ BOOST_AUTO_TEST_CASE(EvalRNNTest)
     eval->Destroy();
 }
 
+BOOST_AUTO_TEST_CASE(EvalConcurrentRNNTest)
+{
+    const size_t featDim = 4;
+    const size_t numRequests = 48;
+
+    std::vector<Values<float>> inputs(numRequests, Values<float>(1));
+    for (size_t k = 0; k < numRequests; k++)
+    {
+        size_t length = 1 + k % 3;
+        for (size_t i = 0; i < featDim * length; i++)
+            inputs[k][0].m_buffer.push_back((float)((i + k) % 5) / 5);
+    }
+
+    // Expected results, one request at a time.
+    VariableSchema inputLayouts;
+    VariableSchema outputLayouts;
+    IEvaluateModelExtended<float>* eval = SetupNetworkAndGetLayouts(LSTMModelDefinition(), inputLayouts, outputLayouts);
+    std::vector<Values<float>> expected;
+    for (size_t k = 0; k < numRequests; k++)
+    {
+        expected.push_back(outputLayouts.CreateBuffers<float>({ 3 }));
+        eval->ForwardPass(inputs[k], expected[k]);
+    }
+    eval->Destroy();
+
+    // More threads than evaluation contexts, so that the contexts are shared between the threads.
+    GetEvalExtendedF(&eval);
+    eval->Init("maxNumEvaluationContexts=3");
+    eval->CreateNetwork(LSTMModelDefinition());
+    eval->StartForwardEvaluation({ outputLayouts[0].m_name });
+
+    const size_t numThreads = 8;
+    const size_t numRounds = 4;
+    std::vector<Values<float>> outputs;
+    for (size_t k = 0; k < numRequests; k++)
+        outputs.push_back(outputLayouts.CreateBuffers<float>({ 3 }));
+
+    for (size_t round = 0; round < numRounds; round++)
+    {
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < numThreads; t++)
+        {
+            threads.push_back(std::thread([&, t]()
+            {
+                for (size_t k = t; k < numRequests; k += numThreads)
+                    eval->ForwardPass(inputs[(k + round) % numRequests], outputs[(k + round) % numRequests]);
+            }));
+        }
+        for (auto& thread : threads)
+            thread.join();
+
+        for (size_t k = 0; k < numRequests; k++)
+        {
+            const auto& result = outputs[k][0].m_buffer;
+            const auto& reference = expected[k][0].m_buffer;
+            BOOST_REQUIRE_EQUAL(result.size(), reference.size());
+            for (size_t i = 0; i < result.size(); i++)
+                BOOST_CHECK_CLOSE(result[i], reference[i], 1e-3);
+        }
+    }
+
+    eval->Destroy();
+}
+
+BOOST_AUTO_TEST_CASE(EvalBatchingRNNTest)
+{
+    const size_t featDim = 4;
+    const size_t numRequests = 64;
+
+    // Sequences of different lengths, so that the batches contain gaps.
+    std::vector<Values<float>> inputs(numRequests, Values<float>(1));
+    for (size_t k = 0; k < numRequests; k++)
+    {
+        size_t length = 1 + k % 5;
+        for (size_t i = 0; i < featDim * length; i++)
+            inputs[k][0].m_buffer.push_back((float)((i + k) % 7) / 7);
+    }
+
+    // Expected results, one request at a time.
+    VariableSchema inputLayouts;
+    VariableSchema outputLayouts;
+    IEvaluateModelExtended<float>* eval = SetupNetworkAndGetLayouts(LSTMModelDefinition(), inputLayouts, outputLayouts);
+    std::vector<Values<float>> expected;
+    for (size_t k = 0; k < numRequests; k++)
+    {
+        expected.push_back(outputLayouts.CreateBuffers<float>({ 5 }));
+        eval->ForwardPass(inputs[k], expected[k]);
+    }
+    eval->Destroy();
+
+    IEvaluateModelBatching<float>* batchingEval;
+    GetEvalBatchingF(&batchingEval);
+    batchingEval->Init("maxBatchSize=16 maxWaitTimeMs=20");
+    batchingEval->CreateNetwork(LSTMModelDefinition());
+    batchingEval->StartForwardEvaluation({ outputLayouts[0].m_name });
+
+    // Malformed requests are rejected without affecting others.
+    Values<float> wrongInput(1);
+    wrongInput[0].m_buffer = { 1, 2, 3 };
+    Values<float> wrongOutput = outputLayouts.CreateBuffers<float>({ 1 });
+    BOOST_REQUIRE_THROW(batchingEval->ForwardPass(wrongInput, wrongOutput), std::exception);
+
+    // Concurrent requests from several clients.
+    const size_t numClients = 8;
+    std::vector<Values<float>> outputs;
+    for (size_t k = 0; k < numRequests; k++)
+        outputs.push_back(outputLayouts.CreateBuffers<float>({ 5 }));
+
+    std::vector<std::thread> clients;
+    for (size_t c = 0; c < numClients; c++)
+    {
+        clients.push_back(std::thread([&, c]()
+        {
+            for (size_t k = c; k < numRequests; k += numClients)
+                batchingEval->ForwardPass(inputs[k], outputs[k]);
+        }));
+    }
+    for (auto& client : clients)
+        client.join();
+
+    for (size_t k = 0; k < numRequests; k++)
+    {
+        const auto& result = outputs[k][0].m_buffer;
+        const auto& reference = expected[k][0].m_buffer;
+        BOOST_REQUIRE_EQUAL(result.size(), reference.size());
+        for (size_t i = 0; i < result.size(); i++)
+            BOOST_CHECK_CLOSE(result[i], reference[i], 1e-3);
+    }
+
+    BatchingStatistics statistics = batchingEval->GetStatistics();
+    BOOST_CHECK_EQUAL(statistics.m_numRequests, numRequests);
+    BOOST_CHECK(statistics.m_numBatches < numRequests);
+    size_t numBatches = 0;
+    for (auto count : statistics.m_batchSizeHistogram)
+        numBatches += count;
+    BOOST_CHECK_EQUAL(numBatches, statistics.m_numBatches);
+
+    batchingEval->Destroy();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }}}}
@@ -9,12 +9,15 @@
 //#include "Windows.h"
 #include "Matrix.h"
 #include "CPUMatrix.h"
+#include "CPUSparseMatrix.h"
 #include "TensorView.h"
 #include "Sequences.h"
 #include <chrono>
 #include <iostream>
 #include <vector>
 #include <algorithm>
+#include <functional>
+#include <random>
 
 using namespace Microsoft::MSR::CNTK;
 using namespace std;
@@ -336,8 +339,62 @@ void MandSTest(int count, int devId)
     delete[] data3;
 }
 
+// Sparse input layer shapes: forward W * X, backward (into a sparse block column gradient) dY * X',
+// and the dense gradient of a transposed product X' * W' with X(vocab x batch) having 'nnzPerColumn' ones per column.
+// Wall clock time is reported since the kernels are multithreaded.
+template <class ElemType>
+void SparseTimesDenseTest(size_t hidden, size_t vocab, size_t batch, size_t nnzPerColumn, int count)
+{
+    cout << "W(" << hidden << "x" << vocab << ") and X(" << vocab << "x" << batch << ") with " << nnzPerColumn << " nonzeros per column" << endl;
+
+    mt19937 rng(1);
+    uniform_int_distribution<size_t> rowDistribution(0, vocab - 1);
+    vector<CPUSPARSE_INDEX_TYPE> colStarts(batch + 1);
+    vector<CPUSPARSE_INDEX_TYPE> rows;
+    for (size_t j = 0; j < batch; j++)
+    {
+        colStarts[j] = (CPUSPARSE_INDEX_TYPE) rows.size();
+        vector<CPUSPARSE_INDEX_TYPE> column;
+        for (size_t i = 0; i < nnzPerColumn; i++)
+            column.push_back((CPUSPARSE_INDEX_TYPE) rowDistribution(rng));
+        sort(column.begin(), column.end());
+        column.erase(unique(column.begin(), column.end()), column.end());
+        rows.insert(rows.end(), column.begin(), column.end());
+    }
+    colStarts[batch] = (CPUSPARSE_INDEX_TYPE) rows.size();
+    vector<ElemType> values(rows.size(), 1);
+
+    CPUSparseMatrix<ElemType> X(matrixFormatSparseCSC, vocab, batch, rows.size());
+    X.SetMatrixFromCSCFormat(colStarts.data(), rows.data(), values.data(), rows.size(), vocab, batch);
+
+    CPUMatrix<ElemType> W(hidden, vocab);
+    W.SetUniformRandomValue(-1, 1, 1);
+    CPUMatrix<ElemType> Y(hidden, batch);
+    CPUMatrix<ElemType> YT(batch, hidden);
+    CPUSparseMatrix<ElemType> gradient(matrixFormatSparseBlockCol, hidden, vocab, 0);
+
+    auto measure = [count](const char* name, const function<void()>& f)
+    {
+        f(); // warm up
+        auto t_start = chrono::steady_clock::now();
+        for (int i = 0; i < count; ++i)
+            f();
+        auto t_end = chrono::steady_clock::now();
+        cout << name << ": " << chrono::duration<double, milli>(t_end - t_start).count() / count << " ms" << endl;
+    };
+
+    measure("W * X (dense)", [&] { CPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(1, W, false, X, false, 0, Y); });
+    measure("dY * X' (block column)", [&] { gradient.Reset(); CPUSparseMatrix<ElemType>::MultiplyAndAdd(1, Y, false, X, true, gradient); });
+    measure("X' * W' (dense)", [&] { CPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(1, X, true, W, true, 0, YT); });
+}
+
 int wmain()
 {
+    cout << endl << "********************CPUSparseMatrix sparse times dense TEST********************" << endl;
+    SparseTimesDenseTest<float>(512, 100000, 256, 20, 10);
+    SparseTimesDenseTest<float>(128, 1000000, 1024, 50, 10);
+    SparseTimesDenseTest<float>(1024, 50000, 32, 1, 100);
+
     // MandSTest<float>(100, 2);
 
     /*cout<<endl<<"********************Matrix SquareMultiplyAndWeightedAdd10TimesAvg TEST********************"<<endl;
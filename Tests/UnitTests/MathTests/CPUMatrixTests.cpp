@@ -4,6 +4,10 @@
 //
 #include "stdafx.h"
 #include "../../../Source/Math/CPUMatrix.h"
+#include "../../../Source/Math/RNNCommon.h"
+#include "../../../Source/Math/CPUCachingMemAllocator.h"
+#include <random>
+#include <thread>
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -1087,6 +1091,290 @@ BOOST_FIXTURE_TEST_CASE(CPUMatrixGatherFromTarget, RandomSeedFixture)
     BOOST_CHECK(m2.IsEqualTo(expect, 1e-6));
 }
 
+BOOST_FIXTURE_TEST_CASE(CPUMatrixRNNForwardBidirectional, RandomSeedFixture)
+{
+    // a single-unit bidirectional tanh RNN over two sequences of length 2 and 1, packed by frame:
+    // columns are (t=0, s=0), (t=0, s=1), (t=1, s=0)
+    RnnAttributes attributes(/*bidirectional=*/true, /*numLayers=*/1, /*hiddenSize=*/1, L"rnnTanh", /*axis=*/-1);
+    vector<size_t> numSequencesForFrame = {2, 1};
+
+    // cuDNN layout: W and R per direction, followed by the input and recurrent bias per direction
+    std::array<double, 8> params = {0.5, 0.25, -0.5, 0.5, 0.1, -0.1, 0, 0};
+    DMatrix paramW(8, 1, params.data(), matrixFlagNormal);
+    std::array<double, 3> input = {1, 2, 3};
+    DMatrix inputX(1, 3, input.data(), matrixFlagNormal);
+
+    DMatrix outputY(2, 3);
+    DMatrix workspace;
+    outputY.RNNForward(inputX, paramW, 1, 2, numSequencesForFrame, attributes, workspace);
+
+    DMatrix expect(2, 3);
+    expect(0, 0) = tanh(0.5 * 1);
+    expect(0, 1) = tanh(0.5 * 2);
+    expect(0, 2) = tanh(0.5 * 3 + 0.25 * expect(0, 0));
+    expect(1, 2) = tanh(-0.5 * 3);
+    expect(1, 1) = tanh(-0.5 * 2);
+    expect(1, 0) = tanh(-0.5 * 1 + 0.5 * expect(1, 2));
+    BOOST_CHECK(outputY.IsEqualTo(expect, 1e-10));
+}
+
+// The forward pass of an RNN stack computed with scalar loops, one sequence at a time, straight from the cuDNN parameter
+// layout: for every layer and direction W [inputDim x numGates*hiddenSize] and R [hiddenSize x numGates*hiddenSize]
+// (column-major), then for every layer and direction the input and the recurrent bias. sequences[s][t] is the input of
+// sequence s at time t, the result is the output in the same form.
+static vector<vector<vector<double>>> RNNForwardReference(const vector<double>& params, const vector<vector<vector<double>>>& sequences,
+                                                          size_t xDim, const RnnAttributes& attributes)
+{
+    const wstring& op = attributes.m_recurrentOp;
+    const size_t H = attributes.m_hiddenSize;
+    const size_t numDirections = attributes.m_bidirectional ? 2 : 1;
+    const size_t numGates = op == L"lstm" ? 4 : op == L"gru" ? 3 : 1;
+    const size_t gateDim = numGates * H;
+    auto sigmoid = [](double x) { return 1 / (1 + exp(-x)); };
+
+    size_t weightOffset = 0, biasOffset = 0;
+    for (size_t layer = 0; layer < attributes.m_numLayers; layer++)
+        biasOffset += numDirections * ((layer == 0 ? xDim : numDirections * H) + H) * gateDim;
+
+    auto layerInput = sequences;
+    for (size_t layer = 0; layer < attributes.m_numLayers; layer++)
+    {
+        const size_t inputDim = layer == 0 ? xDim : numDirections * H;
+        auto layerOutput = layerInput;
+        for (auto& sequence : layerOutput)
+            for (auto& frame : sequence)
+                frame.assign(numDirections * H, 0);
+
+        for (size_t dir = 0; dir < numDirections; dir++)
+        {
+            const double* W = &params[weightOffset];
+            weightOffset += inputDim * gateDim;
+            const double* R = &params[weightOffset];
+            weightOffset += H * gateDim;
+            const double* inputBias = &params[biasOffset];
+            const double* recurrentBias = inputBias + gateDim;
+            biasOffset += 2 * gateDim;
+
+            // the input and the recurrent contribution to unit k of gate g, each with its bias
+            auto fromInput = [&](const vector<double>& x, size_t g, size_t k)
+            {
+                double sum = inputBias[g * H + k];
+                for (size_t i = 0; i < inputDim; i++)
+                    sum += W[i + (g * H + k) * inputDim] * x[i];
+                return sum;
+            };
+            auto fromState = [&](const vector<double>& h, size_t g, size_t k)
+            {
+                double sum = recurrentBias[g * H + k];
+                for (size_t i = 0; i < H; i++)
+                    sum += R[i + (g * H + k) * H] * h[i];
+                return sum;
+            };
+
+            for (size_t s = 0; s < layerInput.size(); s++)
+            {
+                const size_t length = layerInput[s].size();
+                vector<double> h(H, 0), c(H, 0), hNext(H);
+                for (size_t step = 0; step < length; step++)
+                {
+                    const size_t t = dir == 0 ? step : length - 1 - step;
+                    const auto& x = layerInput[s][t];
+                    for (size_t k = 0; k < H; k++)
+                    {
+                        if (op == L"lstm")
+                        {
+                            double inputGate  = sigmoid(fromInput(x, 0, k) + fromState(h, 0, k));
+                            double forgetGate = sigmoid(fromInput(x, 1, k) + fromState(h, 1, k));
+                            double cellInput  = tanh   (fromInput(x, 2, k) + fromState(h, 2, k));
+                            double outputGate = sigmoid(fromInput(x, 3, k) + fromState(h, 3, k));
+                            c[k] = forgetGate * c[k] + inputGate * cellInput;
+                            hNext[k] = outputGate * tanh(c[k]);
+                        }
+                        else if (op == L"gru")
+                        {
+                            double resetGate  = sigmoid(fromInput(x, 0, k) + fromState(h, 0, k));
+                            double updateGate = sigmoid(fromInput(x, 1, k) + fromState(h, 1, k));
+                            double newGate    = tanh(fromInput(x, 2, k) + resetGate * fromState(h, 2, k));
+                            hNext[k] = (1 - updateGate) * newGate + updateGate * h[k];
+                        }
+                        else if (op == L"rnnTanh")
+                            hNext[k] = tanh(fromInput(x, 0, k) + fromState(h, 0, k));
+                        else
+                            hNext[k] = max(fromInput(x, 0, k) + fromState(h, 0, k), 0.0);
+                    }
+                    h = hNext;
+                    copy(h.begin(), h.end(), layerOutput[s][t].begin() + dir * H);
+                }
+            }
+        }
+        layerInput = move(layerOutput);
+    }
+    return layerInput;
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixRNNForwardMatchesReference, RandomSeedFixture)
+{
+    // three sequences of lengths 4, 2 and 1, packed by frame, within a frame in the order of decreasing length
+    const vector<size_t> lengths = { 4, 2, 1 };
+    vector<size_t> numSequencesForFrame = { 3, 2, 1, 1 };
+    vector<size_t> frameOffsets = { 0, 3, 5, 6, 7 };
+    const size_t numCols = frameOffsets.back();
+    const size_t xDim = 3, hiddenSize = 2;
+
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<double> distribution(-1, 1);
+    for (const wstring op : { L"lstm", L"gru", L"rnnTanh", L"rnnReLU" })
+    {
+        for (size_t numLayers : { 1, 2, 3 })
+        {
+            for (bool bidirectional : { false, true })
+            {
+                RnnAttributes attributes(bidirectional, numLayers, hiddenSize, op, /*axis=*/-1);
+                const size_t yDim = (bidirectional ? 2 : 1) * hiddenSize;
+                auto numParameters = attributes.GetNumParameters(xDim);
+                vector<double> params(numParameters.first * numParameters.second);
+                generate(params.begin(), params.end(), [&] { return distribution(rng); });
+
+                vector<vector<vector<double>>> sequences(lengths.size());
+                vector<double> input(xDim * numCols);
+                for (size_t s = 0; s < lengths.size(); s++)
+                {
+                    for (size_t t = 0; t < lengths[s]; t++)
+                    {
+                        sequences[s].push_back(vector<double>(xDim));
+                        generate(sequences[s][t].begin(), sequences[s][t].end(), [&] { return distribution(rng); });
+                        copy(sequences[s][t].begin(), sequences[s][t].end(), input.begin() + (frameOffsets[t] + s) * xDim);
+                    }
+                }
+
+                DMatrix paramW(params.size(), 1, params.data(), matrixFlagNormal);
+                DMatrix inputX(xDim, numCols, input.data(), matrixFlagNormal);
+                DMatrix outputY(yDim, numCols);
+                DMatrix workspace;
+                outputY.RNNForward(inputX, paramW, xDim, yDim, numSequencesForFrame, attributes, workspace);
+
+                auto expected = RNNForwardReference(params, sequences, xDim, attributes);
+                double maxError = 0;
+                for (size_t s = 0; s < lengths.size(); s++)
+                    for (size_t t = 0; t < lengths[s]; t++)
+                        for (size_t i = 0; i < yDim; i++)
+                            maxError = max(maxError, fabs(outputY(i, frameOffsets[t] + s) - expected[s][t][i]));
+                BOOST_CHECK_MESSAGE(maxError < 1e-10, (op == L"lstm" ? "lstm" : op == L"gru" ? "gru" : op == L"rnnTanh" ? "rnnTanh" : "rnnReLU")
+                                                          << ", " << numLayers << " layers" << (bidirectional ? ", bidirectional" : "")
+                                                          << ": output differs from the reference by " << maxError);
+            }
+        }
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixTensorOpParallelSum, RandomSeedFixture)
+{
+    // large enough for the reductions to be run by multiple threads
+    const size_t rows = 256, cols = 512;
+    DMatrix a = DMatrix::RandomUniform(rows, cols, -1, 1, IncrementCounter());
+
+    vector<double> expectRowSums(rows, 0);
+    double expectSum = 0;
+    for (size_t j = 0; j < cols; j++)
+        for (size_t i = 0; i < rows; i++)
+        {
+            expectRowSums[i] += a(i, j);
+            expectSum += a(i, j);
+        }
+
+    int numThreads = DMatrix::GetMaxNumThreads();
+    DMatrix::SetNumThreads(4);
+    // row sums: one output per row, the outputs are distributed over threads
+    DMatrix rowSums(rows, 1);
+    SmallVector<size_t> regularOpDims(1, rows);
+    std::array<SmallVector<ptrdiff_t>, 2> regularStrides = { SmallVector<ptrdiff_t>(1, 1), SmallVector<ptrdiff_t>(1, 1) };
+    SmallVector<size_t> reducingOpDims(1, cols);
+    std::array<SmallVector<ptrdiff_t>, 2> reducingStrides = { SmallVector<ptrdiff_t>(1, rows), SmallVector<ptrdiff_t>(1, 0) };
+    rowSums.TensorOp(0, a, 1, ElementWiseOperator::opCopy, ElementWiseOperator::opSum, { 0, 0 },
+                     regularOpDims, regularStrides, reducingOpDims, reducingStrides);
+
+    // total sum: a single output, the reduction itself is split across threads
+    DMatrix sum(1, 1);
+    SmallVector<size_t> allReducingOpDims(1, rows * cols);
+    std::array<SmallVector<ptrdiff_t>, 2> allReducingStrides = { SmallVector<ptrdiff_t>(1, 1), SmallVector<ptrdiff_t>(1, 0) };
+    sum.TensorOp(0, a, 1, ElementWiseOperator::opCopy, ElementWiseOperator::opSum, { 0, 0 },
+                 SmallVector<size_t>(), std::array<SmallVector<ptrdiff_t>, 2>(), allReducingOpDims, allReducingStrides);
+    DMatrix::SetNumThreads(numThreads);
+
+    for (size_t i = 0; i < rows; i++)
+        BOOST_CHECK_CLOSE(rowSums(i, 0), expectRowSums[i], 1e-8);
+    BOOST_CHECK_CLOSE(sum(0, 0), expectSum, 1e-8);
+}
+
+BOOST_AUTO_TEST_CASE(CPUCachingMemAllocatorReuse)
+{
+    auto& allocator = CPUCachingMemAllocator::Instance();
+    allocator.ReleaseCachedMemory();
+    auto before = allocator.GetStatistics();
+
+    // 1100 and 1200 bytes fall into the same size class (1280 bytes)
+    void* p = allocator.Malloc(1100);
+    BOOST_CHECK_EQUAL(0, (size_t) p % CPUCachingMemAllocator::Alignment);
+    allocator.Free(p);
+    void* q = allocator.Malloc(1200);
+    BOOST_CHECK_EQUAL(p, q);
+
+    // a block freed by another thread is reused once that thread has exited
+    void* r = allocator.Malloc(3000000);
+    BOOST_CHECK_EQUAL(0, (size_t) r % CPUCachingMemAllocator::Alignment);
+    std::thread([&]() { allocator.Free(r); allocator.Free(q); }).join();
+    BOOST_CHECK_EQUAL(r, allocator.Malloc(3000000));
+    BOOST_CHECK_EQUAL(q, allocator.Malloc(1100));
+    allocator.Free(r);
+    allocator.Free(q);
+
+    auto after = allocator.GetStatistics();
+    BOOST_CHECK_EQUAL(after.m_numMisses - before.m_numMisses, 2);
+    BOOST_CHECK_EQUAL(after.m_numHits - before.m_numHits, 3);
+    BOOST_CHECK_EQUAL(after.m_bytesInUse, before.m_bytesInUse);
+    BOOST_CHECK_GE(after.m_peakBytesInUse, 1280 + 3145728);
+    BOOST_CHECK_GE(after.m_bytesCached, 1280 + 3145728);
+
+    allocator.ReleaseCachedMemory();
+    BOOST_CHECK_EQUAL(allocator.GetStatistics().m_bytesCached, 0);
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixCachingMemAllocator, RandomSeedFixture)
+{
+    CPUCachingMemAllocator::Configure(true);
+    {
+        DMatrix a = DMatrix::RandomUniform(43, 10, -1, 1, IncrementCounter());
+        DMatrix b(a.GetNumRows(), a.GetNumCols());
+        BOOST_CHECK_EQUAL(0, (size_t) b.Data() % CPUCachingMemAllocator::Alignment);
+        foreach_coord (i, j, b)
+            BOOST_CHECK_EQUAL(b(i, j), 0);
+
+        // the buffer is reallocated on growth and reused after the matrix is freed
+        b.SetValue(a);
+        b.Resize(430, 10);
+        double* buffer = b.Data();
+        b.Resize(0, 0, false);
+        DMatrix c(430, 10);
+        BOOST_CHECK_EQUAL(buffer, c.Data());
+        foreach_coord (i, j, c)
+            BOOST_CHECK_EQUAL(c(i, j), 0);
+    }
+    // matrices allocated while the cache was enabled still go back to it
+    DMatrix d(20, 20);
+    double* buffer = d.Data();
+    CPUCachingMemAllocator::Configure(false);
+    d.Resize(30, 30);
+    BOOST_CHECK(d.IsEqualTo(DMatrix::Zeros(30, 30)));
+
+    // and are reused once it is enabled again
+    const size_t numHits = CPUCachingMemAllocator::Instance().GetStatistics().m_numHits;
+    CPUCachingMemAllocator::Configure(true);
+    DMatrix e(20, 20);
+    BOOST_CHECK_EQUAL(buffer, e.Data());
+    BOOST_CHECK_EQUAL(CPUCachingMemAllocator::Instance().GetStatistics().m_numHits, numHits + 1);
+    CPUCachingMemAllocator::Configure(false);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }
 } } }
@@ -116,6 +116,83 @@ BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixMultiplyAndAdd, RandomSeedFixture)
     }
 }
 
+BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixMultiplyAndWeightedAdd, RandomSeedFixture)
+{
+    // Large enough to be split across threads, the sparse factor is a column slice view.
+    const size_t m = 300;
+    const size_t k = 500;
+    const size_t n = 20;
+
+    DenseMatrix dense(m, k);
+    dense.SetUniformRandomValue(-1, 1, IncrementCounter());
+
+    DenseMatrix dm1(k, n + 5);
+    dm1.SetUniformRandomValue(-20, 1, IncrementCounter());
+    dm1.InplaceTruncateBottom(0);
+
+    SparseMatrix sm1(MatrixFormat::matrixFormatSparseCSC, k, n + 5, 0);
+    foreach_coord(row, col, dm1)
+    {
+        if (dm1(row, col) != 0)
+            sm1.SetValue(row, col, dm1(row, col));
+    }
+
+    DenseMatrix dmSlice = dm1.ColumnSlice(5, n);
+    SparseMatrix smSlice = sm1.ColumnSlice(5, n);
+
+    DenseMatrix denseT(k, m);
+    denseT.AssignTransposeOf(dense);
+    DenseMatrix dmSliceT(n, k);
+    dmSliceT.AssignTransposeOf(dmSlice);
+    DenseMatrix denseSlice = dense.ColumnSlice(0, n);
+    DenseMatrix denseSliceT(n, m);
+    denseSliceT.AssignTransposeOf(denseSlice);
+
+    // dense * sparse for all transpositions
+    for (bool transposeA : { false, true })
+    {
+        DenseMatrix dmMul(m, n);
+        dmMul.SetUniformRandomValue(-1, 1, IncrementCounter());
+        DenseMatrix smMul(dmMul);
+
+        DenseMatrix::MultiplyAndWeightedAdd(0.5, dense, false, dmSlice, false, 0.25, dmMul);
+        SparseMatrix::MultiplyAndWeightedAdd(0.5, transposeA ? denseT : dense, transposeA, smSlice, false, 0.25, smMul);
+        BOOST_CHECK(smMul.IsEqualTo(dmMul, c_epsilonFloatE4));
+
+        DenseMatrix dmMulT(m, k);
+        dmMulT.SetUniformRandomValue(-1, 1, IncrementCounter());
+        DenseMatrix smMulT(dmMulT);
+
+        DenseMatrix::MultiplyAndWeightedAdd(0.5, denseSlice, false, dmSliceT, false, 0.25, dmMulT);
+        SparseMatrix::MultiplyAndWeightedAdd(0.5, transposeA ? denseSliceT : denseSlice, transposeA, smSlice, true, 0.25, smMulT);
+        BOOST_CHECK(smMulT.IsEqualTo(dmMulT, c_epsilonFloatE4));
+    }
+
+    // sparse * dense for all transpositions
+    DenseMatrix denseB(n, m);
+    denseB.SetUniformRandomValue(-1, 1, IncrementCounter());
+    DenseMatrix denseBT(m, n);
+    denseBT.AssignTransposeOf(denseB);
+    for (bool transposeB : { false, true })
+    {
+        DenseMatrix dmMul(k, m);
+        dmMul.SetUniformRandomValue(-1, 1, IncrementCounter());
+        DenseMatrix smMul(dmMul);
+
+        DenseMatrix::MultiplyAndWeightedAdd(0.5, dmSlice, false, denseB, false, 0.25, dmMul);
+        SparseMatrix::MultiplyAndWeightedAdd(0.5, smSlice, false, transposeB ? denseBT : denseB, transposeB, 0.25, smMul);
+        BOOST_CHECK(smMul.IsEqualTo(dmMul, c_epsilonFloatE4));
+
+        DenseMatrix dmMulT(n, m);
+        dmMulT.SetUniformRandomValue(-1, 1, IncrementCounter());
+        DenseMatrix smMulT(dmMulT);
+
+        DenseMatrix::MultiplyAndWeightedAdd(0.5, dmSliceT, false, denseT, false, 0.25, dmMulT);
+        SparseMatrix::MultiplyAndWeightedAdd(0.5, smSlice, true, transposeB ? dense : denseT, transposeB, 0.25, smMulT);
+        BOOST_CHECK(smMulT.IsEqualTo(dmMulT, c_epsilonFloatE4));
+    }
+}
+
 BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixDoGatherColumnsOf, RandomSeedFixture)
 {
     const size_t m = 100;
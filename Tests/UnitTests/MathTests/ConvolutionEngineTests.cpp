@@ -62,6 +62,19 @@ std::vector<std::tuple<ConvolutionEngineKind, DEVICEID_TYPE, size_t>> GetTestEng
     res.push_back(std::make_tuple(ConvolutionEngineKind::Gemm, -1, 0));
     res.push_back(std::make_tuple(ConvolutionEngineKind::Gemm, -1, 1));
     res.push_back(std::make_tuple(ConvolutionEngineKind::Gemm, -1, 3));
+
+    // Tiled GEMM engine. Implemented only for CPU, does not use temp memory.
+    res.push_back(std::make_tuple(ConvolutionEngineKind::TiledGemm, -1, 0));
+    return res;
+}
+
+// Returns vector of pooling engine config parameters: <kind, device>
+std::vector<std::tuple<ConvolutionEngineKind, DEVICEID_TYPE>> GetTestPoolEngineConfigs()
+{
+    std::vector<std::tuple<ConvolutionEngineKind, DEVICEID_TYPE>> res;
+    res.push_back(std::make_tuple(ConvolutionEngineKind::Reference, -1));
+    res.push_back(std::make_tuple(ConvolutionEngineKind::Reference, 0));
+    res.push_back(std::make_tuple(ConvolutionEngineKind::TiledGemm, -1));
     return res;
 }
 
@@ -233,6 +246,69 @@ BOOST_AUTO_TEST_CASE(ConvolutionForward)
     }
 }
 
+// The TiledGemm engine times its algorithms and caches the fastest per geometry, so ConvolutionForward checks only one
+// of them, and which one depends on the timing. Force each algorithm in turn and check it against the reference engine
+// on every geometry it applies to.
+BOOST_AUTO_TEST_CASE(ConvolutionForwardTiledGemmAlgorithms)
+{
+    std::mt19937 rng(0);
+    boost::random::uniform_int_distribution<> batchSizeG(1, 8);
+    boost::random::normal_distribution<float> nd;
+
+    struct ForcedAlgorithmReset
+    {
+        ~ForcedAlgorithmReset() { ForceTiledGemmConvolutionAlgorithm(TiledGemmConvolutionAlgorithm::None); }
+    } forcedAlgorithmReset;
+
+    int deviceId = -1;
+    for (auto algorithm : { TiledGemmConvolutionAlgorithm::TiledGemm, TiledGemmConvolutionAlgorithm::Pointwise, TiledGemmConvolutionAlgorithm::Direct })
+    {
+        ForceTiledGemmConvolutionAlgorithm(algorithm);
+        size_t numChecked = 0;
+        for (const auto& g : GenerateConvTestConfigs())
+        {
+            auto baseEng = ConvEng::Create(g, deviceId, ImageLayoutKind::CHW, 0, PoolKind::None, ConvolutionEngineKind::Reference);
+            auto testEng = ConvEng::Create(g, deviceId, ImageLayoutKind::CHW, 0, PoolKind::None, ConvolutionEngineKind::TiledGemm);
+
+            size_t n = batchSizeG(rng);
+            vec buf;
+            buf.resize(g->InputShape().GetNumElements() * n);
+            std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+            SingleMatrix in(g->InputShape().GetNumElements(), n, buf.data(), deviceId, matrixFlagNormal);
+
+            size_t mapCount = g->GetMapCount(g->InputShape().GetRank() - 1);
+            buf.resize(g->KernelShape().GetNumElements() * mapCount);
+            std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+            SingleMatrix kernel(mapCount, g->KernelShape().GetNumElements(), buf.data(), deviceId, matrixFlagNormal);
+
+            size_t crowOut = g->OutputShape().GetNumElements();
+            SingleMatrix out(crowOut, n, deviceId);
+            SingleMatrix outB(crowOut, n, deviceId);
+            SingleMatrix workspace(deviceId);
+            SingleMatrix workspaceB(deviceId);
+
+            // the algorithm does not apply to this geometry
+            try
+            {
+                testEng->Forward(in, kernel, out, workspace);
+            }
+            catch (const std::invalid_argument&)
+            {
+                continue;
+            }
+            baseEng->Forward(in, kernel, outB, workspaceB);
+            numChecked++;
+
+            std::stringstream tmsg;
+            tmsg << "Algorithm: " << (int)algorithm << ", Geometry: " << (std::string)(*g) << ", Batch: " << n;
+            std::string emsg;
+            BOOST_REQUIRE_MESSAGE(!out.HasNan("out"), "out has NaNs, " << tmsg.str());
+            BOOST_REQUIRE_MESSAGE(CheckEqual(out, outB, emsg, Err<float>::Rel * 4, Err<float>::Abs * 14), "out are not equal, " << tmsg.str() << ". " << emsg);
+        }
+        BOOST_CHECK_MESSAGE(numChecked > 0, "Algorithm " << (int)algorithm << " applies to none of the geometries.");
+    }
+}
+
 BOOST_AUTO_TEST_CASE(ConvolutionBackwardData)
 {
     std::mt19937 rng(0);
@@ -388,11 +464,12 @@ BOOST_AUTO_TEST_CASE(PoolingForward)
     };
 
     int baseDeviceId = 0;
-    auto engKind = ConvolutionEngineKind::Reference;
     for (auto kind : {PoolKind::Max, PoolKind::Average})
     {
-        for (int deviceId : {-1, 0})
+        for (const auto& engCfg : GetTestPoolEngineConfigs())
         {
+            auto engKind = std::get<0>(engCfg);
+            auto deviceId = std::get<1>(engCfg);
             for (const auto& g : GeneratePoolTestConfigs())
             {
                 auto baseEng = ConvEng::Create(g, baseDeviceId, ImageLayoutKind::CHW, 0, kind, ConvolutionEngineKind::CuDnn);
@@ -414,7 +491,7 @@ BOOST_AUTO_TEST_CASE(PoolingForward)
                 baseEng->ForwardPooling(inB, outB);
 
                 std::stringstream tmsg;
-                tmsg << "Geometry: " << (std::string)(*g) << ", Pool: " << (int)kind << ", Batch: " << n << ", Device: " << deviceId;
+                tmsg << "Geometry: " << (std::string)(*g) << ", Pool: " << (int)kind << ", Batch: " << n << ", Device: " << deviceId << ", Engine: " << (int)engKind;
                 std::string msg = " are not equal, " + tmsg.str();
                 std::string msgNan = " has NaNs, " + tmsg.str();
                 std::string msgNotNan = " has buffer overflow/underflow, " + tmsg.str();
@@ -448,11 +525,12 @@ BOOST_AUTO_TEST_CASE(PoolingBackward)
     };
 
     int baseDeviceId = 0;
-    auto engKind = ConvolutionEngineKind::Reference;
     for (auto kind : {PoolKind::Max, PoolKind::Average})
     {
-        for (int deviceId : {-1, 0})
+        for (const auto& engCfg : GetTestPoolEngineConfigs())
         {
+            auto engKind = std::get<0>(engCfg);
+            auto deviceId = std::get<1>(engCfg);
             for (const auto& g : GeneratePoolTestConfigs())
             {
                 auto baseEng = ConvEng::Create(g, baseDeviceId, ImageLayoutKind::CHW, 0, kind, ConvolutionEngineKind::CuDnn);
@@ -486,7 +564,7 @@ BOOST_AUTO_TEST_CASE(PoolingBackward)
                 baseEng->BackwardPooling(outB, srcGradB, inB, gradB);
 
                 std::stringstream tmsg;
-                tmsg << "Geometry: " << (std::string)(*g) << ", Pool: " << (int)kind << ", Batch: " << n << ", Device: " << deviceId;
+                tmsg << "Geometry: " << (std::string)(*g) << ", Pool: " << (int)kind << ", Batch: " << n << ", Device: " << deviceId << ", Engine: " << (int)engKind;
                 std::string msg = " are not equal, " + tmsg.str();
                 std::string msgNan = " has NaNs, " + tmsg.str();
                 std::string msgNotNan = " has buffer overflow/underflow, " + tmsg.str();
@@ -34,6 +34,42 @@ BOOST_FIXTURE_TEST_CASE(CPUMatrixFileWriteRead, RandomSeedFixture)
     BOOST_CHECK(matrixCpuCopy.IsEqualTo(matrixCpuRead, c_epsilonFloatE5));
 }
 
+BOOST_FIXTURE_TEST_CASE(CPUMatrixFileWriteReadMemoryMapped, RandomSeedFixture)
+{
+    // The large matrix is aligned in the file and used in place when mapped, the small ones are read.
+    CPUMatrix<float> matrixSmall = CPUMatrix<float>::RandomUniform(3, 5, -26.3f, 30.2f, IncrementCounter());
+    CPUMatrix<float> matrixLarge = CPUMatrix<float>::RandomUniform(430, 10, -26.3f, 30.2f, IncrementCounter());
+
+    std::wstring fileName(L"MCPU.bin");
+    {
+        File file(fileName, fileOptionsBinary | fileOptionsWrite);
+        file << matrixSmall << matrixLarge << matrixSmall;
+    }
+
+    for (int options : { 0, (int)fileOptionsMemoryMapped })
+    {
+        CPUMatrix<float> matrixSmallRead, matrixLargeRead, matrixSmallRead2;
+        {
+            File file(fileName, fileOptionsBinary | fileOptionsRead | options);
+            file >> matrixSmallRead >> matrixLargeRead >> matrixSmallRead2;
+        }
+
+        BOOST_CHECK(matrixSmall.IsEqualTo(matrixSmallRead));
+        BOOST_CHECK(matrixLarge.IsEqualTo(matrixLargeRead));
+        BOOST_CHECK(matrixSmall.IsEqualTo(matrixSmallRead2));
+        if (options != 0)
+            BOOST_CHECK_EQUAL(0, (size_t)matrixLargeRead.Data() % File::PayloadAlignment);
+
+        // mapped values are copy-on-write, the file is not modified
+        matrixLargeRead.SetValue(0.0f);
+    }
+
+    CPUMatrix<float> matrixLargeRead;
+    File file(fileName, fileOptionsBinary | fileOptionsRead);
+    file >> matrixLargeRead >> matrixLargeRead;
+    BOOST_CHECK(matrixLarge.IsEqualTo(matrixLargeRead));
+}
+
 BOOST_FIXTURE_TEST_CASE(MatrixFileWriteRead, RandomSeedFixture)
 {
     // Test Matrix in Dense mode
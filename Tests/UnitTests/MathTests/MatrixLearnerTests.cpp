@@ -9,6 +9,7 @@
 #endif 
 #include "../../../Source/Math/Matrix.h"
 #include "../../../Source/Math/CPUMatrix.h"
+#include "../../../Source/Math/FusedParameterUpdate.h"
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -114,5 +115,103 @@ BOOST_FIXTURE_TEST_CASE(AdaDeltaSparse, MatrixLearnerFixture)
     });
 }
 
+// tests the fused update of several parameters vs. the per-matrix updates
+BOOST_FIXTURE_TEST_CASE(FusedParameterUpdateDense, RandomSeedFixture)
+{
+    typedef FusedParameterUpdate<float> FusedUpdate;
+    const size_t shapes[][2] = { { 1, 7 }, { 256, 128 }, { 100, 300 } };
+    const double learningRate = 0.01, momentum = 0.9, varMomentum = 0.99, l2RegWeight = 0.001, l1Threshold = 0.0001;
+
+    for (auto rule : { FusedUpdate::Rule::SGD, FusedUpdate::Rule::MomentumSGD, FusedUpdate::Rule::Nesterov, FusedUpdate::Rule::FSAdaGrad, FusedUpdate::Rule::Adam })
+    {
+        for (bool clippingWithTruncation : { true, false })
+        {
+            FusedUpdate::Options options;
+            options.rule = rule;
+            options.clippingThreshold = 1.5;
+            options.clippingWithTruncation = clippingWithTruncation;
+            options.varMomentum = varMomentum;
+            options.epsilon = 1e-8;
+            FusedUpdate fusedUpdate(options);
+
+            FusedUpdate::ParameterOptions parameterOptions;
+            parameterOptions.learningRate = learningRate;
+            parameterOptions.momentum = momentum;
+            parameterOptions.l2RegWeight = l2RegWeight;
+            parameterOptions.l1Threshold = l1Threshold;
+            // FSAdaGrad: target denominator times sqrt of the smoothed count, Adam: bias correction of AdamUpdate() for a smoothed count of 1
+            parameterOptions.adaMul = rule == FusedUpdate::Rule::Adam ? 1 : 0.5;
+
+            const size_t numAccumulators = (rule == FusedUpdate::Rule::FSAdaGrad || rule == FusedUpdate::Rule::Adam) ? 2 : 1;
+            std::vector<SingleMatrix> values, gradients, smoothedGradients, expectedValues, expectedGradients, expectedSmoothedGradients;
+            for (const auto& shape : shapes)
+            {
+                values.push_back(SingleMatrix::RandomGaussian(shape[0], shape[1], CPUDEVICE, 0.0f, 1.0f, IncrementCounter()));
+                gradients.push_back(SingleMatrix::RandomGaussian(shape[0], shape[1], CPUDEVICE, 0.0f, 1.0f, IncrementCounter()));
+                smoothedGradients.push_back(SingleMatrix::RandomUniform(shape[0], numAccumulators * shape[1], CPUDEVICE, 0.0f, 1.0f, IncrementCounter()));
+                expectedValues.push_back(values.back().DeepClone());
+                expectedGradients.push_back(gradients.back().DeepClone());
+                expectedSmoothedGradients.push_back(smoothedGradients.back().DeepClone());
+            }
+
+            for (size_t i = 0; i < values.size(); i++)
+            {
+                BOOST_REQUIRE(fusedUpdate.CanAdd(values[i], gradients[i], smoothedGradients[i]));
+                fusedUpdate.Add(values[i], gradients[i], smoothedGradients[i], parameterOptions);
+
+                // reference: the per-matrix steps of SGD::UpdateWeights()
+                auto& value = expectedValues[i];
+                auto& gradient = expectedGradients[i];
+                auto& smoothedGradient = expectedSmoothedGradients[i];
+                if (clippingWithTruncation)
+                    gradient.InplaceTruncate(1.5f);
+                else if (gradient.FrobeniusNorm() > 1.5)
+                    gradient *= (float) (1.5 / gradient.FrobeniusNorm());
+                SingleMatrix::ScaleAndAdd((float) l2RegWeight, value, gradient);
+
+                switch (rule)
+                {
+                case FusedUpdate::Rule::SGD:
+                    value.SGDUpdate(gradient, (float) learningRate);
+                    break;
+                case FusedUpdate::Rule::MomentumSGD:
+                    value.MomentumSGDUpdate(gradient, smoothedGradient, (float) learningRate, (float) momentum);
+                    break;
+                case FusedUpdate::Rule::Nesterov:
+                    value.NesterovAcceleratedMomentumSGDUpdate(gradient, smoothedGradient, (float) learningRate, (float) momentum);
+                    break;
+                case FusedUpdate::Rule::FSAdaGrad:
+                    smoothedGradient.FSAdagradUpdate(gradient, value, 0.5, learningRate, momentum, varMomentum);
+                    break;
+                case FusedUpdate::Rule::Adam:
+                    smoothedGradient.AdamUpdate(gradient, value, 1, learningRate, momentum, varMomentum, 1e-8, true, false);
+                    break;
+                }
+                value.InplaceSoftThreshold((float) l1Threshold);
+            }
+
+            BOOST_CHECK_EQUAL(values.size(), fusedUpdate.GetNumParameters());
+            fusedUpdate.Apply();
+            BOOST_CHECK_EQUAL(0, fusedUpdate.GetNumParameters());
+
+            for (size_t i = 0; i < values.size(); i++)
+            {
+                BOOST_CHECK(values[i].IsEqualTo(expectedValues[i], c_epsilonFloatE5));
+                BOOST_CHECK(gradients[i].IsEqualTo(expectedGradients[i], c_epsilonFloatE5));
+                if (rule != FusedUpdate::Rule::SGD)
+                    BOOST_CHECK(smoothedGradients[i].IsEqualTo(expectedSmoothedGradients[i], c_epsilonFloatE5));
+            }
+        }
+    }
+
+    // sparse gradients are updated one by one
+    FusedUpdate fusedUpdate(FusedUpdate::Options{});
+    SingleMatrix value = SingleMatrix::RandomGaussian(16, 8, CPUDEVICE, 0.0f, 1.0f, IncrementCounter());
+    SingleMatrix gradient = value.DeepClone();
+    SingleMatrix smoothedGradient = value.DeepClone();
+    gradient.SwitchToMatrixType(MatrixType::SPARSE, matrixFormatSparseCSC, true);
+    BOOST_CHECK(!fusedUpdate.CanAdd(value, gradient, smoothedGradient));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }}}}
@@ -51,6 +51,35 @@ BOOST_FIXTURE_TEST_CASE(MultiplyIntToShort, RandomSeedFixture)
 }
 
 
+BOOST_FIXTURE_TEST_CASE(MultiplyLargeConstantA, RandomSeedFixture)
+{
+    // sizes that exercise all block sizes (128, 64, 32, 16, 8 and the remainder) of the block multiplier
+    int m = 36, n = 7, k = 255;
+    std::vector<float> A(m*k), B(k*n);
+    for (size_t i = 0; i < A.size(); i++)
+        A[i] = (float)((int)(i % 17) - 8);
+    for (size_t i = 0; i < B.size(); i++)
+        B[i] = (float)((int)(i % 13) - 6) / 4;
+
+    std::vector<float> C_expected(m*n, 0);
+    for (int i = 0; i < m; i++)
+        for (int j = 0; j < n; j++)
+            for (int l = 0; l < k; l++)
+                C_expected[i + j*m] += A[i + l*m] * B[l + k*j];
+
+    shared_ptr<QuantizerBase<float, short>> quantA(new SymmetricQuantizer<float, short>(1));
+    shared_ptr<QuantizerBase<float, short>> quantB(new SymmetricQuantizer<float, short>(1));
+    QuantizedMultiplier<float> mult(quantA, true, quantB, false);
+
+    std::vector<float> C(m*n);
+    for (size_t pass = 0; pass < 2; pass++)
+    {
+        mult.Multiply(m, n, k, A.data(), B.data(), C.data());
+        for (size_t i = 0; i < m*n; i++)
+            BOOST_CHECK_SMALL(C[i] - C_expected[i], 0.5f);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 } } } }
\ No newline at end of file
@@ -0,0 +1,764 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "Matrix.h"
+#include "SimpleDistGradAggregator.h"
+#include "QuantizedDistGradAggregator.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+using namespace Microsoft::MSR::CNTK;
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+namespace
+{
+// An MPIWrapper for tests: one of 'numNodes' nodes, which supports none of the communication. Derived wrappers provide
+// what a test needs, anything else fails the test.
+class TestMPIWrapper : public MPIWrapper
+{
+public:
+    TestMPIWrapper(size_t numNodes, size_t rank) : m_numNodes(numNodes), m_rank(rank) {}
+
+    size_t NumNodesInUse() const override { return m_numNodes; }
+    size_t CurrentNodeRank() const override { return m_rank; }
+    bool IsMainNode() const override { return m_rank == MainNodeRank(); }
+    std::wstring CurrentNodeName() const override { return L"localhost"; }
+    bool IsIdle() const override { return false; }
+    bool UsingAllNodes() const override { return true; }
+    size_t MainNodeRank() const override { return 0; }
+    bool IsMultiHost() const override { return false; }
+    bool UseGpuGdr() override { return false; }
+
+    int Finalize(void) override { return Success(); }
+    int Wait(MPI_Request*, MPI_Status*) override { return Unsupported("Wait"); }
+    int Waitany(int, MPI_Request[], int*, MPI_Status*) override { return Unsupported("Waitany"); }
+    int Waitall(int, MPI_Request[], MPI_Status[]) override { return Unsupported("Waitall"); }
+    int Isend(const void*, int, MPI_Datatype, int, int, MPI_Request*) override { return Unsupported("Isend"); }
+    int Recv(void*, int, MPI_Datatype, int, int, MPI_Status*) override { return Unsupported("Recv"); }
+    int Irecv(void*, int, MPI_Datatype, int, int, MPI_Request*) override { return Unsupported("Irecv"); }
+    int Abort(int) override { return Unsupported("Abort"); }
+    int Error_string(int, char*, int*) override { return Unsupported("Error_string"); }
+    int Iallreduce(const void*, void*, int, MPI_Datatype, MPI_Op, MPI_Request*) override { return Unsupported("Iallreduce"); }
+
+    void AllReduce(std::vector<size_t>&) const override { Unsupported("AllReduce"); }
+    void AllReduce(std::vector<int>&) const override { Unsupported("AllReduce"); }
+    void AllReduce(std::vector<double>&) const override { Unsupported("AllReduce"); }
+    void AllReduce(std::vector<float>&) const override { Unsupported("AllReduce"); }
+
+    void AllReduce(size_t*, size_t, MPI_Op) const override { Unsupported("AllReduce"); }
+    void AllReduce(int*, size_t, MPI_Op) const override { Unsupported("AllReduce"); }
+    void AllReduce(double*, size_t, MPI_Op) const override { Unsupported("AllReduce"); }
+    void AllReduce(float*, size_t, MPI_Op) const override { Unsupported("AllReduce"); }
+
+    void AllReduce(size_t*, size_t*, size_t, MPI_Op) const override { Unsupported("AllReduce"); }
+    void AllReduce(int*, int*, size_t, MPI_Op) const override { Unsupported("AllReduce"); }
+    void AllReduce(double*, double*, size_t, MPI_Op) const override { Unsupported("AllReduce"); }
+    void AllReduce(float*, float*, size_t, MPI_Op) const override { Unsupported("AllReduce"); }
+
+    void AllReduceAsync(size_t*, size_t, MPI_Request*, MPI_Op) const override { Unsupported("AllReduceAsync"); }
+    void AllReduceAsync(int*, size_t, MPI_Request*, MPI_Op) const override { Unsupported("AllReduceAsync"); }
+    void AllReduceAsync(double*, size_t, MPI_Request*, MPI_Op) const override { Unsupported("AllReduceAsync"); }
+    void AllReduceAsync(float*, size_t, MPI_Request*, MPI_Op) const override { Unsupported("AllReduceAsync"); }
+
+    void AllReduceAsync(size_t*, size_t*, size_t, MPI_Request*, MPI_Op) const override { Unsupported("AllReduceAsync"); }
+    void AllReduceAsync(int*, int*, size_t, MPI_Request*, MPI_Op) const override { Unsupported("AllReduceAsync"); }
+    void AllReduceAsync(double*, double*, size_t, MPI_Request*, MPI_Op) const override { Unsupported("AllReduceAsync"); }
+    void AllReduceAsync(float*, float*, size_t, MPI_Request*, MPI_Op) const override { Unsupported("AllReduceAsync"); }
+
+    void Bcast(size_t*, size_t, size_t) override { Unsupported("Bcast"); }
+    void Bcast(double*, size_t, size_t) override { Unsupported("Bcast"); }
+    void Bcast(float*, size_t, size_t) override { Unsupported("Bcast"); }
+    void Bcast(void*, int, MPI_Datatype, int) override { Unsupported("Bcast"); }
+
+    void AllGatherAsync(const size_t*, size_t, size_t*, size_t, MPI_Request*) const override { Unsupported("AllGatherAsync"); }
+    void AllGatherAsync(const int*, size_t, int*, size_t, MPI_Request*) const override { Unsupported("AllGatherAsync"); }
+    void AllGatherAsync(const float*, size_t, float*, size_t, MPI_Request*) const override { Unsupported("AllGatherAsync"); }
+    void AllGatherAsync(const double*, size_t, double*, size_t, MPI_Request*) const override { Unsupported("AllGatherAsync"); }
+
+    void AllGather(const size_t*, size_t, size_t*, size_t) const override { Unsupported("AllGather"); }
+    void AllGather(const int*, size_t, int*, size_t) const override { Unsupported("AllGather"); }
+    void AllGather(const float*, size_t, float*, size_t) const override { Unsupported("AllGather"); }
+    void AllGather(const double*, size_t, double*, size_t) const override { Unsupported("AllGather"); }
+    void Allgather(const void*, int, MPI_Datatype, void*, int, MPI_Datatype) const override { Unsupported("Allgather"); }
+
+    void Gather(const size_t*, size_t, size_t*, size_t, size_t) const override { Unsupported("Gather"); }
+    void Gather(const int*, size_t, int*, size_t, size_t) const override { Unsupported("Gather"); }
+    void Gather(const float*, size_t, float*, size_t, size_t) const override { Unsupported("Gather"); }
+    void Gather(const double*, size_t, double*, size_t, size_t) const override { Unsupported("Gather"); }
+
+    void Gatherv(const size_t*, size_t, size_t*, int[], int[], size_t) const override { Unsupported("Gatherv"); }
+    void Gatherv(const char*, size_t, char*, int[], int[], size_t) const override { Unsupported("Gatherv"); }
+    void Gatherv(const int*, size_t, int*, int[], int[], size_t) const override { Unsupported("Gatherv"); }
+    void Gatherv(const float*, size_t, float*, int[], int[], size_t) const override { Unsupported("Gatherv"); }
+    void Gatherv(const double*, size_t, double*, int[], int[], size_t) const override { Unsupported("Gatherv"); }
+
+    int WaitAll() override { return Unsupported("WaitAll"); }
+    void WaitAny(MPI_Request*, int, int*) override { Unsupported("WaitAny"); }
+    void Wait(MPI_Request*) override { Unsupported("Wait"); }
+    int WaitAll(std::vector<MPI_Request>&) override { return Unsupported("WaitAll"); }
+
+protected:
+    static int Success()
+    {
+        return 0; // MPI_SUCCESS
+    }
+
+    static int Unsupported(const char* function)
+    {
+        LogicError("TestMPIWrapper: %s is not supported.", function);
+    }
+
+private:
+    const size_t m_numNodes;
+    const size_t m_rank;
+};
+
+// A single process that acts as if it was one of 'numSimulatedNodes' nodes which all computed the same gradients:
+// reductions multiply the data by the number of nodes. Asynchronous reductions are carried out right away, so
+// that a gradient which is reduced before it is final gives a wrong result.
+class SimulatedNodesMPIWrapper : public TestMPIWrapper
+{
+public:
+    SimulatedNodesMPIWrapper(size_t numSimulatedNodes) : TestMPIWrapper(1, 0), m_numSimulatedNodes(numSimulatedNodes), m_numAllReduceCalls(0) {}
+
+    size_t NumAllReduceCalls() const { return m_numAllReduceCalls; }
+
+    int Wait(MPI_Request*, MPI_Status*) override { return Success(); }
+    int Waitany(int, MPI_Request[], int* index, MPI_Status*) override { *index = MPI_UNDEFINED; return Success(); }
+    int Waitall(int, MPI_Request[], MPI_Status[]) override { return Success(); }
+
+    int Iallreduce(const void* sendbuf, void* recvbuf, int count, MPI_Datatype datatype, MPI_Op, MPI_Request*) override
+    {
+        if (sendbuf != MPI_IN_PLACE)
+            return Unsupported("Iallreduce (not in place)");
+        if (datatype == MPI_FLOAT)
+            Reduce((float*) recvbuf, count);
+        else if (datatype == MPI_DOUBLE)
+            Reduce((double*) recvbuf, count);
+        else
+            return Unsupported("Iallreduce (not float or double)");
+        return Success();
+    }
+
+    void AllReduce(std::vector<size_t>& accumulator) const override { Reduce(accumulator.data(), accumulator.size()); }
+    void AllReduce(std::vector<int>& accumulator) const override { Reduce(accumulator.data(), accumulator.size()); }
+    void AllReduce(std::vector<double>& accumulator) const override { Reduce(accumulator.data(), accumulator.size()); }
+    void AllReduce(std::vector<float>& accumulator) const override { Reduce(accumulator.data(), accumulator.size()); }
+
+    void AllReduce(size_t* sendData, size_t numElements, MPI_Op) const override { Reduce(sendData, numElements); }
+    void AllReduce(int* sendData, size_t numElements, MPI_Op) const override { Reduce(sendData, numElements); }
+    void AllReduce(double* sendData, size_t numElements, MPI_Op) const override { Reduce(sendData, numElements); }
+    void AllReduce(float* sendData, size_t numElements, MPI_Op) const override { Reduce(sendData, numElements); }
+
+    void AllReduceAsync(size_t* sendData, size_t numElements, MPI_Request*, MPI_Op) const override { Reduce(sendData, numElements); }
+    void AllReduceAsync(int* sendData, size_t numElements, MPI_Request*, MPI_Op) const override { Reduce(sendData, numElements); }
+    void AllReduceAsync(double* sendData, size_t numElements, MPI_Request*, MPI_Op) const override { Reduce(sendData, numElements); }
+    void AllReduceAsync(float* sendData, size_t numElements, MPI_Request*, MPI_Op) const override { Reduce(sendData, numElements); }
+
+    // a single node already has the data of the main node
+    void Bcast(size_t*, size_t, size_t) override {}
+    void Bcast(double*, size_t, size_t) override {}
+    void Bcast(float*, size_t, size_t) override {}
+    void Bcast(void*, int, MPI_Datatype, int) override {}
+
+    int WaitAll() override { return Success(); }
+    void WaitAny(MPI_Request*, int, int* index) override { *index = MPI_UNDEFINED; }
+    void Wait(MPI_Request*) override {}
+    int WaitAll(std::vector<MPI_Request>&) override { return Success(); }
+
+private:
+    template <class T>
+    void Reduce(T* data, size_t numElements) const
+    {
+        for (size_t i = 0; i < numElements; i++)
+            data[i] *= (T) m_numSimulatedNodes;
+        m_numAllReduceCalls++;
+    }
+
+    const size_t m_numSimulatedNodes;
+    mutable size_t m_numAllReduceCalls;
+};
+
+// The messages between nodes that run on threads of one process. Nothing is buffered: a send only completes once the
+// matching receive was posted and the data was copied, so that a send buffer that is reused too early, or a receive
+// that is never posted, fails the test instead of passing by chance. Messages with the same source, destination
+// and tag are matched in the order they were posted, as MPI does.
+class InProcessNetwork
+{
+public:
+    explicit InProcessNetwork(size_t numNodes) : m_numNodes(numNodes), m_failed(false) {}
+
+    size_t NumNodes() const { return m_numNodes; }
+
+    // Returns the id of the request, ids start at 1.
+    int Post(bool isSend, int node, void* buffer, size_t numBytes, int peer, int tag)
+    {
+        if (peer < 0 || peer >= (int) m_numNodes || peer == node)
+            LogicError("InProcessNetwork: node %d cannot exchange messages with node %d.", node, peer);
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        Operation operation = { isSend, isSend ? node : peer, isSend ? peer : node, tag, buffer, numBytes, false };
+        m_operations.push_back(operation);
+        const size_t id = m_operations.size();
+        for (size_t other = 0; other + 1 < id; other++)
+        {
+            auto& match = m_operations[other];
+            if (match.done || match.isSend == isSend || match.source != operation.source || match.dest != operation.dest || match.tag != tag)
+                continue;
+
+            auto& send = isSend ? m_operations[id - 1] : match;
+            auto& recv = isSend ? match : m_operations[id - 1];
+            if (send.numBytes > recv.numBytes)
+                LogicError("InProcessNetwork: message of %d bytes from node %d with tag %d does not fit the receive buffer of %d bytes.",
+                           (int) send.numBytes, send.source, tag, (int) recv.numBytes);
+            memcpy(recv.buffer, send.buffer, send.numBytes);
+            send.done = true;
+            recv.done = true;
+            m_changed.notify_all();
+            break;
+        }
+        return (int) id;
+    }
+
+    void Wait(int id)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        WaitUntil(lock, [&]() { return m_operations[id - 1].done; });
+    }
+
+    // Returns the index of a completed request in 'ids', ignoring ids that are 0, or -1 if all of them are 0.
+    int WaitAny(const std::vector<int>& ids)
+    {
+        if (std::all_of(ids.begin(), ids.end(), [](int id) { return id == 0; }))
+            return -1;
+
+        int index = -1;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        WaitUntil(lock, [&]() {
+            for (size_t i = 0; i < ids.size(); i++)
+            {
+                if (ids[i] != 0 && m_operations[ids[i] - 1].done)
+                {
+                    index = (int) i;
+                    return true;
+                }
+            }
+            return false;
+        });
+        return index;
+    }
+
+    // The 'call'th broadcast of each node: the root publishes its data, the others wait for it.
+    void Bcast(int node, void* buffer, size_t numBytes, int root, size_t call)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (node == root)
+        {
+            if (m_broadcasts.size() != call)
+                LogicError("InProcessNetwork: broadcasts from different roots.");
+            m_broadcasts.push_back(std::vector<char>((const char*) buffer, (const char*) buffer + numBytes));
+            m_changed.notify_all();
+            return;
+        }
+
+        WaitUntil(lock, [&]() { return m_broadcasts.size() > call; });
+        if (m_broadcasts[call].size() != numBytes)
+            LogicError("InProcessNetwork: broadcast of %d bytes received into a buffer of %d bytes.", (int) m_broadcasts[call].size(), (int) numBytes);
+        memcpy(buffer, m_broadcasts[call].data(), numBytes);
+    }
+
+    // A node that fails no longer communicates, which releases the nodes waiting for it.
+    void Fail()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_failed = true;
+        m_changed.notify_all();
+    }
+
+private:
+    template <class Predicate>
+    void WaitUntil(std::unique_lock<std::mutex>& lock, Predicate done)
+    {
+        if (!m_changed.wait_for(lock, std::chrono::seconds(60), [&]() { return m_failed || done(); }))
+            LogicError("InProcessNetwork: the nodes are deadlocked.");
+        if (!done())
+            LogicError("InProcessNetwork: another node failed.");
+    }
+
+    struct Operation
+    {
+        bool isSend;
+        int source;
+        int dest;
+        int tag;
+        void* buffer;
+        size_t numBytes;
+        bool done;
+    };
+
+    const size_t m_numNodes;
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+    std::vector<Operation> m_operations;
+    std::vector<std::vector<char>> m_broadcasts;
+    bool m_failed;
+};
+
+// One of the nodes of an InProcessNetwork, for the point-to-point messages and broadcasts of bytes.
+class InProcessMPIWrapper : public TestMPIWrapper
+{
+public:
+    InProcessMPIWrapper(InProcessNetwork& network, size_t rank) : TestMPIWrapper(network.NumNodes(), rank), m_network(network), m_numBcastCalls(0) {}
+
+    int Isend(const void* buf, int count, MPI_Datatype datatype, int dest, int tag, MPI_Request* request) override
+    {
+        SetRequest(request, m_network.Post(true, (int) CurrentNodeRank(), const_cast<void*>(buf), NumBytes(count, datatype), dest, tag));
+        return Success();
+    }
+
+    int Irecv(void* buf, int count, MPI_Datatype datatype, int source, int tag, MPI_Request* request) override
+    {
+        SetRequest(request, m_network.Post(false, (int) CurrentNodeRank(), buf, NumBytes(count, datatype), source, tag));
+        return Success();
+    }
+
+    int Wait(MPI_Request* request, MPI_Status*) override
+    {
+        Complete(request);
+        return Success();
+    }
+
+    int Waitall(int count, MPI_Request requests[], MPI_Status[]) override
+    {
+        for (int i = 0; i < count; i++)
+            Complete(&requests[i]);
+        return Success();
+    }
+
+    int Waitany(int count, MPI_Request requests[], int* index, MPI_Status*) override
+    {
+        std::vector<int> ids;
+        for (int i = 0; i < count; i++)
+            ids.push_back(GetRequest(requests[i]));
+        *index = m_network.WaitAny(ids);
+        if (*index < 0)
+            *index = MPI_UNDEFINED;
+        else
+            SetRequest(&requests[*index], 0);
+        return Success();
+    }
+
+    void Bcast(void* buffer, int count, MPI_Datatype datatype, int root) override
+    {
+        m_network.Bcast((int) CurrentNodeRank(), buffer, NumBytes(count, datatype), root, m_numBcastCalls++);
+    }
+
+private:
+    // MPI_Request is a handle whose type differs between MPI implementations, it holds the id of the request
+    // (0 for a completed one). The ids are kept in the handles, since the callers keep them in vectors that may move.
+    static void SetRequest(MPI_Request* request, int id)
+    {
+        static_assert(sizeof(MPI_Request) >= sizeof(int), "MPI_Request cannot hold a request id");
+        memset(request, 0, sizeof(*request));
+        memcpy(request, &id, sizeof(id));
+    }
+
+    static int GetRequest(const MPI_Request& request)
+    {
+        int id;
+        memcpy(&id, &request, sizeof(id));
+        return id;
+    }
+
+    void Complete(MPI_Request* request)
+    {
+        const int id = GetRequest(*request);
+        if (id != 0)
+            m_network.Wait(id);
+        SetRequest(request, 0);
+    }
+
+    static size_t NumBytes(int count, MPI_Datatype datatype)
+    {
+        if (datatype != MPI_CHAR)
+            Unsupported("messages other than MPI_CHAR");
+        return (size_t) count;
+    }
+
+    InProcessNetwork& m_network;
+    size_t m_numBcastCalls;
+};
+
+const size_t numSimulatedNodes = 3;
+
+typedef std::vector<std::unique_ptr<Matrix<float>>> Gradients;
+
+Gradients CreateGradients(const std::vector<std::pair<size_t, size_t>>& shapes)
+{
+    Gradients gradients;
+    for (const auto& shape : shapes)
+        gradients.push_back(std::make_unique<Matrix<float>>(Matrix<float>::Zeros(shape.first, shape.second, CPUDEVICE)));
+    return gradients;
+}
+
+// gradients of different sizes, so that some share a bucket and some are bucketed alone
+Gradients CreateGradients()
+{
+    return CreateGradients({ { 2, 3 }, { 16, 8 }, { 1, 5 }, { 4, 4 }, { 3, 1 }, { 7, 9 } });
+}
+
+// the gradient of the given minibatch as backprop would compute it
+void ComputeGradient(Matrix<float>& gradient, size_t gradientIndex, size_t minibatch)
+{
+    gradient.SetUniformRandomValue(-1.0f, 1.0f, (unsigned long) (gradientIndex * 100 + minibatch + 1));
+}
+
+std::vector<Matrix<float>*> GetPointers(const std::vector<std::unique_ptr<Matrix<float>>>& gradients)
+{
+    std::vector<Matrix<float>*> pointers;
+    for (const auto& gradient : gradients)
+        pointers.push_back(gradient.get());
+    return pointers;
+}
+
+struct DistGradHeaderDeleter
+{
+    void operator()(DistGradHeader* header) const { DistGradHeader::Destroy(header); }
+};
+
+std::unique_ptr<DistGradHeader, DistGradHeaderDeleter> CreateHeader(size_t numSamples)
+{
+    std::unique_ptr<DistGradHeader, DistGradHeaderDeleter> header(DistGradHeader::Create(0));
+    header->Clear();
+    header->numSamples = numSamples;
+    header->numSamplesWithLabel = numSamples;
+    return header;
+}
+
+// the steps of the quantized aggregation, done with the quantizer directly
+void Quantize(MatrixQuantizerImpl<float>& quantizer, const Matrix<float>& input, Matrix<float>& residual, QuantizedMatrix<float>& quantized)
+{
+    quantizer.QuantizeAsync(input, residual, quantized, residual, false);
+    quantizer.WaitQuantizeAsyncDone();
+}
+
+void Unquantize(MatrixQuantizerImpl<float>& quantizer, QuantizedMatrix<float>& quantized, Matrix<float>& output)
+{
+    quantizer.UnquantizeAsync(quantized, output, false);
+    quantizer.WaitUnquantizeAsyncDone();
+}
+}
+
+BOOST_AUTO_TEST_SUITE(GradientAggregationTests)
+
+// Aggregating the gradients in buckets while backprop is running must give the same result as aggregating them all after
+// backprop: when backprop reports the gradients ready (in reverse order, each one right after it was computed), and when
+// it does not report them at all (as with sub-minibatches, where the gradients are only final after accumulation).
+BOOST_AUTO_TEST_CASE(BucketedAggregationMatchesAggregationAfterBackprop)
+{
+    auto mpi = std::make_shared<SimulatedNodesMPIWrapper>(numSimulatedNodes);
+    SimpleDistGradAggregator<float> aggregator(mpi, false, CPUDEVICE, 0, /*packThresholdSizeInBytes=*/ 64);
+    SimpleDistGradAggregator<float> bucketedAggregator(mpi, false, CPUDEVICE, 0, /*packThresholdSizeInBytes=*/ 64, /*bucketSizeInBytes=*/ 128);
+    BOOST_REQUIRE(!aggregator.OverlapsAggregationWithBackprop());
+    BOOST_REQUIRE(bucketedAggregator.OverlapsAggregationWithBackprop());
+
+    auto gradients = CreateGradients();
+    auto bucketedGradients = CreateGradients();
+    const size_t numGradients = gradients.size();
+
+    // the first two minibatches report the gradients during backprop, the third one (sub-minibatches) does not, the last
+    // one reports them again
+    const std::vector<bool> reportsGradientsReady = { true, true, false, true };
+    for (size_t minibatch = 0; minibatch < reportsGradientsReady.size(); minibatch++)
+    {
+        for (size_t i = 0; i < numGradients; i++)
+            ComputeGradient(*gradients[i], i, minibatch);
+
+        const size_t numAllReduceCallsBeforeBackprop = mpi->NumAllReduceCalls();
+        for (size_t i = numGradients; i-- > 0;)
+        {
+            ComputeGradient(*bucketedGradients[i], i, minibatch);
+            if (reportsGradientsReady[minibatch])
+                bucketedAggregator.OnGradientReady(bucketedGradients[i].get());
+        }
+
+        // the buckets are known after the first minibatch, from then on reported gradients are reduced during backprop
+        const bool overlapsBackprop = minibatch > 0 && reportsGradientsReady[minibatch];
+        BOOST_CHECK_EQUAL(mpi->NumAllReduceCalls() > numAllReduceCallsBeforeBackprop, overlapsBackprop);
+
+        auto header = CreateHeader(10);
+        auto bucketedHeader = CreateHeader(10);
+        BOOST_CHECK(aggregator.AggregateGradients(GetPointers(gradients), header.get(), minibatch == 0));
+        BOOST_CHECK(bucketedAggregator.AggregateGradients(GetPointers(bucketedGradients), bucketedHeader.get(), minibatch == 0));
+        BOOST_CHECK_EQUAL(bucketedHeader->numSamples, header->numSamples);
+
+        for (size_t i = 0; i < numGradients; i++)
+        {
+            Matrix<float> expected(gradients[i]->GetNumRows(), gradients[i]->GetNumCols(), CPUDEVICE);
+            ComputeGradient(expected, i, minibatch);
+            Matrix<float>::Scale((float) numSimulatedNodes, expected);
+
+            BOOST_CHECK_MESSAGE(gradients[i]->IsEqualTo(expected, 1e-6f), "minibatch " << minibatch << ", gradient " << i << ": wrong aggregation after backprop");
+            BOOST_CHECK_MESSAGE(bucketedGradients[i]->IsEqualTo(*gradients[i], 0), "minibatch " << minibatch << ", gradient " << i << ": bucketed aggregation differs");
+        }
+    }
+
+    // a minibatch without samples gives zero gradients either way
+    for (size_t i = 0; i < numGradients; i++)
+    {
+        ComputeGradient(*gradients[i], i, 0);
+        ComputeGradient(*bucketedGradients[i], i, 0);
+    }
+    auto header = CreateHeader(0);
+    auto bucketedHeader = CreateHeader(0);
+    BOOST_CHECK(!aggregator.AggregateGradients(GetPointers(gradients), header.get(), false));
+    BOOST_CHECK(!bucketedAggregator.AggregateGradients(GetPointers(bucketedGradients), bucketedHeader.get(), false));
+    for (size_t i = 0; i < numGradients; i++)
+    {
+        BOOST_CHECK_EQUAL(gradients[i]->MatrixNorm1(), 0);
+        BOOST_CHECK_EQUAL(bucketedGradients[i]->MatrixNorm1(), 0);
+    }
+}
+
+// Reporting a gradient twice in a minibatch means that backprop and the buckets are out of sync.
+BOOST_AUTO_TEST_CASE(BucketedAggregationRejectsGradientReportedTwice)
+{
+    auto mpi = std::make_shared<SimulatedNodesMPIWrapper>(numSimulatedNodes);
+    SimpleDistGradAggregator<float> bucketedAggregator(mpi, false, CPUDEVICE, 0, /*packThresholdSizeInBytes=*/ 64, /*bucketSizeInBytes=*/ 128);
+
+    auto gradients = CreateGradients();
+    auto header = CreateHeader(10);
+    bucketedAggregator.AggregateGradients(GetPointers(gradients), header.get(), true);
+
+    bucketedAggregator.OnGradientReady(gradients[0].get());
+    BOOST_CHECK_THROW(bucketedAggregator.OnGradientReady(gradients[0].get()), std::logic_error);
+}
+
+// Quantized aggregation on a single node: the gradient is quantized with the residual of the previous minibatch, the
+// owner of the stripe (the node itself) sums and quantizes it again with a residual of its own, and the result is
+// unquantized. The quantization errors must be carried over to the next minibatch, so that over two minibatches the
+// aggregated gradients plus the remaining residuals add up to the gradients that went in.
+BOOST_AUTO_TEST_CASE(QuantizedAggregationFeedsBackQuantizationError)
+{
+    auto mpi = std::make_shared<SimulatedNodesMPIWrapper>(1);
+    const size_t numRows = 6, numCols = 5;
+    const size_t numMinibatches = 2;
+
+    for (int numGradientBits : { 1, 2 })
+    {
+        QuantizedDistGradAggregator<float> aggregator(mpi, numGradientBits, false, 0);
+        QuantizedDistGradAggregator<float> freshAggregator(mpi, numGradientBits, false, 0);
+
+        // the same steps done with the quantizer directly
+        std::unique_ptr<MatrixQuantizerImpl<float>> quantizer(MatrixQuantizerImpl<float>::Create(CPUDEVICE, false));
+        QuantizedMatrix<float> quantized(numRows, numCols, numGradientBits, CPUDEVICE);
+        Matrix<float> residual = Matrix<float>::Zeros(numRows, numCols, CPUDEVICE);
+        Matrix<float> stripeResidual = Matrix<float>::Zeros(numRows, numCols, CPUDEVICE);
+        Matrix<float> stripeSum(numRows, numCols, CPUDEVICE);
+        Matrix<float> expected(numRows, numCols, CPUDEVICE);
+
+        Matrix<float> inputSum = Matrix<float>::Zeros(numRows, numCols, CPUDEVICE);
+        Matrix<float> outputSum = Matrix<float>::Zeros(numRows, numCols, CPUDEVICE);
+        for (size_t minibatch = 0; minibatch < numMinibatches; minibatch++)
+        {
+            Matrix<float> input(numRows, numCols, CPUDEVICE);
+            ComputeGradient(input, 0, minibatch);
+            inputSum += input;
+
+            quantizer->QuantizeAsync(input, residual, quantized, residual, false);
+            quantizer->WaitQuantizeAsyncDone();
+            quantizer->UnquantizeAsync(quantized, stripeSum, false);
+            quantizer->WaitUnquantizeAsyncDone();
+            quantizer->QuantizeAsync(stripeSum, stripeResidual, quantized, stripeResidual, false);
+            quantizer->WaitQuantizeAsyncDone();
+            quantizer->UnquantizeAsync(quantized, expected, false);
+            quantizer->WaitUnquantizeAsyncDone();
+
+            Matrix<float> gradient(numRows, numCols, CPUDEVICE);
+            gradient.SetValue(input);
+            auto header = CreateHeader(10);
+            BOOST_CHECK(aggregator.AggregateGradients({ &gradient }, header.get(), minibatch == 0));
+            BOOST_CHECK_EQUAL(header->numSamples, 10u);
+            BOOST_CHECK_MESSAGE(gradient.IsEqualTo(expected, 1e-6f), numGradientBits << " bits, minibatch " << minibatch << ": aggregated gradient differs from the quantization round trip");
+            outputSum += gradient;
+
+            // a quantization error is left over, which an aggregator without history does not have
+            Matrix<float> freshGradient(numRows, numCols, CPUDEVICE);
+            freshGradient.SetValue(input);
+            auto freshHeader = CreateHeader(10);
+            freshAggregator.AggregateGradients({ &freshGradient }, freshHeader.get(), true);
+            BOOST_CHECK_EQUAL(freshGradient.IsEqualTo(gradient, 1e-6f), minibatch == 0);
+        }
+
+        // error feedback: nothing gets lost, it is either aggregated or still in a residual
+        Matrix<float> remaining(numRows, numCols, CPUDEVICE);
+        remaining.AssignDifferenceOf(inputSum, outputSum);
+        remaining -= residual;
+        remaining -= stripeResidual;
+        BOOST_CHECK_LT(remaining.MatrixNormInf(), 1e-5f);
+        BOOST_CHECK_GT(residual.MatrixNormInf() + stripeResidual.MatrixNormInf(), 0);
+
+        // resetting the state drops the residuals
+        Matrix<float> gradient(numRows, numCols, CPUDEVICE), freshGradient(numRows, numCols, CPUDEVICE);
+        ComputeGradient(gradient, 0, numMinibatches);
+        freshGradient.SetValue(gradient);
+        auto header = CreateHeader(10), freshHeader = CreateHeader(10);
+        aggregator.AggregateGradients({ &gradient }, header.get(), true);
+        QuantizedDistGradAggregator<float> newAggregator(mpi, numGradientBits, false, 0);
+        newAggregator.AggregateGradients({ &freshGradient }, freshHeader.get(), true);
+        BOOST_CHECK(gradient.IsEqualTo(freshGradient, 0));
+    }
+}
+
+// Quantized aggregation across nodes that run on threads of their own. Node j owns the columns numCols * j / numNodes
+// up to numCols * (j + 1) / numNodes of each gradient: it receives that stripe from the other nodes (tagged with the
+// index of the gradient), adds it to its own, quantizes the sum with a residual of its own and sends the result back
+// (tagged with numGradients + 1 + the index), where it is received into the buffers that held the stripes sent before.
+// Gradients with fewer columns than nodes leave some nodes without a stripe. The aggregated gradients must match the
+// same steps done with the quantizer directly, in the same order, and be the same on all nodes.
+BOOST_AUTO_TEST_CASE(QuantizedAggregationAcrossNodes)
+{
+    // with 3 nodes, 2 columns leave node 0 without a stripe and 1 column leaves only node 2 with one
+    const std::vector<std::pair<size_t, size_t>> shapes = { { 6, 5 }, { 4, 2 }, { 3, 1 }, { 5, 7 } };
+    const size_t numGradients = shapes.size();
+    const size_t numMinibatches = 3;
+
+    // node 1 has no samples in the second minibatch: its gradients are zeroed, but its residuals are still sent
+    auto numSamples = [](size_t node, size_t minibatch) -> size_t { return node == 1 && minibatch == 1 ? 0 : 10 + node; };
+    auto computeGradient = [](Matrix<float>& gradient, size_t node, size_t gradientIndex, size_t minibatch) {
+        ComputeGradient(gradient, gradientIndex + 10 * node, minibatch);
+    };
+
+    for (size_t numNodes : { 2, 3 })
+    {
+        for (int numGradientBits : { 1, 2 })
+        {
+            InProcessNetwork network(numNodes);
+            std::vector<std::vector<Gradients>> results(numNodes);
+            std::vector<std::vector<size_t>> aggregatedNumSamples(numNodes);
+            std::vector<std::vector<bool>> hasSamples(numNodes);
+            std::vector<std::exception_ptr> errors(numNodes);
+            std::vector<std::thread> threads;
+            for (size_t node = 0; node < numNodes; node++)
+            {
+                threads.emplace_back([&, node]() {
+                    try
+                    {
+                        auto mpi = std::make_shared<InProcessMPIWrapper>(network, node);
+                        QuantizedDistGradAggregator<float> aggregator(mpi, numGradientBits, false, 0);
+                        for (size_t minibatch = 0; minibatch < numMinibatches; minibatch++)
+                        {
+                            auto gradients = CreateGradients(shapes);
+                            for (size_t i = 0; i < numGradients; i++)
+                                computeGradient(*gradients[i], node, i, minibatch);
+
+                            auto header = CreateHeader(numSamples(node, minibatch));
+                            hasSamples[node].push_back(aggregator.AggregateGradients(GetPointers(gradients), header.get(), minibatch == 0));
+                            aggregatedNumSamples[node].push_back(header->numSamples);
+                            results[node].push_back(std::move(gradients));
+                        }
+                    }
+                    catch (...)
+                    {
+                        errors[node] = std::current_exception();
+                        network.Fail();
+                    }
+                });
+            }
+            for (auto& thread : threads)
+                thread.join();
+            for (const auto& error : errors)
+            {
+                if (error)
+                    std::rethrow_exception(error);
+            }
+
+            // the residuals of the gradients of each node, and of the stripes, each kept by the node that owns it
+            std::unique_ptr<MatrixQuantizerImpl<float>> quantizer(MatrixQuantizerImpl<float>::Create(CPUDEVICE, false));
+            std::vector<Gradients> residuals(numNodes);
+            std::vector<Gradients> stripeResiduals(numNodes);
+            for (size_t node = 0; node < numNodes; node++)
+            {
+                residuals[node] = CreateGradients(shapes);
+                for (const auto& shape : shapes)
+                {
+                    const size_t stripeNumCols = shape.second * (node + 1) / numNodes - shape.second * node / numNodes;
+                    stripeResiduals[node].push_back(stripeNumCols == 0 ? nullptr : std::make_unique<Matrix<float>>(Matrix<float>::Zeros(shape.first, stripeNumCols, CPUDEVICE)));
+                }
+            }
+
+            for (size_t minibatch = 0; minibatch < numMinibatches; minibatch++)
+            {
+                size_t totalNumSamples = 0;
+                for (size_t node = 0; node < numNodes; node++)
+                    totalNumSamples += numSamples(node, minibatch);
+
+                for (size_t i = 0; i < numGradients; i++)
+                {
+                    const size_t numRows = shapes[i].first, numCols = shapes[i].second;
+
+                    // each node quantizes its gradient, which the owners of the stripes unquantize
+                    Gradients unquantized;
+                    for (size_t node = 0; node < numNodes; node++)
+                    {
+                        Matrix<float> input(numRows, numCols, CPUDEVICE);
+                        computeGradient(input, node, i, minibatch);
+                        if (numSamples(node, minibatch) == 0)
+                            input.SetValue(0);
+
+                        QuantizedMatrix<float> quantized(numRows, numCols, numGradientBits, CPUDEVICE);
+                        Quantize(*quantizer, input, *residuals[node][i], quantized);
+                        unquantized.push_back(std::make_unique<Matrix<float>>(numRows, numCols, CPUDEVICE));
+                        Unquantize(*quantizer, quantized, *unquantized.back());
+                    }
+
+                    // the owner adds the stripes of the other nodes to its own, in the order of the nodes
+                    Matrix<float> expected(numRows, numCols, CPUDEVICE);
+                    for (size_t owner = 0; owner < numNodes; owner++)
+                    {
+                        const size_t startCol = numCols * owner / numNodes;
+                        const size_t stripeNumCols = numCols * (owner + 1) / numNodes - startCol;
+                        if (stripeNumCols == 0)
+                            continue;
+
+                        Matrix<float> stripeSum(numRows, stripeNumCols, CPUDEVICE);
+                        stripeSum.SetValue(unquantized[owner]->ColumnSlice(startCol, stripeNumCols));
+                        for (size_t node = 0; node < numNodes; node++)
+                        {
+                            if (node != owner)
+                                stripeSum += unquantized[node]->ColumnSlice(startCol, stripeNumCols);
+                        }
+
+                        QuantizedMatrix<float> quantizedStripe(numRows, stripeNumCols, numGradientBits, CPUDEVICE);
+                        Quantize(*quantizer, stripeSum, *stripeResiduals[owner][i], quantizedStripe);
+                        Unquantize(*quantizer, quantizedStripe, stripeSum);
+                        expected.SetColumnSlice(stripeSum, startCol, stripeNumCols);
+                    }
+
+                    for (size_t node = 0; node < numNodes; node++)
+                    {
+                        const auto& gradient = *results[node][minibatch][i];
+                        BOOST_CHECK_MESSAGE(gradient.IsEqualTo(expected, 1e-6f), numNodes << " nodes, " << numGradientBits << " bits, minibatch " << minibatch << ", gradient " << i << ", node " << node << ": wrong aggregation");
+                        BOOST_CHECK_MESSAGE(gradient.IsEqualTo(*results[0][minibatch][i], 0), numNodes << " nodes, " << numGradientBits << " bits, minibatch " << minibatch << ", gradient " << i << ", node " << node << ": differs from node 0");
+                    }
+                }
+
+                for (size_t node = 0; node < numNodes; node++)
+                {
+                    BOOST_CHECK(hasSamples[node][minibatch]);
+                    BOOST_CHECK_EQUAL(aggregatedNumSamples[node][minibatch], totalNumSamples);
+                }
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}}}}
@@ -0,0 +1,247 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "Sequences.h"
+#include "gammacalculation.h"
+#include <cstdio>
+#include <fstream>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace Microsoft::MSR::CNTK;
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+namespace
+{
+// units of the test model; every unit is a single-state HMM with its own senone
+const char* const testUnits[] = { "sil", "a", "b", "c" };
+const size_t numTestUnits = _countof(testUnits);
+
+// writes the model description files and loads them into 'hset'
+void LoadTestModel(msra::asr::simplesenonehmm& hset)
+{
+    const std::string cdphonetyingPath = "LatticeGammaTests_cdphonetying.txt";
+    const std::string statelistPath = "LatticeGammaTests_statelist.txt";
+    const std::string transPPath = "LatticeGammaTests_transp.txt";
+    {
+        std::ofstream cdphonetying(cdphonetyingPath), statelist(statelistPath), transP(transPPath);
+        transP << "T 1 1.0 0.0 0.6 0.4\n"; // entry, then self-loop and exit of the single state
+        for (size_t u = 0; u < numTestUnits; u++)
+        {
+            statelist << testUnits[u] << "_s2\n";
+            cdphonetying << testUnits[u] << " T " << testUnits[u] << "_s2\n";
+        }
+    }
+    hset.loadfromfile(msra::strfun::utf16(cdphonetyingPath), msra::strfun::utf16(statelistPath), msra::strfun::utf16(transPPath));
+    remove(cdphonetyingPath.c_str());
+    remove(statelistPath.c_str());
+    remove(transPPath.c_str());
+}
+
+// mirrors the header of a serialized lattice (lattice::header_v1_v2)
+struct TestLatticeHeader
+{
+    size_t numnodes : 32;
+    size_t numedges : 32;
+    float lmf;
+    float wp;
+    double frameduration;
+    size_t numframes : 32;
+    size_t impliedspunitid : 31;
+    size_t hasacscores : 1;
+};
+
+// Builds a denominator lattice over 'numFrames' frames: between any two consecutive frames there is one
+// single-frame edge per unit, and every frame is also spanned by a two-frame edge, so that there are
+// many competing paths. The lattice is written in the V1 format and read back through lattice::fread().
+std::shared_ptr<const msra::dbn::latticepair> CreateTestLattice(size_t numFrames, size_t seed)
+{
+    using namespace msra::lattices;
+
+    std::vector<nodeinfo> nodes;
+    for (size_t t = 0; t <= numFrames; t++)
+        nodes.push_back(nodeinfo(t));
+
+    // the algorithms expect the edges to be sorted by end node, then by start node
+    std::vector<edgeinfowithscores> edges;
+    std::vector<aligninfo> align;
+    for (size_t e = 1; e <= numFrames; e++)
+    {
+        if (e >= 2)
+        {
+            edges.push_back(edgeinfowithscores(e - 2, e, 0.0f, -0.3f - 0.05f * ((e + seed) % 5), align.size()));
+            align.push_back(aligninfo(1 + (e + seed) % (numTestUnits - 1), 1));
+            align.push_back(aligninfo(1 + (e + seed + 1) % (numTestUnits - 1), 1));
+            align.back().last = 1;
+        }
+        for (size_t u = 0; u < numTestUnits; u++)
+        {
+            edges.push_back(edgeinfowithscores(e - 1, e, 0.0f, -0.1f * (u + 1) - 0.02f * ((e * 3 + seed) % 7), align.size()));
+            align.push_back(aligninfo(u, 1));
+            align.back().last = 1;
+        }
+    }
+
+    TestLatticeHeader info = {};
+    info.numnodes = nodes.size();
+    info.numedges = edges.size();
+    info.lmf = 1.0f;
+    info.wp = 0.0f;
+    info.frameduration = 0.01;
+    info.numframes = numFrames;
+    info.impliedspunitid = INT_MAX;
+    info.hasacscores = 1;
+
+    FILE* f = tmpfile();
+    BOOST_REQUIRE(f != nullptr);
+    fputTag(f, "LAT ");
+    fputint(f, 1);
+    fwriteOrDie(&info, sizeof(info), 1, f);
+    fputTag(f, "NODE");
+    fputint(f, (int) nodes.size());
+    fwriteOrDie(nodes, f);
+    fputTag(f, "EDGE");
+    fputint(f, (int) edges.size());
+    fwriteOrDie(edges, f);
+    fputTag(f, "ALIG");
+    fputint(f, (int) align.size());
+    fwriteOrDie(align, f);
+    fputTag(f, "END ");
+    rewind(f);
+
+    std::vector<size_t> idmap;
+    for (size_t u = 0; u < numTestUnits; u++)
+        idmap.push_back(u);
+    auto latticePair = std::make_shared<msra::dbn::latticepair>();
+    latticePair->second.fread(f, idmap, SIZE_MAX);
+    fclose(f);
+    return latticePair;
+}
+
+struct GammaResult
+{
+    Matrix<double> gammas;
+    double objective;
+    GammaResult() : gammas(CPUDEVICE), objective(0) {}
+};
+
+// runs calgammaformb() on the given lattices, which are packed one after another into 'logLLs' and 'uids'
+void ComputeGammas(const msra::asr::simplesenonehmm& hset, bool sMBRMode,
+                   std::vector<std::shared_ptr<const msra::dbn::latticepair>> lattices, const Matrix<double>& logLLs, std::vector<size_t> uids,
+                   GammaResult& result)
+{
+    msra::lattices::GammaCalculation<double> gammaCalculation;
+    gammaCalculation.init(hset, CPUDEVICE);
+    msra::lattices::SeqGammarCalParam params;
+    params.sMBRmode = sMBRMode;
+    gammaCalculation.SetGammarCalculationParams(params);
+
+    Matrix<double> objective(1, 1, CPUDEVICE);
+    Matrix<double> labels(logLLs.GetNumRows(), logLLs.GetNumCols(), CPUDEVICE);
+    result.gammas.Resize(logLLs.GetNumRows(), logLLs.GetNumCols());
+    result.gammas.SetValue(0);
+    std::vector<size_t> boundaries(uids.size(), 0);
+    std::vector<size_t> extraUttMap;
+    gammaCalculation.calgammaformb(objective, lattices, logLLs, labels, result.gammas, uids, boundaries, 1, nullptr, extraUttMap, false);
+    result.objective = objective(0, 0);
+}
+
+void SetNumThreads(int numThreads)
+{
+#ifdef _OPENMP
+    omp_set_num_threads(numThreads);
+#else
+    numThreads;
+#endif
+}
+}
+
+BOOST_AUTO_TEST_SUITE(LatticeGammaTests)
+
+// The lattices of a minibatch are processed in parallel, and so are the edges of large lattices.
+// Both must give exactly the same gammas and objective as processing everything on a single thread.
+BOOST_AUTO_TEST_CASE(CalGammaParallelMatchesSerial)
+{
+    msra::asr::simplesenonehmm hset;
+    LoadTestModel(hset);
+
+    // the first lattice is large enough for the edges to be aligned in parallel, the others are not
+    const std::vector<size_t> latticeFrames = { 80, 13, 40, 27 };
+    std::vector<std::shared_ptr<const msra::dbn::latticepair>> lattices;
+    for (size_t i = 0; i < latticeFrames.size(); i++)
+        lattices.push_back(CreateTestLattice(latticeFrames[i], i));
+    BOOST_REQUIRE_GE(lattices[0]->getnumedges(), 256);
+
+    size_t totalFrames = 0;
+    for (auto frames : latticeFrames)
+        totalFrames += frames;
+    Matrix<double> logLLs(numTestUnits, totalFrames, CPUDEVICE);
+    std::vector<size_t> uids(totalFrames);
+    for (size_t t = 0; t < totalFrames; t++)
+    {
+        for (size_t s = 0; s < numTestUnits; s++)
+            logLLs(s, t) = -0.5 - 0.3 * ((s * 7 + t * 13) % 11);
+        uids[t] = (t * 3 + t / 5) % numTestUnits;
+    }
+
+#ifdef _OPENMP
+    const int maxThreads = omp_get_max_threads();
+#else
+    const int maxThreads = 1;
+#endif
+
+    for (bool sMBRMode : { false, true })
+    {
+        // reference: one lattice at a time on a single thread
+        SetNumThreads(1);
+        std::vector<GammaResult> serialResults(lattices.size());
+        double serialObjective = 0;
+        size_t ts = 0;
+        for (size_t i = 0; i < lattices.size(); i++)
+        {
+            const size_t numFrames = latticeFrames[i];
+            std::vector<size_t> latticeUids(uids.begin() + ts, uids.begin() + ts + numFrames);
+            ComputeGammas(hset, sMBRMode, { lattices[i] }, logLLs.ColumnSlice(ts, numFrames), latticeUids, serialResults[i]);
+            serialObjective += serialResults[i].objective;
+            ts += numFrames;
+        }
+
+        // all lattices of the minibatch at once, on multiple threads
+        SetNumThreads(std::max(maxThreads, 4));
+        GammaResult parallelResult;
+        ComputeGammas(hset, sMBRMode, lattices, logLLs, uids, parallelResult);
+
+        // the large lattice alone, so that its edges are aligned on multiple threads
+        GammaResult parallelEdgesResult;
+        ComputeGammas(hset, sMBRMode, { lattices[0] }, logLLs.ColumnSlice(0, latticeFrames[0]), std::vector<size_t>(uids.begin(), uids.begin() + latticeFrames[0]), parallelEdgesResult);
+        SetNumThreads(maxThreads);
+
+        BOOST_CHECK_EQUAL(parallelResult.objective, serialObjective);
+        BOOST_CHECK_EQUAL(parallelEdgesResult.objective, serialResults[0].objective);
+        BOOST_CHECK(parallelEdgesResult.gammas.IsEqualTo(serialResults[0].gammas, 0));
+
+        ts = 0;
+        double gammaSum = 0;
+        for (size_t i = 0; i < lattices.size(); i++)
+        {
+            const size_t numFrames = latticeFrames[i];
+            const auto& serialGammas = serialResults[i].gammas;
+            size_t mismatches = 0;
+            for (size_t t = 0; t < numFrames; t++)
+                for (size_t s = 0; s < numTestUnits; s++)
+                {
+                    mismatches += parallelResult.gammas(s, ts + t) != serialGammas(s, t);
+                    gammaSum += fabs(serialGammas(s, t));
+                }
+            BOOST_CHECK_MESSAGE(mismatches == 0, "lattice " << i << ": " << mismatches << " gammas differ between the serial and the parallel computation");
+            ts += numFrames;
+        }
+        BOOST_CHECK_GT(gammaSum, 0);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+}}}}
@@ -0,0 +1,99 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#include "stdafx.h"
+
+#include "ComputationNode.h"
+#include <memory>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// We perform test on CPU.
+const DEVICEID_TYPE c_deviceId = CPUDEVICE;
+
+BOOST_AUTO_TEST_SUITE(MatrixPoolTestSuite)
+
+BOOST_AUTO_TEST_CASE(PlanMemoryForMinibatchSize)
+{
+    Globals::SetPlanMemoryForMinibatchSize(true);
+
+    // Lifetimes (steps): a [0, 2], b [1, 4], c [3, 6], p [5, never released].
+    // a and c scale with the minibatch size, b and p do not.
+    shared_ptr<Matrix<float>> a, b, c, p;
+    MatrixPool pool;
+    pool.ResetStepCounter();
+    pool.RequestAllocate<float>(c_deviceId, &a, 10, true, false);
+    pool.RequestAllocate<float>(c_deviceId, &b, 500, false, false);
+    pool.RequestRelease<float>(&a);
+    pool.RequestAllocate<float>(c_deviceId, &c, 10, true, false);
+    pool.RequestRelease<float>(&b);
+    pool.RequestAllocate<float>(c_deviceId, &p, 1, false, false);
+    pool.RequestRelease<float>(&c);
+    pool.OptimizedMemoryAllocation();
+
+    BOOST_CHECK_EQUAL(1, pool.GetPlanStatistics().numColumns);
+    BOOST_CHECK(pool.PlanMemoryForMinibatchSize(50));
+    BOOST_CHECK(!pool.PlanMemoryForMinibatchSize(64));
+
+    // Largest first: a and c share a buffer, b overlaps with both and p fits in the buffer of b.
+    auto paramMatrix = p;
+    const auto& statistics = pool.GetPlanStatistics();
+    BOOST_CHECK_EQUAL(64, statistics.numColumns);
+    BOOST_CHECK_EQUAL(4, statistics.numRequests);
+    BOOST_CHECK_EQUAL(2, statistics.numBuffers);
+    BOOST_CHECK(a == c);
+    BOOST_CHECK(b == p);
+    BOOST_CHECK(a != b);
+    BOOST_CHECK_EQUAL((640 + 500) * sizeof(float), statistics.plannedBytes);
+    BOOST_CHECK_EQUAL((640 + 500 + 640 + 1) * sizeof(float), statistics.naiveBytes);
+    BOOST_CHECK_EQUAL((640 + 500) * sizeof(float), statistics.peakLiveBytes);
+
+    // Matrices that are never released keep their matrix object.
+    BOOST_CHECK(pool.PlanMemoryForMinibatchSize(65));
+    BOOST_CHECK_EQUAL(128, pool.GetPlanStatistics().numColumns);
+    BOOST_CHECK(p == paramMatrix);
+    BOOST_CHECK(a == c);
+
+    Globals::SetPlanMemoryForMinibatchSize(false);
+}
+
+BOOST_AUTO_TEST_CASE(PlanMemoryForMinibatchSizeKeepsLargestPlan)
+{
+    Globals::SetPlanMemoryForMinibatchSize(true);
+
+    shared_ptr<Matrix<float>> a, b;
+    MatrixPool pool;
+    pool.ResetStepCounter();
+    pool.RequestAllocate<float>(c_deviceId, &a, 10, true, false);
+    pool.RequestRelease<float>(&a);
+    pool.RequestAllocate<float>(c_deviceId, &b, 10, true, false);
+    pool.RequestRelease<float>(&b);
+    pool.OptimizedMemoryAllocation();
+
+    // Variable-length minibatches and the short last minibatch of an epoch reuse the plan of the largest one.
+    size_t numPlans = 0;
+    for (size_t numColumns : { 512, 300, 512, 17, 512, 1 })
+    {
+        auto matrix = a;
+        if (pool.PlanMemoryForMinibatchSize(numColumns))
+            numPlans++;
+        else
+            BOOST_CHECK(a == matrix);
+        BOOST_CHECK_EQUAL(512, pool.GetPlanStatistics().numColumns);
+    }
+    BOOST_CHECK_EQUAL(1, numPlans);
+
+    BOOST_CHECK(pool.PlanMemoryForMinibatchSize(513));
+    BOOST_CHECK_EQUAL(1024, pool.GetPlanStatistics().numColumns);
+
+    Globals::SetPlanMemoryForMinibatchSize(false);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
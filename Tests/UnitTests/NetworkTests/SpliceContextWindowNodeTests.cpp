@@ -0,0 +1,313 @@
+#include "stdafx.h"
+
+#include "../../../Source/ComputationNetworkLib/ReshapingNodes.h"
+#include "../../../Source/Readers/HTKDeserializers/NeighborAugmentation.h"
+#include "TestHelpers.h"
+#include <memory>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// Extends splice context window node to provide access to protected members.
+template <class ElemType>
+class SpliceContextWindowNodeTest : public SpliceContextWindowNode<ElemType>
+{
+public:
+    SpliceContextWindowNodeTest(size_t leftContext, size_t rightContext, bool windowedInput = false)
+        : SpliceContextWindowNode<ElemType>(CPUDEVICE, L"SpliceContextWindowNodeTest", leftContext, rightContext, windowedInput) {}
+
+    using SpliceContextWindowNode<ElemType>::ForwardProp;
+    using SpliceContextWindowNode<ElemType>::BackpropTo;
+
+    SmallVector<size_t> GetOutputDims() { return this->GetSampleLayout().GetDims(); }
+    void AllocMatrices()
+    {
+        this->CreateValueMatrixIfNull();
+        this->CreateGradientMatrixIfNull();
+        this->Value().Resize(this->GetSampleLayout().GetNumElements(), this->GetMBLayout()->GetNumCols());
+        this->Gradient().Resize(this->GetSampleLayout().GetNumElements(), this->GetMBLayout()->GetNumCols());
+    }
+    Matrix<ElemType>& GetGradient()
+    {
+        return this->Gradient();
+    }
+};
+
+// Two parallel sequences of 4 and 2 frames, the second one is followed by a gap.
+// Columns are ordered by time step, the value of a frame is 10 * s + t, gaps are 99.
+template <class ElemType>
+shared_ptr<DummyNodeTest<ElemType>> CreateSequenceInput()
+{
+    const size_t c_numParallelSequences = 2;
+    const size_t c_numTimeSteps = 4;
+    vector<ElemType> data{0, 10, 1, 11, 2, 99, 3, 99};
+    auto input = make_shared<DummyNodeTest<ElemType>>(CPUDEVICE, c_numParallelSequences * c_numTimeSteps, SmallVector<size_t>{1}, data);
+
+    auto layout = make_shared<MBLayout>();
+    layout->Init(c_numParallelSequences, c_numTimeSteps);
+    layout->AddSequence(0, 0, 0, 4);
+    layout->AddSequence(1, 1, 0, 2);
+    layout->AddGap(1, 2, 4);
+    static_pointer_cast<ComputationNodeBase>(input)->LinkToMBLayout(layout);
+    return input;
+}
+
+template <class ElemType>
+void SpliceContextWindowNodeValidateTestImpl()
+{
+    // Test that the frames of a window are stacked.
+    auto node = make_shared<SpliceContextWindowNodeTest<ElemType>>(2, 1);
+    vector<ElemType> data(6, 0);
+    auto input = make_shared<DummyNodeTest<ElemType>>(CPUDEVICE, 1, SmallVector<size_t>{3, 2}, data);
+    node->AttachInputs(vector<ComputationNodeBasePtr>{input});
+    node->Validate(true);
+
+    BOOST_REQUIRE_MESSAGE(node->GetOutputDims() == SmallVector<size_t>{24}, "Splice context window output has a wrong shape");
+
+    // An input whose last axis happens to have the size of the window is still spliced unless windowedInput=true.
+    vector<ElemType> windowSizedData(12, 0);
+    auto windowSizedInput = make_shared<DummyNodeTest<ElemType>>(CPUDEVICE, 1, SmallVector<size_t>{3, 4}, windowSizedData);
+    node->AttachInputs(vector<ComputationNodeBasePtr>{windowSizedInput});
+    node->Validate(true);
+    BOOST_REQUIRE_MESSAGE(node->GetOutputDims() == SmallVector<size_t>{48}, "Splice context window output has a wrong shape");
+
+    // With windowedInput=true the input must be [frame dim x window size].
+    auto windowedNode = make_shared<SpliceContextWindowNodeTest<ElemType>>(2, 1, true);
+    windowedNode->AttachInputs(vector<ComputationNodeBasePtr>{windowSizedInput});
+    windowedNode->Validate(true);
+    BOOST_REQUIRE_MESSAGE(windowedNode->GetOutputDims() == SmallVector<size_t>{12}, "Splice context window output has a wrong shape for windowed input");
+
+    windowedNode->AttachInputs(vector<ComputationNodeBasePtr>{input});
+    BOOST_CHECK_THROW(windowedNode->Validate(true), std::invalid_argument);
+}
+
+template <class ElemType>
+void SpliceContextWindowNodeForwardTestImpl()
+{
+    // Test that windows are replicated at sequence boundaries and that gaps are zero.
+    auto node = make_shared<SpliceContextWindowNodeTest<ElemType>>(1, 1);
+    auto input = CreateSequenceInput<ElemType>();
+    node->AttachInputs(vector<ComputationNodeBasePtr>{input});
+    node->Validate(true);
+    node->AllocMatrices();
+
+    FrameRange fr;
+    node->ForwardProp(fr);
+
+    vector<ElemType> expected{0, 0, 1, 10, 10, 11, 0, 1, 2, 10, 11, 11, 1, 2, 3, 0, 0, 0, 2, 3, 3, 0, 0, 0};
+    BOOST_REQUIRE_EQUAL(node->Value().GetNumElements(), expected.size());
+    ElemType* outputData = node->Value().Data();
+    for (size_t i = 0; i < expected.size(); i++)
+        BOOST_REQUIRE_MESSAGE(outputData[i] == expected[i], "Splice context window output is invalid");
+}
+
+template <class ElemType>
+void SpliceContextWindowNodeBackwardTestImpl()
+{
+    // Test that a frame receives the gradients of all windows it is part of.
+    auto node = make_shared<SpliceContextWindowNodeTest<ElemType>>(2, 0);
+    auto input = CreateSequenceInput<ElemType>();
+    node->AttachInputs(vector<ComputationNodeBasePtr>{input});
+    node->Validate(true);
+    node->AllocMatrices();
+    node->GetGradient().SetValue(1);
+    input->GetGradient().SetValue(0);
+
+    FrameRange fr;
+    node->BackpropTo(0, fr);
+
+    // Windows of the first sequence are [0 0 0], [0 0 1], [0 1 2], [1 2 3], of the second one [0 0 0], [0 0 1].
+    vector<ElemType> expected{6, 5, 3, 1, 2, 0, 1, 0};
+    ElemType* inputGradient = input->GetGradient().Data();
+    for (size_t i = 0; i < expected.size(); i++)
+        BOOST_REQUIRE_MESSAGE(inputGradient[i] == expected[i], "Splice context window gradient is invalid");
+}
+
+// Frames of the utterances as the HTK deserializer keeps them, with a wrapper for AugmentNeighbors().
+class TestUtterance
+{
+public:
+    TestUtterance(size_t dim, size_t numFrames, float offset) : m_dim(dim), m_frames(dim * numFrames)
+    {
+        for (size_t i = 0; i < m_frames.size(); i++)
+            m_frames[i] = offset + i;
+    }
+
+    size_t size() const { return m_frames.size() / m_dim; }
+    const_array_ref<float> operator[](size_t t) const { return const_array_ref<float>(&m_frames[t * m_dim], m_dim); }
+
+    // the context window of frame t as the reader expands it
+    vector<float> Expand(size_t t, size_t leftContext, size_t rightContext) const
+    {
+        vector<float> window(m_dim * (leftContext + 1 + rightContext));
+        array_ref<float> destination(window.data(), window.size());
+        AugmentNeighbors(*this, t, leftContext, rightContext, destination);
+        return window;
+    }
+
+private:
+    size_t m_dim;
+    vector<float> m_frames;
+};
+
+template <class ElemType>
+void SpliceContextWindowNodeMatchesReaderTestImpl(size_t leftContext, size_t rightContext)
+{
+    // Utterances of 5, 1 and 3 frames in two parallel sequences, the second one holding two utterances and a gap.
+    const size_t dim = 2;
+    const size_t numParallelSequences = 2;
+    const size_t numTimeSteps = 5;
+    const vector<TestUtterance> utterances{ TestUtterance(dim, 5, 0), TestUtterance(dim, 1, 100), TestUtterance(dim, 3, 200) };
+    const vector<size_t> utteranceSequence{ 0, 1, 1 }, utteranceBegin{ 0, 0, 1 };
+
+    auto layout = make_shared<MBLayout>();
+    layout->Init(numParallelSequences, numTimeSteps);
+    vector<ElemType> data(dim * numParallelSequences * numTimeSteps, 0);
+    for (size_t u = 0; u < utterances.size(); u++)
+    {
+        layout->AddSequence(u, utteranceSequence[u], utteranceBegin[u], utteranceBegin[u] + utterances[u].size());
+        for (size_t t = 0; t < utterances[u].size(); t++)
+        {
+            let j = (utteranceBegin[u] + t) * numParallelSequences + utteranceSequence[u];
+            for (size_t i = 0; i < dim; i++)
+                data[j * dim + i] = (ElemType)utterances[u][t][i];
+        }
+    }
+    layout->AddGap(1, 4, 5);
+
+    auto input = make_shared<DummyNodeTest<ElemType>>(CPUDEVICE, numParallelSequences * numTimeSteps, SmallVector<size_t>{dim}, data);
+    static_pointer_cast<ComputationNodeBase>(input)->LinkToMBLayout(layout);
+    auto node = make_shared<SpliceContextWindowNodeTest<ElemType>>(leftContext, rightContext);
+    node->AttachInputs(vector<ComputationNodeBasePtr>{input});
+    node->Validate(true);
+    node->AllocMatrices();
+
+    FrameRange fr;
+    node->ForwardProp(fr);
+
+    let windowDim = dim * (leftContext + 1 + rightContext);
+    const auto& output = node->Value();
+    for (size_t u = 0; u < utterances.size(); u++)
+    {
+        for (size_t t = 0; t < utterances[u].size(); t++)
+        {
+            let j = (utteranceBegin[u] + t) * numParallelSequences + utteranceSequence[u];
+            let expected = utterances[u].Expand(t, leftContext, rightContext);
+            for (size_t i = 0; i < windowDim; i++)
+                BOOST_REQUIRE_MESSAGE(output(i, j) == (ElemType)expected[i], "Splice context window output differs from the reader's expansion at utterance " << u << ", frame " << t);
+        }
+    }
+}
+
+template <class ElemType>
+void SpliceContextWindowNodeWindowedInputTestImpl()
+{
+    // In frame mode the reader gathers the windows, [dim x window size] for every frame, which the node passes through.
+    const size_t dim = 3, leftContext = 2, rightContext = 1, windowSize = leftContext + 1 + rightContext;
+    const vector<TestUtterance> utterances{ TestUtterance(dim, 6, 0), TestUtterance(dim, 2, 100) };
+    const vector<pair<size_t, size_t>> frames{ { 0, 4 }, { 1, 0 }, { 0, 0 }, { 1, 1 }, { 0, 5 } }; // (utterance, frame)
+
+    vector<ElemType> data;
+    for (let& frame : frames)
+    {
+        let window = utterances[frame.first].Expand(frame.second, leftContext, rightContext);
+        data.insert(data.end(), window.begin(), window.end());
+    }
+
+    // frame mode: every frame is a sequence of its own
+    auto layout = make_shared<MBLayout>();
+    layout->Init(frames.size(), 1);
+    for (size_t s = 0; s < frames.size(); s++)
+        layout->AddSequence(s, s, 0, 1);
+
+    auto input = make_shared<DummyNodeTest<ElemType>>(CPUDEVICE, frames.size(), SmallVector<size_t>{dim, windowSize}, data);
+    static_pointer_cast<ComputationNodeBase>(input)->LinkToMBLayout(layout);
+    auto node = make_shared<SpliceContextWindowNodeTest<ElemType>>(leftContext, rightContext, true);
+    node->AttachInputs(vector<ComputationNodeBasePtr>{input});
+    node->Validate(true);
+    BOOST_REQUIRE_MESSAGE(node->GetOutputDims() == SmallVector<size_t>{dim * windowSize}, "Splice context window output has a wrong shape for windowed input");
+    node->AllocMatrices();
+
+    FrameRange fr;
+    node->ForwardProp(fr);
+
+    BOOST_REQUIRE_EQUAL(node->Value().GetNumElements(), data.size());
+    ElemType* outputData = node->Value().Data();
+    for (size_t i = 0; i < data.size(); i++)
+        BOOST_REQUIRE_MESSAGE(outputData[i] == data[i], "Splice context window output is invalid for windowed input");
+
+    node->GetGradient().SetValue(1);
+    input->GetGradient().SetValue(1);
+    node->BackpropTo(0, fr);
+    ElemType* inputGradient = input->GetGradient().Data();
+    for (size_t i = 0; i < data.size(); i++)
+        BOOST_REQUIRE_MESSAGE(inputGradient[i] == 2, "Splice context window gradient is invalid for windowed input");
+}
+
+template <class ElemType>
+void SpliceContextWindowNodeTruncatedTestImpl()
+{
+    // A sequence cut by truncated BPTT lacks the frames beyond the cut, which the reader's expansion uses.
+    const size_t numTimeSteps = 4;
+    vector<ElemType> data{0, 1, 2, 3};
+    auto input = make_shared<DummyNodeTest<ElemType>>(CPUDEVICE, numTimeSteps, SmallVector<size_t>{1}, data);
+    auto layout = make_shared<MBLayout>();
+    layout->Init(1, numTimeSteps);
+    layout->AddSequence(0, 0, -2, numTimeSteps);
+    static_pointer_cast<ComputationNodeBase>(input)->LinkToMBLayout(layout);
+
+    auto node = make_shared<SpliceContextWindowNodeTest<ElemType>>(1, 1);
+    node->AttachInputs(vector<ComputationNodeBasePtr>{input});
+    node->Validate(true);
+    node->AllocMatrices();
+
+    FrameRange fr;
+    BOOST_CHECK_THROW(node->ForwardProp(fr), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_SUITE(SpliceContextWindowNodeTestSuite)
+
+BOOST_AUTO_TEST_CASE(SpliceContextWindowNodeValidateTest)
+{
+    SpliceContextWindowNodeValidateTestImpl<float>();
+    SpliceContextWindowNodeValidateTestImpl<double>();
+}
+
+BOOST_AUTO_TEST_CASE(SpliceContextWindowNodeForwardTest)
+{
+    SpliceContextWindowNodeForwardTestImpl<float>();
+    SpliceContextWindowNodeForwardTestImpl<double>();
+}
+
+BOOST_AUTO_TEST_CASE(SpliceContextWindowNodeBackwardTest)
+{
+    SpliceContextWindowNodeBackwardTestImpl<float>();
+    SpliceContextWindowNodeBackwardTestImpl<double>();
+}
+
+BOOST_AUTO_TEST_CASE(SpliceContextWindowNodeMatchesReaderTest)
+{
+    for (let& context : vector<pair<size_t, size_t>>{ { 1, 1 }, { 2, 1 }, { 0, 3 }, { 5, 5 } })
+    {
+        SpliceContextWindowNodeMatchesReaderTestImpl<float>(context.first, context.second);
+        SpliceContextWindowNodeMatchesReaderTestImpl<double>(context.first, context.second);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(SpliceContextWindowNodeWindowedInputTest)
+{
+    SpliceContextWindowNodeWindowedInputTestImpl<float>();
+    SpliceContextWindowNodeWindowedInputTestImpl<double>();
+}
+
+BOOST_AUTO_TEST_CASE(SpliceContextWindowNodeTruncatedTest)
+{
+    SpliceContextWindowNodeTruncatedTestImpl<float>();
+    SpliceContextWindowNodeTruncatedTestImpl<double>();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} } } }
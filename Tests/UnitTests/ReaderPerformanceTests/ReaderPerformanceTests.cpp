@@ -0,0 +1,177 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// ReaderPerformanceTests.cpp : Reader pipeline throughput benchmark.
+//
+// Drives any reader configuration without a network and reports the throughput of the stages of the reader pipeline
+// (chunk loading, randomization, transformation, packing, transfer into matrices), chunk load latency percentiles,
+// the size of the randomization window and the time spent waiting for the prefetch thread.
+//
+// Usage: readerperformancetests configFile=<file> [section=<section>] [reader=reader] [mbSize=256] [epochSize=0]
+//            [numEpochs=1] [maxMinibatches=0] [deviceId=-1] [profilerDir=<dir>] [<config overrides>]
+//
+// The reader configuration is taken from <section>/<reader> of the configuration, as for a train or test command.
+// An epoch size of 0 reads whole sweeps, maxMinibatches=0 reads whole epochs. With profilerDir the stages are also
+// written to the profiler logs, as for training with profilerEnabled.
+//
+#include "stdafx.h"
+#include "Basics.h"
+#include "Config.h"
+#include "DataReader.h"
+#include "Matrix.h"
+#include "Sequences.h"
+#include "PerformanceProfiler.h"
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+using namespace Microsoft::MSR::CNTK;
+using namespace std;
+
+static const char* c_stageNames[readerStageMax] = {
+    "Load chunk",           // readerStageLoadChunk
+    "Randomize",            // readerStageRandomize
+    "Transform",            // readerStageTransform
+    "Pack",                 // readerStagePack
+    "Transfer",             // readerStageTransfer
+    "Wait for prefetch",    // readerStageWaitForPrefetch
+};
+
+static const double c_megabyte = 1024.0 * 1024.0;
+
+static void PrintStatistics(const ReaderStatistics& statistics, size_t numSamples, double seconds)
+{
+    fprintf(stderr, "\nEnd to end: %zu samples in %.3f s, %.1f samples/s\n\n", numSamples, seconds, seconds > 0 ? numSamples / seconds : 0.0);
+
+    // Times of the stages are inclusive, see ReaderStage.
+    fprintf(stderr, "%-20s %10s %12s %14s %14s %12s\n", "Stage", "Calls", "Seconds", "Samples", "Samples/s", "MB/s");
+    for (int i = 0; i < readerStageMax; i++)
+    {
+        const auto& stage = statistics.stages[i];
+        if (i == readerStageWaitForPrefetch)
+        {
+            fprintf(stderr, "%-20s %10lld %12.3f\n", c_stageNames[i], stage.count, stage.seconds);
+            continue;
+        }
+
+        double samplesPerSecond = stage.seconds > 0 ? stage.samples / stage.seconds : 0.0;
+        double megabytesPerSecond = stage.seconds > 0 ? stage.bytes / c_megabyte / stage.seconds : 0.0;
+        fprintf(stderr, "%-20s %10lld %12.3f %14lld %14.1f %12.1f\n", c_stageNames[i], stage.count, stage.seconds, stage.samples, samplesPerSecond, megabytesPerSecond);
+    }
+
+    fprintf(stderr, "\nChunk load latency: p50 %.2f ms, p90 %.2f ms, p99 %.2f ms, max %.2f ms\n",
+            statistics.chunkLoadP50 * 1000, statistics.chunkLoadP90 * 1000, statistics.chunkLoadP99 * 1000, statistics.chunkLoadMax * 1000);
+
+    // The memory of the window is estimated from the average size of a sample of the loaded chunks.
+    const auto& loadChunk = statistics.stages[readerStageLoadChunk];
+    double bytesPerSample = loadChunk.samples > 0 ? (double)loadChunk.bytes / loadChunk.samples : 0.0;
+    fprintf(stderr, "Randomization window: %lld chunks, %lld samples, ~%.1f MB (peak %lld chunks, %lld samples, ~%.1f MB)\n",
+            statistics.windowChunks, statistics.windowSamples, statistics.windowSamples * bytesPerSample / c_megabyte,
+            statistics.peakWindowChunks, statistics.peakWindowSamples, statistics.peakWindowSamples * bytesPerSample / c_megabyte);
+
+    const auto& wait = statistics.stages[readerStageWaitForPrefetch];
+    fprintf(stderr, "Prefetch stalls: %.3f s (%.1f%% of the end to end time)\n\n", wait.seconds, seconds > 0 ? 100 * wait.seconds / seconds : 0.0);
+}
+
+static void RunBenchmark(const ConfigParameters& config)
+{
+    wstring section = config(L"section", wstring());
+    wstring readerSection = config(L"reader", wstring(L"reader"));
+    size_t mbSize = config(L"mbSize", (size_t)256);
+    size_t epochSize = config(L"epochSize", (size_t)0);
+    size_t numEpochs = config(L"numEpochs", (size_t)1);
+    size_t maxMinibatches = config(L"maxMinibatches", (size_t)0);
+    int deviceId = config(L"deviceId", -1);
+    wstring profilerDir = config(L"profilerDir", wstring());
+
+    if (epochSize == 0)
+        epochSize = requestDataSize;
+
+    const ConfigParameters sectionConfig = section.empty() ? config : config(section);
+    const ConfigParameters readerConfig = sectionConfig(readerSection);
+
+    ProfilerContext profilerContext;
+    if (!profilerDir.empty())
+    {
+        profilerContext.Init(profilerDir);
+        ProfilerEnable(true);
+    }
+
+    DataReader reader(readerConfig);
+
+    auto streams = reader.GetInputStreamDescriptions(deviceId);
+    if (streams.empty())
+        RuntimeError("The reader does not describe its streams, legacy readers are not supported.");
+
+    StreamMinibatchInputs inputs;
+    for (const auto& stream : streams)
+    {
+        auto matrix = make_shared<Matrix<float>>(0, 0, stream.GetDeviceId(), stream.GetMatrixType(), stream.GetMatrixFormat());
+        inputs.AddInput(stream.GetStreamName(), matrix, make_shared<MBLayout>(), TensorShape());
+        fprintf(stderr, "Stream '%ls' (%s)\n", stream.GetStreamName().c_str(), stream.GetMatrixType() == MatrixType::DENSE ? "dense" : "sparse");
+    }
+
+    for (size_t epoch = 0; epoch < numEpochs; epoch++)
+    {
+        ReaderStatisticsReset();
+        ReaderStatisticsEnable(true);
+
+        auto start = chrono::steady_clock::now();
+        reader.StartMinibatchLoop(mbSize, epoch, inputs.GetStreamDescriptions(), epochSize);
+
+        size_t numSamples = 0;
+        size_t numMinibatches = 0;
+        while ((maxMinibatches == 0 || numMinibatches < maxMinibatches) && reader.GetMinibatch(inputs))
+        {
+            numSamples += inputs.begin()->second.pMBLayout->GetActualNumSamples();
+            numMinibatches++;
+        }
+
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        ReaderStatisticsEnable(false);
+        ReaderStatistics statistics;
+        ReaderStatisticsGet(statistics);
+
+        fprintf(stderr, "\nEpoch %zu: %zu minibatches\n", epoch + 1, numMinibatches);
+        PrintStatistics(statistics, numSamples, seconds);
+    }
+}
+
+int wmain(int argc, wchar_t* argv[])
+{
+    try
+    {
+        ConfigParameters config;
+        const std::string rawConfigString = ConfigParameters::ParseCommandLine(argc, argv, config);
+        config.ResolveVariables(rawConfigString);
+
+        RunBenchmark(config);
+    }
+    catch (const exception& e)
+    {
+        fprintf(stderr, "EXCEPTION occurred: %s\n", e.what());
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+#ifndef _WIN32
+int main(int argc, char* argv[])
+{
+    vector<wstring> args;
+    for (int i = 0; i < argc; ++i)
+        args.push_back(msra::strfun::utf16(argv[i]));
+
+    vector<wchar_t*> wargs;
+    for (auto& arg : args)
+        wargs.push_back(&arg[0]);
+
+    return wmain(argc, &wargs[0]);
+}
+#endif
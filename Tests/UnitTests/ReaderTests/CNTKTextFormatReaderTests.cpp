@@ -13,6 +13,8 @@
 #define _fileno fileno
 #endif
 #include <cstdio>
+#include <chrono>
+#include <random>
 #include <boost/scope_exit.hpp>
 #include "Common/ReaderTestHelper.h"
 #include "TextParser.h"
@@ -33,13 +35,14 @@ public:
     ChunkPtr m_chunk;
 
     CNTKTextFormatReaderTestRunner(const string& filename,
-        const vector<StreamDescriptor>& streams, unsigned int maxErrors) :
+        const vector<StreamDescriptor>& streams, unsigned int maxErrors, bool fastParsing = true) :
         m_parser(std::make_shared<CorpusDescriptor>(true), wstring(filename.begin(), filename.end()), streams, true)
     {
         m_parser.SetMaxAllowedErrors(maxErrors);
         m_parser.SetTraceLevel(TextParser<ElemType>::TraceLevel::Info);
         m_parser.SetChunkSize(SIZE_MAX);
         m_parser.SetNumRetries(0);
+        m_parser.SetFastParsing(fastParsing);
         m_parser.Initialize();
     }
     // Retrieves a chunk of data.
@@ -47,6 +50,11 @@ public:
     {
         m_chunk = m_parser.GetChunk(0);
     }
+
+    size_t GetNumSequences()
+    {
+        return m_parser.m_indexer->GetIndex().Chunks()[0].Sequences().size();
+    }
 };
 
 namespace Test {
@@ -1054,6 +1062,99 @@ BOOST_AUTO_TEST_CASE(CNTKTextFormatReaderNoFirstMinibatchData)
         2);
 };
 
+// Parses generated input containing numbers in all supported notations with and without the fast parsing path,
+// checks that both produce bit-identical data and reports the time spent by each of them.
+BOOST_AUTO_TEST_CASE(CNTKTextFormatReader_fast_parsing)
+{
+    vector<StreamDescriptor> streams(2);
+    streams[0].m_alias = "A";
+    streams[0].m_name = L"A";
+    streams[0].m_storageType = StorageType::dense;
+    streams[0].m_sampleDimension = 20;
+
+    streams[1].m_alias = "B";
+    streams[1].m_name = L"B";
+    streams[1].m_storageType = StorageType::sparse_csc;
+    streams[1].m_sampleDimension = 1000;
+
+    string filename = "fast_parsing.txt";
+    {
+        std::mt19937 rng(17);
+        auto digits = [&rng](size_t count)
+        {
+            string result;
+            for (size_t i = 0; i < count; ++i)
+                result += static_cast<char>('0' + rng() % 10);
+            return result;
+        };
+        auto number = [&rng, &digits]()
+        {
+            static const char* signs[] = { "", "", "-", "+" };
+            static const char* exponents[] = { "e", "E", "e-", "e+", "E-" };
+            string result = signs[rng() % 4] + digits(1 + rng() % (rng() % 4 == 0 ? 25 : 6));
+            switch (rng() % 5)
+            {
+            case 0: return result;
+            case 1: return result + ".";
+            case 2: return result + "." + digits(1 + rng() % (rng() % 4 == 0 ? 30 : 8));
+            case 3: return result + exponents[rng() % 5] + digits(1 + rng() % 2);
+            default: return result + "." + digits(1 + rng() % 8) + exponents[rng() % 5] + digits(1 + rng() % 3);
+            }
+        };
+
+        boost::filesystem::remove(filename);
+        std::ofstream file;
+        file.open(filename, std::ofstream::out);
+        for (size_t row = 0; row < 20000; ++row)
+        {
+            file << row / 4 << "\t|A";
+            for (size_t i = 0; i < streams[0].m_sampleDimension; ++i)
+                file << " " << number();
+            file << (row % 7 == 0 ? " |# a comment to skip " + digits(40) + "\t" : "\t") << "|B";
+            for (size_t i = rng() % 10; i > 0; --i)
+                file << " " << rng() % streams[1].m_sampleDimension << ":" << number();
+            file << "\n";
+        }
+    }
+
+    vector<unique_ptr<CNTKTextFormatReaderTestRunner<double>>> testRunners;
+    vector<double> milliseconds;
+    for (bool fastParsing : { false, true })
+    {
+        testRunners.push_back(make_unique<CNTKTextFormatReaderTestRunner<double>>(filename, streams, 0, fastParsing));
+        auto start = std::chrono::steady_clock::now();
+        testRunners.back()->LoadChunk();
+        milliseconds.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    BOOST_TEST_MESSAGE("Parsing " << filename << ": " << milliseconds[0] << " ms, with fast parsing: " << milliseconds[1] << " ms.");
+
+    size_t numSequences = testRunners[0]->GetNumSequences();
+    BOOST_REQUIRE_EQUAL(numSequences, 5000);
+    for (size_t i = 0; i < numSequences; ++i)
+    {
+        vector<SequenceDataPtr> expected, actual;
+        testRunners[0]->m_chunk->GetSequence(i, expected);
+        testRunners[1]->m_chunk->GetSequence(i, actual);
+        BOOST_REQUIRE_EQUAL(expected.size(), actual.size());
+
+        BOOST_REQUIRE_EQUAL(expected[0]->m_numberOfSamples, actual[0]->m_numberOfSamples);
+        auto expectedDense = reinterpret_cast<const double*>(expected[0]->GetDataBuffer());
+        auto actualDense = reinterpret_cast<const double*>(actual[0]->GetDataBuffer());
+        size_t numValues = expected[0]->m_numberOfSamples * streams[0].m_sampleDimension;
+        BOOST_REQUIRE(memcmp(expectedDense, actualDense, numValues * sizeof(double)) == 0);
+
+        auto expectedSparse = static_pointer_cast<SparseSequenceData>(expected[1]);
+        auto actualSparse = static_pointer_cast<SparseSequenceData>(actual[1]);
+        BOOST_REQUIRE_EQUAL(expectedSparse->m_totalNnzCount, actualSparse->m_totalNnzCount);
+        BOOST_REQUIRE(expectedSparse->m_nnzCounts == actualSparse->m_nnzCounts);
+        numValues = expectedSparse->m_totalNnzCount;
+        BOOST_REQUIRE(memcmp(expectedSparse->m_indices, actualSparse->m_indices, numValues * sizeof(IndexType)) == 0);
+        BOOST_REQUIRE(memcmp(expectedSparse->GetDataBuffer(), actualSparse->GetDataBuffer(), numValues * sizeof(double)) == 0);
+    }
+
+    boost::filesystem::remove(filename);
+};
+
 BOOST_AUTO_TEST_SUITE_END()
 
 } } } }
@@ -4,11 +4,42 @@
 //
 #include "stdafx.h"
 #include "Common/ReaderTestHelper.h"
+#ifdef ENABLE_IMAGEREADER_TESTS
+#include <opencv2/opencv.hpp>
+#include "ImageDecoder.h"
+#endif
 
 using namespace Microsoft::MSR::CNTK;
 
 namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
 
+#ifdef ENABLE_IMAGEREADER_TESTS
+namespace
+{
+std::vector<unsigned char> ReadImageFile(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    BOOST_REQUIRE_MESSAGE(file, "Cannot open file " << path);
+    return std::vector<unsigned char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+// SOI, an APP0 segment with 2 fill bytes in front of its marker, an APP1 segment, a standalone marker
+// and a baseline frame header of a 300x200 (width x height) image, followed by some data.
+const std::vector<unsigned char> testJpegHeader =
+{
+    0xFF, 0xD8,
+    0xFF, 0xFF, 0xFF, 0xE0, 0x00, 0x06, 'J', 'F', 'I', 'F',
+    0xFF, 0xE1, 0x00, 0x05, 0xC0, 0x01, 0x02,
+    0xFF, 0x01,
+    0xFF, 0xC0, 0x00, 0x0B, 0x08, 0x00, 0xC8, 0x01, 0x2C, 0x01, 0x01, 0x11, 0x00,
+    0xFF, 0xDA, 0x00, 0x08
+};
+const size_t testJpegFrameMarkerOffset = 22;
+const size_t testJpegFrameHeaderEnd = 30;
+}
+#endif
+
+
 struct ImageReaderFixture : ReaderFixture
 {
     ImageReaderFixture()
@@ -380,6 +411,28 @@ BOOST_AUTO_TEST_CASE(ImageReaderMultiView)
         1);
 }
 
+BOOST_AUTO_TEST_CASE(ImageReaderMultiViewDecodedImageCache)
+{
+    // All copies of an image after the first one come from the cache, the output must not change.
+    HelperRunReaderTest<float>(
+        testDataPath() + "/Config/ImageReaderMultiView_Config.cntk",
+        testDataPath() + "/Control/ImageReaderMultiView_Control.txt",
+        testDataPath() + "/Control/ImageReaderMultiViewDecodedImageCache_Output.txt",
+        "MultiView_Test",
+        "reader",
+        10,
+        10,
+        1,
+        1,
+        0,
+        0,
+        1,
+        false,
+        false,
+        true,
+        { L"MultiView_Test=[reader=[decodedImageCacheSizeInBytes=1048576]]" });
+}
+
 BOOST_AUTO_TEST_CASE(ImageReaderIntensityTransform)
 {
     HelperRunReaderTest<float>(
@@ -550,6 +603,189 @@ BOOST_AUTO_TEST_CASE(ImageReaderNoMatchingIds)
     });
 }
 
+BOOST_AUTO_TEST_CASE(ImageReaderDecodedImageCacheMultipleEpochs)
+{
+    // From the second epoch on all images come from the cache, the output must not change.
+    auto readEpochs = [this](const string& outputFile, std::vector<std::wstring> additionalParameters)
+    {
+        HelperReadInAndWriteOut<float>(
+            testDataPath() + "/Config/ImageReaderSimple_Config.cntk",
+            outputFile,
+            "Simple_Test",
+            "reader",
+            4,
+            4,
+            3,
+            1,
+            1,
+            0,
+            1,
+            false,
+            false,
+            true,
+            additionalParameters);
+    };
+
+    readEpochs(testDataPath() + "/Control/ImageReaderDecodedImageCacheMultipleEpochs_Reference.txt", {});
+    readEpochs(testDataPath() + "/Control/ImageReaderDecodedImageCacheMultipleEpochs_Output.txt",
+               { L"Simple_Test=[reader=[decodedImageCacheSizeInBytes=1048576]]" });
+
+    CheckFilesEquivalent(
+        testDataPath() + "/Control/ImageReaderDecodedImageCacheMultipleEpochs_Reference.txt",
+        testDataPath() + "/Control/ImageReaderDecodedImageCacheMultipleEpochs_Output.txt");
+}
+
+#ifdef ENABLE_IMAGEREADER_TESTS
+BOOST_AUTO_TEST_CASE(ImageDecoderJpegDimensions)
+{
+    int width = 0, height = 0;
+    BOOST_REQUIRE(GetJpegDimensions(testJpegHeader.data(), testJpegHeader.size(), width, height));
+    BOOST_CHECK_EQUAL(width, 300);
+    BOOST_CHECK_EQUAL(height, 200);
+
+    // Progressive frame header.
+    auto progressive = testJpegHeader;
+    progressive[testJpegFrameMarkerOffset] = 0xC2;
+    BOOST_REQUIRE(GetJpegDimensions(progressive.data(), progressive.size(), width, height));
+    BOOST_CHECK_EQUAL(width, 300);
+    BOOST_CHECK_EQUAL(height, 200);
+
+    // The data is cut before the end of the frame header.
+    for (size_t size = 0; size < testJpegFrameHeaderEnd; size++)
+        BOOST_CHECK_MESSAGE(!GetJpegDimensions(testJpegHeader.data(), size, width, height), "truncated to " << size << " bytes");
+
+    // The scan starts before a frame header.
+    auto noFrame = testJpegHeader;
+    noFrame[testJpegFrameMarkerOffset] = 0xDA;
+    BOOST_CHECK(!GetJpegDimensions(noFrame.data(), noFrame.size(), width, height));
+
+    // A segment is not followed by a marker.
+    auto corrupt = testJpegHeader;
+    corrupt[19] = 0x00;
+    BOOST_CHECK(!GetJpegDimensions(corrupt.data(), corrupt.size(), width, height));
+
+    auto jpeg = ReadImageFile(testDataPath() + "/Data/images/red.jpg");
+    BOOST_REQUIRE(GetJpegDimensions(jpeg.data(), jpeg.size(), width, height));
+    BOOST_CHECK_EQUAL(width, 4);
+    BOOST_CHECK_EQUAL(height, 8);
+
+    auto png = ReadImageFile(testDataPath() + "/Data/images/grayscale.png");
+    BOOST_CHECK(!GetJpegDimensions(png.data(), png.size(), width, height));
+}
+
+BOOST_AUTO_TEST_CASE(ImageDecoderReductionFactor)
+{
+    BOOST_CHECK_EQUAL(GetReductionFactor(640, 480, 0), 8);
+    BOOST_CHECK_EQUAL(GetReductionFactor(640, 480, 60), 8);
+    BOOST_CHECK_EQUAL(GetReductionFactor(640, 480, 61), 4);
+    BOOST_CHECK_EQUAL(GetReductionFactor(640, 480, 224), 2);
+    BOOST_CHECK_EQUAL(GetReductionFactor(480, 640, 240), 2);
+    BOOST_CHECK_EQUAL(GetReductionFactor(640, 480, 241), 1);
+    BOOST_CHECK_EQUAL(GetReductionFactor(640, 480, 1000), 1);
+    // The reduced size is rounded up: 375 / 8 = 46.9 pixels are decoded as 47.
+    BOOST_CHECK_EQUAL(GetReductionFactor(500, 375, 47), 8);
+    BOOST_CHECK_EQUAL(GetReductionFactor(500, 375, 48), 4);
+    BOOST_CHECK_EQUAL(GetReductionFactor(4, 8, 2), 2);
+}
+
+#ifdef USE_LIBJPEG
+BOOST_AUTO_TEST_CASE(ImageDecoderReducedDecode)
+{
+    for (auto name : { "red", "green", "blue", "black" })
+    {
+        auto jpeg = ReadImageFile(testDataPath() + "/Data/images/" + name + ".jpg");
+        for (bool grayscale : { false, true })
+        {
+            cv::Mat full = DecodeImage(jpeg.data(), jpeg.size(), grayscale, 0);
+            BOOST_REQUIRE_EQUAL(full.cols, 4);
+            BOOST_REQUIRE_EQUAL(full.rows, 8);
+
+            for (size_t minSize : { 1, 2, 4 })
+            {
+                cv::Mat reduced = DecodeImage(jpeg.data(), jpeg.size(), grayscale, minSize);
+                int factor = GetReductionFactor(4, 8, minSize);
+                BOOST_REQUIRE_EQUAL(reduced.type(), full.type());
+                BOOST_REQUIRE_EQUAL(reduced.cols, (4 + factor - 1) / factor);
+                BOOST_REQUIRE_EQUAL(reduced.rows, (8 + factor - 1) / factor);
+
+                // The test images have a single color, which is kept exactly in the DCT domain.
+                cv::Mat expected;
+                cv::resize(full, expected, reduced.size(), 0, 0, cv::INTER_AREA);
+                BOOST_CHECK_MESSAGE(cv::countNonZero(cv::Mat(reduced != expected).reshape(1)) == 0,
+                                    name << ".jpg, grayscale " << grayscale << ", minSize " << minSize);
+            }
+        }
+    }
+
+    // Other formats are decoded at full resolution.
+    auto png = ReadImageFile(testDataPath() + "/Data/images/grayscale.png");
+    cv::Mat full = DecodeImage(png.data(), png.size(), true, 0);
+    cv::Mat image = DecodeImage(png.data(), png.size(), true, 1);
+    BOOST_CHECK_EQUAL(image.size(), full.size());
+}
+
+BOOST_AUTO_TEST_CASE(ImageReaderDecodeMinSize)
+{
+    // The images are decoded at half their resolution and scaled back up, the colors must not change.
+    HelperRunReaderTest<float>(
+        testDataPath() + "/Config/ImageReaderSimple_Config.cntk",
+        testDataPath() + "/Control/ImageReaderSimple_Control.txt",
+        testDataPath() + "/Control/ImageReaderDecodeMinSize_Output.txt",
+        "Simple_Test",
+        "reader",
+        4,
+        4,
+        1,
+        1,
+        0,
+        0,
+        1,
+        false,
+        false,
+        true,
+        { L"Simple_Test=[reader=[decodeMinSize=2]]" });
+}
+#else
+BOOST_AUTO_TEST_CASE(ImageReaderDecodeMinSizeWithoutLibjpeg)
+{
+    BOOST_CHECK_THROW(VerifyDecodeMinSize(2), std::invalid_argument);
+    VerifyDecodeMinSize(0);
+}
+#endif
+
+BOOST_AUTO_TEST_CASE(ImageDecoderCacheMultipleEpochs)
+{
+    auto jpeg = ReadImageFile(testDataPath() + "/Data/images/red.jpg");
+    cv::Mat decoded = DecodeImage(jpeg.data(), jpeg.size(), false, 0);
+    const size_t imageSize = decoded.total() * decoded.elemSize();
+
+    // Space for two of the three images.
+    DecodedImageCache cache(2 * imageSize + imageSize / 2);
+    for (size_t epoch = 0; epoch < 3; epoch++)
+    {
+        for (size_t seqId : { 2, 0, 1 })
+        {
+            cv::Mat image;
+            bool cached = cache.TryGet(seqId, image);
+            BOOST_CHECK_EQUAL(cached, epoch > 0 && seqId != 1);
+            if (!cached)
+            {
+                image = decoded.clone();
+                cache.Add(seqId, image);
+            }
+
+            BOOST_REQUIRE_EQUAL(cv::countNonZero(cv::Mat(image != decoded).reshape(1)), 0);
+
+            // Transforms modify the image in place, this must not change the cached copy.
+            image.setTo(cv::Scalar::all(0));
+        }
+
+        BOOST_CHECK_EQUAL(cache.GetNumImages(), 2u);
+        BOOST_CHECK_EQUAL(cache.GetSizeInBytes(), 2 * imageSize);
+    }
+}
+#endif
+
 BOOST_AUTO_TEST_SUITE_END()
 
 namespace
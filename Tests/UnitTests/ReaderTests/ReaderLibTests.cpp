@@ -16,6 +16,11 @@
 #include "CudaMemoryProvider.h"
 #include "HeapMemoryProvider.h"
 #include "MemoryBuffer.h"
+#include "Indexer.h"
+#include "ChunkCache.h"
+#include "ReaderShim.h"
+#include "IndexCache.h"
+#include "../../../Source/Readers/HTKDeserializers/MLFIndexer.h"
 
 #pragma warning(push)
 // disable warning about possible mod 0 operation in uniform_int_distribution
@@ -927,6 +932,85 @@ BOOST_AUTO_TEST_CASE(NoRandomizerOneEpoch)
                                   actual.begin(), actual.end());
 }
 
+BOOST_AUTO_TEST_CASE(ChunkCacheEvictsLeastRecentlyUsed)
+{
+    vector<float> data(10);
+    iota(data.begin(), data.end(), 0.0f);
+    auto mockDeserializer = make_shared<MockDeserializer>(5, 2, data);
+
+    // Every chunk holds two sequences of a single float, room for two chunks.
+    auto cache = make_shared<ChunkCache>(mockDeserializer, 2 * 2 * sizeof(float));
+
+    auto chunk0 = cache->GetChunk(0);
+    auto chunk1 = cache->GetChunk(1);
+    BOOST_CHECK(cache->GetChunk(0) == chunk0);
+    cache->GetChunk(2); // evicts chunk 1
+    BOOST_CHECK(cache->GetChunk(0) == chunk0);
+    BOOST_CHECK(cache->GetChunk(1) != chunk1); // evicts chunk 2
+
+    auto statistics = cache->GetStatistics();
+    BOOST_CHECK_EQUAL(statistics.m_hits, 2);
+    BOOST_CHECK_EQUAL(statistics.m_misses, 4);
+    BOOST_CHECK_EQUAL(statistics.m_evictions, 2);
+    BOOST_CHECK_EQUAL(statistics.m_prefetches, 0);
+    BOOST_CHECK_EQUAL(statistics.m_sizeInBytes, 2 * 2 * sizeof(float));
+}
+
+void ChunkCacheWithRandomizerTest(bool randomize)
+{
+    vector<float> data(20);
+    iota(data.begin(), data.end(), 0.0f);
+
+    auto createRandomizer = [randomize](IDataDeserializerPtr deserializer) -> SequenceEnumeratorPtr
+    {
+        if (randomize)
+            return make_shared<BlockRandomizer>(0, 18, deserializer, true, false);
+        return make_shared<NoRandomizer>(deserializer);
+    };
+
+    auto readEpochs = [&data](SequenceEnumeratorPtr randomizer)
+    {
+        vector<float> actual;
+        for (size_t epoch = 0; epoch < 3; ++epoch)
+        {
+            EpochConfiguration epochConfiguration;
+            epochConfiguration.m_numberOfWorkers = 1;
+            epochConfiguration.m_workerRank = 0;
+            epochConfiguration.m_minibatchSizeInSamples = 0;
+            epochConfiguration.m_totalEpochSizeInSamples = data.size();
+            epochConfiguration.m_epochIndex = epoch;
+            randomizer->StartEpoch(epochConfiguration);
+
+            for (int i = 0; i < data.size(); i++)
+            {
+                Sequences sequences = randomizer->GetNextSequences(1, 1);
+                BOOST_REQUIRE_EQUAL(sequences.m_data.size(), 1);
+                auto& data2 = reinterpret_cast<DenseSequenceData&>(*sequences.m_data[0][0]);
+                actual.push_back(*((float*)data2.GetDataBuffer()));
+            }
+        }
+        return actual;
+    };
+
+    auto expected = readEpochs(createRandomizer(make_shared<MockDeserializer>(10, 2, data)));
+
+    // Room for three chunks, the chunks are prefetched by the cache in the background.
+    auto cache = make_shared<ChunkCache>(make_shared<MockDeserializer>(10, 2, data), 3 * 2 * sizeof(float), true);
+    auto actual = readEpochs(createRandomizer(cache));
+
+    BOOST_CHECK_EQUAL_COLLECTIONS(expected.begin(), expected.end(), actual.begin(), actual.end());
+
+    auto statistics = cache->GetStatistics();
+    BOOST_CHECK_GT(statistics.m_hits + statistics.m_misses, 0);
+    BOOST_CHECK_LE(statistics.m_sizeInBytes, 3 * 2 * sizeof(float));
+}
+
+BOOST_AUTO_TEST_CASE(ChunkCacheWithRandomizers)
+{
+    ChunkCacheWithRandomizerTest(false);
+    ChunkCacheWithRandomizerTest(true);
+}
+
 BOOST_AUTO_TEST_CASE(CheckGetCurrentCursorForRandomizers)
 {
     size_t chunkSizeInSamples = 10000;
@@ -1517,6 +1601,244 @@ BOOST_AUTO_TEST_CASE(MemoryBufferFullLineWithoutLastCR)
     remove("test.tmp");
 }
 
+static void CheckIndicesEqual(const Index& expected, const Index& actual)
+{
+    const auto& expectedChunks = expected.Chunks();
+    const auto& actualChunks = actual.Chunks();
+    BOOST_REQUIRE_EQUAL(expectedChunks.size(), actualChunks.size());
+    for (size_t i = 0; i < expectedChunks.size(); ++i)
+    {
+        BOOST_CHECK_EQUAL(expectedChunks[i].m_offset, actualChunks[i].m_offset);
+        BOOST_CHECK_EQUAL(expectedChunks[i].SizeInBytes(), actualChunks[i].SizeInBytes());
+        BOOST_CHECK_EQUAL(expectedChunks[i].NumSamples(), actualChunks[i].NumSamples());
+
+        const auto& expectedSequences = expectedChunks[i].Sequences();
+        const auto& actualSequences = actualChunks[i].Sequences();
+        BOOST_REQUIRE_EQUAL(expectedSequences.size(), actualSequences.size());
+        for (size_t j = 0; j < expectedSequences.size(); ++j)
+        {
+            BOOST_CHECK_EQUAL(expectedSequences[j].m_key, actualSequences[j].m_key);
+            BOOST_CHECK_EQUAL(expectedSequences[j].m_numberOfSamples, actualSequences[j].m_numberOfSamples);
+            BOOST_CHECK_EQUAL(expectedSequences[j].OffsetInChunk(), actualSequences[j].OffsetInChunk());
+            BOOST_CHECK_EQUAL(expectedSequences[j].SizeInBytes(), actualSequences[j].SizeInBytes());
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(IndexerInParallel)
+{
+    FILE* test = fopen("test.tmp", "w+b");
+    fwrite(g_MemBufferTextData.c_str(), 1, g_MemBufferTextData.size(), test);
+    fclose(test);
+
+    auto buildIndex = [](size_t numThreads, bool skipSequenceIds)
+    {
+        FILE* file = fopen("test.tmp", "rb");
+        auto indexer = make_shared<Indexer>(file, true, skipSequenceIds, '|', 40);
+        indexer->SetNumThreads(numThreads);
+        indexer->Build(make_shared<CorpusDescriptor>(true));
+        fclose(file);
+        return indexer;
+    };
+
+    for (bool skipSequenceIds : { false, true })
+    {
+        auto expected = buildIndex(1, skipSequenceIds);
+        auto actual = buildIndex(4, skipSequenceIds);
+        CheckIndicesEqual(expected->GetIndex(), actual->GetIndex());
+    }
+
+    remove("test.tmp");
+}
+
+BOOST_AUTO_TEST_CASE(IndexerInParallelAcrossRangeBoundaries)
+{
+    // Sequences of 10 lines each, so that most of the range boundaries fall inside a sequence.
+    // Every third line continues the sequence without repeating its id.
+    auto makeData = [](bool symbolicKeys)
+    {
+        std::string data;
+        for (size_t sequence = 0; sequence < 5; ++sequence)
+        {
+            std::string id = symbolicKeys ? "seq" + std::to_string(sequence) : std::to_string(sequence);
+            for (size_t line = 0; line < 10; ++line)
+                data += (line % 3 == 2 ? std::string() : id) + "\t|a " + std::to_string(line) + " 1\t|b 2\n";
+        }
+        // The last line is not terminated.
+        data += symbolicKeys ? "seq5\t|a 1 1" : "5\t|a 1 1";
+        return data;
+    };
+
+    auto buildIndex = [](bool symbolicKeys, size_t numThreads, size_t minRangeSize, bool skipSequenceIds, const std::string& mainStream)
+    {
+        FILE* file = fopen("test.tmp", "rb");
+        auto indexer = make_shared<Indexer>(file, true, skipSequenceIds, '|', 64, mainStream);
+        indexer->SetNumThreads(numThreads);
+        indexer->SetMinRangeSize(minRangeSize);
+        indexer->Build(make_shared<CorpusDescriptor>(!symbolicKeys));
+        fclose(file);
+        return indexer;
+    };
+
+    for (bool symbolicKeys : { false, true })
+    {
+        std::string data = makeData(symbolicKeys);
+        FILE* test = fopen("test.tmp", "w+b");
+        fwrite(data.c_str(), 1, data.size(), test);
+        fclose(test);
+
+        for (bool skipSequenceIds : { false, true })
+        {
+            if (symbolicKeys && skipSequenceIds)
+                continue; // line numbers are numeric keys
+
+            for (const std::string& mainStream : { std::string(), std::string("|b") })
+            {
+                auto expected = buildIndex(symbolicKeys, 1, 1, skipSequenceIds, mainStream);
+                BOOST_REQUIRE_EQUAL(expected->GetIndex().Chunks().size() > 1, true);
+
+                // From a single range (minRangeSize == file size) up to 4 ranges per thread, most of which
+                // start and end inside a sequence.
+                for (size_t numThreads : { 2, 4, 7 })
+                    for (size_t minRangeSize : { (size_t)1, (size_t)17, data.size() / 3, data.size() })
+                    {
+                        auto actual = buildIndex(symbolicKeys, numThreads, minRangeSize, skipSequenceIds, mainStream);
+                        CheckIndicesEqual(expected->GetIndex(), actual->GetIndex());
+                        BOOST_CHECK_EQUAL(expected->HasSequenceIds(), actual->HasSequenceIds());
+                    }
+            }
+        }
+    }
+
+    remove("test.tmp");
+}
+
+BOOST_AUTO_TEST_CASE(IndexerWithCache)
+{
+    FILE* test = fopen("test.tmp", "w+b");
+    fwrite(g_MemBufferTextData.c_str(), 1, g_MemBufferTextData.size(), test);
+    fclose(test);
+    remove("test.tmp.cntkidx");
+
+    auto buildIndex = [](CorpusDescriptorPtr corpus, bool useCache, size_t chunkSize)
+    {
+        FILE* file = fopen("test.tmp", "rb");
+        auto indexer = make_shared<Indexer>(file, true, false, '|', chunkSize);
+        if (useCache)
+            indexer->EnableCache(L"test.tmp");
+        indexer->Build(corpus);
+        fclose(file);
+        return indexer;
+    };
+
+    // Numeric keys, the cache is written by the first build and read by the second one.
+    auto expected = buildIndex(make_shared<CorpusDescriptor>(true), false, 40);
+    auto written = buildIndex(make_shared<CorpusDescriptor>(true), true, 40);
+    BOOST_CHECK(fexists(L"test.tmp.cntkidx"));
+    auto restored = buildIndex(make_shared<CorpusDescriptor>(true), true, 40);
+    CheckIndicesEqual(expected->GetIndex(), written->GetIndex());
+    CheckIndicesEqual(expected->GetIndex(), restored->GetIndex());
+
+    // Chunks are recomputed for the current chunk size.
+    CheckIndicesEqual(buildIndex(make_shared<CorpusDescriptor>(true), false, 70)->GetIndex(),
+                      buildIndex(make_shared<CorpusDescriptor>(true), true, 70)->GetIndex());
+
+    // A cache of another version of the input is ignored.
+    const std::string appended = "2\t|a 11 11\n";
+    test = fopen("test.tmp", "ab");
+    fwrite(appended.c_str(), 1, appended.size(), test);
+    fclose(test);
+    auto expectedChanged = buildIndex(make_shared<CorpusDescriptor>(true), false, 40);
+    auto restoredChanged = buildIndex(make_shared<CorpusDescriptor>(true), true, 40);
+    CheckIndicesEqual(expectedChanged->GetIndex(), restoredChanged->GetIndex());
+    BOOST_CHECK_EQUAL(restoredChanged->GetIndex().Chunks().back().Sequences().back().m_key, 2);
+
+    // Symbolic keys are mapped through the corpus again, so they get the ids the corpus would assign to them now.
+    auto symbolicCorpus = [] {
+        auto corpus = make_shared<CorpusDescriptor>(false);
+        corpus->KeyToId("unrelated");
+        return corpus;
+    };
+    buildIndex(make_shared<CorpusDescriptor>(false), true, 40);
+    auto expectedSymbolic = buildIndex(symbolicCorpus(), false, 40);
+    auto restoredSymbolic = buildIndex(symbolicCorpus(), true, 40);
+    CheckIndicesEqual(expectedSymbolic->GetIndex(), restoredSymbolic->GetIndex());
+
+    remove("test.tmp");
+    remove("test.tmp.cntkidx");
+}
+
+BOOST_AUTO_TEST_CASE(MLFIndexerWithCache)
+{
+    const std::string mlf =
+        "#!MLF!#\n"
+        "\"utterance1.lab\"\n"
+        "0 100000 s1\n"
+        "100000 300000 s2\n"
+        ".\n"
+        "\"*/utterance2.lab\"\n"
+        "0 200000 s3\n"
+        "200000 500000 s4\n"
+        "500000 600000 s5\n"
+        ".\n"
+        "#!MLF!#\n"
+        "\"utterance3.lab\"\n"
+        "0 400000 s6\n"
+        ".\n";
+    FILE* test = fopen("test.tmp.mlf", "w+b");
+    fwrite(mlf.c_str(), 1, mlf.size(), test);
+    fclose(test);
+    remove("test.tmp.mlf.cntkidx");
+
+    const size_t chunkSize = 40;
+    auto buildIndex = [&](CorpusDescriptorPtr corpus, bool useCache, bool frameMode)
+    {
+        FILE* file = fopen("test.tmp.mlf", "rb");
+        auto indexer = make_shared<MLFIndexer>(file, frameMode, chunkSize, /*bufferSize=*/ 1024);
+        if (useCache)
+            indexer->EnableCache(L"test.tmp.mlf");
+        indexer->Build(corpus);
+        fclose(file);
+        return indexer;
+    };
+
+    for (bool frameMode : { false, true })
+    {
+        auto corpus = make_shared<CorpusDescriptor>(false);
+        auto expected = buildIndex(corpus, false, frameMode);
+        size_t numSequences = 0;
+        for (const auto& chunk : expected->GetIndex().Chunks())
+            numSequences += chunk.Sequences().size();
+        BOOST_REQUIRE_EQUAL(numSequences, 3);
+        BOOST_REQUIRE_EQUAL(expected->GetIndex().Chunks().size() > 1, true);
+
+        // The first build writes the cache.
+        auto written = buildIndex(corpus, true, frameMode);
+        BOOST_CHECK(fexists(L"test.tmp.mlf.cntkidx"));
+        CheckIndicesEqual(expected->GetIndex(), written->GetIndex());
+
+        // The cache is valid for the MLF file, so the second build loads it instead of indexing the file again.
+        Index cached(chunkSize, true, frameMode);
+        uint32_t flags = 1;
+        IndexCache cache(L"test.tmp.mlf", "mlf");
+        BOOST_REQUIRE(cache.TryLoad(corpus, cached, flags));
+        BOOST_CHECK_EQUAL(flags, 0);
+        CheckIndicesEqual(expected->GetIndex(), cached);
+
+        auto restored = buildIndex(corpus, true, frameMode);
+        CheckIndicesEqual(expected->GetIndex(), restored->GetIndex());
+
+        // The keys are stored as strings and mapped through the corpus of the run that loads the cache.
+        auto otherCorpus = make_shared<CorpusDescriptor>(false);
+        otherCorpus->KeyToId("unrelated");
+        CheckIndicesEqual(buildIndex(otherCorpus, false, frameMode)->GetIndex(), buildIndex(otherCorpus, true, frameMode)->GetIndex());
+
+        remove("test.tmp.mlf.cntkidx");
+    }
+
+    remove("test.tmp.mlf");
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 BOOST_AUTO_TEST_SUITE(PackerTests)
@@ -2075,6 +2397,83 @@ BOOST_AUTO_TEST_CASE(SequencePackerSmallChunksWithSequences)
     }
 }
 
+// Reads an epoch and returns the keys of the packed sequences and the number of gaps in the minibatch layouts.
+size_t ReadEpochWithPadding(PackerPtr packer, SequenceEnumeratorPtr randomizer, size_t epochSize, size_t minibatchSize, std::vector<size_t>& keys)
+{
+    EpochConfiguration config;
+    config.m_minibatchSizeInSamples = minibatchSize;
+    config.m_truncationSize = 0;
+    config.m_epochIndex = 0;
+    config.m_totalEpochSizeInSamples = epochSize;
+    config.m_numberOfWorkers = 1;
+    config.m_workerRank = 0;
+
+    packer->SetConfiguration(config, std::vector<MemoryProviderPtr> { std::make_shared<HeapMemoryProvider>() });
+    randomizer->StartEpoch(config);
+
+    size_t numGaps = 0;
+    for (;;)
+    {
+        auto minibatch = packer->ReadMinibatch();
+        if (!minibatch.m_data.empty())
+        {
+            const auto& layout = minibatch.m_data.front()->m_layout;
+            numGaps += layout->GetNumCols() - layout->GetActualNumSamples();
+
+            auto data = (float*)minibatch.m_data.front()->m_data;
+            for (const auto& s : layout->GetAllSequences())
+            {
+                if (s.seqId != GAP_SEQUENCE_ID)
+                    keys.push_back((size_t)data[layout->GetNumParallelSequences() * s.tBegin + s.s]);
+            }
+        }
+
+        if (minibatch.m_endOfEpoch)
+            break;
+    }
+
+    return numGaps;
+}
+
+BOOST_AUTO_TEST_CASE(SequencePackerWithLengthBuckets)
+{
+    size_t chunkSizeInSamples = 20000;
+    size_t sweepNumberOfSamples = 100000;
+    uint32_t maxSequenceLength = 300;
+    size_t randomizationWindow = chunkSizeInSamples * 2;
+    size_t lengthBucketSizeInSamples = 1024;
+
+    auto deserializer = make_shared<SequentialDeserializer>(0, chunkSizeInSamples, sweepNumberOfSamples, maxSequenceLength);
+
+    // All sequences are still delivered once per sweep with the decimation by chunks.
+    {
+        auto blockRandomizer = make_shared<BlockRandomizer>(0, randomizationWindow, deserializer, true, false, 0, true, 0, lengthBucketSizeInSamples);
+        PackerPtr packer = std::make_shared<SequencePacker>(blockRandomizer, deserializer->GetStreamDescriptions(), 1, true);
+
+        CheckPackerOnSweep(packer, blockRandomizer, deserializer, 1, 1024, false, true);
+        CheckPackerOnSweep(packer, blockRandomizer, deserializer, 3, 1024, false, true);
+    }
+
+    // The order is deterministic and the minibatches need less padding than without buckets.
+    auto readEpoch = [&](size_t bucketSize, std::vector<size_t>& keys)
+    {
+        auto blockRandomizer = make_shared<BlockRandomizer>(0, randomizationWindow, deserializer, true, false, 0, true, 0, bucketSize);
+        PackerPtr packer = std::make_shared<SequencePacker>(blockRandomizer, deserializer->GetStreamDescriptions(), 1, true, nullptr, true);
+        return ReadEpochWithPadding(packer, blockRandomizer, sweepNumberOfSamples, 1024, keys);
+    };
+
+    std::vector<size_t> keys1, keys2, keysWithoutBuckets;
+    size_t gaps1 = readEpoch(lengthBucketSizeInSamples, keys1);
+    size_t gaps2 = readEpoch(lengthBucketSizeInSamples, keys2);
+    size_t gapsWithoutBuckets = readEpoch(0, keysWithoutBuckets);
+
+    BOOST_REQUIRE_EQUAL_COLLECTIONS(keys1.begin(), keys1.end(), keys2.begin(), keys2.end());
+    BOOST_REQUIRE_EQUAL(gaps1, gaps2);
+    BOOST_REQUIRE_EQUAL(keys1.size(), keysWithoutBuckets.size());
+    BOOST_REQUIRE_EQUAL(keys1 != keysWithoutBuckets, true);
+    BOOST_REQUIRE_EQUAL(gaps1 < gapsWithoutBuckets, true);
+}
+
 BOOST_AUTO_TEST_CASE(TestTruncatedBpttPacker)
 {
     size_t chunkSizeInSamples = 100;
@@ -2116,6 +2515,188 @@ BOOST_AUTO_TEST_CASE(TestTruncatedBpttPacker)
     BOOST_TEST(!mb.m_endOfSweep);
 }
 
+// A reader that returns the global sample positions as the values of a single dense stream.
+// Every epoch has the same number of samples, and epoch i starts at position i * epochSize.
+class SamplePositionReader : public Reader
+{
+    size_t m_epochSize;
+    size_t m_minibatchSize;
+    size_t m_position;
+    size_t m_endOfEpochPosition;
+    vector<float> m_buffer;
+    StreamDescriptionPtr m_stream;
+
+public:
+    // Total number of minibatches read and number of reads past the end of an epoch.
+    // The shim calls the reader from one prefetch at a time.
+    size_t m_numReads;
+    size_t m_numReadsPastEndOfEpoch;
+
+    SamplePositionReader(size_t epochSize)
+        : m_epochSize(epochSize), m_minibatchSize(0), m_position(0), m_endOfEpochPosition(0), m_numReads(0), m_numReadsPastEndOfEpoch(0)
+    {
+        m_stream = make_shared<StreamDescription>();
+        m_stream->m_id = 0;
+        m_stream->m_name = L"features";
+        m_stream->m_storageType = StorageType::dense;
+        m_stream->m_elementType = ElementType::tfloat;
+        m_stream->m_sampleLayout = make_shared<TensorShape>(1);
+        m_stream->m_definesMbSize = true;
+    }
+
+    vector<StreamDescriptionPtr> GetStreamDescriptions() override
+    {
+        return vector<StreamDescriptionPtr> { m_stream };
+    }
+
+    void StartEpoch(const EpochConfiguration& config, const map<wstring, int>&) override
+    {
+        m_minibatchSize = config.m_minibatchSizeInSamples;
+        m_position = config.m_epochIndex * m_epochSize;
+        m_endOfEpochPosition = m_position + m_epochSize;
+    }
+
+    void SetConfiguration(const ReaderConfiguration& config, const map<wstring, int>&) override
+    {
+        m_minibatchSize = config.m_minibatchSizeInSamples;
+    }
+
+    size_t GetCurrentSamplePosition() override
+    {
+        return m_position;
+    }
+
+    void SetCurrentSamplePosition(size_t currentSamplePosition) override
+    {
+        m_position = currentSamplePosition;
+    }
+
+    Minibatch ReadMinibatch() override
+    {
+        m_numReads++;
+        if (m_position >= m_endOfEpochPosition)
+        {
+            m_numReadsPastEndOfEpoch++;
+            return Minibatch(false, true);
+        }
+
+        size_t numSamples = min(m_minibatchSize, m_endOfEpochPosition - m_position);
+        m_buffer.resize(numSamples);
+        for (size_t i = 0; i < numSamples; ++i)
+            m_buffer[i] = (float)(m_position + i);
+        m_position += numSamples;
+
+        auto stream = make_shared<StreamMinibatch>();
+        stream->m_data = m_buffer.data();
+        stream->m_layout = make_shared<MBLayout>();
+        stream->m_layout->Init(1, numSamples);
+        stream->m_layout->AddSequence(0, 0, 0, numSamples);
+
+        Minibatch minibatch(false, m_position >= m_endOfEpochPosition);
+        minibatch.m_data.push_back(stream);
+        return minibatch;
+    }
+};
+
+// A minibatch as seen by the network: its samples and the sample position the shim reported afterwards.
+struct ShimMinibatch
+{
+    vector<float> m_samples;
+    size_t m_samplePosition;
+    bool m_endOfEpoch;
+
+    bool operator==(const ShimMinibatch& other) const
+    {
+        return m_samples == other.m_samples && m_samplePosition == other.m_samplePosition && m_endOfEpoch == other.m_endOfEpoch;
+    }
+};
+
+// Reads three epochs through a reader shim with the given prefetch depth. The second epoch is
+// rewound to a checkpoint in the middle, the minibatch size is changed in the middle of the third.
+static vector<ShimMinibatch> ReadThroughReaderShim(size_t prefetchDepth, shared_ptr<SamplePositionReader>& reader)
+{
+    const size_t epochSize = 10;
+    const size_t minibatchSize = 3;
+
+    reader = make_shared<SamplePositionReader>(epochSize);
+
+    ConfigParameters config;
+    config.Insert("prefetchDepth", std::to_string(prefetchDepth));
+    config.Insert("maxPrefetchDepth", std::to_string(prefetchDepth));
+    auto shim = new ReaderShim<float>(reader);
+    shim->Init(config);
+
+    StreamMinibatchInputs inputs;
+    inputs.AddInput(L"features", make_shared<Matrix<float>>(CPUDEVICE), make_shared<MBLayout>(), TensorShape(1));
+
+    vector<ShimMinibatch> result;
+    auto readMinibatches = [&](size_t maxMinibatches)
+    {
+        for (size_t i = 0; i < maxMinibatches && shim->GetMinibatch(inputs); ++i)
+        {
+            const auto& matrix = inputs.GetInputMatrix<float>(L"features");
+            ShimMinibatch minibatch;
+            for (size_t j = 0; j < matrix.GetNumCols(); ++j)
+                minibatch.m_samples.push_back(matrix(0, j));
+            minibatch.m_samplePosition = shim->GetCurrentSamplePosition();
+            minibatch.m_endOfEpoch = shim->IsEndOfEpoch();
+            result.push_back(minibatch);
+        }
+    };
+
+    // Epoch 0 is read to the end, the prefetches behind its last minibatch must not read.
+    shim->StartMinibatchLoop(minibatchSize, 0, inputs.GetStreamDescriptions(), epochSize);
+    readMinibatches(SIZE_MAX);
+
+    // Epoch 1 is restored to a checkpoint after the first two minibatches.
+    shim->StartMinibatchLoop(minibatchSize, 1, inputs.GetStreamDescriptions(), epochSize);
+    readMinibatches(2);
+    size_t checkpoint = shim->GetCurrentSamplePosition();
+    readMinibatches(1);
+    shim->SetCurrentSamplePosition(checkpoint);
+    readMinibatches(SIZE_MAX);
+
+    // Epoch 2 continues with a larger minibatch size after the first minibatch.
+    shim->StartMinibatchLoop(minibatchSize, 2, inputs.GetStreamDescriptions(), epochSize);
+    readMinibatches(1);
+    ReaderConfiguration readerConfig;
+    readerConfig.m_numberOfWorkers = 1;
+    readerConfig.m_minibatchSizeInSamples = minibatchSize + 1;
+    shim->SetConfiguration(readerConfig, map<wstring, int>{ { L"features", CPUDEVICE } });
+    readMinibatches(SIZE_MAX);
+
+    shim->Destroy();
+    return result;
+}
+
+BOOST_AUTO_TEST_CASE(ReaderShimWithPrefetchDepth)
+{
+    shared_ptr<SamplePositionReader> reader;
+    auto expected = ReadThroughReaderShim(1, reader);
+    size_t numReadsWithoutDepth = reader->m_numReads;
+    BOOST_CHECK_EQUAL(reader->m_numReadsPastEndOfEpoch, 0);
+
+    // The samples of every minibatch end right before the reported sample position.
+    const vector<size_t> expectedSamplePositions { 3, 6, 9, 10, 13, 16, 19, 19, 20, 23, 27, 30 };
+    BOOST_REQUIRE_EQUAL(expected.size(), expectedSamplePositions.size());
+    for (size_t i = 0; i < expected.size(); ++i)
+    {
+        BOOST_CHECK_EQUAL(expected[i].m_samplePosition, expectedSamplePositions[i]);
+        BOOST_CHECK_EQUAL(expected[i].m_samples.back(), (float)(expected[i].m_samplePosition - 1));
+        BOOST_CHECK_EQUAL(expected[i].m_endOfEpoch, expected[i].m_samplePosition % 10 == 0);
+    }
+
+    for (size_t prefetchDepth : { 2, 3, 4 })
+    {
+        auto actual = ReadThroughReaderShim(prefetchDepth, reader);
+        BOOST_CHECK(actual == expected);
+        BOOST_CHECK_EQUAL(reader->m_numReadsPastEndOfEpoch, 0);
+
+        // The minibatches prefetched before the checkpoint restore and the reconfiguration were read and dropped.
+        BOOST_CHECK_GT(reader->m_numReads, numReadsWithoutDepth);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 } } } }
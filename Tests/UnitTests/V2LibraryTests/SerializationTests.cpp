@@ -13,6 +13,9 @@
 #include <vector>
 #include <functional>
 #include <iostream>
+#ifdef _WIN32
+#include <Windows.h>
+#endif
 
 using namespace CNTK;
 using namespace std;
@@ -443,6 +446,108 @@ void TestFunctionSerialization(const DeviceDescriptor& device)
     TestFunctionSaveAndLoad(BuildLSTMClassifierNet(inputVar, 5, device), device);
 }
 
+// Returns true if 'address' is in a memory mapping of the file 'fileName'.
+bool IsInMappedFile(const void* address, const std::string& fileName)
+{
+#ifdef _WIN32
+    (void)fileName;
+    MEMORY_BASIC_INFORMATION info;
+    return VirtualQuery(address, &info, sizeof(info)) == sizeof(info) && info.Type == MEM_MAPPED;
+#else
+    // Lines of /proc/self/maps are "begin-end permissions offset device inode path".
+    std::ifstream maps("/proc/self/maps");
+    std::string line;
+    while (std::getline(maps, line))
+    {
+        unsigned long long begin, end;
+        if (sscanf(line.c_str(), "%llx-%llx", &begin, &end) != 2)
+            continue;
+        if ((unsigned long long)(uintptr_t)address < begin || (unsigned long long)(uintptr_t)address >= end)
+            continue;
+        return line.size() >= fileName.size() && line.compare(line.size() - fileName.size(), fileName.size(), fileName) == 0;
+    }
+    return false;
+#endif
+}
+
+void TestRawTensorSectionSerialization(const DeviceDescriptor& device)
+{
+    // The raw section is a process-wide setting, make sure that a failing check does not leave it on for other tests.
+    struct RawTensorSectionGuard
+    {
+        RawTensorSectionGuard() { Internal::SetRawTensorSectionInModelFiles(true); }
+        ~RawTensorSectionGuard() { Internal::SetRawTensorSectionInModelFiles(false); }
+    };
+
+    const size_t inputDim = 200;
+    const size_t outputDim = 50;
+    auto inputVar = InputVariable({ inputDim }, DataType::Float, L"features");
+    // Parameters and a constant above, and a constant below the size limit of the raw section.
+    auto largeConstant = Constant(NDArrayView::RandomUniform<float>({ outputDim, outputDim }, -0.5, 0.5, 1, device), L"largeConstant");
+    auto function = Plus(Times(largeConstant, FullyConnectedLinearLayer(inputVar, outputDim, device)), Constant::Scalar(2.0f, device));
+    ForceInitParameters(function);
+
+    const std::string fileName = "TestRawTensorSection.out";
+    auto file = L"TestRawTensorSection.out";
+    DictionaryValue largeValue(*NDArrayView::RandomUniform<double>({ 3000 }, -0.5, 0.5, SentinelValueForAutoSelectRandomSeed, DeviceDescriptor::CPUDevice()));
+    {
+        RawTensorSectionGuard rawTensorSection;
+        function->Save(file);
+        largeValue.Save(tempFilePath);
+    }
+    BOOST_REQUIRE(!Internal::IsRawTensorSectionInModelFilesEnabled());
+
+    auto findLargeConstant = [](const FunctionPtr& f)
+    {
+        auto constants = f->Constants();
+        auto constant = std::find_if(constants.begin(), constants.end(), [](const Constant& c) { return c.Name() == L"largeConstant"; });
+        BOOST_REQUIRE_MESSAGE(constant != constants.end(), "TestRawTensorSectionSerialization: the large constant is missing in the reloaded function.");
+        return *constant;
+    };
+
+    auto originalValues = largeConstant.Value()->DeepClone(DeviceDescriptor::CPUDevice());
+    auto checkValues = [&originalValues](const Constant& constant)
+    {
+        auto values = constant.Value()->DeepClone(DeviceDescriptor::CPUDevice());
+        BOOST_REQUIRE(values->Shape() == originalValues->Shape());
+        const float* expected = originalValues->DataBuffer<float>();
+        const float* actual = values->DataBuffer<float>();
+        for (size_t i = 0; i < values->Shape().TotalSize(); ++i)
+            BOOST_REQUIRE_EQUAL(expected[i], actual[i]);
+    };
+
+    // Mapped from the file.
+    auto reloadedFunction = Function::Load(file, device);
+    if (!AreEqual(function, reloadedFunction))
+        BOOST_ERROR("TestRawTensorSectionSerialization: original and reloaded (mapped) functions are not identical.");
+
+    auto mappedConstant = findLargeConstant(reloadedFunction);
+    checkValues(mappedConstant);
+    if (device.Type() == DeviceKind::CPU)
+    {
+        // The constant is used in place: a read-only view at an aligned address inside the mapping of the file.
+        BOOST_CHECK(mappedConstant.Value()->IsReadOnly());
+        const float* data = mappedConstant.Value()->DataBuffer<float>();
+        BOOST_CHECK_EQUAL((uintptr_t)data % 64, 0);
+        BOOST_CHECK(IsInMappedFile(data, fileName));
+    }
+
+    // Read from a stream.
+    {
+        auto stream = GetFstream(file, true);
+        reloadedFunction = Function::Load(*stream, device);
+    }
+    if (!AreEqual(function, reloadedFunction))
+        BOOST_ERROR("TestRawTensorSectionSerialization: original and reloaded (streamed) functions are not identical.");
+
+    auto streamedConstant = findLargeConstant(reloadedFunction);
+    checkValues(streamedConstant);
+    BOOST_CHECK(!IsInMappedFile(streamedConstant.Value()->DataBuffer<float>(), fileName));
+
+    if (largeValue != DictionaryValue::Load(tempFilePath))
+        BOOST_ERROR("TestRawTensorSectionSerialization: original and deserialized values are not identical.");
+}
+
 TrainerPtr BuildTrainer(const FunctionPtr& function, const Variable& labels,
                      LearningRateSchedule lr = LearningRatePerSampleSchedule(0.005),
                      MomentumSchedule m = MomentumAsTimeConstantSchedule(0.0))
@@ -1005,6 +1110,11 @@ BOOST_AUTO_TEST_CASE(FunctionSerializationInCPU)
     TestFunctionSerialization(DeviceDescriptor::CPUDevice());
 }
 
+BOOST_AUTO_TEST_CASE(RawTensorSectionSerializationInCPU)
+{
+    TestRawTensorSectionSerialization(DeviceDescriptor::CPUDevice());
+}
+
 BOOST_AUTO_TEST_CASE(ModelSerializationDuringTrainingInCPU)
 {
     TestModelSerializationDuringTraining(DeviceDescriptor::CPUDevice());